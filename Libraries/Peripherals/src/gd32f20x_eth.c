@@ -2877,6 +2877,13 @@ static void ETH_Delay(__IO uint32_t nCount)
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-26      Test          First version. Add eth interface to RTT.
+ * 2017-06-29      Test          Receive into pool pbufs and send pbuf chains
+ *                               by DMA descriptors without copy.
+ * 2017-06-29      Test          Checksums by MAC with RT_LWIP_USING_HW_CHECKSUM.
+ * 2017-06-29      Test          Reclaim sent frames in rx thread after tx
+ *                               interrupt, tx may be called by tcpip thread.
+ * 2017-06-29      Test          Receive multicast groups by MAC address 1 to 3,
+ *                               all multicast when more groups joined.
  ******************************************************************************
  */
  
@@ -2902,10 +2909,22 @@ static void ETH_Delay(__IO uint32_t nCount)
 
 #define MAX_ADDR_LEN            (6)
 #define ETH_RXBUFNB         	(4)
-#define ETH_TXBUFNB         	(4)
+#define ETH_TXBUFNB         	(8)     /* one descriptor for each pbuf of a frame */
+
+/* rx descriptors take pool pbufs, dma buffer size must be multiple of 4 */
+#define ETH_RX_BUF_SIZE         (PBUF_POOL_BUFSIZE & ~3)
+
+/* dma of eth only reaches sram, pbufs elsewhere are copied */
+#define ETH_DMA_ADDR_OK(addr)   (((rt_uint32_t)(addr) & 0xE0000000) == 0x20000000)
+
+#if ETH_PAD_SIZE
+#error "rx pbufs are given to dma from payload, ETH_PAD_SIZE must be 0"
+#endif /* ETH_PAD_SIZE */
 
 #define PHY_ADDRESS             (0x01)
 
+#define ETH_MCAST_SLOTS         (3)     /* perfect filters of MAC address 1 to 3 */
+
 /**
  ******************************************************************************
  *                               TYPE DEFINITION
@@ -2944,10 +2963,23 @@ ALIGN(4)
 static ETH_DMADESCTypeDef  DMARxDscrTab[ETH_RXBUFNB];
 ALIGN(4)
 static ETH_DMADESCTypeDef DMATxDscrTab[ETH_TXBUFNB];
-ALIGN(4)
-static rt_uint8_t Rx_Buff[ETH_RXBUFNB][ETH_MAX_FRAME_SIZE];
-ALIGN(4)
-static rt_uint8_t Tx_Buff[ETH_TXBUFNB][ETH_MAX_FRAME_SIZE];
+
+/* pbuf of each rx descriptor, RT_NULL when taken and not refilled */
+static struct pbuf *rx_pbufs[ETH_RXBUFNB];
+static rt_uint32_t  rx_cur;         /* next descriptor to receive */
+static rt_uint32_t  rx_fill;        /* next descriptor to refill */
+
+/* frame sent from each tx descriptor, set on the last one of the frame */
+static struct pbuf *tx_pbufs[ETH_TXBUFNB];
+static rt_uint32_t  tx_cur;         /* next descriptor to send */
+static rt_uint32_t  tx_dirty;       /* next descriptor to reclaim */
+static rt_uint32_t  tx_used;        /* descriptors not reclaimed */
+
+/* multicast addresses received, filtered by MAC address 1 to 3 */
+static const rt_uint32_t mcast_reg[ETH_MCAST_SLOTS] = {ETH_MAC_ADDRESS1, ETH_MAC_ADDRESS2, ETH_MAC_ADDRESS3};
+static rt_uint8_t   mcast_addr[ETH_MCAST_SLOTS][MAX_ADDR_LEN];
+static rt_uint8_t   mcast_refs[ETH_MCAST_SLOTS];
+static rt_uint8_t   mcast_overflow;     /* addresses without filter, all multicast passed */
 
 /**
  ******************************************************************************
@@ -2973,6 +3005,13 @@ struct pbuf *       rt_gd32_eth_rx      (rt_device_t dev);
 static void RCC_Configuration   (void);
 static void GPIO_Configuration  (void);
 static void NVIC_Configuration  (void);
+
+static void     eth_rx_desc_init    (void);
+static rt_err_t eth_rx_refill       (void);
+static void     eth_tx_desc_init    (void);
+static void     eth_tx_reclaim      (void);
+static void     eth_mcast_apply     (void);
+static rt_err_t eth_mcast_filter    (const rt_uint8_t *addr, rt_bool_t add);
  
 /**
  ******************************************************************************
@@ -3009,6 +3048,9 @@ void ETH_IRQHandler(void)
     if ( (status & ETH_DMA_INT_T) != (u32)RESET ) /* packet transmission */
     {
         rt_sem_release(&tx_buf_free);
+        /* let rx thread free frames sent without waiting next tx, TCP does
+           not resend a segment whose pbuf is still held */
+        eth_device_ready(&(gd32_eth_device.parent));
         ETH_DMAClearIntBitState(ETH_DMA_INT_T);
     }
 
@@ -3020,15 +3062,10 @@ void ETH_IRQHandler(void)
     if ((status & ETH_DMA_INT_RO) != (u32)RESET)
         ETH_DMA->STR = (u32)ETH_DMA_INT_RO;
 
+    /* rx dma is resumed after descriptors refilled in rt_gd32_eth_rx() */
     if ((status & ETH_DMA_INT_RBU) != (u32)RESET)
     {
-        ETH_ResumeDMAReception();
-        ETH_DMA->STR = (u32)ETH_DMA_INT_RBU;
-    }
-
-    if ((status & ETH_DMA_INT_RBU) != (u32)RESET)
-    {
-        ETH_ResumeDMATransmission();
+        eth_device_ready(&(gd32_eth_device.parent));
         ETH_DMA->STR = (u32)ETH_DMA_INT_RBU;
     }
 
@@ -3097,22 +3134,25 @@ static rt_err_t rt_gd32_eth_init(rt_device_t dev)
     /* Enable DMA Receive interrupt (need to enable in this case Normal interrupt) */
     ETH_DMAINTConfig(ETH_DMA_INT_NIS | ETH_DMA_INT_R | ETH_DMA_INT_T, ENABLE);
 
-    /* Initialize Tx Descriptors list: Chain Mode */
-    ETH_DMATxDescChainModeInit(DMATxDscrTab, &Tx_Buff[0][0], ETH_TXBUFNB);
-    /* Initialize Rx Descriptors list: Chain Mode  */
-    ETH_DMARxDescChainModeInit(DMARxDscrTab, &Rx_Buff[0][0], ETH_RXBUFNB);
+    /* Initialize Tx Descriptors list: Chain Mode, buffers are pbufs sent */
+    eth_tx_desc_init();
+    /* Initialize Rx Descriptors list: Chain Mode, buffers are pool pbufs,
+       Rx interrupt enabled */
+    eth_rx_desc_init();
 
     /* MAC address configuration */
     ETH_SetMACAddress(ETH_MAC_ADDRESS0, (u8*)&gd32_eth_device.dev_addr[0]);
-    
-    /* Enable Ethernet Rx interrrupt */
-    { 
-        int i;
-        for(i=0; i<ETH_RXBUFNB; i++)
-        {
-            ETH_DMARxDescReceiveINTConfig(&DMARxDscrTab[i], ENABLE);
-        }
+    /* filters are cleared by ETH_DeInit(), groups joined are kept */
+    eth_mcast_apply();
+
+#if CHECKSUM_BY_HARDWARE
+    /* checksums of this netif are inserted and checked by MAC, not lwip.
+       init is called by netif_add() after netif checksum flags set */
+    if (gd32_eth_device.parent.netif != RT_NULL)
+    {
+        NETIF_SET_CHECKSUM_CTRL(gd32_eth_device.parent.netif, NETIF_CHECKSUM_DISABLE_ALL);
     }
+#endif /* CHECKSUM_BY_HARDWARE */
 
     /* Enable MAC and DMA transmission and reception */
     ETH_Enable(ENABLE);
@@ -3152,6 +3192,12 @@ static rt_err_t rt_gd32_eth_control(rt_device_t dev, rt_uint8_t cmd, void *args)
         else return -RT_ERROR;
         break;
 
+    case NIOCTL_ADD_MCAST:
+    case NIOCTL_DEL_MCAST:
+        /* receive or not frames to multicast mac address */
+        if(args) return eth_mcast_filter((rt_uint8_t *)args, cmd == NIOCTL_ADD_MCAST);
+        else return -RT_ERROR;
+
     default :
         break;
     }
@@ -3159,57 +3205,310 @@ static rt_err_t rt_gd32_eth_control(rt_device_t dev, rt_uint8_t cmd, void *args)
     return RT_EOK;
 }
 
-/* ethernet device interface */
-/* transmit packet. */
-rt_err_t rt_gd32_eth_tx( rt_device_t dev, struct pbuf* p)
+/**
+ * @brief  program MAC address 1 to 3 with multicast addresses in use,
+ *         pass all multicast if addresses are more than filters.
+ */
+static void eth_mcast_apply(void)
 {
-    struct pbuf* q;
-    rt_uint32_t offset;
+    int i;
 
-    /* get free tx buffer */
+    for(i = 0; i < ETH_MCAST_SLOTS; i++)
     {
-        rt_err_t result;
-        result = rt_sem_take(&tx_buf_free, 2);
-        if (result != RT_EOK) return -RT_ERROR;
+        if(mcast_refs[i] > 0)
+        {
+            /* high register is overwritten, destination address compared */
+            ETH_SetMACAddress(mcast_reg[i], mcast_addr[i]);
+            ETH_MACAddressFilterConfig(mcast_reg[i], ETH_MAC_ADDRESSFILTER_DA);
+            ETH_MACAddressPerfectFilter_Enable(mcast_reg[i], ENABLE);
+        }
+        else
+        {
+            ETH_MACAddressPerfectFilter_Enable(mcast_reg[i], DISABLE);
+        }
     }
 
-    offset = 0;
-    for (q = p; q != NULL; q = q->next)
+    if(mcast_overflow > 0)
     {
-        rt_uint8_t* ptr;
-        rt_uint32_t len;
+        ETH_MAC->FRMFR |= ETH_MAC_FRMFR_MFD;
+    }
+    else
+    {
+        ETH_MAC->FRMFR &= ~ETH_MAC_FRMFR_MFD;
+    }
+}
 
-        len = q->len;
-        ptr = q->payload;
+/**
+ * @brief  add or delete a multicast address, called by igmp in tcpip thread.
+ *         same address may be added by several groups, counted by reference.
+ * @param  addr: multicast mac address
+ * @param  add: RT_TRUE to add, RT_FALSE to delete
+ * @retval RT_EOK, -RT_ERROR if address is not added
+ */
+static rt_err_t eth_mcast_filter(const rt_uint8_t *addr, rt_bool_t add)
+{
+    int i;
+    int free_slot = -1;
 
-        /* Copy the frame to be sent into memory pointed by the current ETHERNET DMA Tx descriptor */
-        while (len)
+    for(i = 0; i < ETH_MCAST_SLOTS; i++)
+    {
+        if((mcast_refs[i] > 0) && (rt_memcmp(mcast_addr[i], addr, MAX_ADDR_LEN) == 0))
         {
-            (*(__IO uint8_t *)((DMACurrentTxDesc->Buffer1Addr) + offset)) = *ptr;
+            break;
+        }
+        if((mcast_refs[i] == 0) && (free_slot < 0))
+        {
+            free_slot = i;
+        }
+    }
 
-            offset ++;
-            ptr ++;
-            len --;
+    if(add)
+    {
+        if(i < ETH_MCAST_SLOTS)
+        {
+            mcast_refs[i]++;
+        }
+        else if(free_slot >= 0)
+        {
+            rt_memcpy(mcast_addr[free_slot], addr, MAX_ADDR_LEN);
+            mcast_refs[free_slot] = 1;
+        }
+        else
+        {
+            mcast_overflow++;
+        }
+    }
+    else
+    {
+        if(i < ETH_MCAST_SLOTS)
+        {
+            mcast_refs[i]--;
+        }
+        else if(mcast_overflow > 0)
+        {
+            mcast_overflow--;
+        }
+        else
+        {
+            return -RT_ERROR;
         }
     }
 
+    eth_mcast_apply();
+
+    return RT_EOK;
+}
+
+/**
+ * @brief  init tx descriptors in chain mode, free frames left by last init.
+ *         dma has been reset by ETH_DeInit().
+ */
+static void eth_tx_desc_init(void)
+{
+    rt_uint32_t i;
+
+    for(i = 0; i < ETH_TXBUFNB; i++)
+    {
+        if(tx_pbufs[i] != RT_NULL)
+        {
+            pbuf_free(tx_pbufs[i]);
+            tx_pbufs[i] = RT_NULL;
+        }
+        DMATxDscrTab[i].Status = ETH_DMATXDESC_TCHM;
+        DMATxDscrTab[i].Buffer1Addr = 0;
+        DMATxDscrTab[i].Buffer2NextDescAddr = (rt_uint32_t)&DMATxDscrTab[(i + 1) % ETH_TXBUFNB];
+    }
+    tx_cur   = 0;
+    tx_dirty = 0;
+    tx_used  = 0;
+
+    ETH_DMA->TDTAR = (rt_uint32_t)DMATxDscrTab;
+}
+
+/**
+ * @brief  free frames sent by dma, called by tx and rx with interrupt
+ *         disabled. not in interrupt, SYS_ARCH_PROTECT only locks scheduler.
+ */
+static void eth_tx_reclaim(void)
+{
+    while(tx_used > 0 &&
+          (DMATxDscrTab[tx_dirty].Status & ETH_DMATXDESC_BUSY) == (uint32_t)RESET)
+    {
+        if(tx_pbufs[tx_dirty] != RT_NULL)
+        {
+            pbuf_free(tx_pbufs[tx_dirty]);
+            tx_pbufs[tx_dirty] = RT_NULL;
+        }
+        tx_dirty = (tx_dirty + 1) % ETH_TXBUFNB;
+        tx_used--;
+    }
+}
+
+/**
+ * @brief  init rx descriptors in chain mode with pool pbufs, free pbufs left
+ *         by last init. dma has been reset by ETH_DeInit().
+ */
+static void eth_rx_desc_init(void)
+{
+    rt_uint32_t i;
+
+    for(i = 0; i < ETH_RXBUFNB; i++)
+    {
+        if(rx_pbufs[i] != RT_NULL)
+        {
+            pbuf_free(rx_pbufs[i]);
+            rx_pbufs[i] = RT_NULL;
+        }
+        /* owned by CPU until refilled, Rx interrupt enabled */
+        DMARxDscrTab[i].Status = 0;
+        DMARxDscrTab[i].ControlBufferSize = ETH_DMARXDESC_RCHM | ETH_RX_BUF_SIZE;
+        DMARxDscrTab[i].Buffer2NextDescAddr = (rt_uint32_t)&DMARxDscrTab[(i + 1) % ETH_RXBUFNB];
+    }
+    rx_cur  = 0;
+    rx_fill = 0;
+
+    eth_rx_refill();
+
+    ETH_DMA->RDTAR = (rt_uint32_t)DMARxDscrTab;
+}
+
+/**
+ * @brief  give pool pbufs to rx descriptors taken by rt_gd32_eth_rx(), in
+ *         ring order, and resume dma reception.
+ * @retval RT_EOK for all descriptors refilled, -RT_ENOMEM for pool empty
+ */
+static rt_err_t eth_rx_refill(void)
+{
+    struct pbuf *p;
+    rt_uint32_t refilled = 0;
+
+    while(rx_pbufs[rx_fill] == RT_NULL)
+    {
+        p = pbuf_alloc(PBUF_RAW, ETH_RX_BUF_SIZE, PBUF_POOL);
+        if(p == RT_NULL)
+        {
+            break;
+        }
+
+        rx_pbufs[rx_fill] = p;
+        DMARxDscrTab[rx_fill].Buffer1Addr = (rt_uint32_t)p->payload;
+        /* Set Own bit of the Rx descriptor Status: gives the buffer to ETHERNET DMA */
+        DMARxDscrTab[rx_fill].Status = ETH_DMARXDESC_BUSY;
+
+        rx_fill = (rx_fill + 1) % ETH_RXBUFNB;
+        refilled++;
+    }
+
+    if(refilled > 0)
+    {
+        /* Clear RBUS ETHERNET DMA flag and resume DMA reception */
+        ETH_DMA->STR = ETH_DMA_STR_RBU;
+        ETH_DMA->RPER = 0;
+    }
+
+    return (rx_pbufs[rx_fill] == RT_NULL) ? -RT_ENOMEM : RT_EOK;
+}
+
+/* ethernet device interface */
+/* transmit packet. */
+rt_err_t rt_gd32_eth_tx( rt_device_t dev, struct pbuf* p)
+{
+    ETH_DMADESCTypeDef *first;
+    struct pbuf *frame, *q;
+    rt_uint32_t num = 0, used = 0;
+    rt_bool_t   copy = RT_FALSE;
+    rt_base_t   level;
+
+    for (q = p; q != RT_NULL; q = q->next)
+    {
+        if (q->len == 0) continue;
+
+        num++;
+        /* PBUF_REF/PBUF_ROM point to data of caller, such as a buffer given to
+           sendto(), which may be changed after return and before dma reads it */
+        if ((q->type != PBUF_RAM) && (q->type != PBUF_POOL)) copy = RT_TRUE;
+        if (!ETH_DMA_ADDR_OK(q->payload)) copy = RT_TRUE;
+    }
+
+    if (copy || num > ETH_TXBUFNB)
+    {
+        /* send a copy in one descriptor */
+        frame = pbuf_alloc(PBUF_RAW, p->tot_len, PBUF_RAM);
+        if (frame == RT_NULL) return -RT_ENOMEM;
+        pbuf_copy(frame, p);
+        num = 1;
+    }
+    else
+    {
+        /* PBUF_RAM and PBUF_POOL only, held until sent,
+           lwip does not resend or change a pbuf referenced */
+        pbuf_ref(p);
+        frame = p;
+    }
+
 #ifdef ETH_TX_DUMP
-    packet_dump("TX dump", p);
+    packet_dump("TX dump", frame);
 #endif
 
-    /* Setting the Frame Length: bits[12:0] */
-    DMACurrentTxDesc->ControlBufferSize = (p->tot_len & ETH_DMATXDESC_TB1S);
-    /* Setting the last segment and first segment bits (in this case a frame is transmitted in one descriptor) */
-    DMACurrentTxDesc->Status |= ETH_DMATXDESC_LSG | ETH_DMATXDESC_FSG;
-    /* Enable TX Completion Interrupt */
-    DMACurrentTxDesc->Status |= ETH_DMATXDESC_INTC;
+    /* get free tx descriptors, tx interrupt releases the semaphore.
+       a full ring holds the sender for 2 ticks at most */
+    while (ETH_TXBUFNB - tx_used < num)
+    {
+        level = rt_hw_interrupt_disable();
+        eth_tx_reclaim();
+        rt_hw_interrupt_enable(level);
+        if (ETH_TXBUFNB - tx_used >= num) break;
+
+        if (rt_sem_take(&tx_buf_free, 2) != RT_EOK)
+        {
+            pbuf_free(frame);
+            return -RT_EFULL;
+        }
+    }
+
+    /* one descriptor for each pbuf, first one is given to dma at last */
+    first = &DMATxDscrTab[tx_cur];
+    for (q = frame; q != RT_NULL; q = q->next)
+    {
+        ETH_DMADESCTypeDef *desc;
+        rt_uint32_t status = ETH_DMATXDESC_TCHM;
+
+        if (q->len == 0) continue;
 
+        desc = &DMATxDscrTab[tx_cur];
+        if (desc == first)
+        {
+            status |= ETH_DMATXDESC_FSG;
 #if CHECKSUM_BY_HARDWARE
-    DMACurrentTxDesc->Status |= ETH_DMATXDESC_CM_TCPUDPICMP_FULL;
+            status |= ETH_DMATXDESC_CM_TCPUDPICMP_FULL;
 #endif /* CHECKSUM_BY_HARDWARE */
+        }
+        else
+        {
+            status |= ETH_DMATXDESC_BUSY;
+        }
+        if (--num == 0)
+        {
+            /* Enable TX Completion Interrupt on last segment, frame freed after it sent */
+            status |= ETH_DMATXDESC_LSG | ETH_DMATXDESC_INTC;
+            tx_pbufs[tx_cur] = frame;
+        }
 
-    /* Set Own bit of the Tx descriptor Status: gives the buffer back to ETHERNET DMA */
-    DMACurrentTxDesc->Status |= ETH_DMATXDESC_BUSY;
+        desc->Buffer1Addr = (rt_uint32_t)q->payload;
+        desc->ControlBufferSize = (q->len & ETH_DMATXDESC_TB1S);
+        desc->Status = status;
+
+        tx_cur = (tx_cur + 1) % ETH_TXBUFNB;
+        used++;
+    }
+
+    /* Set Own bit of the first Tx descriptor Status: gives the frame to ETHERNET DMA */
+    first->Status |= ETH_DMATXDESC_BUSY;
+
+    /* reclaimed from now */
+    level = rt_hw_interrupt_disable();
+    tx_used += used;
+    rt_hw_interrupt_enable(level);
     /* When Tx Buffer unavailable flag is set: clear it and resume transmission */
     if ((ETH_DMA->STR & ETH_DMA_STR_TBU) != (uint32_t)RESET)
     {
@@ -3219,11 +3518,6 @@ rt_err_t rt_gd32_eth_tx( rt_device_t dev, struct pbuf* p)
         ETH_DMA->TPER = 0;
     }
 
-    /* Update the ETHERNET DMA global Tx descriptor with next Tx decriptor */
-    /* Chained Mode */
-    /* Selects the next DMA Tx descriptor list for next buffer to send */
-    DMACurrentTxDesc = (ETH_DMADESCTypeDef*) (DMACurrentTxDesc->Buffer2NextDescAddr);
-
     /* Return SUCCESS */
     return RT_EOK;
 }
@@ -3231,77 +3525,84 @@ rt_err_t rt_gd32_eth_tx( rt_device_t dev, struct pbuf* p)
 /* reception packet. */
 struct pbuf *rt_gd32_eth_rx(rt_device_t dev)
 {
-    struct pbuf* p;
-    rt_uint32_t framelength = 0;
-
-    /* init p pointer */
-    p = RT_NULL;
+    struct pbuf *p = RT_NULL;
+    rt_uint32_t status, framelength;
+    rt_uint32_t last, num;
+    rt_base_t   level;
 
-    /* Check if the descriptor is owned by the ETHERNET DMA (when set) or CPU (when reset) */
-    if(((DMACurrentRxDesc->Status & ETH_DMARXDESC_BUSY) != (uint32_t)RESET))
-        return p;
+    /* woken by tx interrupt too, free frames sent */
+    level = rt_hw_interrupt_disable();
+    eth_tx_reclaim();
+    rt_hw_interrupt_enable(level);
 
-    if (((DMACurrentRxDesc->Status & ETH_DMARXDESC_ERRS) == (uint32_t)RESET) &&
-            ((DMACurrentRxDesc->Status & ETH_DMARXDESC_LDES) != (uint32_t)RESET) &&
-            ((DMACurrentRxDesc->Status & ETH_DMARXDESC_FDES) != (uint32_t)RESET))
+    /* find the last descriptor of a frame, all owned by CPU */
+    for (last = rx_cur, num = 1; ; last = (last + 1) % ETH_RXBUFNB, num++)
     {
-        /* Get the Frame Length of the received packet: substruct 4 bytes of the CRC */
-        framelength = ((DMACurrentRxDesc->Status & ETH_DMARXDESC_FRML) >> ETH_DMARXDESC_FRAME_LENGTHSHIFT) - 4;
-
-        /* allocate buffer */
-        p = pbuf_alloc(PBUF_LINK, framelength, PBUF_RAM);
-        if (p != RT_NULL)
+        if ((rx_pbufs[last] == RT_NULL) ||
+            ((DMARxDscrTab[last].Status & ETH_DMARXDESC_BUSY) != (uint32_t)RESET))
         {
-            const char * from;
-            struct pbuf* q;
-
-            from = (const char *)(DMACurrentRxDesc->Buffer1Addr);
-
-            for (q = p; q != RT_NULL; q= q->next)
+            /* no frame, or frame is still received */
+            if (eth_rx_refill() != RT_EOK)
             {
-                /* Copy the received frame into buffer from memory pointed by the current ETHERNET DMA Rx descriptor */
-                memcpy(q->payload, from, q->len);
-                from += q->len;
+                /* pool is empty, dma may stop without descriptors, retry later */
+                rt_thread_delay(1);
+                eth_device_ready(&(gd32_eth_device.parent));
             }
+            return RT_NULL;
+        }
 
-#ifdef ETH_RX_DUMP
-            packet_dump("RX dump", p);
-#endif /* ETH_RX_DUMP */
+        /* a frame longer than all descriptors is dropped */
+        if (((DMARxDscrTab[last].Status & ETH_DMARXDESC_LDES) != (uint32_t)RESET) ||
+            (num == ETH_RXBUFNB))
+        {
+            break;
         }
     }
 
-    /* Set Own bit of the Rx descriptor Status: gives the buffer back to ETHERNET DMA */
-    DMACurrentRxDesc->Status = ETH_DMARXDESC_BUSY;
-
-    /* When Rx Buffer unavailable flag is set: clear it and resume reception */
-    if ((ETH_DMA->STR & ETH_DMA_STR_RBU) != (uint32_t)RESET)
+    status = DMARxDscrTab[last].Status;
+    if (((status & ETH_DMARXDESC_ERRS) != (uint32_t)RESET) ||
+        ((status & ETH_DMARXDESC_LDES) == (uint32_t)RESET) ||
+        ((DMARxDscrTab[rx_cur].Status & ETH_DMARXDESC_FDES) == (uint32_t)RESET))
     {
-        /* Clear RBUS ETHERNET DMA flag */
-        ETH_DMA->STR = ETH_DMA_STR_RBU;
-        /* Resume DMA reception */
-        ETH_DMA->RPER = 0;
+        framelength = 0;
     }
-
-    /* Update the ETHERNET DMA global Rx descriptor with next Rx decriptor */
-    /* Chained Mode */
-    if((DMACurrentRxDesc->ControlBufferSize & ETH_DMARXDESC_RCHM) != (uint32_t)RESET)
+    else
     {
-        /* Selects the next DMA Rx descriptor list for next buffer to read */
-        DMACurrentRxDesc = (ETH_DMADESCTypeDef*) (DMACurrentRxDesc->Buffer2NextDescAddr);
+        /* Get the Frame Length of the received packet: substruct 4 bytes of the CRC */
+        framelength = ((status & ETH_DMARXDESC_FRML) >> ETH_DMARXDESC_FRAME_LENGTHSHIFT) - 4;
     }
-    else /* Ring Mode */
+
+    /* take pbufs of the frame from descriptors, refilled below */
+    while (num--)
     {
-        if((DMACurrentRxDesc->ControlBufferSize & ETH_DMARXDESC_RCHM) != (uint32_t)RESET)
+        if (p == RT_NULL)
         {
-            /* Selects the first DMA Rx descriptor for next buffer to read: last Rx descriptor was used */
-            DMACurrentRxDesc = (ETH_DMADESCTypeDef*) (ETH_DMA->RDTAR);
+            p = rx_pbufs[rx_cur];
         }
         else
         {
-            /* Selects the next DMA Rx descriptor list for next buffer to read */
-            DMACurrentRxDesc = (ETH_DMADESCTypeDef*) ((uint32_t)DMACurrentRxDesc + 0x10 + ((ETH_DMA->BCR & ETH_DMA_BCR_DPSL) >> 2));
+            pbuf_cat(p, rx_pbufs[rx_cur]);
         }
+        rx_pbufs[rx_cur] = RT_NULL;
+        rx_cur = (rx_cur + 1) % ETH_RXBUFNB;
+    }
+
+    if (framelength == 0)
+    {
+        pbuf_free(p);
+        p = RT_NULL;
     }
+    else
+    {
+        /* trim to frame length, pbufs with CRC only are freed */
+        pbuf_realloc(p, framelength);
+
+#ifdef ETH_RX_DUMP
+        packet_dump("RX dump", p);
+#endif /* ETH_RX_DUMP */
+    }
+
+    eth_rx_refill();
 
     return p;
 }
@@ -3554,8 +3855,8 @@ void rt_register_eth_dev(uint8_t mac[6])
     gd32_eth_device.parent.eth_rx     = rt_gd32_eth_rx;
     gd32_eth_device.parent.eth_tx     = rt_gd32_eth_tx;
 
-    /* init tx buffer free semaphore */
-    rt_sem_init(&tx_buf_free, "tx_buf", ETH_TXBUFNB, RT_IPC_FLAG_FIFO);
+    /* init tx done semaphore, released by tx interrupt */
+    rt_sem_init(&tx_buf_free, "tx_buf", 0, RT_IPC_FLAG_FIFO);
 
     /* register eth device */
     eth_device_init(&(gd32_eth_device.parent), "e0");
@@ -14,6 +14,10 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-05      Test          First version.
+ * 2017-06-23      Test          Start trace thread.
+ * 2017-06-27      Test          Start cpu profiler.
+ * 2017-06-29      Test          Start mqtt state push thread.
+ * 2017-06-29      Test          Start wall clock and sntp.
  ******************************************************************************
  */
  
@@ -34,7 +38,10 @@
 #include "embedded_flash.h"
 #include "external_flash.h"
 #include "pcf8563.h"
+#include "wall_clock.h"
 #include "log.h"
+#include "trace.h"
+#include "profiler.h"
 
 #ifdef RT_USING_GD_FLASH
 #include "spi_flash_gd.h"
@@ -168,6 +175,9 @@ static void user_params_init(void)
  */
 static void thread_init(void* parameter)
 {
+    /* account threads cpu time from now on */
+    profiler_init();
+    
 #ifdef RT_USING_GD_FLASH
     /* initailize external flash */
     gd_init(RT_GD_FLASH_DEVICE_NAME, "spi1_0");
@@ -181,6 +191,7 @@ static void thread_init(void* parameter)
     
     /* initailize rtc clock */
     pcf8563_init();
+    wall_clock_init();                  /* reads pcf8563 once */
     
     /* perpare to use log */
     logs_init();
@@ -206,6 +217,8 @@ static void thread_init(void* parameter)
 	eth_system_device_init();    
 	/* initialize lwip system */
 	lwip_system_init();
+    /* discipline wall clock by pc server */
+    wall_clock_sntp_start();
                               
 #endif /* RT_USING_LWIP */
 
@@ -242,6 +255,16 @@ static void thread_init(void* parameter)
 #endif /* RT_USING_LORA */
     
     /* create user threads */
+#if TRACE_DEFERRED
+    tid_trace = rt_thread_create(RT_THREAD_NAME_TRACE,
+                                 thread_trace, 
+                                 RT_NULL,
+                                 RT_THREAD_STACK_SIZE_TRACE, 
+                                 RT_THREAD_PRIORITY_TRACE, 
+                                 RT_THREAD_TIME_SLICE_TRACE);
+    if (tid_trace != RT_NULL) rt_thread_startup(tid_trace);
+#endif /* TRACE_DEFERRED */
+    
     tid_sys_ctrl = rt_thread_create(RT_THREAD_NAME_SYSCTRL,
                                     thread_system_control, 
                                     RT_NULL,
@@ -312,6 +335,15 @@ static void thread_init(void* parameter)
                                       RT_THREAD_PRIORITY_TCP_SERV, 
                                       RT_THREAD_TIME_SLICE_TCP_SERV);
     if (tid_tcp_server != RT_NULL) rt_thread_startup(tid_tcp_server);
+    
+    /* mqtt part */
+    tid_mqtt_push = rt_thread_create(RT_THREAD_NAME_MQTT_PUSH,
+                                     thread_mqtt_push, 
+                                     RT_NULL,
+                                     RT_THREAD_STACK_SIZE_MQTT_PUSH, 
+                                     RT_THREAD_PRIORITY_MQTT_PUSH, 
+                                     RT_THREAD_TIME_SLICE_MQTT_PUSH);
+    if (tid_mqtt_push != RT_NULL) rt_thread_startup(tid_mqtt_push);
 #endif /* RT_USING_LWIP */
     
     /* exit thread when work is done, system will delete this thead automatically */
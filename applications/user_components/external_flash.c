@@ -14,6 +14,9 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-03      Test          First version.
+ * 2017-06-29      Test          Read files by offset and resume downloads.
+ * 2017-06-29      Test          A log is read by one stream at a time.
+ * 2017-06-29      Test          Save mqtt broker in wnc config.
  ******************************************************************************
  */
  
@@ -51,6 +54,7 @@
 #define DEF_NETMASK                 (0x00ffffff)        /* 255.255.255.0 */
 #define DEF_PC_IP                   (0)                 /* not cross network */
 #define DEF_HVCS_IP                 (0)
+#define DEF_MQTT_IP                 (0)                 /* mqtt push disabled */
 
 #define FILE_OPT_STATE_IDLE         (0x00)
 #define FILE_OPT_STATE_DOWNLOAD     (0x01)
@@ -171,7 +175,14 @@ const char file_name_def[MAX_FILE_TYPE_NUM][24]=
  */
 static struct stu_file_operate_state    file_operate_state;
 
+/* name of file downloading by download_open(), checked when resume */
+static char                             download_name[MAX_FILE_NAME_LEN];
+
 static file_info_list_t                 g_file_info_list;
+
+/* reader of each log by file_stream_open(), 0 for none. a log has one read
+ * position, a stream or upload_file() moving it breaks the running one */
+static int                              log_owner[MAX_FILE_TYPE_NUM];
  
 /**
  ******************************************************************************
@@ -758,6 +769,7 @@ void user_init(void)
     g_wnc_config.net_config.netmask  = DEF_NETMASK;
     g_wnc_config.net_config.pc_ip    = DEF_PC_IP;
     g_wnc_config.net_config.hvcs_ip  = DEF_HVCS_IP;
+    g_wnc_config.mqtt_ip             = DEF_MQTT_IP;
     
     rt_device_control(dev_ext_flash, GD_FLASH_CTRL_SCT_ERASE, (void *)WNC_CONFIG_ADDR);
     rt_device_write(dev_ext_flash, WNC_CONFIG_ADDR, &g_wnc_config, sizeof(g_wnc_config));
@@ -806,6 +818,12 @@ void get_wnc_config(void)
         }
     }
     
+    /* saved before mqtt_ip was added */
+    if(g_wnc_config.mqtt_ip == 0xffffffff)
+    {
+        g_wnc_config.mqtt_ip = DEF_MQTT_IP;
+    }
+    
     rt_memcpy(&g_wnc_config_bak, &g_wnc_config, sizeof(g_wnc_config));
 }
 
@@ -970,11 +988,21 @@ int16_t upload_file(rt_uint8_t pack_sn, char *data, rt_uint16_t buf_size)
             name_len = rt_strlen(tmp_name);
             break;
         case SYSTEM_LOG_FILE:
+            if(log_owner[SYSTEM_LOG_FILE] != 0)
+            {
+                /* log is read by a stream */
+                return -1;
+            }
             size = prepare_read_system_log();
             name_len = rt_strlen(file_name_def[SYSTEM_LOG_FILE]);
             rt_memcpy(tmp_name, file_name_def[SYSTEM_LOG_FILE], name_len);                    
             break;
         case WORKSTATE_LOG_FILE:
+            if(log_owner[WORKSTATE_LOG_FILE] != 0)
+            {
+                /* log is read by a stream */
+                return -1;
+            }
             size = prepare_read_work_state_log();
             name_len = rt_strlen(file_name_def[WORKSTATE_LOG_FILE]);
             rt_memcpy(tmp_name, file_name_def[WORKSTATE_LOG_FILE], name_len);                    
@@ -1025,6 +1053,204 @@ void file_operate_reset(void)
     rt_memset(&file_operate_state, 0, sizeof(file_operate_state));
 }
 
+/**
+ * @brief   open a file to read from an offset
+ * @param   stream: pointer to stream to open
+ * @param   name: pointer to file name string
+ * @param   offset: where to start read
+ * @param   owner: reader of the stream, not 0. a log is held by it until
+ *          file_stream_close()
+ * @retval  file size, -1 for file not exist, offset out of file or log held
+ *          by another stream
+ */
+rt_int32_t file_stream_open(struct file_stream *stream, const char *name,
+                            rt_uint32_t offset, int owner)
+{
+    single_file_info_t *info;
+    
+    stream->file_type = get_file_type(name);
+    stream->owner     = owner;
+    if((stream->file_type < MAX_FILE_TYPE_NUM) && (log_owner[stream->file_type] != 0))
+    {
+        /* log is read by another stream */
+        return -1;
+    }
+    
+    switch(stream->file_type)
+    {
+    case REGION_CONFIG_FILE:
+        info = &g_file_info_list.region_config;
+        stream->flash_addr = REGION_CONFIG_FILE_ADDR;
+        break;
+    case LIGHT_CONNECT_FILE:
+        info = &g_file_info_list.light_connect;
+        stream->flash_addr = LIGHT_CONNECT_FILE_ADDR;
+        break;
+    case LIGHT_PARKING_FILE:
+        info = &g_file_info_list.light_parking;
+        stream->flash_addr = LIGHT_PARKING_FILE_ADDR;
+        break;
+    case SENSOR_LIST_FILE:
+        info = &g_file_info_list.sensor_list;
+        stream->flash_addr = SENSOR_LIST_FILE_ADDR;
+        break;
+    case RESERVED_PARKING:
+        info = &g_file_info_list.reserved_parking;
+        stream->flash_addr = RESERVED_PARKING_FILE_ADDR;
+        break;
+    case SYSTEM_LOG_FILE:
+        stream->file_size = prepare_read_system_log();
+        if(offset > stream->file_size)
+        {
+            return -1;
+        }
+        /* logs are read in sequence, skip data before offset */
+        read_system_log(RT_NULL, offset);
+        log_owner[SYSTEM_LOG_FILE] = owner;
+        return stream->file_size;
+    case WORKSTATE_LOG_FILE:
+        stream->file_size = prepare_read_work_state_log();
+        if(offset > stream->file_size)
+        {
+            return -1;
+        }
+        read_work_state_log(RT_NULL, offset);
+        log_owner[WORKSTATE_LOG_FILE] = owner;
+        return stream->file_size;
+    default:
+        /* file type not support */
+        return -1;
+    }
+    
+    if((info->sn == 0xffffffff) || (offset > info->size))
+    {
+        /* file not exist */
+        return -1;
+    }
+    
+    stream->file_size   = info->size;
+    stream->flash_addr += offset;
+    
+    return stream->file_size;
+}
+
+/**
+ * @brief   read data of file opened by file_stream_open()
+ * @param   stream: pointer to opened stream
+ * @param   buf: pointer to data buffer
+ * @param   size: data size want to read, not over end of file
+ * @retval  size read out
+ */
+rt_size_t file_stream_read(struct file_stream *stream, char *buf, rt_uint32_t size)
+{
+    switch(stream->file_type)
+    {
+    case SYSTEM_LOG_FILE:
+        return read_system_log(buf, size);
+    case WORKSTATE_LOG_FILE:
+        return read_work_state_log(buf, size);
+    default:
+        size = rt_device_read(dev_ext_flash, stream->flash_addr, buf, size);
+        stream->flash_addr += size;
+        return size;
+    }
+}
+
+/**
+ * @brief   close a stream opened by file_stream_open(), a log it holds is
+ *          free for other readers
+ * @param   stream: pointer to opened stream
+ */
+void file_stream_close(struct file_stream *stream)
+{
+    if((stream->file_type < MAX_FILE_TYPE_NUM) &&
+       (log_owner[stream->file_type] == stream->owner))
+    {
+        log_owner[stream->file_type] = 0;
+    }
+    stream->owner = 0;
+}
+
+/**
+ * @brief   open a download, resume it when the same file was interrupted
+ * @param   file_name: pointer to file name string
+ * @param   size: file size
+ * @param   offset: offset host asks to resume from, 0 for a new download.
+ *          return offset host should send from
+ * @retval  return 0 when got an error, 1 when success
+ */
+rt_uint8_t download_open(char *file_name, rt_uint32_t size, rt_uint32_t *offset)
+{
+    if((*offset != 0) &&
+       (file_operate_state.state == FILE_OPT_STATE_DOWNLOAD) &&
+       (file_operate_state.file_size == size) &&
+       !rt_strncmp(download_name, file_name, sizeof(download_name)))
+    {
+        /* resume from data already saved */
+        *offset = size - file_operate_state.remain;
+        return 1;
+    }
+    
+    /* new download, file area is erased */
+    *offset = 0;
+    file_operate_reset();
+    if((size == 0) || !process_download_type(file_name, size))
+    {
+        DEBUG_PRINTF("file type not support\r\n");
+        file_operate_reset();
+        return 0;
+    }
+    
+    file_operate_state.state = FILE_OPT_STATE_DOWNLOAD;
+    rt_strncpy(download_name, file_name, sizeof(download_name) - 1);
+    
+    return 1;
+}
+
+/**
+ * @brief   save data of download opened by download_open() to external flash
+ * @param   offset: offset of data in file. return offset of next data needed
+ * @param   data: pointer to data buffer
+ * @param   data_len: data length
+ * @retval  DOWNLOAD_DOWNLOADING: current file downloading not finish yet
+ *          DOWNLOAD_OVER: current file download success
+ *          DOWNLOAD_ERR: data not saved, download goes on from returned offset
+ */
+rt_uint8_t download_write(rt_uint32_t *offset, char *data, rt_uint16_t data_len)
+{
+    rt_uint32_t saved;
+    
+    if(file_operate_state.state != FILE_OPT_STATE_DOWNLOAD)
+    {
+        *offset = 0;
+        return DOWNLOAD_ERR;
+    }
+    
+    /* data must follow what saved */
+    saved = file_operate_state.file_size - file_operate_state.remain;
+    if((*offset != saved) || (data_len > file_operate_state.remain))
+    {
+        DEBUG_PRINTF("offset not correct, now %d, need %d\r\n", *offset, saved);
+        *offset = saved;
+        return DOWNLOAD_ERR;
+    }
+    
+    rt_device_write(dev_ext_flash, file_operate_state.flash_addr, data, data_len);
+    
+    file_operate_state.flash_addr += data_len;
+    file_operate_state.remain     -= data_len;
+    *offset                        = saved + data_len;
+    
+    if(file_operate_state.remain == 0)
+    {
+        finish_download_option();
+        file_operate_reset();
+        return DOWNLOAD_OVER;
+    }
+    
+    return DOWNLOAD_DOWNLOADING;
+}
+
 /**
  * @brief  initalize configure files interrelated lists
  */
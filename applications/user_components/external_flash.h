@@ -14,6 +14,9 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-03      Test          First version.
+ * 2017-06-29      Test          Read files by offset and resume downloads.
+ * 2017-06-21      Test          Reserve a sector for lora calibration cache.
+ * 2017-06-29      Test          Save mqtt broker in wnc config.
  ******************************************************************************
  */
 
@@ -89,6 +92,10 @@
 #define WNC_CONFIG_BAK_SCT          (1000)
 #define WNC_CONFIG_BAK_ADDR         (WNC_CONFIG_BAK_SCT * FLASH_BYTES_PER_SECTOR)
 
+/* sx1301 calibration cache */
+#define LORA_CAL_SCT                (1001)
+#define LORA_CAL_ADDR               (LORA_CAL_SCT * FLASH_BYTES_PER_SECTOR)
+
 /* file types */
 enum file_types
 {
@@ -113,6 +120,20 @@ enum file_types
  ******************************************************************************
  */
 
+/**
+ * @brief  structure containing a file read from an offset, for streaming upload
+ *
+ * @NOTE   log files share one read position, a log is held by one stream
+ *         from file_stream_open() to file_stream_close()
+ */
+struct file_stream
+{
+    rt_uint8_t      file_type;
+    rt_uint32_t     file_size;
+    rt_uint32_t     flash_addr;         /* address of next byte, configure files only */
+    int             owner;              /* reader holding a log, not 0 */
+};
+
 /**
  * @brief  structure containing network configuration parameters
  */
@@ -149,6 +170,8 @@ __packed typedef struct
 	rt_uint32_t			version;
 	net_cfg_t           net_config;
 	lora_cfg_t          lora_config;
+    /* appended so configs saved before keep their layout, they read 0xffffffff */
+    rt_uint32_t         mqtt_ip;            /* broker of mqtt state push, 0 for disabled */
 } wnc_cfg_t;
 
 /**
@@ -188,6 +211,12 @@ extern rt_err_t     set_wnc_config      (void);
 extern rt_int16_t   upload_file         (rt_uint8_t pack_sn, char *data, rt_uint16_t buf_size);
 extern rt_uint8_t   download_file       (rt_uint8_t pack_sn, char *data, rt_uint16_t data_len);
 extern void         file_operate_reset  (void);
+extern rt_int32_t   file_stream_open    (struct file_stream *stream, const char *name,
+                                         rt_uint32_t offset, int owner);
+extern void         file_stream_close   (struct file_stream *stream);
+extern rt_size_t    file_stream_read    (struct file_stream *stream, char *buf, rt_uint32_t size);
+extern rt_uint8_t   download_open       (char *file_name, rt_uint32_t size, rt_uint32_t *offset);
+extern rt_uint8_t   download_write      (rt_uint32_t *offset, char *data, rt_uint16_t data_len);
 extern void         init_parking_lists  (void);
 extern rt_uint32_t  get_file_sn         (void);
 extern void         upgrade_confirm     (void);
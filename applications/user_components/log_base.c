@@ -14,6 +14,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-18      Test          First version.
+ * 2017-06-29      Test          Skip log data by reading to RT_NULL.
  ******************************************************************************
  */
  
@@ -328,7 +329,7 @@ void log_write(char *buf, rt_uint32_t size, enum log_type type)
 
 /**
  * @brief  read string format log data to data buffer
- * @param  buf: pointer to data buffer
+ * @param  buf: pointer to data buffer, RT_NULL to skip data
  * @param  buf_size: maximum size of data buffer
  * @param  type: which file to operate, definition in log_type
  * @retval bytes number read out
@@ -378,12 +379,15 @@ rt_size_t log_read(char *buf, rt_uint32_t buf_size, enum log_type type)
             tmp_size = (buf_size < tmp_size) ? buf_size : tmp_size;
         }
 
-        addr = p_info->base_addr + p_info->read_offset;
-        rt_device_read(dev_ext_flash, addr, buf, tmp_size);
+        if(buf != RT_NULL)
+        {
+            addr = p_info->base_addr + p_info->read_offset;
+            rt_device_read(dev_ext_flash, addr, buf, tmp_size);
+            buf += tmp_size;
+        }
         
         p_info->read_offset += tmp_size;
         read_size           += tmp_size;
-        buf                 += tmp_size;
         buf_size            -= tmp_size;
     }
 
@@ -0,0 +1,182 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : mem_bench.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version, bench_mem moved from profiler.c.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rthw.h>
+
+#include "mem_bench.h"
+#include "gd32f20x.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* bench_mem buffers, largest size and misalignment */
+#define BENCH_MEM_SIZE          (1024 + 4)
+#define BENCH_MEM_RUNS          (8)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+#if MEM_BENCH_ENABLE
+static void        *bench_byte_copy (void *dst, const void *src, rt_ubase_t count);
+#endif /* MEM_BENCH_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#if MEM_BENCH_ENABLE
+/**
+ * @brief  byte copy, the reference rt_memcpy is compared with
+ */
+static void *bench_byte_copy(void *dst, const void *src, rt_ubase_t count)
+{
+    volatile char *d = (volatile char *)dst;
+    const char *s = (const char *)src;
+
+    while(count--)
+    {
+        *d++ = *s++;
+    }
+    return dst;
+}
+#endif /* MEM_BENCH_ENABLE */
+
+/**
+ * @brief  least cycles of one rt_memcpy, rt_memset, rt_memcmp and byte copy
+ *         call over some runs, interrupts are disabled around each call.
+ *         the target side of tools/host_test/test_kservice.c
+ */
+void bench_mem(void)
+{
+#if MEM_BENCH_ENABLE
+    static const rt_uint16_t sizes[] = { 16, 64, 264, 1024 };
+    static const rt_uint8_t  offs[][2] = { { 0, 0 }, { 2, 0 }, { 1, 3 } };
+    rt_uint32_t best[4], cycles;
+    rt_uint8_t *src, *dst;
+    rt_base_t level;
+    int i, k, r, f;
+
+    src = rt_malloc(BENCH_MEM_SIZE);
+    dst = rt_malloc(BENCH_MEM_SIZE);
+    if(src == RT_NULL || dst == RT_NULL)
+    {
+        rt_kprintf("no memory\n");
+        rt_free(src);
+        rt_free(dst);
+        return;
+    }
+    rt_memset(src, 0x5a, BENCH_MEM_SIZE);
+
+    /* the profiler may be off, start the cycle counter without a reset */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    rt_kprintf("size src/dst  memcpy  memset  memcmp  byte copy (cycles)\n");
+    rt_kprintf("---- ------- ------- ------- ------- ---------\n");
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        for(k = 0; k < sizeof(offs) / sizeof(offs[0]); k++)
+        {
+            rt_uint8_t *s = src + offs[k][0];
+            rt_uint8_t *d = dst + offs[k][1];
+
+            for(f = 0; f < 4; f++)
+            {
+                best[f] = 0xffffffff;
+                for(r = 0; r < BENCH_MEM_RUNS; r++)
+                {
+                    level = rt_hw_interrupt_disable();
+                    cycles = DWT->CYCCNT;
+                    switch(f)
+                    {
+                        case 0: rt_memcpy(d, s, sizes[i]); break;
+                        case 1: rt_memset(d, 0xa5, sizes[i]); break;
+                        case 2: rt_memcmp(d, s, sizes[i]); break;
+                        default: bench_byte_copy(d, s, sizes[i]); break;
+                    }
+                    cycles = DWT->CYCCNT - cycles;
+                    rt_hw_interrupt_enable(level);
+                    if(cycles < best[f])
+                    {
+                        best[f] = cycles;
+                    }
+                }
+            }
+            rt_kprintf("%4d %3d/%-3d %7d %7d %7d %9d\n", sizes[i], offs[k][0], offs[k][1],
+                       best[0], best[1], best[2], best[3]);
+        }
+    }
+
+    rt_free(src);
+    rt_free(dst);
+#endif /* MEM_BENCH_ENABLE */
+}
+
+#if defined(RT_USING_FINSH) && MEM_BENCH_ENABLE
+FINSH_FUNCTION_EXPORT(bench_mem, cycles of kservice memory routines);
+#endif /* RT_USING_FINSH && MEM_BENCH_ENABLE */
+
+/* ****************************** end of file ****************************** */
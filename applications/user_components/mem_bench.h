@@ -0,0 +1,84 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : mem_bench.h
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __MEM_BENCH_H__
+#define __MEM_BENCH_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* 1: bench_mem command times kservice memory routines; 0: close */
+#define MEM_BENCH_ENABLE        1
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern void         bench_mem           (void);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __MEM_BENCH_H__ */
+
+/* ****************************** end of file ****************************** */
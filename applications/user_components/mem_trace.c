@@ -0,0 +1,122 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : mem_trace.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version, mem_trace moved from profiler.c.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include "mem_trace.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+#if MEM_TRACE_ENABLE && defined(RT_USING_HOOK)
+static void         mem_trace_malloc(void *ptr, rt_uint32_t size);
+static void         mem_trace_free  (void *ptr);
+#endif /* MEM_TRACE_ENABLE && RT_USING_HOOK */
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#if MEM_TRACE_ENABLE && defined(RT_USING_HOOK)
+/**
+ * @brief  malloc hook of mem_trace, one trace line per allocation
+ */
+static void mem_trace_malloc(void *ptr, rt_uint32_t size)
+{
+    rt_kprintf("m %08x %d\n", (rt_uint32_t)ptr, size);
+}
+
+/**
+ * @brief  free hook of mem_trace, one trace line per release
+ */
+static void mem_trace_free(void *ptr)
+{
+    rt_kprintf("f %08x\n", (rt_uint32_t)ptr);
+}
+#endif /* MEM_TRACE_ENABLE && RT_USING_HOOK */
+
+/**
+ * @brief  start or stop logging rt_malloc and rt_free to console. the log
+ *         is the allocation trace tools/host_test/test_tlsf.c replays.
+ * @param  on: 1 to start, 0 to stop
+ * @NOTE   every call prints a line, the timing of the gateway changes while
+ *         the trace is on.
+ */
+void mem_trace(int on)
+{
+#if MEM_TRACE_ENABLE && defined(RT_USING_HOOK)
+    rt_malloc_sethook(on ? mem_trace_malloc : RT_NULL);
+    rt_free_sethook(on ? mem_trace_free : RT_NULL);
+#endif /* MEM_TRACE_ENABLE && RT_USING_HOOK */
+}
+
+#if defined(RT_USING_FINSH) && MEM_TRACE_ENABLE && defined(RT_USING_HOOK)
+FINSH_FUNCTION_EXPORT(mem_trace, log rt_malloc and rt_free for test_tlsf);
+#endif /* RT_USING_FINSH && MEM_TRACE_ENABLE && RT_USING_HOOK */
+
+/* ****************************** end of file ****************************** */
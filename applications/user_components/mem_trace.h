@@ -0,0 +1,84 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : mem_trace.h
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __MEM_TRACE_H__
+#define __MEM_TRACE_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* 1: mem_trace command logs heap allocations, with RT_USING_HOOK; 0: close */
+#define MEM_TRACE_ENABLE        1
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern void         mem_trace           (int on);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __MEM_TRACE_H__ */
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,315 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : net_perf.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Max of pbuf pool and heap by net_stat windows.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <lwip/tcpip.h>
+#include <lwip/stats.h>
+#include <lwip/sockets.h>
+#include <lwip/apps/lwiperf.h>
+
+#include "net_perf.h"
+#include "net_stat.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+#if NET_PERF_ENABLE
+/* all changed with tcpip core locked */
+static void                 *perf_session = RT_NULL;   /* lwiperf handle */
+static struct net_perf_stat perf_stat;
+static rt_uint32_t          perf_retrans_base;
+static rt_uint32_t          perf_err_base;
+#endif /* NET_PERF_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+#if NET_PERF_ENABLE
+static rt_uint32_t  perf_pool_err   (void);
+static void         perf_usage_start(void);
+static void         perf_report     (void *arg, enum lwiperf_report_type report_type,
+                                     const ip_addr_t *local_addr, u16_t local_port,
+                                     const ip_addr_t *remote_addr, u16_t remote_port,
+                                     u32_t bytes, u32_t ms, u32_t kbps);
+#endif /* NET_PERF_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#if NET_PERF_ENABLE
+/**
+ * @brief  allocation failures of all lwip pools
+ */
+static rt_uint32_t perf_pool_err(void)
+{
+    rt_uint32_t err = 0;
+#if MEMP_STATS
+    int i;
+
+    for(i = 0; i < MEMP_MAX; i++)
+    {
+        err += lwip_stats.memp[i]->err;
+    }
+#endif /* MEMP_STATS */
+
+    return err;
+}
+
+/**
+ * @brief  start usage of a test: max of pbuf pool and heap restart from
+ *         used now in a net_stat window, lwip stats are not written here.
+ *         retransmits and failures are counted from now.
+ */
+static void perf_usage_start(void)
+{
+#if MIB2_STATS
+    perf_retrans_base = lwip_stats.mib2.tcpretranssegs;
+#endif /* MIB2_STATS */
+    net_stat_window_start();
+    perf_err_base = perf_pool_err();
+}
+
+/**
+ * @brief  lwiperf report, a test finished. called in tcpip thread.
+ */
+static void perf_report(void *arg, enum lwiperf_report_type report_type,
+                        const ip_addr_t *local_addr, u16_t local_port,
+                        const ip_addr_t *remote_addr, u16_t remote_port,
+                        u32_t bytes, u32_t ms, u32_t kbps)
+{
+    if(++perf_stat.tests == 0)
+    {
+        perf_stat.tests = 1;
+    }
+    perf_stat.report    = report_type;
+    perf_stat.remote_ip = (remote_addr != RT_NULL) ? ip4_addr_get_u32(ip_2_ip4(remote_addr)) : 0;
+    perf_stat.bytes     = bytes;
+    perf_stat.ms        = ms;
+    perf_stat.kbps      = kbps;
+#if MIB2_STATS
+    perf_stat.retrans   = lwip_stats.mib2.tcpretranssegs - perf_retrans_base;
+#endif /* MIB2_STATS */
+#if MEMP_STATS
+    perf_stat.pbuf_avail= lwip_stats.memp[MEMP_PBUF_POOL]->avail;
+#endif /* MEMP_STATS */
+    perf_stat.pbuf_max  = net_stat_window_pool_max(MEMP_PBUF_POOL);
+    perf_stat.mem_max   = net_stat_window_heap_max();
+    perf_stat.pool_err  = (rt_uint16_t)(perf_pool_err() - perf_err_base);
+
+    if(perf_stat.state == NET_PERF_CLIENT)
+    {
+        /* client session is freed by lwiperf */
+        perf_session    = RT_NULL;
+        perf_stat.state = NET_PERF_IDLE;
+    }
+    else
+    {
+        /* server goes on for next test */
+        perf_usage_start();
+    }
+}
+#endif /* NET_PERF_ENABLE */
+
+/**
+ * @brief  start iperf server on NET_PERF_PORT, a test runs when an iperf
+ *         client (iperf -c) connects.
+ * @retval 0 for success, -1 for test running or no memory
+ */
+int net_perf_server(void)
+{
+#if NET_PERF_ENABLE
+    int ret = -1;
+
+    LOCK_TCPIP_CORE();
+    if(perf_session == RT_NULL)
+    {
+        perf_session = lwiperf_start_tcp_server(IP_ADDR_ANY, NET_PERF_PORT, perf_report, RT_NULL);
+        if(perf_session != RT_NULL)
+        {
+            perf_stat.state = NET_PERF_SERVER;
+            perf_usage_start();
+            ret = 0;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return ret;
+#else
+    return -1;
+#endif /* NET_PERF_ENABLE */
+}
+
+/**
+ * @brief  start iperf client sending to an iperf server (iperf -s)
+ * @param  ip: server address, network order
+ * @param  port: server port
+ * @param  seconds: test time, 1 to NET_PERF_MAX_SECONDS
+ * @retval 0 for success, -1 for test running, bad params or no memory
+ */
+int net_perf_client(rt_uint32_t ip, rt_uint16_t port, rt_uint32_t seconds)
+{
+#if NET_PERF_ENABLE
+    ip_addr_t   addr;
+    int         ret = -1;
+
+    if(ip == 0 || port == 0 || seconds == 0 || seconds > NET_PERF_MAX_SECONDS)
+    {
+        return -1;
+    }
+    ip4_addr_set_u32(ip_2_ip4(&addr), ip);
+
+    LOCK_TCPIP_CORE();
+    if(perf_session == RT_NULL)
+    {
+        perf_usage_start();
+        perf_session = lwiperf_start_tcp_client(&addr, port, seconds, perf_report, RT_NULL);
+        if(perf_session != RT_NULL)
+        {
+            perf_stat.state = NET_PERF_CLIENT;
+            ret = 0;
+        }
+    }
+    UNLOCK_TCPIP_CORE();
+
+    return ret;
+#else
+    return -1;
+#endif /* NET_PERF_ENABLE */
+}
+
+/**
+ * @brief  stop iperf server or client, a test running gives no result
+ */
+void net_perf_stop(void)
+{
+#if NET_PERF_ENABLE
+    LOCK_TCPIP_CORE();
+    if(perf_session != RT_NULL)
+    {
+        lwiperf_abort(perf_session);
+        perf_session    = RT_NULL;
+        perf_stat.state = NET_PERF_IDLE;
+    }
+    UNLOCK_TCPIP_CORE();
+#endif /* NET_PERF_ENABLE */
+}
+
+/**
+ * @brief  get state and result of last test
+ * @param  stat: pointer to save result
+ */
+void net_perf_get(struct net_perf_stat *stat)
+{
+#if NET_PERF_ENABLE
+    LOCK_TCPIP_CORE();
+    *stat = perf_stat;
+    UNLOCK_TCPIP_CORE();
+#else
+    rt_memset(stat, 0, sizeof(*stat));
+#endif /* NET_PERF_ENABLE */
+}
+
+#if defined(RT_USING_FINSH) && NET_PERF_ENABLE
+/**
+ * @brief  start iperf client from finsh, such as perf_client("192.168.1.2", 10)
+ */
+int perf_client(const char *ip, int seconds)
+{
+    return net_perf_client(inet_addr(ip), NET_PERF_PORT, seconds);
+}
+FINSH_FUNCTION_EXPORT(perf_client, start iperf client to server ip for seconds);
+
+/**
+ * @brief  print state and result of last test
+ */
+void perf_result(void)
+{
+    static const char * const state_str[] = {"idle", "server", "client"};
+    struct net_perf_stat stat;
+    struct in_addr remote;
+
+    net_perf_get(&stat);
+    rt_kprintf("state: %s\n", state_str[stat.state]);
+    if(stat.tests == 0)
+    {
+        rt_kprintf("no test finished\n");
+        return;
+    }
+
+    remote.s_addr = stat.remote_ip;
+    rt_kprintf("last test: %s, report %d\n", inet_ntoa(remote), stat.report);
+    rt_kprintf("%u bytes in %u ms, %u kbit/s\n", stat.bytes, stat.ms, stat.kbps);
+    rt_kprintf("retransmits %u, pbuf pool max %u/%u, heap max %u, pool errors %u\n",
+               stat.retrans, stat.pbuf_max, stat.pbuf_avail, stat.mem_max, stat.pool_err);
+}
+FINSH_FUNCTION_EXPORT(perf_result, print iperf test result);
+
+FINSH_FUNCTION_EXPORT(net_perf_server, start iperf server);
+FINSH_FUNCTION_EXPORT(net_perf_stop, stop iperf server or client);
+#endif /* RT_USING_FINSH && NET_PERF_ENABLE */
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,113 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : net_perf.h
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __NET_PERF_H__
+#define __NET_PERF_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* 1: iperf server and client of lwiperf for throughput test; 0: close */
+#define NET_PERF_ENABLE         1
+
+#define NET_PERF_PORT           (5001)  /* iperf port */
+#define NET_PERF_MAX_SECONDS    (600)   /* longest client test */
+
+/* state of net_perf_stat */
+#define NET_PERF_IDLE           (0)
+#define NET_PERF_SERVER         (1)     /* iperf server is listening */
+#define NET_PERF_CLIENT         (2)     /* iperf client is sending */
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  result of last finished test, retrans is 0 without RT_LWIP_STATS
+ */
+struct net_perf_stat
+{
+    rt_uint8_t  state;                  /* NET_PERF_IDLE, _SERVER or _CLIENT */
+    rt_uint8_t  tests;                  /* tests finished, 0 for no result */
+    rt_uint8_t  report;                 /* enum lwiperf_report_type */
+    rt_uint32_t remote_ip;              /* peer of the test, network order */
+    rt_uint32_t bytes;                  /* bytes transferred */
+    rt_uint32_t ms;                     /* test duration */
+    rt_uint32_t kbps;                   /* throughput in kbit/s */
+    rt_uint32_t retrans;                /* tcp segments resent during test */
+    rt_uint16_t pbuf_max;               /* max pool pbufs used during test */
+    rt_uint16_t pbuf_avail;             /* pool pbufs */
+    rt_uint16_t pool_err;               /* memp allocation failures during test */
+    rt_uint32_t mem_max;                /* max lwip heap used during test */
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern int          net_perf_server     (void);
+extern int          net_perf_client     (rt_uint32_t ip, rt_uint16_t port, rt_uint32_t seconds);
+extern void         net_perf_stop       (void);
+extern void         net_perf_get        (struct net_perf_stat *stat);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __NET_PERF_H__ */
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,303 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : net_stat.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Own max of lwip stats, windows for net_perf.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <lwip/opt.h>
+#include <lwip/def.h>
+#include <lwip/sys.h>
+#include <lwip/memp.h>
+#include <lwip/stats.h>
+
+#include "net_stat.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+/* pool names in order of memp_t */
+static const char * const pool_name[MEMP_MAX] =
+{
+#define LWIP_MEMPOOL(name, num, size, desc) desc,
+#include "lwip/priv/memp_std.h"
+};
+
+/* max of lwip stats is only written here. it is folded into max since reset
+   and max of window before restarted, peaks are kept by both */
+#if MEMP_STATS
+static rt_uint16_t  pool_err_base[MEMP_MAX];    /* failures before reset */
+static rt_uint16_t  pool_reset_max[MEMP_MAX];
+static rt_uint16_t  pool_window_max[MEMP_MAX];
+#endif /* MEMP_STATS */
+#if MEM_STATS
+static rt_uint16_t  heap_err_base;
+static mem_size_t   heap_reset_max;
+static mem_size_t   heap_window_max;
+#endif /* MEM_STATS */
+static rt_tick_t    reset_tick;
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+static void         net_stat_fold       (void);
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief  fold max of lwip stats into max since reset and of window,
+ *         then restart it from used now. called with SYS_ARCH_PROTECT.
+ */
+static void net_stat_fold(void)
+{
+#if MEMP_STATS
+    int i;
+
+    for(i = 0; i < MEMP_MAX; i++)
+    {
+        pool_reset_max[i]  = LWIP_MAX(pool_reset_max[i], lwip_stats.memp[i]->max);
+        pool_window_max[i] = LWIP_MAX(pool_window_max[i], lwip_stats.memp[i]->max);
+        lwip_stats.memp[i]->max = lwip_stats.memp[i]->used;
+    }
+#endif /* MEMP_STATS */
+#if MEM_STATS
+    heap_reset_max  = LWIP_MAX(heap_reset_max, lwip_stats.mem.max);
+    heap_window_max = LWIP_MAX(heap_window_max, lwip_stats.mem.max);
+    lwip_stats.mem.max = lwip_stats.mem.used;
+#endif /* MEM_STATS */
+}
+
+/**
+ * @brief  get usage of lwip memp pools
+ * @param  stat: array to save usage
+ * @param  max: elements of stat
+ * @retval pools saved
+ */
+int net_stat_pools(struct net_pool_stat *stat, int max)
+{
+    int i;
+    SYS_ARCH_DECL_PROTECT(level);
+
+    if(max > MEMP_MAX)
+    {
+        max = MEMP_MAX;
+    }
+
+    SYS_ARCH_PROTECT(level);
+    for(i = 0; i < max; i++)
+    {
+        rt_memset(&stat[i], 0, sizeof(stat[i]));
+        stat[i].name = pool_name[i];
+        stat[i].size = memp_pools[i]->size;
+#if MEMP_STATS
+        stat[i].avail = lwip_stats.memp[i]->avail;
+        stat[i].used  = lwip_stats.memp[i]->used;
+        stat[i].max   = LWIP_MAX(pool_reset_max[i], lwip_stats.memp[i]->max);
+        stat[i].err   = lwip_stats.memp[i]->err - pool_err_base[i];
+#endif /* MEMP_STATS */
+    }
+    SYS_ARCH_UNPROTECT(level);
+
+    return max;
+}
+
+/**
+ * @brief  get usage of lwip heap
+ * @param  stat: pointer to save usage
+ */
+void net_stat_heap(struct net_heap_stat *stat)
+{
+    SYS_ARCH_DECL_PROTECT(level);
+
+    rt_memset(stat, 0, sizeof(*stat));
+    stat->size = MEM_SIZE;
+    SYS_ARCH_PROTECT(level);
+#if MEM_STATS
+    stat->avail = lwip_stats.mem.avail;
+    stat->used  = lwip_stats.mem.used;
+    stat->max   = LWIP_MAX(heap_reset_max, lwip_stats.mem.max);
+    stat->err   = lwip_stats.mem.err - heap_err_base;
+#endif /* MEM_STATS */
+    stat->seconds = (rt_tick_get() - reset_tick) / RT_TICK_PER_SECOND;
+    SYS_ARCH_UNPROTECT(level);
+}
+
+/**
+ * @brief  restart max from used now and count failures from now
+ */
+void net_stat_reset(void)
+{
+    int i;
+    SYS_ARCH_DECL_PROTECT(level);
+
+    SYS_ARCH_PROTECT(level);
+    net_stat_fold();
+    for(i = 0; i < MEMP_MAX; i++)
+    {
+#if MEMP_STATS
+        pool_reset_max[i] = lwip_stats.memp[i]->used;
+        pool_err_base[i]  = lwip_stats.memp[i]->err;
+#endif /* MEMP_STATS */
+    }
+#if MEM_STATS
+    heap_reset_max = lwip_stats.mem.used;
+    heap_err_base  = lwip_stats.mem.err;
+#endif /* MEM_STATS */
+    reset_tick = rt_tick_get();
+    SYS_ARCH_UNPROTECT(level);
+}
+
+/**
+ * @brief  start a window, such as a net_perf test, max of window restart
+ *         from used now. max since reset is not changed.
+ */
+void net_stat_window_start(void)
+{
+    int i;
+    SYS_ARCH_DECL_PROTECT(level);
+
+    SYS_ARCH_PROTECT(level);
+    net_stat_fold();
+    for(i = 0; i < MEMP_MAX; i++)
+    {
+#if MEMP_STATS
+        pool_window_max[i] = lwip_stats.memp[i]->used;
+#endif /* MEMP_STATS */
+    }
+#if MEM_STATS
+    heap_window_max = lwip_stats.mem.used;
+#endif /* MEM_STATS */
+    SYS_ARCH_UNPROTECT(level);
+}
+
+/**
+ * @brief  get max of a pool in window
+ * @param  pool: memp_t of the pool
+ * @retval max elements used since window start, 0 without MEMP_STATS
+ */
+rt_uint16_t net_stat_window_pool_max(int pool)
+{
+    rt_uint16_t max = 0;
+#if MEMP_STATS
+    SYS_ARCH_DECL_PROTECT(level);
+
+    if((pool >= 0) && (pool < MEMP_MAX))
+    {
+        SYS_ARCH_PROTECT(level);
+        max = LWIP_MAX(pool_window_max[pool], lwip_stats.memp[pool]->max);
+        SYS_ARCH_UNPROTECT(level);
+    }
+#endif /* MEMP_STATS */
+
+    return max;
+}
+
+/**
+ * @brief  get max of lwip heap in window
+ * @retval max bytes used since window start, 0 without MEM_STATS
+ */
+rt_uint32_t net_stat_window_heap_max(void)
+{
+    rt_uint32_t max = 0;
+#if MEM_STATS
+    SYS_ARCH_DECL_PROTECT(level);
+
+    SYS_ARCH_PROTECT(level);
+    max = LWIP_MAX(heap_window_max, lwip_stats.mem.max);
+    SYS_ARCH_UNPROTECT(level);
+#endif /* MEM_STATS */
+
+    return max;
+}
+
+#ifdef RT_USING_FINSH
+/**
+ * @brief  print usage of lwip heap and memp pools
+ */
+void pool_stat(void)
+{
+    struct net_pool_stat    pools[MEMP_MAX];
+    struct net_heap_stat    heap;
+    int                     num;
+    int                     i;
+
+    net_stat_heap(&heap);
+    num = net_stat_pools(pools, MEMP_MAX);
+
+    rt_kprintf("%u seconds since reset\n", heap.seconds);
+    rt_kprintf("%-16s %5s %5s %5s %5s %5s\n", "pool", "size", "avail", "used", "max", "err");
+    rt_kprintf("%-16s %5u %5u %5u %5u %5u\n", "HEAP", heap.size,
+               heap.avail, heap.used, heap.max, heap.err);
+    for(i = 0; i < num; i++)
+    {
+        rt_kprintf("%-16.16s %5u %5u %5u %5u %5u\n", pools[i].name, pools[i].size,
+                   pools[i].avail, pools[i].used, pools[i].max, pools[i].err);
+    }
+}
+FINSH_FUNCTION_EXPORT(pool_stat, print lwip heap and pool usage);
+FINSH_FUNCTION_EXPORT(net_stat_reset, restart lwip heap and pool usage);
+#endif /* RT_USING_FINSH */
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,113 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : net_stat.h
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Own max of lwip stats, windows for net_perf.
+ ******************************************************************************
+ */
+
+#ifndef __NET_STAT_H__
+#define __NET_STAT_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  usage of a lwip memp pool, all 0 without MEMP_STATS
+ */
+struct net_pool_stat
+{
+    const char  *name;                  /* pool description of memp_std.h */
+    rt_uint16_t size;                   /* element size */
+    rt_uint16_t avail;                  /* elements of pool, 0 for MEMP_MEM_MALLOC */
+    rt_uint16_t used;                   /* elements used now */
+    rt_uint16_t max;                    /* max elements used since reset */
+    rt_uint16_t err;                    /* allocation failures since reset */
+};
+
+/**
+ * @brief  usage of lwip heap (MEM_SIZE), all 0 without MEM_STATS
+ */
+struct net_heap_stat
+{
+    rt_uint32_t size;                   /* MEM_SIZE */
+    rt_uint32_t avail;                  /* bytes of heap */
+    rt_uint32_t used;                   /* bytes used now */
+    rt_uint32_t max;                    /* high-water mark since reset */
+    rt_uint16_t err;                    /* allocation failures since reset */
+    rt_uint32_t seconds;                /* seconds since reset */
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern int          net_stat_pools      (struct net_pool_stat *stat, int max);
+extern void         net_stat_heap       (struct net_heap_stat *stat);
+extern void         net_stat_reset      (void);
+extern void         net_stat_window_start   (void);
+extern rt_uint16_t  net_stat_window_pool_max(int pool);
+extern rt_uint32_t  net_stat_window_heap_max(void);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __NET_STAT_H__ */
+
+/* ****************************** end of file ****************************** */
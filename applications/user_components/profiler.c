@@ -0,0 +1,348 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : profiler.c
+ * Arthor    : Test
+ * Date      : Jun 27th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-27      Test          First version.
+ * 2017-06-29      Test          Add bench_mem for kservice memory routines.
+ * 2017-06-29      Test          Add mem_trace to log heap allocations.
+ * 2017-06-29      Test          Move mem_trace to mem_trace.c.
+ * 2017-06-29      Test          Move bench_mem to mem_bench.c.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rthw.h>
+
+#include "profiler.h"
+#include "gd32f20x.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+#define PROFILER_EVENT_MASK     (PROFILER_EVENT_NUM - 1)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  a thread accounted by profiler
+ */
+struct profiler_thread
+{
+    rt_thread_t             thread;
+    struct profiler_stat    stat;
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+#if PROFILER_ENABLE
+/* all changed in scheduler hook with interrupt disabled */
+static struct profiler_thread   prof_threads[PROFILER_THREAD_NUM];
+static struct profiler_event    prof_events[PROFILER_EVENT_NUM];
+static rt_uint32_t              prof_event_cnt = 0;
+static rt_uint32_t              prof_last_cycle = 0;
+#endif /* PROFILER_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+#if PROFILER_ENABLE
+static rt_uint8_t   profiler_slot   (rt_thread_t thread);
+static void         profiler_hook   (rt_thread_t from, rt_thread_t to);
+#endif /* PROFILER_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#if PROFILER_ENABLE
+/**
+ * @brief  get slot of a thread, a free slot is given to the thread on its
+ *         first switch.
+ * @param  thread: thread switched
+ * @retval slot index, PROFILER_NO_THREAD if no free slot
+ */
+static rt_uint8_t profiler_slot(rt_thread_t thread)
+{
+    int i;
+
+    for(i = 0; i < PROFILER_THREAD_NUM; i++)
+    {
+        if(prof_threads[i].thread == thread)
+        {
+            return i;
+        }
+        if(prof_threads[i].thread == RT_NULL)
+        {
+            /* slots are taken in order, first free slot ends the search */
+            prof_threads[i].thread = thread;
+            rt_strncpy(prof_threads[i].stat.name, thread->name, RT_NAME_MAX);
+            return i;
+        }
+    }
+
+    return PROFILER_NO_THREAD;
+}
+
+/**
+ * @brief  scheduler hook, charge cycles since last switch to from thread.
+ *         called by rt_schedule() with interrupt disabled, time of
+ *         interrupts is charged to the thread interrupted.
+ * @param  from: thread switched out
+ * @param  to: thread switched in
+ */
+static void profiler_hook(rt_thread_t from, rt_thread_t to)
+{
+    rt_uint32_t now = DWT->CYCCNT;
+    rt_uint32_t slice = now - prof_last_cycle;
+    struct profiler_event *event;
+    rt_uint8_t  from_slot, to_slot;
+
+    from_slot = profiler_slot(from);
+    to_slot   = profiler_slot(to);
+
+    if(from_slot != PROFILER_NO_THREAD)
+    {
+        struct profiler_stat *stat = &prof_threads[from_slot].stat;
+
+        stat->run_lo += slice;
+        if(stat->run_lo < slice)
+        {
+            stat->run_hi++;
+        }
+        if(slice > stat->max_slice)
+        {
+            stat->max_slice = slice;
+        }
+    }
+    if(to_slot != PROFILER_NO_THREAD)
+    {
+        prof_threads[to_slot].stat.switches++;
+    }
+
+    event = &prof_events[prof_event_cnt & PROFILER_EVENT_MASK];
+    event->cycle = now;
+    event->from  = from_slot;
+    event->to    = to_slot;
+    prof_event_cnt++;
+
+    prof_last_cycle = now;
+}
+#endif /* PROFILER_ENABLE */
+
+/**
+ * @brief  start DWT cycle counter and account threads in scheduler hook
+ */
+void profiler_init(void)
+{
+#if PROFILER_ENABLE
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    profiler_reset();
+    rt_scheduler_sethook(profiler_hook);
+#endif /* PROFILER_ENABLE */
+}
+
+/**
+ * @brief  clear statistics and switch events of all threads
+ */
+void profiler_reset(void)
+{
+#if PROFILER_ENABLE
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    rt_memset(prof_threads, 0, sizeof(prof_threads));
+    prof_event_cnt  = 0;
+    prof_last_cycle = DWT->CYCCNT;
+    rt_hw_interrupt_enable(level);
+#endif /* PROFILER_ENABLE */
+}
+
+/**
+ * @brief  get cpu time of a thread
+ * @param  index: thread slot index
+ * @param  stat: pointer to save statistics
+ * @retval 0 for success, -1 for no thread in the slot
+ */
+int profiler_get(int index, struct profiler_stat *stat)
+{
+#if PROFILER_ENABLE
+    rt_base_t level;
+    int ret = -1;
+
+    if(index < 0 || index >= PROFILER_THREAD_NUM)
+    {
+        return -1;
+    }
+
+    level = rt_hw_interrupt_disable();
+    if(prof_threads[index].thread != RT_NULL)
+    {
+        *stat = prof_threads[index].stat;
+        ret = 0;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return ret;
+#else
+    return -1;
+#endif /* PROFILER_ENABLE */
+}
+
+/**
+ * @brief  get recent switch events, oldest first
+ * @param  events: buffer to save events
+ * @param  num: max events to get
+ * @retval number of events saved
+ */
+int profiler_get_events(struct profiler_event *events, int num)
+{
+#if PROFILER_ENABLE
+    rt_base_t   level;
+    rt_uint32_t start;
+    int i;
+
+    level = rt_hw_interrupt_disable();
+    if(num > PROFILER_EVENT_NUM)
+    {
+        num = PROFILER_EVENT_NUM;
+    }
+    if(num > prof_event_cnt)
+    {
+        num = prof_event_cnt;
+    }
+    start = prof_event_cnt - num;
+    for(i = 0; i < num; i++)
+    {
+        events[i] = prof_events[(start + i) & PROFILER_EVENT_MASK];
+    }
+    rt_hw_interrupt_enable(level);
+
+    return num;
+#else
+    return 0;
+#endif /* PROFILER_ENABLE */
+}
+
+#if defined(RT_USING_FINSH) && PROFILER_ENABLE
+/**
+ * @brief  print cpu usage of threads since profiler reset
+ */
+void list_cpu(void)
+{
+    struct profiler_stat stat;
+    rt_uint32_t total = 0;
+    rt_uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    int i;
+
+    /* 1024 cycles unit, enough for 10 hours */
+    for(i = 0; profiler_get(i, &stat) == 0; i++)
+    {
+        total += (stat.run_hi << 22) | (stat.run_lo >> 10);
+    }
+    if(total < 1000)
+    {
+        rt_kprintf("profiler has run too short\n");
+        return;
+    }
+
+    rt_kprintf("thread   cpu(%%)  switches  max slice(us)\n");
+    rt_kprintf("-------- ------- --------- -------------\n");
+    for(i = 0; profiler_get(i, &stat) == 0; i++)
+    {
+        rt_uint32_t permille = ((stat.run_hi << 22) | (stat.run_lo >> 10)) / (total / 1000);
+
+        rt_kprintf("%-*.*s %3d.%d   %9d %13d\n",
+                   RT_NAME_MAX, RT_NAME_MAX, stat.name,
+                   permille / 10, permille % 10,
+                   stat.switches,
+                   stat.max_slice / cycles_per_us);
+    }
+}
+FINSH_FUNCTION_EXPORT(list_cpu, list cpu usage of threads);
+
+/**
+ * @brief  print recent context switches, cycles are relative to the oldest
+ */
+void list_cpu_events(void)
+{
+    static struct profiler_event events[PROFILER_EVENT_NUM];
+    struct profiler_stat from, to;
+    int num, i;
+
+    num = profiler_get_events(events, PROFILER_EVENT_NUM);
+    for(i = 0; i < num; i++)
+    {
+        if(profiler_get(events[i].from, &from) != 0)
+        {
+            rt_strncpy(from.name, "?", RT_NAME_MAX);
+        }
+        if(profiler_get(events[i].to, &to) != 0)
+        {
+            rt_strncpy(to.name, "?", RT_NAME_MAX);
+        }
+        rt_kprintf("%10u %-*.*s -> %-*.*s\n",
+                   events[i].cycle - events[0].cycle,
+                   RT_NAME_MAX, RT_NAME_MAX, from.name,
+                   RT_NAME_MAX, RT_NAME_MAX, to.name);
+    }
+}
+FINSH_FUNCTION_EXPORT(list_cpu_events, list recent context switches);
+
+FINSH_FUNCTION_EXPORT(profiler_reset, reset cpu usage of threads);
+#endif /* RT_USING_FINSH && PROFILER_ENABLE */
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,114 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : profiler.h
+ * Arthor    : Test
+ * Date      : Jun 27th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-27      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* 1: account threads cpu time in scheduler hook; 0: profiler close */
+#define PROFILER_ENABLE         1
+
+#define PROFILER_THREAD_NUM     (16)    /* threads can be accounted */
+#define PROFILER_EVENT_NUM      (128)   /* recent switches, must be power of 2 */
+
+/* thread index of switch events to threads not accounted */
+#define PROFILER_NO_THREAD      (0xff)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  cpu time of a thread, in DWT cycles of core clock
+ */
+struct profiler_stat
+{
+    char        name[RT_NAME_MAX];
+    rt_uint32_t run_hi;                 /* high 32 bits of run cycles */
+    rt_uint32_t run_lo;                 /* low 32 bits of run cycles */
+    rt_uint32_t switches;               /* times switched in */
+    rt_uint32_t max_slice;              /* longest run in cycles */
+};
+
+/**
+ * @brief  a context switch, from and to are thread index of profiler_get()
+ */
+struct profiler_event
+{
+    rt_uint32_t cycle;                  /* DWT cycle counter at switch */
+    rt_uint8_t  from;
+    rt_uint8_t  to;
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern void         profiler_init       (void);
+extern void         profiler_reset      (void);
+extern int          profiler_get        (int index, struct profiler_stat *stat);
+extern int          profiler_get_events (struct profiler_event *events, int num);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __PROFILER_H__ */
+
+/* ****************************** end of file ****************************** */
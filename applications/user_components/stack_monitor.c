@@ -0,0 +1,412 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : stack_monitor.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Release slots of deleted threads.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rthw.h>
+
+#include "stack_monitor.h"
+#include "log.h"
+#include "gd32f20x.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* backup registers from BKP_DR11: magic, then name hash and peak of slots */
+#define STACK_MON_BKP_MAGIC     (0x5354)
+#define STACK_MON_BKP_REG(n)    ((uint16_t)(BKP_DR11 + (n) * 4))
+#define STACK_MON_BKP_HASH(i)   STACK_MON_BKP_REG(1 + (i) * 2)
+#define STACK_MON_BKP_PEAK(i)   STACK_MON_BKP_REG(2 + (i) * 2)
+
+/* rt_thread_init fills stacks with this */
+#define STACK_FILL_BYTE         ('#')
+
+/* suggested size: peak of all boots with 25% margin, 64 bytes aligned */
+#define STACK_SUGGEST(peak)     RT_ALIGN((peak) + (peak) / 4, 64)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  a thread monitored, slot index is also the backup register slot
+ */
+struct stack_mon_thread
+{
+    rt_thread_t             thread;
+    rt_uint16_t             hash;           /* hash of thread name */
+    rt_uint8_t              warned;         /* usage warning has been logged */
+    rt_uint8_t              warn_pending;   /* usage warning to be logged */
+    rt_uint8_t              seen;           /* found in thread list by last check */
+    struct stack_mon_stat   stat;
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+#if STACK_MON_ENABLE
+/* changed with scheduler locked */
+static struct stack_mon_thread  stack_threads[STACK_MON_THREAD_NUM];
+#endif /* STACK_MON_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+#if STACK_MON_ENABLE
+static rt_uint16_t  stack_name_hash     (const char *name);
+static int          stack_mon_slot      (rt_thread_t thread);
+static rt_uint32_t  stack_measure       (rt_thread_t thread);
+#endif /* STACK_MON_ENABLE */
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#if STACK_MON_ENABLE
+/**
+ * @brief  hash of thread name to find its slot of last boot, never 0
+ * @param  name: thread name
+ * @retval hash value
+ */
+static rt_uint16_t stack_name_hash(const char *name)
+{
+    rt_uint16_t hash = 0;
+    int i;
+
+    for(i = 0; i < RT_NAME_MAX && name[i] != '\0'; i++)
+    {
+        hash = hash * 31 + name[i];
+    }
+
+    return (hash != 0) ? hash : 1;
+}
+
+/**
+ * @brief  get slot of a thread. a new thread takes the slot of same name in
+ *         backup registers, then an empty slot, then a slot not used in this
+ *         boot or released by a deleted thread.
+ * @param  thread: thread checked
+ * @retval slot index, -1 if no free slot
+ */
+static int stack_mon_slot(rt_thread_t thread)
+{
+    struct stack_mon_thread *mon;
+    rt_uint16_t hash;
+    int i, empty = -1, unused = -1, slot = -1;
+
+    for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+    {
+        /* thread objects may be reused after a thread is deleted */
+        if(stack_threads[i].thread == thread &&
+           rt_strncmp(stack_threads[i].stat.name, thread->name, RT_NAME_MAX) == 0)
+        {
+            return i;
+        }
+    }
+
+    hash = stack_name_hash(thread->name);
+    for(i = 0; i < STACK_MON_THREAD_NUM && slot < 0; i++)
+    {
+        rt_uint16_t saved_hash;
+
+        if(stack_threads[i].thread != RT_NULL)
+        {
+            continue;
+        }
+
+        saved_hash = BKP_ReadBackupRegister(STACK_MON_BKP_HASH(i));
+        if(saved_hash == hash)
+        {
+            slot = i;
+        }
+        else if(saved_hash == 0 && empty < 0)
+        {
+            empty = i;
+        }
+        else if(unused < 0)
+        {
+            unused = i;
+        }
+    }
+
+    if(slot < 0)
+    {
+        slot = (empty >= 0) ? empty : unused;
+        if(slot < 0)
+        {
+            return -1;
+        }
+        BKP_WriteBackupRegister(STACK_MON_BKP_HASH(slot), hash);
+        BKP_WriteBackupRegister(STACK_MON_BKP_PEAK(slot), 0);
+    }
+
+    mon = &stack_threads[slot];
+    rt_memset(mon, 0, sizeof(*mon));
+    mon->thread     = thread;
+    mon->hash       = hash;
+    mon->stat.size  = thread->stack_size;
+    mon->stat.saved = BKP_ReadBackupRegister(STACK_MON_BKP_PEAK(slot));
+    rt_strncpy(mon->stat.name, thread->name, RT_NAME_MAX);
+
+    return slot;
+}
+
+/**
+ * @brief  measure used stack by the fill pattern left untouched at bottom
+ * @param  thread: thread measured
+ * @retval max used bytes of the stack
+ */
+static rt_uint32_t stack_measure(rt_thread_t thread)
+{
+    rt_uint8_t *ptr = (rt_uint8_t *)thread->stack_addr;
+    rt_uint8_t *end = ptr + thread->stack_size;
+
+    while(ptr < end && *ptr == STACK_FILL_BYTE)
+    {
+        ptr++;
+    }
+
+    return (rt_uint32_t)(end - ptr);
+}
+#endif /* STACK_MON_ENABLE */
+
+/**
+ * @brief  enable backup registers, clear them if they are not written by
+ *         stack monitor, such as after backup domain power lost.
+ */
+void stack_monitor_init(void)
+{
+#if STACK_MON_ENABLE
+    int i;
+
+    RCC_APB1PeriphClock_Enable(RCC_APB1PERIPH_PWR | RCC_APB1PERIPH_BKP, ENABLE);
+    PWR_BackupAccess_Enable(ENABLE);
+
+    if(BKP_ReadBackupRegister(STACK_MON_BKP_REG(0)) != STACK_MON_BKP_MAGIC)
+    {
+        for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+        {
+            BKP_WriteBackupRegister(STACK_MON_BKP_HASH(i), 0);
+            BKP_WriteBackupRegister(STACK_MON_BKP_PEAK(i), 0);
+        }
+        BKP_WriteBackupRegister(STACK_MON_BKP_REG(0), STACK_MON_BKP_MAGIC);
+    }
+#endif /* STACK_MON_ENABLE */
+}
+
+/**
+ * @brief  measure stacks of all threads, save new peaks to backup registers
+ *         and log threads using more than STACK_MON_WARN_PERCENT.
+ *         called every STACK_MON_PERIOD seconds by system control thread.
+ */
+void stack_monitor_check(void)
+{
+#if STACK_MON_ENABLE
+    struct rt_object_information *info;
+    struct rt_list_node *node;
+    rt_thread_t thread;
+    int i;
+
+    info = rt_object_get_information(RT_Object_Class_Thread);
+
+    /* no thread is created or deleted while walking the list */
+    rt_enter_critical();
+    for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+    {
+        stack_threads[i].seen = 0;
+    }
+    for(node = info->object_list.next; node != &info->object_list; node = node->next)
+    {
+        struct stack_mon_thread *mon;
+        rt_uint32_t used;
+
+        thread = rt_list_entry(node, struct rt_thread, list);
+        i = stack_mon_slot(thread);
+        if(i < 0)
+        {
+            continue;
+        }
+
+        mon  = &stack_threads[i];
+        mon->seen = 1;
+        used = stack_measure(thread);
+        if(used > mon->stat.peak)
+        {
+            mon->stat.peak = used;
+            if(used > mon->stat.saved)
+            {
+                mon->stat.saved = used;
+                BKP_WriteBackupRegister(STACK_MON_BKP_PEAK(i), (uint16_t)used);
+            }
+        }
+        if(!mon->warned && used * 100 >= mon->stat.size * STACK_MON_WARN_PERCENT)
+        {
+            mon->warned = 1;
+            mon->warn_pending = 1;
+        }
+    }
+
+    /* a deleted thread releases its slot, its peaks stay in backup registers
+     * for the next boot until another thread needs the slot */
+    for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+    {
+        if(stack_threads[i].thread != RT_NULL && !stack_threads[i].seen)
+        {
+            stack_threads[i].thread = RT_NULL;
+        }
+    }
+    rt_exit_critical();
+
+    /* add_log writes flash, not in critical */
+    for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+    {
+        if(stack_threads[i].warn_pending)
+        {
+            char str[48];
+
+            stack_threads[i].warn_pending = 0;
+            rt_snprintf(str, sizeof(str), "stack of %.*s used %d/%d",
+                        RT_NAME_MAX, stack_threads[i].stat.name,
+                        stack_threads[i].stat.peak, stack_threads[i].stat.size);
+            add_log(str);
+        }
+    }
+#endif /* STACK_MON_ENABLE */
+}
+
+/**
+ * @brief  clear peaks of this boot and in backup registers
+ */
+void stack_monitor_clear(void)
+{
+#if STACK_MON_ENABLE
+    int i;
+
+    rt_enter_critical();
+    for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+    {
+        stack_threads[i].stat.peak  = 0;
+        stack_threads[i].stat.saved = 0;
+        stack_threads[i].warned     = 0;
+        BKP_WriteBackupRegister(STACK_MON_BKP_PEAK(i), 0);
+    }
+    rt_exit_critical();
+#endif /* STACK_MON_ENABLE */
+}
+
+/**
+ * @brief  get stack usage of a thread, a deleted thread is kept until
+ *         another thread takes its slot
+ * @param  index: thread slot index
+ * @param  stat: pointer to save usage
+ * @retval 0 for success, -1 for no thread in the slot
+ */
+int stack_monitor_get(int index, struct stack_mon_stat *stat)
+{
+#if STACK_MON_ENABLE
+    int ret = -1;
+
+    if(index < 0 || index >= STACK_MON_THREAD_NUM)
+    {
+        return -1;
+    }
+
+    rt_enter_critical();
+    if(stack_threads[index].thread != RT_NULL || stack_threads[index].stat.name[0] != '\0')
+    {
+        *stat = stack_threads[index].stat;
+        stat->suggest = STACK_SUGGEST(stat->saved);
+        ret = 0;
+    }
+    rt_exit_critical();
+
+    return ret;
+#else
+    return -1;
+#endif /* STACK_MON_ENABLE */
+}
+
+#if defined(RT_USING_FINSH) && STACK_MON_ENABLE
+/**
+ * @brief  measure stacks now and print usage with suggested sizes. the
+ *         compile time need of each thread is given by tools/stack_usage.py
+ */
+void list_stack(void)
+{
+    struct stack_mon_stat stat;
+    int i;
+
+    stack_monitor_check();
+
+    rt_kprintf("thread    size  peak  saved  suggest\n");
+    rt_kprintf("-------- ----- ----- ------ --------\n");
+    for(i = 0; i < STACK_MON_THREAD_NUM; i++)
+    {
+        if(stack_monitor_get(i, &stat) != 0)
+        {
+            continue;
+        }
+        rt_kprintf("%-*.*s %5d %5d %6d %8d\n",
+                   RT_NAME_MAX, RT_NAME_MAX, stat.name,
+                   stat.size, stat.peak, stat.saved, stat.suggest);
+    }
+}
+FINSH_FUNCTION_EXPORT(list_stack, list stack usage and suggested sizes);
+
+FINSH_FUNCTION_EXPORT(stack_monitor_clear, clear stack peaks of threads);
+#endif /* RT_USING_FINSH && STACK_MON_ENABLE */
+
+/* ****************************** end of file ****************************** */
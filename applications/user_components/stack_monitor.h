@@ -0,0 +1,102 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : stack_monitor.h
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __STACK_MONITOR_H__
+#define __STACK_MONITOR_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* 1: measure thread stacks and keep peaks in backup registers; 0: close */
+#define STACK_MON_ENABLE        1
+
+#define STACK_MON_THREAD_NUM    (15)    /* threads can be monitored, limited by backup registers */
+#define STACK_MON_PERIOD        (10)    /* check period in seconds */
+#define STACK_MON_WARN_PERCENT  (90)    /* add a log when a stack is used more */
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  stack usage of a thread in bytes
+ */
+struct stack_mon_stat
+{
+    char        name[RT_NAME_MAX];
+    rt_uint32_t size;                   /* stack size */
+    rt_uint32_t peak;                   /* max used since boot */
+    rt_uint32_t saved;                  /* max used of all boots, kept in backup registers */
+    rt_uint32_t suggest;                /* suggested stack size */
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern void         stack_monitor_init  (void);
+extern void         stack_monitor_check (void);
+extern void         stack_monitor_clear (void);
+extern int          stack_monitor_get   (int index, struct stack_mon_stat *stat);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __STACK_MONITOR_H__ */
+
+/* ****************************** end of file ****************************** */
@@ -14,6 +14,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-19      Test          First version.
+ * 2017-06-29      Test          Read time from wall clock instead of pcf8563.
  ******************************************************************************
  */
  
@@ -25,7 +26,7 @@
  */
 
 #include "log.h"
-#include "pcf8563.h"
+#include "wall_clock.h"
 
 /**
  ******************************************************************************
@@ -85,7 +86,7 @@ void add_log(const char *data)
     char        str_log[256];
     rt_uint32_t len;
     
-    pcf8563_get_datetime(&rtc);
+    wall_clock_get(&rtc);
     
     len = rt_snprintf(str_log, sizeof(str_log),
             "%04d-%02d-%02d %02d:%02d:%02d  %s\r\n",
@@ -110,7 +111,7 @@ rt_size_t prepare_read_system_log(void)
 
 /**
  * @brief  read system log data to buffer
- * @param  buf: pointer to data buffer
+ * @param  buf: pointer to data buffer, RT_NULL to skip data
  * @param  max_size: data size want to read
  * @retval size read out
  */
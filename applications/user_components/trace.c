@@ -0,0 +1,414 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : trace.c
+ * Arthor    : Test
+ * Date      : Jun 23th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-23      Test          First version.
+ * 2017-06-29      Test          Split long hex data, print at once without stack buffer.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <stdarg.h>
+#include <rthw.h>
+
+#include "trace.h"
+#include "gd32f20x.h"
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+#define TRACE_TYPE_ARGS         (0)
+#define TRACE_TYPE_HEX          (1)
+
+#define TRACE_RING_MASK         (TRACE_RING_SIZE - 1)
+#define TRACE_DRAIN_PERIOD      (RT_TICK_PER_SECOND / 10)
+
+/* record is written before head moves and read before tail moves, also a compiler barrier */
+#define TRACE_BARRIER()         __DMB()
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  structure of a trace record, formatted later in trace thread
+ */
+struct trace_record
+{
+    const char      *fmt;                       /* constant format string, identify the record */
+    rt_tick_t       tick;                       /* record time, to merge threads records */
+    rt_uint8_t      type;                       /* arguments or hex data */
+    rt_uint8_t      len;                        /* number of arguments or data bytes */
+    union
+    {
+        rt_uint32_t args[TRACE_MAX_ARGS];
+        rt_uint8_t  data[TRACE_MAX_HEX];
+    } u;
+};
+
+/**
+ * @brief  structure of a thread trace ring, written by owner thread only and
+ *         read by trace thread only, so no lock is needed.
+ */
+struct trace_ring
+{
+    rt_thread_t             owner;
+    volatile rt_uint16_t    head;               /* changed by owner thread */
+    volatile rt_uint16_t    tail;               /* changed by trace thread */
+    volatile rt_uint32_t    dropped;            /* changed by owner thread */
+    rt_uint32_t             reported;           /* dropped records already printed */
+    struct trace_record     records[TRACE_RING_SIZE];
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+rt_thread_t tid_trace = RT_NULL;
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+#if TRACE_DEFERRED
+static struct trace_ring    trace_rings[TRACE_RING_NUM];
+#endif /* TRACE_DEFERRED */
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+static int                  count_args      (const char *fmt);
+static void                 trace_vprintf   (const char *fmt, int cnt, va_list args);
+
+#if TRACE_DEFERRED
+static struct trace_ring *  get_ring        (void);
+static rt_err_t             drain_one       (void);
+#endif /* TRACE_DEFERRED */
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief  count arguments needed by a format string
+ * @param  fmt: format string
+ * @retval number of arguments
+ */
+static int count_args(const char *fmt)
+{
+    int cnt = 0;
+
+    while(*fmt)
+    {
+        if(*fmt++ == '%')
+        {
+            if(*fmt == '%')
+            {
+                fmt++;
+            }
+            else
+            {
+                cnt++;
+            }
+        }
+    }
+
+    return cnt;
+}
+
+/**
+ * @brief  print a trace at once with integer arguments as a record is printed,
+ *         rt_kprintf formats it in its own buffer, not on stack of caller.
+ * @param  fmt: format string
+ * @param  cnt: number of arguments in fmt
+ * @param  args: arguments list
+ */
+static void trace_vprintf(const char *fmt, int cnt, va_list args)
+{
+    rt_uint32_t argv[TRACE_MAX_ARGS] = {0};
+    int         i;
+
+    if(cnt > TRACE_MAX_ARGS)
+    {
+        rt_kprintf("[trace] too many arguments: %s", fmt);
+        return;
+    }
+
+    for(i = 0; i < cnt; i++)
+    {
+        argv[i] = va_arg(args, rt_uint32_t);
+    }
+    rt_kprintf(fmt, argv[0], argv[1], argv[2], argv[3], argv[4], argv[5]);
+}
+
+#if TRACE_DEFERRED
+/**
+ * @brief  get trace ring of current thread, a free ring is given to the
+ *         thread on its first trace.
+ * @retval pointer to the ring, RT_NULL in interrupt or no free ring
+ */
+static struct trace_ring *get_ring(void)
+{
+    rt_thread_t self;
+    rt_base_t   level;
+    int         i;
+
+    if(rt_interrupt_get_nest() != 0)
+    {
+        return RT_NULL;
+    }
+
+    self = rt_thread_self();
+    for(i = 0; i < TRACE_RING_NUM; i++)
+    {
+        if(trace_rings[i].owner == self)
+        {
+            return &trace_rings[i];
+        }
+    }
+
+    /* first trace of this thread */
+    level = rt_hw_interrupt_disable();
+    for(i = 0; i < TRACE_RING_NUM; i++)
+    {
+        if(trace_rings[i].owner == RT_NULL)
+        {
+            trace_rings[i].owner = self;
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return (i < TRACE_RING_NUM) ? &trace_rings[i] : RT_NULL;
+}
+
+/**
+ * @brief  print the oldest trace record of all rings
+ * @retval RT_EOK if a record is printed, -RT_EEMPTY if all rings are empty
+ */
+static rt_err_t drain_one(void)
+{
+    struct trace_ring   *ring = RT_NULL;
+    struct trace_record *rec;
+    int i;
+
+    for(i = 0; i < TRACE_RING_NUM; i++)
+    {
+        struct trace_ring *tmp = &trace_rings[i];
+
+        if(tmp->head == tmp->tail)
+        {
+            continue;
+        }
+        if(ring == RT_NULL ||
+           (rt_int32_t)(tmp->records[tmp->tail & TRACE_RING_MASK].tick -
+                        ring->records[ring->tail & TRACE_RING_MASK].tick) < 0)
+        {
+            ring = tmp;
+        }
+    }
+
+    if(ring == RT_NULL)
+    {
+        return -RT_EEMPTY;
+    }
+
+    rec = &ring->records[ring->tail & TRACE_RING_MASK];
+    TRACE_BARRIER();
+    if(rec->type == TRACE_TYPE_HEX)
+    {
+        for(i = 0; i < rec->len; i++)
+        {
+            rt_kprintf(rec->fmt, rec->u.data[i]);
+        }
+    }
+    else
+    {
+        rt_kprintf(rec->fmt, rec->u.args[0], rec->u.args[1], rec->u.args[2],
+                   rec->u.args[3], rec->u.args[4], rec->u.args[5]);
+    }
+
+    /* give the record back to owner thread after printed */
+    TRACE_BARRIER();
+    ring->tail++;
+
+    return RT_EOK;
+}
+#endif /* TRACE_DEFERRED */
+
+/**
+ * @brief  record a trace, replace rt_kprintf in time critical code.
+ *         only integer arguments are saved, format and "%s" arguments must
+ *         be constant strings.
+ * @param  fmt: format string
+ */
+void trace_printf(const char *fmt, ...)
+{
+    va_list args;
+    int     cnt;
+#if TRACE_DEFERRED
+    struct trace_ring   *ring;
+    struct trace_record *rec;
+    int i;
+
+    cnt = count_args(fmt);
+    ring = get_ring();
+    if(ring == RT_NULL || cnt > TRACE_MAX_ARGS)
+    {
+        va_start(args, fmt);
+        trace_vprintf(fmt, cnt, args);
+        va_end(args);
+        return;
+    }
+
+    if((rt_uint16_t)(ring->head - ring->tail) >= TRACE_RING_SIZE)
+    {
+        ring->dropped++;
+        return;
+    }
+
+    rec = &ring->records[ring->head & TRACE_RING_MASK];
+    rec->fmt  = fmt;
+    rec->tick = rt_tick_get();
+    rec->type = TRACE_TYPE_ARGS;
+    rec->len  = cnt;
+    va_start(args, fmt);
+    for(i = 0; i < cnt; i++)
+    {
+        rec->u.args[i] = va_arg(args, rt_uint32_t);
+    }
+    va_end(args);
+
+    /* publish the record to trace thread */
+    TRACE_BARRIER();
+    ring->head++;
+#else
+    cnt = count_args(fmt);
+    va_start(args, fmt);
+    trace_vprintf(fmt, cnt, args);
+    va_end(args);
+#endif /* TRACE_DEFERRED */
+}
+
+/**
+ * @brief  record data bytes, printed with fmt one by one
+ * @param  fmt: format string of a byte, such as " %02X"
+ * @param  data: pointer to data buffer
+ * @param  len: data length, data over TRACE_MAX_HEX bytes takes several records
+ */
+void trace_hex(const char *fmt, const rt_uint8_t *data, rt_uint8_t len)
+{
+#if TRACE_DEFERRED
+    struct trace_ring   *ring;
+    struct trace_record *rec;
+    rt_uint8_t          size;
+
+    ring = get_ring();
+    if(ring != RT_NULL)
+    {
+        while(len > 0)
+        {
+            if((rt_uint16_t)(ring->head - ring->tail) >= TRACE_RING_SIZE)
+            {
+                /* records of data left are lost */
+                ring->dropped += (len + TRACE_MAX_HEX - 1) / TRACE_MAX_HEX;
+                return;
+            }
+
+            size = (len > TRACE_MAX_HEX) ? TRACE_MAX_HEX : len;
+
+            rec = &ring->records[ring->head & TRACE_RING_MASK];
+            rec->fmt  = fmt;
+            rec->tick = rt_tick_get();
+            rec->type = TRACE_TYPE_HEX;
+            rec->len  = size;
+            rt_memcpy(rec->u.data, data, size);
+
+            TRACE_BARRIER();
+            ring->head++;
+
+            data += size;
+            len  -= size;
+        }
+        return;
+    }
+#endif /* TRACE_DEFERRED */
+    {
+        int i;
+
+        for(i = 0; i < len; i++)
+        {
+            rt_kprintf(fmt, data[i]);
+        }
+    }
+}
+
+/**
+ * @brief  trace thread entry, print records of all threads.
+ * @param  parameter: rt-thread param.
+ */
+void thread_trace(void* parameter)
+{
+#if TRACE_DEFERRED
+    int i;
+
+    while(1)
+    {
+        while(drain_one() == RT_EOK);
+
+        for(i = 0; i < TRACE_RING_NUM; i++)
+        {
+            rt_uint32_t dropped = trace_rings[i].dropped;
+
+            if(dropped != trace_rings[i].reported)
+            {
+                rt_kprintf("\r\n[trace] ring %d dropped %d records\r\n",
+                           i, dropped - trace_rings[i].reported);
+                trace_rings[i].reported = dropped;
+            }
+        }
+
+        rt_thread_delay(TRACE_DRAIN_PERIOD);
+    }
+#endif /* TRACE_DEFERRED */
+}
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,94 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : trace.h
+ * Arthor    : Test
+ * Date      : Jun 23th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-23      Test          First version.
+ * 2017-06-29      Test          Note the check of trace argument count.
+ ******************************************************************************
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* 1: record traces and print them in trace thread; 0: print at once */
+#define TRACE_DEFERRED          1
+
+#define TRACE_RING_NUM          (4)     /* number of threads can trace */
+#define TRACE_RING_SIZE         (32)    /* records of each thread, must be power of 2 */
+/* arguments saved with a format, tools/check_trace_args.py finds calls over it */
+#define TRACE_MAX_ARGS          (6)
+#define TRACE_MAX_HEX           (TRACE_MAX_ARGS * 4)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+extern rt_thread_t  tid_trace;      /* trace thread handler */
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern void         trace_printf    (const char *fmt, ...);
+extern void         trace_hex       (const char *fmt, const rt_uint8_t *data, rt_uint8_t len);
+extern void         thread_trace    (void* parameter);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __TRACE_H__ */
+
+/* ****************************** end of file ****************************** */
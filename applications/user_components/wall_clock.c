@@ -0,0 +1,442 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : wall_clock.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Time got does not go back when pcf8563 is read again.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rthw.h>
+
+#include "wall_clock.h"
+#include "external_flash.h"
+
+#ifdef RT_USING_LWIP
+#include <lwip/tcpip.h>
+#include <lwip/sockets.h>
+#include <lwip/apps/sntp.h>
+#endif /* RT_USING_LWIP */
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+#define US_PER_SEC                  (1000000LL)
+#define SEC_PER_DAY                 (86400L)
+
+/* sntp offset larger than this steps the clock, also backwards */
+#define WALL_CLOCK_STEP_US          (US_PER_SEC)
+/* pcf8563 read again differing more than this is taken */
+#define WALL_CLOCK_RTC_DIFF_US      (2 * US_PER_SEC)
+/* limit of tick rate correction */
+#define WALL_CLOCK_MAX_PPM          (500)
+/* shortest sntp interval to estimate tick rate from */
+#define WALL_CLOCK_MIN_DRIFT_US     (600 * US_PER_SEC)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+/* changed with interrupt disabled, time is local us since 1970-01-01 */
+static long long            clock_us      = 0;      /* time at clock_tick */
+static rt_tick_t            clock_tick    = 0;
+static long long            clock_last_us = 0;      /* last time got, never goes back */
+static long                 clock_ppm     = 0;      /* tick rate correction */
+static long long            sync_us       = 0;      /* time of last sntp sync */
+static rt_uint8_t           clock_valid   = 0;
+static rt_uint8_t           clock_synced  = 0;      /* synced by sntp */
+static volatile rt_uint8_t  save_pending  = 0;      /* write pcf8563 */
+
+static rt_uint32_t          rtc_read_cnt  = 0;      /* seconds since pcf8563 read */
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+static long         days_from_date      (int year, int month, int day);
+static void         date_from_days      (long days, RTC_T *rtc);
+static long long    clock_now           (rt_tick_t tick);
+static rt_err_t     clock_read_rtc      (long long *us);
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief  days since 1970-01-01 of a date
+ */
+static long days_from_date(int year, int month, int day)
+{
+    long era, yoe, doy;
+
+    /* year starts from March, leap day is the last */
+    year -= (month <= 2);
+    era   = year / 400;
+    yoe   = year - era * 400;
+    doy   = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+
+    return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/**
+ * @brief  date and day of week of days since 1970-01-01
+ */
+static void date_from_days(long days, RTC_T *rtc)
+{
+    long era, doe, yoe, doy, mp;
+
+    rtc->week = (rt_uint8_t)((days + 4) % 7);   /* 1970-01-01 is Thursday */
+
+    days += 719468;
+    era   = days / 146097;
+    doe   = days - era * 146097;
+    yoe   = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy   = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp    = (5 * doy + 2) / 153;
+
+    rtc->day   = (rt_uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+    rtc->month = (rt_uint8_t)((mp < 10) ? mp + 3 : mp - 9);
+    rtc->year  = (rt_uint16_t)(yoe + era * 400 + (rtc->month <= 2));
+}
+
+/**
+ * @brief  time at a tick, called with interrupt disabled
+ */
+static long long clock_now(rt_tick_t tick)
+{
+    long long us;
+
+    us  = (long long)(rt_tick_t)(tick - clock_tick) * US_PER_SEC / RT_TICK_PER_SECOND;
+    us += us * clock_ppm / US_PER_SEC;
+
+    return clock_us + us;
+}
+
+/**
+ * @brief  read pcf8563
+ * @param  us: pointer to save local us since 1970-01-01
+ * @retval RT_EOK, other means read failed
+ */
+static rt_err_t clock_read_rtc(long long *us)
+{
+    RTC_T rtc;
+
+    if(pcf8563_get_datetime(&rtc) != RT_EOK)
+    {
+        return RT_ERROR;
+    }
+
+    *us = ((long long)days_from_date(rtc.year, rtc.month, rtc.day) * SEC_PER_DAY +
+           rtc.hour * 3600L + rtc.minute * 60L + rtc.second) * US_PER_SEC;
+
+    return RT_EOK;
+}
+
+/**
+ * @brief  read pcf8563 once to start the clock, pcf8563 must be initialized
+ */
+void wall_clock_init(void)
+{
+    long long   us;
+    rt_base_t   level;
+
+    if(clock_read_rtc(&us) != RT_EOK)
+    {
+        return;
+    }
+
+    level = rt_hw_interrupt_disable();
+    clock_us      = us;
+    clock_tick    = rt_tick_get();
+    clock_last_us = us;
+    clock_valid   = 1;
+    rt_hw_interrupt_enable(level);
+}
+
+/**
+ * @brief  get local time, never goes back except the clock is set or
+ *         stepped by sntp
+ * @param  ms: pointer to save milliseconds, may be RT_NULL
+ * @retval local seconds since 1970-01-01, 0 for clock not started
+ */
+rt_uint32_t wall_clock_time(rt_uint16_t *ms)
+{
+    long long   us;
+    rt_base_t   level;
+
+    level = rt_hw_interrupt_disable();
+    us = clock_valid ? clock_now(rt_tick_get()) : 0;
+    if(us < clock_last_us)
+    {
+        us = clock_last_us;
+    }
+    clock_last_us = us;
+    rt_hw_interrupt_enable(level);
+
+    if(ms != RT_NULL)
+    {
+        *ms = (rt_uint16_t)((us % US_PER_SEC) / 1000);
+    }
+
+    return (rt_uint32_t)(us / US_PER_SEC);
+}
+
+/**
+ * @brief  get local datetime, replaces pcf8563_get_datetime() without I2C
+ * @param  rtc: pointer to datatime structure
+ * @retval RT_EOK, other means clock not started
+ */
+rt_err_t wall_clock_get(RTC_T *rtc)
+{
+    rt_uint32_t sec;
+
+    if(!clock_valid)
+    {
+        return RT_ERROR;
+    }
+
+    sec = wall_clock_time(RT_NULL);
+    date_from_days(sec / SEC_PER_DAY, rtc);
+    sec %= SEC_PER_DAY;
+    rtc->hour   = sec / 3600;
+    rtc->minute = (sec / 60) % 60;
+    rtc->second = sec % 60;
+
+    return RT_EOK;
+}
+
+/**
+ * @brief  set local datetime to pcf8563 and the clock
+ * @param  rtc: pointer to datatime structure
+ * @retval RT_EOK, other means set failed
+ */
+rt_err_t wall_clock_set(RTC_T *rtc)
+{
+    long long   us;
+    rt_base_t   level;
+
+    if(pcf8563_set_datetime(rtc) != RT_EOK)
+    {
+        return RT_ERROR;
+    }
+
+    us = ((long long)days_from_date(rtc->year, rtc->month, rtc->day) * SEC_PER_DAY +
+          rtc->hour * 3600L + rtc->minute * 60L + rtc->second) * US_PER_SEC;
+
+    level = rt_hw_interrupt_disable();
+    clock_us      = us;
+    clock_tick    = rt_tick_get();
+    clock_last_us = us;
+    clock_valid   = 1;
+    clock_synced  = 0;      /* next sntp sync does not estimate rate */
+    rt_hw_interrupt_enable(level);
+    rtc_read_cnt  = 0;
+
+    return RT_EOK;
+}
+
+/**
+ * @brief  called every second by system control thread: moves the base
+ *         forward for tick overflow, writes pcf8563 after sntp synced and
+ *         reads it periodically before synced.
+ */
+void wall_clock_check(void)
+{
+    long long   us;
+    rt_base_t   level;
+    rt_tick_t   tick;
+
+    level = rt_hw_interrupt_disable();
+    tick = rt_tick_get();
+    clock_us   = clock_now(tick);
+    clock_tick = tick;
+    rt_hw_interrupt_enable(level);
+
+    if(save_pending)
+    {
+        RTC_T rtc;
+
+        save_pending = 0;
+        if(wall_clock_get(&rtc) == RT_EOK)
+        {
+            pcf8563_set_datetime(&rtc);
+        }
+    }
+    else if(!clock_synced && ++rtc_read_cnt >= WALL_CLOCK_RTC_PERIOD)
+    {
+        rtc_read_cnt = 0;
+        if(clock_read_rtc(&us) != RT_EOK)
+        {
+            return;
+        }
+
+        /* pcf8563 has seconds only, keep tick time if close. time got
+         * does not go back, it stays until the new base passes it */
+        level = rt_hw_interrupt_disable();
+        tick = rt_tick_get();
+        if(!clock_valid || clock_now(tick) - us >  WALL_CLOCK_RTC_DIFF_US ||
+                           us - clock_now(tick) >  WALL_CLOCK_RTC_DIFF_US)
+        {
+            clock_us      = us;
+            clock_tick    = tick;
+            clock_valid   = 1;
+        }
+        rt_hw_interrupt_enable(level);
+    }
+}
+
+/**
+ * @brief  start sntp client with the pc server of net config
+ */
+void wall_clock_sntp_start(void)
+{
+#ifdef RT_USING_LWIP
+    ip_addr_t server;
+
+    if(g_wnc_config.net_config.pc_ip == 0)
+    {
+        return;
+    }
+    ip4_addr_set_u32(ip_2_ip4(&server), g_wnc_config.net_config.pc_ip);
+
+    LOCK_TCPIP_CORE();
+    if(sntp_enabled())
+    {
+        sntp_stop();
+    }
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setserver(0, &server);
+    sntp_init();
+    UNLOCK_TCPIP_CORE();
+#endif /* RT_USING_LWIP */
+}
+
+/**
+ * @brief  set time from sntp, called in tcpip thread as SNTP_SET_SYSTEM_TIME_US.
+ *         small offsets between two syncs correct the tick rate.
+ * @param  sec: UTC seconds since 1970-01-01
+ * @param  us: microseconds
+ */
+void wall_clock_sntp_set(rt_uint32_t sec, rt_uint32_t us)
+{
+    long long   now, time, offset, interval;
+    rt_base_t   level;
+    rt_tick_t   tick;
+
+    time = ((long long)sec + WALL_CLOCK_TZ_SECONDS) * US_PER_SEC + us;
+
+    level = rt_hw_interrupt_disable();
+    tick   = rt_tick_get();
+    now    = clock_now(tick);
+    offset = time - now;
+
+    if(clock_valid && clock_synced && offset > -WALL_CLOCK_STEP_US && offset < WALL_CLOCK_STEP_US)
+    {
+        interval = now - sync_us;
+        if(interval >= WALL_CLOCK_MIN_DRIFT_US)
+        {
+            /* half of the rate error, for jitter of network delay */
+            clock_ppm += (long)(offset * US_PER_SEC / interval / 2);
+            if(clock_ppm > WALL_CLOCK_MAX_PPM)
+            {
+                clock_ppm = WALL_CLOCK_MAX_PPM;
+            }
+            else if(clock_ppm < -WALL_CLOCK_MAX_PPM)
+            {
+                clock_ppm = -WALL_CLOCK_MAX_PPM;
+            }
+        }
+    }
+    else
+    {
+        /* wrong time from pcf8563 or set by hand */
+        clock_last_us = time;
+    }
+
+    clock_us     = time;
+    clock_tick   = tick;
+    sync_us      = time;
+    clock_valid  = 1;
+    clock_synced = 1;
+    rt_hw_interrupt_enable(level);
+
+    save_pending = 1;
+}
+
+#ifdef RT_USING_FINSH
+/**
+ * @brief  print wall clock
+ */
+void wall_clock(void)
+{
+    RTC_T       rtc;
+    rt_uint16_t ms;
+
+    if(wall_clock_get(&rtc) != RT_EOK)
+    {
+        rt_kprintf("clock not started\n");
+        return;
+    }
+    wall_clock_time(&ms);
+
+    rt_kprintf("%04d-%02d-%02d %02d:%02d:%02d.%03d, week %d\n",
+               rtc.year, rtc.month, rtc.day, rtc.hour, rtc.minute, rtc.second, ms, rtc.week);
+    rt_kprintf("sntp %s, rate correction %d ppm\n",
+               clock_synced ? "synced" : "not synced", clock_ppm);
+}
+FINSH_FUNCTION_EXPORT(wall_clock, print wall clock and sntp state);
+#endif /* RT_USING_FINSH */
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,95 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : wall_clock.h
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __WALL_CLOCK_H__
+#define __WALL_CLOCK_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+#include "pcf8563.h"
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+/* pcf8563 and wall clock keep local time, sntp gives UTC */
+#define WALL_CLOCK_TZ_SECONDS       (8 * 3600)
+
+/* pcf8563 is read again in this period (seconds) until sntp synced */
+#define WALL_CLOCK_RTC_PERIOD       (3600)
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern void         wall_clock_init         (void);
+extern rt_err_t     wall_clock_get          (RTC_T *rtc);
+extern rt_uint32_t  wall_clock_time         (rt_uint16_t *ms);
+extern rt_err_t     wall_clock_set          (RTC_T *rtc);
+extern void         wall_clock_check        (void);
+extern void         wall_clock_sntp_start   (void);
+extern void         wall_clock_sntp_set     (rt_uint32_t sec, rt_uint32_t us);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __WALL_CLOCK_H__ */
+
+/* ****************************** end of file ****************************** */
@@ -14,6 +14,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-19      Test          First version.
+ * 2017-06-29      Test          Read time from wall clock instead of pcf8563.
  ******************************************************************************
  */
  
@@ -25,7 +26,7 @@
  */
 
 #include "log.h"
-#include "pcf8563.h"
+#include "wall_clock.h"
 #include "embedded_flash.h"
 #include "external_flash.h"
 #include "wnc_data_base.h"
@@ -224,7 +225,7 @@ rt_size_t prepare_read_work_state_log(void)
 
 /**
  * @brief  read work state log data to buffer
- * @param  buf: pointer to data buffer
+ * @param  buf: pointer to data buffer, RT_NULL to skip data
  * @param  max_size: data size want to read
  * @retval size read out
  */
@@ -242,7 +243,7 @@ void work_state_power_on(void)
     rt_uint32_t len;
     char        str_log[256];
     
-    pcf8563_get_datetime(&rtc);
+    wall_clock_get(&rtc);
     
 	rt_memset(&g_work_state, 0, sizeof(g_work_state));
 	g_work_state.time_start = rtc;
@@ -320,7 +321,7 @@ void work_state_time_period(void)
     extern rt_uint32_t get_ip_addr(void);
 
 	rt_memset(&rtc, 0, sizeof(rtc));
-    pcf8563_get_datetime(&rtc);
+    wall_clock_get(&rtc);
 
     /* time */
     len = rt_snprintf(str_log, sizeof(str_log), 
@@ -14,6 +14,8 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-22      Test          First version.
+ * 2017-06-25      Test          Scan led in timer2 interrupt with precomputed
+ *                               port words.
  ******************************************************************************
  */
  
@@ -64,9 +66,6 @@ const uint16_t column_gpio_pin[8] =
 	GPIO_PIN_7,
 };
 
-#define SET_COLUMN_ON(x)   GPIO_ResetBits((GPIO_TypeDef*)column_gpio_port[x], column_gpio_pin[x])
-#define SET_COLUMN_OFF(x)  GPIO_SetBits((GPIO_TypeDef*)column_gpio_port[x], column_gpio_pin[x])
-
 const GPIO_TypeDef* row_gpio_port[8] =
 {
 	GPIOE,
@@ -91,14 +90,29 @@ const uint32_t row_gpio_pin[8] =
 	GPIO_PIN_11,
 };
 
-#define SET_ROW_ON(x)      GPIO_ResetBits((GPIO_TypeDef*)row_gpio_port[x], row_gpio_pin[x]) 
-#define SET_ROW_OFF(x)	   GPIO_SetBits((GPIO_TypeDef*)row_gpio_port[x], row_gpio_pin[x])
+/* ports used by rows and columns, written once each for a row scan */
+#define LED_PORT_NUM        (2)
+
+const GPIO_TypeDef* led_gpio_port[LED_PORT_NUM] =
+{
+	GPIOC,
+	GPIOE,
+};
  
 /**
  ******************************************************************************
  *                               TYPE DEFINITION
  ******************************************************************************
  */
+
+/**
+ * @brief  port bit operate words to show a row, low half set pins off and
+ *         high half reset pins on
+ */
+struct led_scan_row
+{
+    rt_uint32_t bor[LED_PORT_NUM];
+};
  
 
 /**
@@ -117,6 +131,10 @@ rt_mq_t     mq_led  = RT_NULL;
  */
 
 static rt_uint8_t dot_buf[8];       /* 1 byte for a line, 1 bit for a light */
+
+/* built from dot_buf by thread, shown by timer2 interrupt */
+static struct led_scan_row  scan_tab[2][8];
+static volatile rt_uint8_t  scan_index = 0;     /* table shown by interrupt */
  
 /**
  ******************************************************************************
@@ -129,6 +147,7 @@ static void TIM2_Configuration  (void);
 static void NVIC_Configuration  (void);
 
 static void led_init            (void);
+static void led_update_scan     (void);
 static void led_test_fresh_buf  (void);
  
 /**
@@ -219,22 +238,23 @@ static void NVIC_Configuration(void)
 }
 
 /**
- * @brief  timer2 interrupt handler
+ * @brief  timer2 interrupt handler, show next row of led module
  */
 void TIMER2_IRQHandler(void)
 {
-    stu_led_msg msg;
-    
-	TIMER_INTConfig(TIMER2, TIMER_INT_UPDATE, DISABLE);
+    static rt_uint8_t row = 0;
+    const struct led_scan_row *line;
+    int i;
 
-    if(mq_led != RT_NULL)
+	TIMER_ClearIntBitState(TIMER2, TIMER_INT_UPDATE);
+
+    line = &scan_tab[scan_index][row];
+    for(i = 0; i < LED_PORT_NUM; i++)
     {
-        msg.type = MSG_LED_REFRESH;
-        rt_mq_send(mq_led, &msg, sizeof(msg));
+        ((GPIO_TypeDef*)led_gpio_port[i])->BOR = line->bor[i];
     }
 
-	TIMER_ClearIntBitState(TIMER2, TIMER_INT_UPDATE);
-	TIMER_INTConfig(TIMER2, TIMER_INT_UPDATE, ENABLE);
+    row = (row + 1) & 0x07;
 }
 
 /**
@@ -243,7 +263,10 @@ void TIMER2_IRQHandler(void)
  */
 static void callback_timer_led_test(void* parameter)
 {
-    led_test_fresh_buf();
+    stu_led_msg msg;
+
+    msg.type = MSG_LED_TEST_FRESH;
+    rt_mq_send(mq_led, &msg, sizeof(msg));
 }
 
 /**
@@ -264,31 +287,59 @@ static void led_init(void)
 	rt_memset((void*)dot_buf, 0, sizeof(dot_buf));
 
 	dot_buf[7] |= 0x05;
+
+    led_update_scan();
 }
 
 /**
- * @brief  refresh led module
+ * @brief  get port index in led_gpio_port
+ * @param  port: gpio port of a row or column
+ * @retval port index
  */
-static void refresh_led(void)
+static int led_port_index(const GPIO_TypeDef* port)
 {
-	static uint8_t row = 0;
-	int i;
+    int i;
 
-	for(i = 0; i < 8; i++)
-	{
-		(row == i) ? SET_ROW_ON(i) : SET_ROW_OFF(i);
-	}
+    for(i = 0; i < LED_PORT_NUM - 1; i++)
+    {
+        if(led_gpio_port[i] == port)
+        {
+            break;
+        }
+    }
 
-	for(i = 0; i < 8; i++)
-	{
-		(dot_buf[row] & (0x80 >> i)) ? SET_COLUMN_ON(i) : SET_COLUMN_OFF(i);
-	}	
+    return i;
+}
+
+/**
+ * @brief  build port words from dot_buf into the table not shown, then
+ *         switch timer2 interrupt to it
+ */
+static void led_update_scan(void)
+{
+    struct led_scan_row *tab = scan_tab[!scan_index];
+    int row, i, port;
 
-    row++;
-	if(row > 7)
+    rt_memset((void*)tab, 0, sizeof(scan_tab[0]));
+
+    for(row = 0; row < 8; row++)
     {
-		row = 0;
+        /* low level turn on both rows and columns */
+        for(i = 0; i < 8; i++)
+        {
+            port = led_port_index(row_gpio_port[i]);
+            tab[row].bor[port] |= (row == i) ? (row_gpio_pin[i] << 16) : row_gpio_pin[i];
+        }
+
+        for(i = 0; i < 8; i++)
+        {
+            port = led_port_index(column_gpio_port[i]);
+            tab[row].bor[port] |= (dot_buf[row] & (0x80 >> i)) ?
+                                  ((rt_uint32_t)column_gpio_pin[i] << 16) : column_gpio_pin[i];
+        }
     }
+
+    scan_index = !scan_index;
 }
 
 /**
@@ -349,9 +400,10 @@ void thread_led(void* parameter)
         {
             switch(msg.type)
             {
-            case MSG_LED_REFRESH:
+            case MSG_LED_TEST_FRESH:
             {
-                refresh_led();
+                led_test_fresh_buf();
+                led_update_scan();
                 break;
             }
             case MSG_LED_SET_LED:
@@ -368,6 +420,7 @@ void thread_led(void* parameter)
                 {
                     dot_buf[row] |= 0x80 >> column;
                 }
+                led_update_scan();
                 break;
             }
             case MSG_LED_TEST:
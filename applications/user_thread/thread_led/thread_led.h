@@ -14,6 +14,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-22      Test          First version.
+ * 2017-06-25      Test          Replace refresh message with test fresh message.
  ******************************************************************************
  */
 
@@ -40,7 +41,7 @@
 #define RT_MQ_NUM_LED                   (10)
 
 /* message types */
-#define MSG_LED_REFRESH                 (0x4001)
+#define MSG_LED_TEST_FRESH              (0x4001)
 #define MSG_LED_SET_LED                 (0x4002)
 #define MSG_LED_TEST                    (0x4004)
 
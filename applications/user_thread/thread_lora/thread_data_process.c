@@ -14,6 +14,12 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-21      Test          First version.
+ * 2017-06-23      Test          Use deferred trace for debug messages.
+ * 2017-06-26      Test          Beat soft dog in thread loop.
+ * 2017-06-29      Test          Push detector and light state changes by mqtt.
+ * 2017-06-29      Test          Keep rssi and snr of new device for gateway sync.
+ * 2017-06-29      Test          Read light state to push with light list locked.
+ * 2017-06-29      Test          Split detector statistics for trace argument limit.
  ******************************************************************************
  */
  
@@ -30,6 +36,7 @@
 #include "thread_lora.h"
 #include "thread_sysctrl.h"
 #include "log.h"
+#include "trace.h"
 
 #include <lwip/sockets.h>
 #include "thread_network.h"
@@ -67,9 +74,11 @@ enum work_mode
 /* for debug */
 #define DEBUG_DATA_PROCESS    1    /* 1: debug open; 0: debug close */
 #if DEBUG_DATA_PROCESS
-    #define DEBUG_PRINTF            rt_kprintf
+    #define DEBUG_PRINTF            trace_printf
+    #define DEBUG_HEX               trace_hex
 #else
     #define DEBUG_PRINTF(fmt, ...)
+    #define DEBUG_HEX(fmt, data, len)
 #endif /* DEBUG_DATA_PROCESS */
  
  /**
@@ -129,8 +138,10 @@ static rt_uint16_t  crc_calculate                   (rt_uint8_t *data, rt_uint8_
 static rt_uint8_t   adr_control                     (rt_lora_pkt_t rx_pkt, int index);
 static void         refresh_detector_info           (single_detector_info_t node_info, int index);
 static void         refresh_light_info              (single_light_info_t light_info, int index);
-static void         insert_new_device               (rt_uint32_t id, rt_uint8_t type);
+static void         insert_new_device               (rt_uint32_t id, rt_uint8_t type,
+                                                     rt_int16_t rssi, rt_int8_t snr);
 static void         analyse_light_state             (void);
+static void         push_light_state                (int index);
 static void         analyze_lora_pkt                (rt_lora_pkt_t rx_pkt);
 static void         check_lora_node_connect         (void);
 static void         lora_send_tcp_data              (int fd, 
@@ -362,6 +373,7 @@ static void refresh_detector_info(single_detector_info_t node_info, int index)
                     node_info.id, g_detector_info_list.detector_info[index].state, node_info.state, node_info.value);
         add_log(log_buf);
         DEBUG_PRINTF("--------- %d changed park state\r\n", node_info.id);
+        mqtt_push_state(NODE_DEVICE_TYPE_DETECTOR, node_info.id, node_info.state, node_info.battery);
     }				
 
     g_detector_info_list.detector_info[index].state    = node_info.state;
@@ -428,26 +440,27 @@ static void refresh_detector_info(single_detector_info_t node_info, int index)
                        (float)g_detector_info_list.detector_info[index].send_num;
         detector_loss_per = (float)g_detector_info_list.detector_info[index].miss_send_num * 100 /
                           (float)g_detector_info_list.detector_info[index].recv_num;
+        /* a trace record keeps TRACE_MAX_ARGS arguments */
         DEBUG_PRINTF("recv num      : %d\r\n"
                      "abs recv num  : %d\r\n"
                      "send num      : %d\r\n"
-                     "loss percent  : %d.%02d%%\r\n"
-                     "abs loss      : %d.%02d%%\r\n"
-                     "detector loss : %d.%02d%%\r\n"
-                     "offline times : %d\r\n"
-                     "reset times   : %d\r\n"
-                     "resend once   : %d\r\n"
-                     "resend twice  : %d\r\n"
-                     "resend 3 times: %d\r\n"
-                     "miss frames   : %d\r\n",
+                     "loss percent  : %d.%02d%%\r\n",
                      g_detector_info_list.detector_info[index].recv_num,
                      g_detector_info_list.detector_info[index].abs_recv_num,
                      g_detector_info_list.detector_info[index].send_num,
-                     (int)(loss_per*100)/100, (int)(loss_per*100)%100,
+                     (int)(loss_per*100)/100, (int)(loss_per*100)%100);
+        DEBUG_PRINTF("abs loss      : %d.%02d%%\r\n"
+                     "detector loss : %d.%02d%%\r\n"
+                     "offline times : %d\r\n"
+                     "reset times   : %d\r\n",
                      (int)(abs_loss_per*100)/100, (int)(abs_loss_per*100)%100,
                      (int)(detector_loss_per*100)/100, (int)(detector_loss_per*100)%100,
                      g_detector_info_list.detector_info[index].offline_time,
-                     g_detector_info_list.detector_info[index].reset_time,
+                     g_detector_info_list.detector_info[index].reset_time);
+        DEBUG_PRINTF("resend once   : %d\r\n"
+                     "resend twice  : %d\r\n"
+                     "resend 3 times: %d\r\n"
+                     "miss frames   : %d\r\n",
                      g_detector_info_list.detector_info[index].resend1,
                      g_detector_info_list.detector_info[index].resend2,
                      g_detector_info_list.detector_info[index].resend3,
@@ -463,8 +476,12 @@ static void refresh_detector_info(single_detector_info_t node_info, int index)
  */
 static void refresh_light_info(single_light_info_t light_info, int index)
 {
+    rt_bool_t changed;
+    
     rt_mutex_take(&mutex_light_list, RT_WAITING_FOREVER);
     
+    changed = (g_light_info_list.light_info[index].state == NODE_STATE_OFFLINE) ||
+              (g_light_info_list.light_info[index].current_color != light_info.current_color);
     g_light_info_list.light_info[index].state         = 0;
     g_light_info_list.light_info[index].rssi          = light_info.rssi;
     g_light_info_list.light_info[index].snr           = light_info.snr;
@@ -472,6 +489,12 @@ static void refresh_light_info(single_light_info_t light_info, int index)
     g_light_info_list.light_info[index].interval      = 0;
     g_light_info_list.light_info[index].time_left     = 10;
     
+    /* push values just written, before others change them */
+    if(changed)
+    {
+        push_light_state(index);
+    }
+    
     rt_mutex_release(&mutex_light_list);
 }
 
@@ -479,8 +502,10 @@ static void refresh_light_info(single_light_info_t light_info, int index)
  * @brief  insert new LoRa device to g_new_node_list
  * @param  id:   device id
  * @param  type: device type(light or detector)
+ * @param  rssi: rssi on concentrator side
+ * @param  snr:  snr on concentrator side
  */
-static void insert_new_device(rt_uint32_t id, rt_uint8_t type)
+static void insert_new_device(rt_uint32_t id, rt_uint8_t type, rt_int16_t rssi, rt_int8_t snr)
 {
     int i;
     
@@ -490,6 +515,13 @@ static void insert_new_device(rt_uint32_t id, rt_uint8_t type)
     {
         if(g_new_node_list.node[i].id == id)
         {
+            if(g_new_node_list.node[i].time_left == 0)
+            {
+                /* reported before, gateways compare again */
+                g_new_node_list.node[i].sync = 0;
+            }
+            g_new_node_list.node[i].rssi      = rssi;
+            g_new_node_list.node[i].snr       = snr;
             g_new_node_list.node[i].time_left = NEW_DEVICE_REPORT_TIMES;     /* refresh send time */
             break;
         }
@@ -500,7 +532,10 @@ static void insert_new_device(rt_uint32_t id, rt_uint8_t type)
         DEBUG_PRINTF("get a new device\r\n");
         g_new_node_list.node[g_new_node_list.num].id          = id;
         g_new_node_list.node[g_new_node_list.num].device_type = type;
+        g_new_node_list.node[g_new_node_list.num].rssi        = rssi;
+        g_new_node_list.node[g_new_node_list.num].snr         = snr;
         g_new_node_list.node[g_new_node_list.num].time_left   = NEW_DEVICE_REPORT_TIMES;
+        g_new_node_list.node[g_new_node_list.num].sync        = 0;
         g_new_node_list.num++;
     }
     rt_mutex_release(&mutex_new_node_list);
@@ -810,10 +845,7 @@ static void analyze_lora_pkt(rt_lora_pkt_t rx_pkt)
                      rx_pkt->rssi,
                      rx_pkt->snr); 
         DEBUG_PRINTF("data: ");
-        for(i = 0; i < 10; i++)
-        {
-            DEBUG_PRINTF("0x%02x ", rx_pkt->payload[i]);
-        } 
+        DEBUG_HEX("0x%02x ", rx_pkt->payload, 10);
         DEBUG_PRINTF("\r\n"); 
 #endif /* DEBUG_DATA_PROCESS */        
         
@@ -904,7 +936,7 @@ static void analyze_lora_pkt(rt_lora_pkt_t rx_pkt)
         /* not in list but received */
         if(i >= g_detector_info_list.num)
         {
-            insert_new_device(id, NODE_DEVICE_TYPE_DETECTOR);
+            insert_new_device(id, NODE_DEVICE_TYPE_DETECTOR, rx_pkt->rssi, rx_pkt->snr);
         }
         
         break;
@@ -928,13 +960,14 @@ static void analyze_lora_pkt(rt_lora_pkt_t rx_pkt)
                 DEBUG_PRINTF("\r\n\r\n----- receive light heartbeat from %d -----\r\n", 
                             light_info.id);
                 refresh_light_info(light_info, i);
+                break;
             }
         }
         
         /* not in list but received */
-        if(i >= g_detector_info_list.num)
+        if(i >= g_light_info_list.num)
         {
-            insert_new_device(id, NODE_DEVICE_TYPE_LIGHT);
+            insert_new_device(id, NODE_DEVICE_TYPE_LIGHT, rx_pkt->rssi, rx_pkt->snr);
         }
         
         break;
@@ -1005,6 +1038,7 @@ static void analyse_light_state(void)
 	int i, j, k, bit;
 	static int index = 0;
     bool is_first;
+    unsigned char color;
 
     /* calculate number of free parking */
 	rt_memset((void*)g_relation_list.empty,
@@ -1035,6 +1069,7 @@ static void analyse_light_state(void)
         is_first = false;
 
         rt_mutex_take(&mutex_light_list, RT_WAITING_FOREVER);
+        color = g_light_info_list.light_info[i].correct_color;
 		if(g_relation_list.empty[i] > 0)
 		{
 			g_light_info_list.light_info[i].correct_color = LIGHT_COLOR_GREEN;
@@ -1043,6 +1078,10 @@ static void analyse_light_state(void)
 		{
 			g_light_info_list.light_info[i].correct_color = LIGHT_COLOR_RED;
 		}
+        if(color != g_light_info_list.light_info[i].correct_color)
+        {
+            push_light_state(i);
+        }
         rt_mutex_release(&mutex_light_list);
 
 		if(g_light_info_list.light_info[i].state != NODE_STATE_OFFLINE)
@@ -1098,6 +1137,7 @@ static void analyse_light_state(void)
 					DEBUG_PRINTF("light %d lose control\r\n",
 					             g_light_info_list.light_info[i].id);
 					g_light_info_list.light_info[i].state = NODE_STATE_OFFLINE;
+                    push_light_state(i);
 				}
 			}
 		}
@@ -1109,6 +1149,28 @@ static void analyse_light_state(void)
 	}
 }
 
+/**
+ * @brief  push displayed and correct color of a light by mqtt
+ * @param  index: index of light in g_light_info_list
+ * @NOTE   values are read with mutex_light_list taken, callers changing
+ *         them call this before releasing the mutex (it is recursive)
+ */
+static void push_light_state(int index)
+{
+    single_light_info_t *light = &g_light_info_list.light_info[index];
+    rt_uint32_t         id;
+    rt_uint8_t          state;
+    rt_uint8_t          color;
+    
+    rt_mutex_take(&mutex_light_list, RT_WAITING_FOREVER);
+    id    = light->id;
+    state = (light->state == NODE_STATE_OFFLINE) ? NODE_STATE_OFFLINE : light->current_color;
+    color = light->correct_color;
+    rt_mutex_release(&mutex_light_list);
+    
+    mqtt_push_state(NODE_DEVICE_TYPE_LIGHT, id, state, color);
+}
+
 /**
  * @brief  check device belone to this concentrator LoRa connect state
  */
@@ -1131,6 +1193,10 @@ static void check_lora_node_connect(void)
 			{
 				g_detector_info_list.detector_info[i].state = NODE_STATE_OFFLINE;
                 set_led(OFF, (i / 8), (i % 8));
+                mqtt_push_state(NODE_DEVICE_TYPE_DETECTOR,
+                                g_detector_info_list.detector_info[i].id,
+                                NODE_STATE_OFFLINE,
+                                g_detector_info_list.detector_info[i].battery);
 				work_state_log_add_event(EVENT_DETECTOR_OFFLINE);
 				DEBUG_PRINTF("detector %d is offline\r\n", 
 				             g_detector_info_list.detector_info[i].id);
@@ -1156,6 +1222,7 @@ static void check_lora_node_connect(void)
 			else
 			{
 				g_light_info_list.light_info[i].state = NODE_STATE_OFFLINE;
+                push_light_state(i);
 				work_state_log_add_event(EVENT_LIGHT_OFFLINE);
 				DEBUG_PRINTF("light %d offline\r\n", g_light_info_list.light_info[i].id);
 			}
@@ -1430,8 +1497,10 @@ void thread_data_process(void* parameter)
     /* thread loop */
     while(1)
     {
-        /* fetch messages */
-        if(rt_mq_recv(mq_data_proc, &msg, sizeof(msg), RT_WAITING_FOREVER) == RT_EOK)
+        data_proc_feed_dog();
+        
+        /* fetch messages, wake up every second to beat */
+        if(rt_mq_recv(mq_data_proc, &msg, sizeof(msg), RT_TICK_PER_SECOND) == RT_EOK)
         {            
             switch(msg.type)
             {
@@ -1493,11 +1562,6 @@ void thread_data_process(void* parameter)
                 perpair_init_node(*tmp_fd, (char *)(tmp_fd + 1));
                 break;
             }
-            case MSG_DATA_PROC_FEED_DOG:
-            {
-                data_proc_feed_dog();
-                break;
-            }
             default:
             {
                 /* wrong message type */
@@ -14,6 +14,9 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-07      Test          First version.
+ * 2017-06-26      Test          Remove feed dog messages.
+ * 2017-06-29      Test          Add check_lora_module and lora_rx_tick.
+ * 2017-06-29      Test          restart_lora_module takes cold.
  ******************************************************************************
  */
 
@@ -55,8 +58,6 @@
 #define MSG_LORA_CONFIG_NODE_BY_RANGE   (0x1040)
 #define MSG_LORA_CONFIG_NODE_BY_ID      (0x1041)
 #define MSG_LORA_INIT_NODE              (0x1080)
-#define MSG_LORA_SEND_FEED_DOG          (0x1100)
-#define MSG_DATA_PROC_FEED_DOG          (0x1200)
 
 /* lora command key word */
 #define LORA_CMD_SET_PERIOD             (0x04)
@@ -102,6 +103,7 @@ extern struct rt_mutex     mutex_lora;     /* lock when sending or receiving */
 
 extern rt_thread_t         tid_lora_send;  /* lora send thread handler */
 extern rt_thread_t         tid_lora_recv;  /* lora receive thread handler */
+extern volatile rt_tick_t  lora_rx_tick;   /* tick of last received packets */
 extern rt_thread_t         tid_data_proc;  /* data process thread handler */
 
 extern rt_mq_t             mq_lora_send;   /* lora send thread message queue */
@@ -132,6 +134,13 @@ extern rt_uint8_t       lora_set_datarate       (rt_uint8_t dr);
 extern rt_uint32_t      get_tx_freq             (void);
 extern rt_int8_t        get_tx_power            (void);
 extern int              start_lora_module       (void);
+extern int              restart_lora_module     (int cold);
+extern int              recalibrate_lora_module (void);
+extern int              check_lora_module       (void);
+extern int              set_lora_channel        (rt_uint8_t if_chain, rt_uint8_t enable, 
+                                                 rt_uint32_t freq_hz, rt_uint8_t sf_mask);
+extern int              get_lora_channel        (rt_uint8_t if_chain, rt_uint8_t *enable, 
+                                                 rt_uint32_t *freq_hz, rt_uint8_t *sf_mask);
 extern rt_uint16_t      get_self_detector_info  (char *data);
 
 extern void         thread_lora_send        (void* parameter);
@@ -14,6 +14,11 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-07      Test          First version.
+ * 2017-06-20      Test          Add restart_lora_module.
+ * 2017-06-21      Test          Cache calibration results on external flash.
+ * 2017-06-22      Test          Add runtime channel reconfiguration.
+ * 2017-06-29      Test          Add check_lora_module health check.
+ * 2017-06-29      Test          restart_lora_module does cold restarts too.
  ******************************************************************************
  */
  
@@ -25,8 +30,11 @@
  */
 
 #include "loragw_hal.h"
+#include "loragw_reg.h"
 #include "thread_lora.h" 
 #include "external_flash.h"
+#include "embedded_flash.h"
+#include "board.h"
 
 /**
  ******************************************************************************
@@ -36,6 +44,20 @@
 
 #define DEFAULT_RSSI_OFFSET  (-176.0f)
 #define DEFAULT_NOTCH_FREQ   129000U
+
+/* radios center frequency, relative to configured base frequency */
+#define RF_A_FREQ_OFFSET     1400000
+#define RF_B_FREQ_OFFSET     400000
+
+/* calibration cache, one entry per temperature band */
+#define LORA_CAL_MAGIC       (0x4C43414CU)   /* "LCAL" */
+#define LORA_CAL_TEMP_MIN    (-40)
+#define LORA_CAL_TEMP_BAND   (20)            /* degrees per band */
+#define LORA_CAL_ENTRY_NUM   (8)             /* -40 to 120 degrees */
+#define LORA_CAL_REFRESH     (10 * 60 * RT_TICK_PER_SECOND)  /* calibrate again 10 min after reusing cache */
+
+/* sx1301 VERSION register */
+#define LORA_CHIP_VERSION    (103)
  
 /**
  ******************************************************************************
@@ -43,6 +65,18 @@
  ******************************************************************************
  */
 
+/**
+ * @brief  structure of a calibration cache entry saved on external flash
+ */
+typedef struct
+{
+    rt_uint32_t             magic;
+    rt_uint32_t             dev_id;     /* radios are soldered on board, device id identifies them */
+    rt_int32_t              temp_band;
+    struct lgw_cal_data_s   cal;        /* include hash of radio configuration */
+    rt_uint32_t             checksum;
+} lora_cal_entry_t;
+
 static rt_uint32_t base_freq = 471100000;
 static rt_uint8_t  base_powr = 17;
 
@@ -53,6 +87,8 @@ static rt_uint8_t  base_powr = 17;
  */
 
 struct rt_mutex     mutex_lora;
+
+extern rt_device_t  dev_ext_flash;
  
  /**
  ******************************************************************************
@@ -60,6 +96,12 @@ struct rt_mutex     mutex_lora;
  ******************************************************************************
  */
 
+static lora_cal_entry_t cal_table[LORA_CAL_ENTRY_NUM];
+static rt_int32_t       cal_temp_band;
+static rt_uint8_t       cal_refresh_pending = 0;
+static rt_tick_t        cal_reuse_tick;
+static uint32_t         health_trig_cnt;
+static rt_uint8_t       health_trig_valid = 0;
  
 /**
  ******************************************************************************
@@ -67,7 +109,10 @@ struct rt_mutex     mutex_lora;
  ******************************************************************************
  */
 
-static void parse_module_config(void);
+static void         parse_module_config (void);
+static rt_uint32_t  cal_entry_checksum  (lora_cal_entry_t *entry);
+static void         lora_cal_select     (void);
+static void         lora_cal_update     (void);
  
 /**
  ******************************************************************************
@@ -108,7 +153,7 @@ static void parse_module_config(void)
     rt_memset(&rfconf, 0, sizeof(rfconf));
 
     rfconf.enable = true;
-    rfconf.freq_hz = base_freq + 1400000;
+    rfconf.freq_hz = base_freq + RF_A_FREQ_OFFSET;
     rfconf.rssi_offset = DEFAULT_RSSI_OFFSET;
     rfconf.type = radio_type;
     rfconf.tx_enable = true;
@@ -116,7 +161,7 @@ static void parse_module_config(void)
     lgw_rxrf_setconf(0, rfconf); /* radio A, f0 */
 
     rfconf.enable = true;
-    rfconf.freq_hz = base_freq + 400000;
+    rfconf.freq_hz = base_freq + RF_B_FREQ_OFFSET;
     rfconf.rssi_offset = DEFAULT_RSSI_OFFSET;
     rfconf.type = radio_type;
     rfconf.tx_enable = false;
@@ -193,16 +238,281 @@ static void parse_module_config(void)
 }
 
 /**
- * @brief  start sx1301 module 
+ * @brief  calculate checksum of a calibration cache entry
+ * @param  entry: pointer to cache entry
+ * @retval checksum value
+ */
+static rt_uint32_t cal_entry_checksum(lora_cal_entry_t *entry)
+{
+    rt_uint8_t  *p = (rt_uint8_t *)entry;
+    rt_uint32_t sum = 0;
+    rt_uint32_t i;
+    
+    for(i = 0; i < sizeof(*entry) - sizeof(entry->checksum); i++)
+    {
+        sum = (sum << 1 | sum >> 31) + p[i];
+    }
+    
+    return sum;
+}
+
+/**
+ * @brief  find a cached calibration matching device, temperature and rf
+ *         configuration, give it to lora hal to skip calibration on start.
+ *         rf configuration must be set before.
+ */
+static void lora_cal_select(void)
+{
+    lora_cal_entry_t *entry;
+    rt_int32_t temp;
+    
+    temp = rt_hw_get_temperature();
+    cal_temp_band = (temp - LORA_CAL_TEMP_MIN) / LORA_CAL_TEMP_BAND;
+    if(cal_temp_band < 0)
+    {
+        cal_temp_band = 0;
+    }
+    else if(cal_temp_band >= LORA_CAL_ENTRY_NUM)
+    {
+        cal_temp_band = LORA_CAL_ENTRY_NUM - 1;
+    }
+    
+    entry = &cal_table[cal_temp_band];
+    rt_device_read(dev_ext_flash, LORA_CAL_ADDR + cal_temp_band * sizeof(*entry), 
+                   entry, sizeof(*entry));
+    
+    if(entry->magic == LORA_CAL_MAGIC &&
+       entry->dev_id == wnc_device.id &&
+       entry->temp_band == cal_temp_band &&
+       entry->cal.config_hash == lgw_cal_config_hash() &&
+       entry->checksum == cal_entry_checksum(entry))
+    {
+        lgw_cal_setconf(&entry->cal);
+    }
+    else
+    {
+        lgw_cal_setconf(RT_NULL);
+    }
+}
+
+/**
+ * @brief  save results of a new calibration to external flash, or schedule
+ *         a new calibration if cached results were used.
+ */
+static void lora_cal_update(void)
+{
+    lora_cal_entry_t *entry;
+    struct lgw_cal_data_s cal;
+    
+    if(lgw_cal_get(&cal) != LGW_HAL_SUCCESS)
+    {
+        return;
+    }
+    
+    if(cal.reused)
+    {
+        cal_refresh_pending = 1;
+        cal_reuse_tick = rt_tick_get();
+        return;
+    }
+    cal_refresh_pending = 0;
+    
+    /* sector must be erased before rewrite, keep other temperature bands */
+    rt_device_read(dev_ext_flash, LORA_CAL_ADDR, cal_table, sizeof(cal_table));
+    
+    entry = &cal_table[cal_temp_band];
+    if(entry->magic == LORA_CAL_MAGIC &&
+       entry->dev_id == wnc_device.id &&
+       rt_memcmp(&entry->cal, &cal, sizeof(cal)) == 0)
+    {
+        return;     /* already saved, warm restart keeps calibration */
+    }
+    
+    entry->magic = LORA_CAL_MAGIC;
+    entry->dev_id = wnc_device.id;
+    entry->temp_band = cal_temp_band;
+    rt_memcpy(&entry->cal, &cal, sizeof(cal));
+    entry->checksum = cal_entry_checksum(entry);
+    
+    rt_device_control(dev_ext_flash, GD_FLASH_CTRL_SCT_ERASE, (void *)LORA_CAL_ADDR);
+    rt_device_write(dev_ext_flash, LORA_CAL_ADDR, cal_table, sizeof(cal_table));
+}
+
+/**
+ * @brief  start sx1301 module, calibration is skipped if results of a
+ *         previous one are cached for current temperature and configuration.
  * @retval 0 for success, others for failure
  */
 int start_lora_module(void)
 {
+    int ret;
+    
     /* set RF params */
     parse_module_config();
+    lora_cal_select();
     
 	/* start sx1301 module */
-	return lgw_start();
+	ret = lgw_start();
+    if(ret == LGW_HAL_SUCCESS)
+    {
+        lora_cal_update();
+    }
+    
+    return ret;
+}
+
+/**
+ * @brief  restart sx1301 module, firmwares loading and calibration are skipped
+ *         when it was not power-cycled.
+ * @param  cold: 1 to reset the concentrator and load firmwares again, a warm
+ *         restart leaves a stalled one as it is.
+ * @retval 0 for success, others for failure
+ */
+int restart_lora_module(int cold)
+{
+    int ret;
+    
+    rt_mutex_take(&mutex_lora, RT_WAITING_FOREVER);
+    lora_cal_select();
+    if(cold)
+    {
+        lgw_stop();
+        ret = lgw_start();
+    }
+    else
+    {
+        ret = lgw_restart();
+    }
+    if(ret == LGW_HAL_SUCCESS)
+    {
+        lora_cal_update();
+    }
+    rt_mutex_release(&mutex_lora);
+    
+    return ret;
+}
+
+/**
+ * @brief  check sx1301 module is alive: chip version reads back over spi,
+ *         clocks are on and the internal us counter ran since last check.
+ *         call it periodically, at least some ms apart. with LGW_GPS_PPS
+ *         the counter is only captured on pulses and is not checked.
+ * @retval 0 for healthy, others for a fault
+ */
+int check_lora_module(void)
+{
+    int32_t     version, global_en;
+    uint32_t    trig_cnt;
+    int         ret = -1;
+    
+    rt_mutex_take(&mutex_lora, RT_WAITING_FOREVER);
+    if(lgw_reg_r(LGW_VERSION, &version) == LGW_REG_SUCCESS && version == LORA_CHIP_VERSION &&
+       lgw_reg_r(LGW_GLOBAL_EN, &global_en) == LGW_REG_SUCCESS && global_en == 1 &&
+       lgw_get_trigcnt(&trig_cnt) == LGW_HAL_SUCCESS)
+    {
+        /* a stopped counter means the concentrator is hung */
+        ret = (!LGW_GPS_PPS && health_trig_valid && trig_cnt == health_trig_cnt) ? -1 : 0;
+        health_trig_cnt = trig_cnt;
+        health_trig_valid = 1;
+    }
+    else
+    {
+        health_trig_valid = 0;
+    }
+    rt_mutex_release(&mutex_lora);
+    
+    return ret;
+}
+
+/**
+ * @brief  calibrate sx1301 module again some time after cached calibration
+ *         results were used, and update the cache. receiving stops during
+ *         calibration, call it when lora is idle.
+ * @retval 0 for success or nothing to do, others for failure
+ */
+int recalibrate_lora_module(void)
+{
+    int ret;
+    
+    if(cal_refresh_pending == 0 ||
+       (rt_tick_get() - cal_reuse_tick) < LORA_CAL_REFRESH)
+    {
+        return 0;
+    }
+    
+    rt_mutex_take(&mutex_lora, RT_WAITING_FOREVER);
+    lgw_cal_setconf(RT_NULL);
+    ret = lgw_start();
+    if(ret == LGW_HAL_SUCCESS)
+    {
+        lora_cal_update();
+    }
+    rt_mutex_release(&mutex_lora);
+    
+    return ret;
+}
+
+/**
+ * @brief  change a LoRa multi-SF receive channel while the module is running,
+ *         no calibration is needed. the radio of the channel is kept.
+ * @param  if_chain: channel number, 0 ~ 7
+ * @param  enable: 0 to disable the channel
+ * @param  freq_hz: channel center frequency in hz
+ * @param  sf_mask: enabled spreading factors, bit0 for SF7 ... bit5 for SF12
+ * @retval 0 for success, others for failure
+ */
+int set_lora_channel(rt_uint8_t if_chain, rt_uint8_t enable, rt_uint32_t freq_hz, rt_uint8_t sf_mask)
+{
+    struct lgw_conf_rxif_s ifconf;
+    rt_uint32_t rf_freq;
+    int ret;
+    
+    if(lgw_rxif_getconf(if_chain, &ifconf) != LGW_HAL_SUCCESS)
+    {
+        return -1;
+    }
+    rf_freq = base_freq + ((ifconf.rf_chain == 0) ? RF_A_FREQ_OFFSET : RF_B_FREQ_OFFSET);
+    
+    ifconf.enable = (enable != 0);
+    ifconf.freq_hz = (rt_int32_t)(freq_hz - rf_freq);
+    ifconf.datarate = ((rt_uint32_t)sf_mask << 1) & DR_LORA_MULTI;
+    if(ifconf.enable && ifconf.datarate == 0)
+    {
+        return -1;
+    }
+    
+    rt_mutex_take(&mutex_lora, RT_WAITING_FOREVER);
+    ret = lgw_rxif_update(if_chain, ifconf);
+    rt_mutex_release(&mutex_lora);
+    
+    return ret;
+}
+
+/**
+ * @brief  get a LoRa multi-SF receive channel settings
+ * @param  if_chain: channel number, 0 ~ 7
+ * @param  enable: output 0 if the channel is disabled
+ * @param  freq_hz: output channel center frequency in hz
+ * @param  sf_mask: output enabled spreading factors, bit0 for SF7 ... bit5 for SF12
+ * @retval 0 for success, others for failure
+ */
+int get_lora_channel(rt_uint8_t if_chain, rt_uint8_t *enable, rt_uint32_t *freq_hz, rt_uint8_t *sf_mask)
+{
+    struct lgw_conf_rxif_s ifconf;
+    rt_uint32_t rf_freq;
+    
+    if(if_chain >= LGW_MULTI_NB ||
+       lgw_rxif_getconf(if_chain, &ifconf) != LGW_HAL_SUCCESS)
+    {
+        return -1;
+    }
+    rf_freq = base_freq + ((ifconf.rf_chain == 0) ? RF_A_FREQ_OFFSET : RF_B_FREQ_OFFSET);
+    
+    *enable = ifconf.enable;
+    *freq_hz = rf_freq + ifconf.freq_hz;
+    *sf_mask = (rt_uint8_t)(ifconf.datarate >> 1);
+    
+    return 0;
 }
 
 /**
@@ -14,6 +14,11 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-07      Test          First version.
+ * 2017-06-20      Test          Restart concentrator after lora hal faults.
+ * 2017-06-21      Test          Refresh cached calibration when idle.
+ * 2017-06-23      Test          Use deferred trace for packet dump.
+ * 2017-06-29      Test          Concentrator restart and recalibration move
+ *                               to sys_ctrl.
  ******************************************************************************
  */
  
@@ -27,6 +32,7 @@
 #include "loragw_hal.h"
 #include "thread_lora.h"
 #include "thread_sysctrl.h"
+#include "trace.h"
 
 /**
  ******************************************************************************
@@ -40,9 +46,11 @@
 /* for debug */
 #define DEBUG_LORA_RECV    1    /* 1: debug open; 0: debug close */
 #if DEBUG_LORA_RECV
-    #define DEBUG_PRINTF    rt_kprintf
+    #define DEBUG_PRINTF    trace_printf
+    #define DEBUG_HEX       trace_hex
 #else
     #define DEBUG_PRINTF(fmt, ...)
+    #define DEBUG_HEX(fmt, data, len)
 #endif /* DEBUG_LORA_RECV */
  
  /**
@@ -59,6 +67,7 @@
  */
 
 rt_thread_t tid_lora_recv = RT_NULL;
+volatile rt_tick_t lora_rx_tick = 0;  /* tick of last received packets */
  
  /**
  ******************************************************************************
@@ -107,9 +116,9 @@ void thread_lora_recv(void* parameter)
         nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);
         rt_mutex_release(&mutex_lora);
         
+        /* hal is not started, sys_ctrl health check restarts it */
         if(nb_pkt == LGW_HAL_ERROR)
         {
-            DEBUG_PRINTF("lora hal fault \r\n");
             rt_thread_delay(10);  /* 100ms */
             continue;
         }
@@ -119,6 +128,7 @@ void thread_lora_recv(void* parameter)
             rt_thread_delay(10);  /* 100ms */
             continue;
         }
+        lora_rx_tick = rt_tick_get();
         
         /* handle received packets */
         for(i=0; i < nb_pkt; ++i) {
@@ -126,8 +136,6 @@ void thread_lora_recv(void* parameter)
 
 #if DEBUG_LORA_RECV            
             {
-                int j;
-
                 DEBUG_PRINTF("\r\n------\r\nRcv pkt >>\r\n");
                 DEBUG_PRINTF(" size:%3u", p->size);
                 switch (p->datarate) {
@@ -143,9 +151,7 @@ void thread_lora_recv(void* parameter)
                 DEBUG_PRINTF(" freq: %d\r\n", p->freq_hz);
                 DEBUG_PRINTF(" RSSI:%d\r\n SNR:%d (min:%d, max:%d)\r\n payload:", (int)p->rssi, (int)p->snr, (int)p->snr_min, (int)p->snr_max);
 
-                for (j = 0; j < p->size; ++j) {
-                    DEBUG_PRINTF(" %02X", p->payload[j]);
-                }
+                DEBUG_HEX(" %02X", p->payload, p->size);
                 DEBUG_PRINTF(" #\r\n");
             }
 #endif /* DEBUG_LORA_RECV */
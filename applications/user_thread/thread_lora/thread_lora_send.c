@@ -14,6 +14,9 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-24      Test          First version.
+ * 2017-06-15      Test          Send with cached prepared TX descriptors.
+ * 2017-06-26      Test          Beat soft dog in thread loop.
+ * 2017-06-29      Test          No prepared TX with LBT, lgw_send if it fails.
  ******************************************************************************
  */
  
@@ -24,8 +27,10 @@
  ******************************************************************************
  */
 
+#include "gd32f20x.h"
 #include "loragw_hal.h"
 #include "loragw_reg.h"
+#include "loragw_lbt.h"
 #include "thread_lora.h"
 #include "thread_sysctrl.h"
 
@@ -43,12 +48,43 @@
     #define DEBUG_PRINTF(fmt, ...)
 #endif /* DEBUG_LORA_SEND */
 
+/* 1: send with cached TX descriptors; 0: build whole packet by lgw_send */
+#define LORA_SEND_PREPARED      1
+
+/* gateway sends on very few (freq, SF, power) combinations */
+#define TX_DESC_CACHE_SIZE      4
+
+/* for benchmark, print CPU cycles spent to schedule each packet */
+#define LORA_SEND_BENCHMARK     0    /* 1: benchmark open; 0: benchmark close */
+#if LORA_SEND_BENCHMARK
+    #define BENCHMARK_INIT()    do { CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; \
+                                     DWT->CYCCNT = 0; \
+                                     DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk; } while(0)
+    #define BENCHMARK_START()   rt_uint32_t bench_cycles = DWT->CYCCNT
+    #define BENCHMARK_END()     rt_kprintf("lora send: %d cycles\r\n", DWT->CYCCNT - bench_cycles)
+#else
+    #define BENCHMARK_INIT()
+    #define BENCHMARK_START()
+    #define BENCHMARK_END()
+#endif /* LORA_SEND_BENCHMARK */
+
 
 /**
  ******************************************************************************
  *                               TYPE DEFINITION
  ******************************************************************************
  */
+
+/**
+ * @brief prepared TX descriptor of one (freq, SF, power) combination
+ */
+struct tx_desc_cache
+{
+    rt_uint32_t             freq_hz;    /* center frequency of TX */
+    rt_uint32_t             datarate;   /* SF for LoRa */
+    rt_int8_t               rf_power;   /* TX power, in dBm */
+    struct lgw_tx_desc_s    desc;       /* prepared metadata and TX gain */
+};
  
 
 /**
@@ -67,6 +103,11 @@ rt_mq_t     mq_lora_send  = RT_NULL;
  */
 
 static struct lgw_pkt_tx_s txpkt; /* configuration and metadata for an outbound packet */
+
+#if LORA_SEND_PREPARED
+static struct tx_desc_cache tx_desc_cache[TX_DESC_CACHE_SIZE];
+static rt_uint8_t           tx_desc_next = 0;   /* next cache entry to replace */
+#endif /* LORA_SEND_PREPARED */
  
 /**
  ******************************************************************************
@@ -88,6 +129,82 @@ static struct lgw_pkt_tx_s txpkt; /* configuration and metadata for an outbound
  ******************************************************************************
  */
 
+/**
+ * @brief  set configuration of outbound packet, payload is not touched.
+ * @param  freq_hz: center frequency of TX.
+ * @param  datarate: SF for LoRa.
+ */
+static void set_tx_config(rt_uint32_t freq_hz, rt_uint32_t datarate)
+{
+    txpkt.freq_hz  = freq_hz;
+    txpkt.tx_mode  = IMMEDIATE;
+    txpkt.rf_power = get_tx_power();
+    txpkt.modulation = MOD_LORA;
+    txpkt.bandwidth = BW_125KHZ;                
+    txpkt.coderate = CR_LORA_4_5;
+    txpkt.preamble = 8;
+    txpkt.rf_chain = 0;
+    txpkt.datarate = datarate;
+}
+
+#if LORA_SEND_PREPARED
+/**
+ * @brief  get prepared TX descriptor, prepare it when not cached or outdated.
+ *         called with mutex_lora taken. hal sends no prepared TX with LBT.
+ * @param  freq_hz: center frequency of TX.
+ * @param  datarate: SF for LoRa.
+ * @retval TX descriptor, RT_NULL when got error.
+ */
+static struct lgw_tx_desc_s * get_tx_desc(rt_uint32_t freq_hz, rt_uint32_t datarate)
+{
+    rt_uint8_t i;
+    rt_int8_t rf_power = get_tx_power();
+    struct tx_desc_cache * entry = RT_NULL;
+    
+    if(lbt_is_enabled())
+    {
+        return RT_NULL;
+    }
+    
+    for(i = 0; i < TX_DESC_CACHE_SIZE; i++)
+    {
+        if((tx_desc_cache[i].freq_hz == freq_hz)
+            && (tx_desc_cache[i].datarate == datarate)
+            && (tx_desc_cache[i].rf_power == rf_power))
+        {
+            entry = &tx_desc_cache[i];
+            break;
+        }
+    }
+    
+    if((entry != RT_NULL) && lgw_tx_is_prepared(&entry->desc))
+    {
+        return &entry->desc;
+    }
+    
+    /* not cached, replace the oldest one */
+    if(entry == RT_NULL)
+    {
+        entry = &tx_desc_cache[tx_desc_next];
+        tx_desc_next = (tx_desc_next + 1) % TX_DESC_CACHE_SIZE;
+    }
+    
+    rt_memset(&txpkt, 0, sizeof(txpkt));
+    set_tx_config(freq_hz, datarate);
+    if(lgw_tx_prepare(&txpkt, &entry->desc) != LGW_HAL_SUCCESS)
+    {
+        entry->freq_hz = 0;
+        DEBUG_PRINTF("prepare tx descriptor failed\r\n");
+        return RT_NULL;
+    }
+    entry->freq_hz  = freq_hz;
+    entry->datarate = datarate;
+    entry->rf_power = rf_power;
+    
+    return &entry->desc;
+}
+#endif /* LORA_SEND_PREPARED */
+
 /**
  * @brief  continuous mode sending to test tx power
  */
@@ -98,17 +215,9 @@ static void lora_send_test(void)
 	
 	/*add by Ann ΪSX1301Ĳδܳʼ߷Ͳʱδĳʼ 2017.11.24*/
 	rt_memset(&txpkt, 0, sizeof(txpkt));
-	txpkt.freq_hz  = 471100000;
-	txpkt.tx_mode  = IMMEDIATE;
-	txpkt.rf_power = get_tx_power();
-	txpkt.modulation = MOD_LORA;
-	txpkt.bandwidth = BW_125KHZ;                
-	txpkt.coderate = CR_LORA_4_5;
-	txpkt.preamble = 8;
-	txpkt.rf_chain = 0;
+	set_tx_config(471100000, DR_LORA_SF8);
 	/*************************************************************************************************************/
 	
-	txpkt.datarate = DR_LORA_SF8;
 	txpkt.size = rt_strlen(test_string);
 
 	lgw_send(txpkt); /* non-blocking scheduling of TX packet */
@@ -123,37 +232,43 @@ void thread_lora_send(void* parameter)
     stu_lora_msg  msg;
     rt_uint8_t status_var = 0;
     
+    BENCHMARK_INIT();
+    
     /* thread loop */
     while(1)
     {
-        /* fetch messages */
-        if(rt_mq_recv(mq_lora_send, &msg, sizeof(msg), RT_WAITING_FOREVER) == RT_EOK)
+        lora_send_feed_dog();
+        
+        /* fetch messages, wake up every second to beat */
+        if(rt_mq_recv(mq_lora_send, &msg, sizeof(msg), RT_TICK_PER_SECOND) == RT_EOK)
         {        
             switch(msg.type)
             {
             case MSG_LORA_SEND_DATA:
             {
                 rt_lora_pkt_t tx_pkt = (rt_lora_pkt_t)msg.data;
-                
-                /* set tx packet */
-                rt_memset(&txpkt, 0, sizeof(txpkt));
-                txpkt.freq_hz  = tx_pkt->freq_hz;
-                txpkt.tx_mode  = IMMEDIATE;
-                txpkt.rf_power = get_tx_power();
-                txpkt.modulation = MOD_LORA;
-                txpkt.bandwidth = BW_125KHZ;                
-                txpkt.coderate = CR_LORA_4_5;
-                txpkt.preamble = 8;
-                txpkt.rf_chain = 0;
-                
-                txpkt.datarate = lora_set_datarate(tx_pkt->datarate);
-                txpkt.size     = tx_pkt->len;
-                rt_memcpy(txpkt.payload, tx_pkt->payload, txpkt.size);
+                struct lgw_tx_desc_s * desc = RT_NULL;
+                BENCHMARK_START();
                 
                 /* send lora data */
                 rt_mutex_take(&mutex_lora, RT_WAITING_FOREVER);
-                lgw_send(txpkt); /* non-blocking scheduling of TX packet */
+#if LORA_SEND_PREPARED
+                desc = get_tx_desc(tx_pkt->freq_hz, lora_set_datarate(tx_pkt->datarate));
+#endif /* LORA_SEND_PREPARED */
+                /* only payload is copied, sent by lgw_send if it fails */
+                if((desc == RT_NULL) ||
+                   (lgw_send_prepared(desc, 0, tx_pkt->payload, tx_pkt->len) != LGW_HAL_SUCCESS))
+                {
+                    /* set tx packet */
+                    rt_memset(&txpkt, 0, sizeof(txpkt));
+                    set_tx_config(tx_pkt->freq_hz, lora_set_datarate(tx_pkt->datarate));
+                    txpkt.size     = tx_pkt->len;
+                    rt_memcpy(txpkt.payload, tx_pkt->payload, txpkt.size);
+                    
+                    lgw_send(txpkt); /* non-blocking scheduling of TX packet */
+                }
                 rt_mutex_release(&mutex_lora);
+                BENCHMARK_END();
                 do {
                     rt_thread_delay(2);
                     lgw_status(TX_STATUS, &status_var); /* get TX status */
@@ -183,11 +298,6 @@ void thread_lora_send(void* parameter)
                 }
                 break;
             }
-            case MSG_LORA_SEND_FEED_DOG:
-            {
-                lora_send_feed_dog();
-                break;
-            }
             default:
             {
                 /* wrong message type */
@@ -0,0 +1,450 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : thread_mqtt.c
+ * Arthor    : Test
+ * Date      : Jun 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Push only to a broker set by mqtt_broker().
+ * 2017-06-29      Test          Broker is saved in wnc config, read node lists
+ *                               under their mutex.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <lwip/tcpip.h>
+#include <lwip/sockets.h>
+#include <lwip/apps/mqtt.h>
+
+#include "thread_network.h"
+
+#include "embedded_flash.h"
+#include "external_flash.h"
+#include "wnc_data_base.h"
+#include "trace.h"
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+#define MQTT_PUSH_PORT              (1883)
+#define MQTT_PUSH_QOS               (1)     /* 0: at most once, 1: at least once */
+#define MQTT_PUSH_KEEP_ALIVE        (60)    /* seconds */
+
+#define MQTT_PUSH_MQ_NAME           "mqtt_push"
+#define MQTT_PUSH_MQ_NUM            (64)    /* changes waiting to be published */
+#define MQTT_PUSH_MAX_RECORDS       (32)    /* records in one publish */
+#define MQTT_PUSH_VERSION           (1)     /* payload format */
+
+/* a burst of changes in this time goes in one publish, 0 for no wait */
+#define MQTT_PUSH_BATCH_TICKS       (RT_TICK_PER_SECOND / 50)               /* 20ms */
+#define MQTT_PUSH_CONNECT_TICKS     (10 * RT_TICK_PER_SECOND)               /* 10s */
+#define MQTT_PUSH_RETRY_TICKS       (5 * RT_TICK_PER_SECOND)                /* 5s */
+/* QoS 1 requests time out in MQTT_REQ_TIMEOUT seconds */
+#define MQTT_PUSH_ACK_TICKS         ((MQTT_REQ_TIMEOUT + 5) * RT_TICK_PER_SECOND)
+
+/* for debug */
+#define DEBUG_MQTT  0
+
+#if DEBUG_MQTT
+    #define DEBUG_PRINTF    trace_printf
+#else
+    #define DEBUG_PRINTF(...)
+#endif /* DEBUG_MQTT */
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  a state change of a lora node
+ */
+struct mqtt_push_record
+{
+    rt_uint8_t      type;       /* NODE_DEVICE_TYPE_DETECTOR or _LIGHT */
+    rt_uint8_t      state;      /* see mqtt_push_state() */
+    rt_uint8_t      value;
+    rt_uint32_t     id;         /* node id */
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+rt_thread_t tid_mqtt_push = RT_NULL;
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+static rt_mq_t                  mq_mqtt_push = RT_NULL;
+static struct rt_semaphore      sem_mqtt_push;      /* released by mqtt callbacks */
+
+static mqtt_client_t            push_client;        /* used with tcpip core locked */
+static volatile rt_uint8_t      push_connected = 0;
+static volatile err_t           push_result;        /* result of last publish */
+static volatile int             push_snapshot  = 1; /* publish all nodes */
+static rt_uint32_t              push_broker_ip = 0; /* broker connected to */
+
+static char                     push_client_id[16];
+static char                     push_topic[32];
+static struct mqtt_push_record  push_batch[MQTT_PUSH_MAX_RECORDS];
+static rt_uint8_t               push_buf[2 + MQTT_PUSH_MAX_RECORDS * 7];
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+static void     mqtt_push_connection_cb (mqtt_client_t *client, void *arg,
+                                         mqtt_connection_status_t status);
+static void     mqtt_push_request_cb    (void *arg, err_t err);
+static int      mqtt_push_connect       (void);
+static void     mqtt_push_disconnect    (void);
+static int      mqtt_push_publish       (const struct mqtt_push_record *rec, int num);
+static int      mqtt_push_all           (void);
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern struct rt_mutex   mutex_detector_list;
+extern struct rt_mutex   mutex_light_list;
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief  mqtt connection callback, called in tcpip thread
+ */
+static void mqtt_push_connection_cb(mqtt_client_t *client, void *arg,
+                                    mqtt_connection_status_t status)
+{
+    push_connected = (status == MQTT_CONNECT_ACCEPTED);
+    rt_sem_release(&sem_mqtt_push);
+}
+
+/**
+ * @brief  mqtt publish callback, called in tcpip thread when a QoS 0 publish
+ *         is sent or a QoS 1 publish is acked or timed out
+ */
+static void mqtt_push_request_cb(void *arg, err_t err)
+{
+    push_result = err;
+    rt_sem_release(&sem_mqtt_push);
+}
+
+/**
+ * @brief  connect to broker in wnc config
+ * @retval 0 for success, -1 for failure
+ */
+static int mqtt_push_connect(void)
+{
+    struct mqtt_connect_client_info_t info;
+    ip_addr_t   broker;
+    err_t       err;
+
+    push_broker_ip = g_wnc_config.mqtt_ip;
+    if(push_broker_ip == 0)
+    {
+        return -1;
+    }
+    ip4_addr_set_u32(ip_2_ip4(&broker), push_broker_ip);
+
+    rt_snprintf(push_client_id, sizeof(push_client_id), "%s%d", DEVICE_TYPE, wnc_device.id);
+    rt_snprintf(push_topic, sizeof(push_topic), "%s/%d/state", DEVICE_TYPE, wnc_device.id);
+
+    rt_memset(&info, 0, sizeof(info));
+    info.client_id  = push_client_id;
+    info.keep_alive = MQTT_PUSH_KEEP_ALIVE;
+
+    rt_sem_control(&sem_mqtt_push, RT_IPC_CMD_RESET, 0);
+    LOCK_TCPIP_CORE();
+    err = mqtt_client_connect(&push_client, &broker, MQTT_PUSH_PORT,
+                              mqtt_push_connection_cb, RT_NULL, &info);
+    UNLOCK_TCPIP_CORE();
+    if(err != ERR_OK)
+    {
+        return -1;
+    }
+
+    if(rt_sem_take(&sem_mqtt_push, MQTT_PUSH_CONNECT_TICKS) != RT_EOK || !push_connected)
+    {
+        mqtt_push_disconnect();
+        return -1;
+    }
+
+    DEBUG_PRINTF("mqtt connected\r\n");
+    return 0;
+}
+
+/**
+ * @brief  close connection to broker
+ */
+static void mqtt_push_disconnect(void)
+{
+    LOCK_TCPIP_CORE();
+    mqtt_disconnect(&push_client);
+    UNLOCK_TCPIP_CORE();
+    push_connected = 0;
+}
+
+/**
+ * @brief  publish records and wait until sent (QoS 0) or acked (QoS 1)
+ * @param  rec: records to publish
+ * @param  num: number of records, 1 to MQTT_PUSH_MAX_RECORDS
+ * @retval 0 for success, -1 for failure, connection is closed
+ *
+ * @NOTE   payload format: version, record count, then for each record node
+ *         type, node id (4 bytes, big endian), state and value.
+ */
+static int mqtt_push_publish(const struct mqtt_push_record *rec, int num)
+{
+    rt_uint8_t  *p = push_buf;
+    err_t       err;
+    int         i;
+
+    *p++ = MQTT_PUSH_VERSION;
+    *p++ = num;
+    for(i = 0; i < num; i++)
+    {
+        *p++ = rec[i].type;
+        *p++ = (rec[i].id >> 24) & 0xff;
+        *p++ = (rec[i].id >> 16) & 0xff;
+        *p++ = (rec[i].id >> 8)  & 0xff;
+        *p++ =  rec[i].id        & 0xff;
+        *p++ = rec[i].state;
+        *p++ = rec[i].value;
+    }
+
+    rt_sem_control(&sem_mqtt_push, RT_IPC_CMD_RESET, 0);
+    push_result = ERR_INPROGRESS;
+    LOCK_TCPIP_CORE();
+    err = mqtt_publish(&push_client, push_topic, push_buf, (u16_t)(p - push_buf),
+                       MQTT_PUSH_QOS, 0, mqtt_push_request_cb, RT_NULL);
+    UNLOCK_TCPIP_CORE();
+
+    /* a closed connection releases the semaphore too */
+    if(err == ERR_OK &&
+       rt_sem_take(&sem_mqtt_push, MQTT_PUSH_ACK_TICKS) == RT_EOK &&
+       push_connected && push_result == ERR_OK)
+    {
+        return 0;
+    }
+
+    DEBUG_PRINTF("mqtt publish failed, err %d, result %d\r\n", err, push_result);
+    mqtt_push_disconnect();
+    return -1;
+}
+
+/**
+ * @brief  publish state of all detectors and lights. a batch is copied with
+ *         the mutex of its list taken and published with it released.
+ * @retval 0 for success, -1 for failure
+ */
+static int mqtt_push_all(void)
+{
+    int i, num;
+
+    i = 0;
+    do
+    {
+        rt_mutex_take(&mutex_detector_list, RT_WAITING_FOREVER);
+        for(num = 0; (num < MQTT_PUSH_MAX_RECORDS) && (i < g_detector_info_list.num); num++, i++)
+        {
+            push_batch[num].type  = NODE_DEVICE_TYPE_DETECTOR;
+            push_batch[num].id    = g_detector_info_list.detector_info[i].id;
+            push_batch[num].state = g_detector_info_list.detector_info[i].state;
+            push_batch[num].value = g_detector_info_list.detector_info[i].battery;
+        }
+        rt_mutex_release(&mutex_detector_list);
+
+        if((num > 0) && (mqtt_push_publish(push_batch, num) != 0))
+        {
+            return -1;
+        }
+    } while(num == MQTT_PUSH_MAX_RECORDS);
+
+    i = 0;
+    do
+    {
+        rt_mutex_take(&mutex_light_list, RT_WAITING_FOREVER);
+        for(num = 0; (num < MQTT_PUSH_MAX_RECORDS) && (i < g_light_info_list.num); num++, i++)
+        {
+            push_batch[num].type  = NODE_DEVICE_TYPE_LIGHT;
+            push_batch[num].id    = g_light_info_list.light_info[i].id;
+            push_batch[num].state = (g_light_info_list.light_info[i].state == NODE_STATE_OFFLINE) ?
+                                     NODE_STATE_OFFLINE : g_light_info_list.light_info[i].current_color;
+            push_batch[num].value = g_light_info_list.light_info[i].correct_color;
+        }
+        rt_mutex_release(&mutex_light_list);
+
+        if((num > 0) && (mqtt_push_publish(push_batch, num) != 0))
+        {
+            return -1;
+        }
+    } while(num == MQTT_PUSH_MAX_RECORDS);
+
+    return 0;
+}
+
+/**
+ * @brief  queue a state change to publish, never blocks. all nodes are
+ *         published again if the queue is full. nothing is queued while
+ *         push is disabled.
+ * @NOTE   may be called with mutex of node list taken
+ * @param  type: NODE_DEVICE_TYPE_DETECTOR or NODE_DEVICE_TYPE_LIGHT
+ * @param  id: node id
+ * @param  state: park state of detector, or displayed color of light,
+ *         NODE_STATE_OFFLINE for node offline
+ * @param  value: battery of detector, or color light should display
+ */
+void mqtt_push_state(rt_uint8_t type, rt_uint32_t id, rt_uint8_t state, rt_uint8_t value)
+{
+    struct mqtt_push_record rec;
+
+    if((mq_mqtt_push == RT_NULL) || (g_wnc_config.mqtt_ip == 0))
+    {
+        return;
+    }
+
+    rec.type  = type;
+    rec.id    = id;
+    rec.state = state;
+    rec.value = value;
+    if(rt_mq_send(mq_mqtt_push, &rec, sizeof(rec)) != RT_EOK)
+    {
+        push_snapshot = 1;
+    }
+}
+
+/**
+ * @brief  mqtt push thread entry. publishes state changes of lora nodes to
+ *         the broker as soon as they happen, all nodes after connected.
+ *         push is off while no broker is set in wnc config, by
+ *         CMD_MQTT_BROKER_OPT or mqtt_broker().
+ * @param  parameter: rt-thread param.
+ */
+void thread_mqtt_push(void* parameter)
+{
+    int num;
+
+    rt_sem_init(&sem_mqtt_push, "mqtt_push", 0, RT_IPC_FLAG_FIFO);
+    mq_mqtt_push = rt_mq_create(MQTT_PUSH_MQ_NAME,
+                                sizeof(struct mqtt_push_record),
+                                MQTT_PUSH_MQ_NUM,
+                                RT_IPC_FLAG_FIFO);
+    RT_ASSERT(mq_mqtt_push != RT_NULL);
+
+    while(1)
+    {
+        /* broker changed, reconnect */
+        if(push_connected && (push_broker_ip != g_wnc_config.mqtt_ip))
+        {
+            mqtt_push_disconnect();
+        }
+
+        if(g_wnc_config.mqtt_ip == 0)
+        {
+            /* push disabled, changes queued before are dropped */
+            while(rt_mq_recv(mq_mqtt_push, &push_batch[0], sizeof(push_batch[0]), 0) == RT_EOK);
+            rt_thread_delay(MQTT_PUSH_RETRY_TICKS);
+            continue;
+        }
+
+        if(!push_connected)
+        {
+            if(mqtt_push_connect() != 0)
+            {
+                rt_thread_delay(MQTT_PUSH_RETRY_TICKS);
+                continue;
+            }
+            push_snapshot = 1;
+        }
+
+        /* changes lost while disconnected or queue full */
+        if(push_snapshot)
+        {
+            push_snapshot = 0;
+            if(mqtt_push_all() != 0)
+            {
+                push_snapshot = 1;
+                continue;
+            }
+        }
+
+        if(rt_mq_recv(mq_mqtt_push, &push_batch[0], sizeof(push_batch[0]),
+                      MQTT_PUSH_RETRY_TICKS) != RT_EOK)
+        {
+            continue;
+        }
+
+#if MQTT_PUSH_BATCH_TICKS
+        rt_thread_delay(MQTT_PUSH_BATCH_TICKS);
+#endif /* MQTT_PUSH_BATCH_TICKS */
+        for(num = 1; num < MQTT_PUSH_MAX_RECORDS; num++)
+        {
+            if(rt_mq_recv(mq_mqtt_push, &push_batch[num], sizeof(push_batch[num]), 0) != RT_EOK)
+            {
+                break;
+            }
+        }
+
+        if(mqtt_push_publish(push_batch, num) != 0)
+        {
+            push_snapshot = 1;
+        }
+    }
+}
+
+#ifdef RT_USING_FINSH
+/**
+ * @brief  set and save broker from finsh to enable push, such as
+ *         mqtt_broker("192.168.1.2"), mqtt_broker("") to disable push
+ */
+void mqtt_broker(const char *ip)
+{
+    g_wnc_config_bak.mqtt_ip = inet_addr(ip);
+    if(g_wnc_config_bak.mqtt_ip == IPADDR_NONE)
+    {
+        g_wnc_config_bak.mqtt_ip = 0;
+    }
+    set_wnc_config();
+}
+FINSH_FUNCTION_EXPORT(mqtt_broker, set mqtt broker ip of state push and enable it);
+#endif /* RT_USING_FINSH */
+
+/* ****************************** end of file ****************************** */
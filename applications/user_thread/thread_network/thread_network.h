@@ -14,6 +14,11 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-04      Test          First version.
+ * 2017-06-26      Test          Add threads stall statistics command.
+ * 2017-06-27      Test          Add cpu profiler command.
+ * 2017-06-29      Test          Add mqtt state push thread.
+ * 2017-06-29      Test          Add tcp protocol v2 with request id and streams.
+ * 2017-06-29      Test          Add mqtt broker command.
  ******************************************************************************
  */
 
@@ -55,6 +60,12 @@
 #define CMD_GET_SLOT_INFOS              31
 #define CMD_LOCAL_LORA_PARAMS_OPT	    38
 #define CMD_SENSOR_OFFLINE_TIMEOUT      39
+#define CMD_THREAD_STALL_STAT           40
+#define CMD_CPU_PROFILE                 41
+#define CMD_NET_PERF                    42
+#define CMD_PROTO_V2                    43
+#define CMD_NET_POOL_STAT               44
+#define CMD_MQTT_BROKER_OPT             45
 #define CMD_LORA_SEND_TEST              240
 #define CMD_USER_INIT                   241 
 #define CMD_CLIENT_NODE_LORA_SEND       242
@@ -66,6 +77,35 @@
 #define CMD_LORA_CONFIG_NODE_BY_ID      248
 
 #define DEVICE_TYPE                     "LN"
+
+/**
+ * tcp protocol v2, used after CMD_PROTO_V2 succeeded on a connection and
+ * v1 packets still work on it. a v2 frame is struct tcp_v2_header followed
+ * by data_len bytes payload, crc is crc32 of header before crc and payload.
+ * replies carry req_id of request, so requests need not wait for replies.
+ * replies sent later by other threads (lora node config) stay v1 packets.
+ */
+#define TCP_V2_MAGIC                    (0xA5)      /* no v1 command use it */
+#define TCP_V2_VERSION                  (2)
+#define TCP_V2_MAX_PAYLOAD              (MAX_TCP_DATA_LENGTH)
+#define TCP_V2_MAX_WINDOW               (16)        /* chunks of a read stream in flight */
+
+/* v2 commands */
+#define TCP_V2_TUNNEL                   0x01        /* payload is a v1 packet */
+#define TCP_V2_CANCEL                   0x02        /* stop read stream of req_id */
+#define TCP_V2_READ_OPEN                0x10        /* read a file or log from offset */
+#define TCP_V2_READ_DATA                0x11        /* chunk of read stream */
+#define TCP_V2_READ_ACK                 0x12        /* bytes of read stream received */
+#define TCP_V2_WRITE_OPEN               0x20        /* new or resumed download */
+#define TCP_V2_WRITE_DATA               0x21        /* chunk of download */
+
+/* v2 flags */
+#define TCP_V2_FLAG_FIN                 0x01        /* last chunk of read stream */
+#define TCP_V2_FLAG_ERR                 0x02        /* frame refused, payload is error */
+
+/* v2 errors */
+#define TCP_V2_ERR_CRC                  (1)
+#define TCP_V2_ERR_CMD                  (2)
  
 /**
  ******************************************************************************
@@ -86,6 +126,21 @@ __packed struct tcp_pack_header
 };
 typedef struct tcp_pack_header * tcp_pack_header_t;
 
+/**
+ * @brief  structure containing tcp protocol v2 frame header
+ */
+__packed struct tcp_v2_header
+{
+	rt_uint8_t     magic;                  /* TCP_V2_MAGIC */
+	rt_uint8_t     version;                /* TCP_V2_VERSION */
+	rt_uint8_t     cmd;                    /* v2 command value */
+	rt_uint8_t     flags;                  /* TCP_V2_FLAG_xxx */
+	rt_uint16_t    req_id;                 /* request id given by host */
+	rt_uint16_t    data_len;               /* payload length */
+	rt_uint32_t    crc;                    /* crc32 of header before crc and payload */
+};
+typedef struct tcp_v2_header * tcp_v2_header_t;
+
 /**
  ******************************************************************************
  *                              GLOBAL VARIABLES
@@ -95,6 +150,7 @@ typedef struct tcp_pack_header * tcp_pack_header_t;
 extern rt_thread_t  tid_udp_client;  /* udp client thread handler */
 extern rt_thread_t  tid_udp_server;  /* udp server thread handler */
 extern rt_thread_t  tid_tcp_server;  /* tcp server thread handler */
+extern rt_thread_t  tid_mqtt_push;   /* mqtt state push thread handler */
 
  /**
  ******************************************************************************
@@ -117,11 +173,15 @@ extern rt_thread_t  tid_tcp_server;  /* tcp server thread handler */
  */
 
 extern char     xor_verify                  (const char *data, int len);
+extern rt_uint32_t crc32_verify              (rt_uint32_t crc, const char *data, int len);
 extern void     get_datetime                (char *data);
 extern int      init_udp_socket_handler     (void);
 extern void     thread_udp_client           (void* parameter);
 extern void     thread_udp_server           (void* parameter);
 extern void     thread_tcp_server           (void* parameter);
+extern void     thread_mqtt_push            (void* parameter);
+extern void     mqtt_push_state             (rt_uint8_t type, rt_uint32_t id,
+                                             rt_uint8_t state, rt_uint8_t value);
 
 /**
  ******************************************************************************
@@ -14,6 +14,17 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-04      Test          First version.
+ * 2017-06-22      Test          Set and get lora receive channels at runtime.
+ * 2017-06-23      Test          Use deferred trace for debug messages.
+ * 2017-06-26      Test          Get threads stall statistics.
+ * 2017-06-27      Test          Get cpu profiler statistics and switch events.
+ * 2017-06-29      Test          Start iperf test and get its result.
+ * 2017-06-29      Test          Get and set datetime by wall clock.
+ * 2017-06-29      Test          Add protocol v2 with request id and streams.
+ * 2017-06-29      Test          Get lwip heap and pool usage.
+ * 2017-06-29      Test          Search packet again inside a rejected v2 header.
+ * 2017-06-29      Test          Hold a log for the stream reading it.
+ * 2017-06-29      Test          Set and get mqtt broker.
  ******************************************************************************
  */
  
@@ -26,6 +37,7 @@
 
 
 #include <lwip/sockets.h>
+#include <lwip/memp.h>
 
 #include "embedded_flash.h"
 #include "external_flash.h"
@@ -33,8 +45,13 @@
 #include "thread_sysctrl.h"
 #include "thread_lora.h"
 #include "thread_led.h"
+#include "trace.h"
+#include "profiler.h"
+#include "net_perf.h"
+#include "net_stat.h"
+#include "gd32f20x.h"
 
-#include "pcf8563.h"
+#include "wall_clock.h"
 
 #include <stdio.h>              // sscanf
 
@@ -49,6 +66,16 @@
 /* need less than NUM_SOCKETS - 3(udp socket + tcp server socket + refuse new fd) */
 #define MAX_TCP_CONNECT             RT_LWIP_TCP_PCB_NUM
 
+/* data of a v2 read stream chunk, after 4 bytes offset */
+#define TCP_V2_CHUNK_SIZE           (TCP_V2_MAX_PAYLOAD - 4)
+
+/* read stream chunks sent once for a connection, then others get their turn */
+#define TCP_V2_PUMP_CHUNKS          (4)
+
+/* bytes checked for a packet start, the longer of v1 and v2 headers */
+#define TCP_HEADER_LEN              ((sizeof(struct tcp_pack_header) > sizeof(struct tcp_v2_header)) ? \
+                                      sizeof(struct tcp_pack_header) : sizeof(struct tcp_v2_header))
+
 #define min(a, b)     (((a) < (b)) ? (a) : (b))
 #define max(a, b)     min((b), (a))
 
@@ -56,7 +83,7 @@
 #define DEBUG_TCP   1
 
 #if DEBUG_TCP
-    #define DEBUG_PRINTF    rt_kprintf
+    #define DEBUG_PRINTF    trace_printf
 #else
     #define DEBUG_PRINTF(...)
 #endif /* DEBUG_TCP */
@@ -67,6 +94,36 @@
  ******************************************************************************
  */
 
+/**
+ * @brief  structure containing v2 read stream of a connection
+ */
+struct tcp_read_stream
+{
+    rt_uint8_t          active;
+    rt_uint16_t         req_id;                 /* READ_OPEN request id, network order */
+    rt_uint32_t         offset;                 /* next byte to send */
+    rt_uint32_t         acked;                  /* bytes host received */
+    rt_uint32_t         window;                 /* bytes could be sent before acked */
+    struct file_stream  file;
+};
+
+/**
+ * @brief  structure containing state of a tcp connection
+ */
+struct tcp_conn
+{
+    int                     fd;
+    rt_uint8_t              v2;                 /* protocol v2 negotiated */
+    rt_uint8_t              new_pack;           /* followed data should be new packet */
+    rt_uint8_t              v2_frame;           /* packet in buf is a v2 frame */
+    size_t                  pack_len;           /* completed packet length */
+    size_t                  buf_len;            /* data in buf length */
+    struct tcp_read_stream  read;
+    
+    /* buffer containing completed command, a tunneled v1 packet follows v2 header */
+    char                    buf[sizeof(struct tcp_v2_header) + TCP_V2_MAX_PAYLOAD];
+};
+
 
 /**
  ******************************************************************************
@@ -82,9 +139,15 @@ rt_thread_t tid_tcp_server = RT_NULL;
  ******************************************************************************
  */
 
-static char     tcp_buf[MAX_TCP_DATA_LENGTH];       /* tcp buffer */
-static size_t   cmd_buf_len = 0;                    /* data in cmd_buf length */
-static char     cmd_buf[MAX_TCP_DATA_LENGTH];       /* buffer containing completed command */
+static char             tcp_buf[MAX_TCP_DATA_LENGTH];       /* tcp buffer */
+static struct tcp_conn  tcp_conns[MAX_TCP_CONNECT];         /* connected clients */
+
+/* frame of read stream chunk */
+static char             stream_buf[sizeof(struct tcp_v2_header) + TCP_V2_MAX_PAYLOAD];
+
+/* set while a v1 packet in v2 frame is analyzed, replies go in v2 frames */
+static rt_uint8_t       tunnel_active = 0;
+static rt_uint16_t      tunnel_req_id;
  
 /**
  ******************************************************************************
@@ -103,10 +166,28 @@ static rt_uint16_t  get_device_net_params   (char *data);
 static rt_uint16_t  get_dev_all_info        (char * data);
 static rt_uint8_t   set_lora_params         (char *data, rt_uint16_t data_len);
 static rt_uint16_t  get_lora_params         (char *data);
+static rt_uint8_t   set_lora_channels       (char *data, rt_uint16_t data_len);
+static rt_uint16_t  get_lora_channels       (char *data);
 static rt_uint8_t   set_offline_timeout     (char *data, rt_uint16_t data_len);
 static rt_uint16_t  get_offline_timeout     (char *data);
-static void         analyze_command         (int fd, char *data, size_t len);
-static void         handle_recv_pack        (int fd, char *data, size_t len);
+static rt_uint8_t   set_mqtt_broker         (char *data, rt_uint16_t data_len);
+static rt_uint16_t  get_mqtt_broker         (char *data);
+static void         tcp_reply               (int fd, char *data, size_t len);
+static void         analyze_command         (struct tcp_conn *conn, char *data, size_t len);
+static void         v2_send                 (int fd, char *frame, rt_uint8_t cmd, rt_uint8_t flags,
+                                             rt_uint16_t req_id, rt_uint16_t data_len);
+static void         v2_read_open            (struct tcp_conn *conn, rt_uint16_t req_id,
+                                             char *payload, rt_uint16_t data_len);
+static void         v2_write_open           (struct tcp_conn *conn, rt_uint16_t req_id,
+                                             char *payload, rt_uint16_t data_len);
+static void         v2_write_data           (struct tcp_conn *conn, rt_uint16_t req_id,
+                                             char *payload, rt_uint16_t data_len);
+static void         analyze_v2_frame        (struct tcp_conn *conn);
+static rt_uint8_t   stream_can_send         (struct tcp_conn *conn);
+static void         stream_pump             (struct tcp_conn *conn);
+static void         stream_stop             (struct tcp_conn *conn);
+static rt_uint8_t   check_pack_header       (struct tcp_conn *conn);
+static void         handle_recv_pack        (struct tcp_conn *conn, char *data, size_t len);
 static int          set_socket_fd_keepalive (int fd);
  
 /**
@@ -174,7 +255,7 @@ static rt_uint8_t set_datetime(char *data)
 	datetime.second = *data;
 	//DEBUG_PRINTF("year:%d,month:%d,day:%d,hour:%d,min:%d,sen:%d\n",datetime.year,
 	//		datetime.month,datetime.day,datetime.hour,datetime.minute,datetime.second);
-	return (pcf8563_set_datetime(&datetime) == RT_EOK) ? 1 : 0;
+	return (wall_clock_set(&datetime) == RT_EOK) ? 1 : 0;
 
 }
 
@@ -543,6 +624,72 @@ static rt_uint16_t get_lora_params(char *data)
     return ((rt_uint16_t)5); /* always 5 */
 }
 
+/**
+ * @brief  change lora multi-SF receive channels, applied on running module
+ *         and lost after reboot.
+ * @param  data: pointer to command buffer, operate(1) + count(1) + count * 
+ *         [channel(1) + enable(1) + frequency(4) + SF mask(1)]
+ * @param  data_len: command length
+ * @retval 1 for success, 0 for failed
+ *
+ * @NOTE   SF mask bit0 for SF7 ... bit5 for SF12, channels are applied in
+ *         order and stop on first failed one.
+ */
+static rt_uint8_t set_lora_channels(char *data, rt_uint16_t data_len)
+{
+    rt_uint8_t  cnt, i;
+    rt_uint32_t tmp_freq;
+    char        *p;
+    
+    cnt = data[1];
+    if(cnt == 0 || data_len != 2 + cnt * 7)
+    {
+        return 0;
+    }
+    
+    for(i = 0, p = data + 2; i < cnt; i++, p += 7)
+    {
+        tmp_freq = (((rt_uint32_t)p[2] << 24) & 0xff000000) |
+                   (((rt_uint32_t)p[3] << 16) & 0x00ff0000) |
+                   (((rt_uint32_t)p[4] << 8 ) & 0x0000ff00) |
+                   (((rt_uint32_t)p[5]        & 0x000000ff));
+        
+        if(set_lora_channel(p[0], p[1], tmp_freq, p[6]) != 0)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/**
+ * @brief  get lora multi-SF receive channels
+ * @param  data: pointer to data buffer
+ * @retval data length
+ */
+static rt_uint16_t get_lora_channels(char *data)
+{
+    rt_uint8_t  i, enable, sf_mask;
+    rt_uint32_t tmp_freq;
+    char        *p = data + 1;
+    
+    data[0] = 0;
+    for(i = 0; get_lora_channel(i, &enable, &tmp_freq, &sf_mask) == 0; i++)
+    {
+        p[0] = i;
+        p[1] = enable;
+        tmp_freq = htonl(tmp_freq);
+        rt_memcpy(&p[2], &tmp_freq, sizeof(tmp_freq));
+        p[6] = sf_mask;
+        
+        p += 7;
+        data[0]++;
+    }
+    
+    return ((rt_uint16_t)(p - data));
+}
+
 /**
  * @brief  set ditector offline timeout
  * @param  data: pointer to command buffer
@@ -591,25 +738,364 @@ static rt_uint16_t get_offline_timeout(char *data)
 }
 
 /**
- * @brief  analyze tcp commands
+ * @brief  set broker of mqtt state push and save it
+ * @param  data: pointer to command buffer
+ * @param  data_len: command length
+ * @retval 1 for success, 0 for failed
+ *
+ * @NOTE   data format: operate, ip length, ip string. length 0 disables
+ *         push.
+ */
+static rt_uint8_t set_mqtt_broker(char *data, rt_uint16_t data_len)
+{
+    char        ip_str[16] = {0};
+    rt_uint8_t  ip_len;
+    rt_uint32_t ip = 0;
+
+    if(data_len < 2)
+    {
+        return 0;
+    }
+
+    data++;
+    ip_len = *data++;
+    if((data_len != ip_len + 2) || (ip_len >= sizeof(ip_str)))
+    {
+        return 0;
+    }
+    rt_memcpy(ip_str, data, ip_len);
+
+    if((ip_len != 0) && !ip_str_to_digit(ip_str, &ip))
+    {
+        return 0;
+    }
+
+    /* mqtt push thread reconnects to the new broker */
+    g_wnc_config_bak.mqtt_ip = ip;
+    set_wnc_config();
+
+    return 1;
+}
+
+/**
+ * @brief  get broker of mqtt state push
+ * @param  data: pointer to data buffer
+ * @retval data length
+ *
+ * @NOTE   data format: ip length, ip string. length 0 for push disabled.
+ */
+static rt_uint16_t get_mqtt_broker(char *data)
+{
+    if(g_wnc_config.mqtt_ip == 0)
+    {
+        data[0] = 0;
+    }
+    else
+    {
+        ip_digit_to_str(g_wnc_config.mqtt_ip, &data[1], &data[0]);
+    }
+
+    return ((rt_uint16_t)(1 + data[0]));
+}
+
+/**
+ * @brief  set stall deadline of a thread
+ * @param  data: pointer to command buffer
+ * @param  data_len: command length
+ * @retval 1 for success, 0 for falied
+ *
+ * @NOTE   data format: operate, thread index, deadline in ms (4 bytes),
+ *         deadline 0 restores default.
+ */
+static rt_uint8_t set_thread_deadline(char *data, rt_uint16_t data_len)
+{
+    rt_uint32_t deadline;
+
+    if(data_len != 6)
+    {
+        return 0;
+    }
+
+    rt_memcpy(&deadline, &data[2], sizeof(deadline));
+    
+    return (threads_set_dog_deadline(data[1], ntohl(deadline)) == 0);
+}
+
+/**
+ * @brief  get stall statistics of all threads
+ * @param  data: pointer to data buffer
+ * @retval data length
+ *
+ * @NOTE   data format: thread count, then for each thread index, deadline,
+ *         loops, max interval, stalls and histogram of loop intervals, all
+ *         4 bytes big endian except index.
+ */
+static rt_uint16_t get_thread_stall_stat(char *data)
+{
+    struct soft_dog_stat    stat;
+    rt_uint32_t             *words;
+    char                    *p = data + 1;
+    int                     i, j;
+    
+    data[0] = 0;
+    for(i = 0; threads_get_dog_stat(i, &stat) == 0; i++)
+    {
+        words = (rt_uint32_t *)&stat;
+        
+        p[0] = i;
+        p++;
+        for(j = 0; j < sizeof(stat) / sizeof(rt_uint32_t); j++)
+        {
+            rt_uint32_t tmp = htonl(words[j]);
+            
+            rt_memcpy(p, &tmp, sizeof(tmp));
+            p += sizeof(tmp);
+        }
+        data[0]++;
+    }
+    
+    return ((rt_uint16_t)(p - data));
+}
+
+/**
+ * @brief  get cpu time of threads
+ * @param  data: pointer to data buffer
+ * @retval data length
+ *
+ * @NOTE   data format: core clock in Hz, thread count, then for each thread
+ *         name (RT_NAME_MAX bytes), run cycles (8 bytes), switches and max
+ *         slice in cycles, all big endian.
+ */
+static rt_uint16_t get_cpu_profile(char *data)
+{
+    struct profiler_stat    stat;
+    rt_uint32_t             words[4];
+    char                    *p = data + 5;
+    int                     i, j;
+    
+    words[0] = htonl(SystemCoreClock);
+    rt_memcpy(data, &words[0], sizeof(words[0]));
+    
+    data[4] = 0;
+    for(i = 0; profiler_get(i, &stat) == 0; i++)
+    {
+        rt_memcpy(p, stat.name, RT_NAME_MAX);
+        p += RT_NAME_MAX;
+        
+        words[0] = stat.run_hi;
+        words[1] = stat.run_lo;
+        words[2] = stat.switches;
+        words[3] = stat.max_slice;
+        for(j = 0; j < 4; j++)
+        {
+            rt_uint32_t tmp = htonl(words[j]);
+            
+            rt_memcpy(p, &tmp, sizeof(tmp));
+            p += sizeof(tmp);
+        }
+        data[4]++;
+    }
+    
+    return ((rt_uint16_t)(p - data));
+}
+
+/**
+ * @brief  get recent context switches
+ * @param  data: pointer to data buffer
+ * @retval data length
+ *
+ * @NOTE   data format: event count (2 bytes), then for each event DWT cycle
+ *         (4 bytes), from and to thread index of get_cpu_profile(), oldest
+ *         first. index 0xff is a thread not accounted.
+ */
+static rt_uint16_t get_cpu_events(char *data)
+{
+    static struct profiler_event events[PROFILER_EVENT_NUM];
+    rt_uint16_t num;
+    char        *p = data + 2;
+    int         i;
+    
+    num = profiler_get_events(events, PROFILER_EVENT_NUM);
+    data[0] = (num >> 8) & 0xff;
+    data[1] =  num       & 0xff;
+    
+    for(i = 0; i < num; i++)
+    {
+        rt_uint32_t tmp = htonl(events[i].cycle);
+        
+        rt_memcpy(p, &tmp, sizeof(tmp));
+        p[4] = events[i].from;
+        p[5] = events[i].to;
+        p += 6;
+    }
+    
+    return ((rt_uint16_t)(p - data));
+}
+
+/**
+ * @brief  get state and result of last iperf test
+ * @param  data: pointer to data buffer
+ * @retval data length
+ *
+ * @NOTE   data format: state, tests finished, report type (1 byte each),
+ *         remote ip (network order), bytes, ms, kbit/s, retransmits (4 bytes
+ *         each), pbuf pool max, pbuf pool size, pool errors (2 bytes each),
+ *         lwip heap max (4 bytes), all big endian.
+ */
+static rt_uint16_t get_net_perf(char *data)
+{
+    struct net_perf_stat    stat;
+    rt_uint32_t             words[5];
+    rt_uint16_t             halves[3];
+    char                    *p = data + 3;
+    int                     i;
+    
+    net_perf_get(&stat);
+    data[0] = stat.state;
+    data[1] = stat.tests;
+    data[2] = stat.report;
+    
+    rt_memcpy(p, &stat.remote_ip, sizeof(stat.remote_ip));
+    p += sizeof(stat.remote_ip);
+    
+    words[0] = stat.bytes;
+    words[1] = stat.ms;
+    words[2] = stat.kbps;
+    words[3] = stat.retrans;
+    for(i = 0; i < 4; i++)
+    {
+        rt_uint32_t tmp = htonl(words[i]);
+        
+        rt_memcpy(p, &tmp, sizeof(tmp));
+        p += sizeof(tmp);
+    }
+    
+    halves[0] = htons(stat.pbuf_max);
+    halves[1] = htons(stat.pbuf_avail);
+    halves[2] = htons(stat.pool_err);
+    rt_memcpy(p, halves, sizeof(halves));
+    p += sizeof(halves);
+    
+    words[4] = htonl(stat.mem_max);
+    rt_memcpy(p, &words[4], sizeof(words[4]));
+    p += sizeof(words[4]);
+    
+    return ((rt_uint16_t)(p - data));
+}
+
+/**
+ * @brief  get usage of lwip heap and memp pools
+ * @param  data: pointer to data buffer
+ * @retval data length
+ *
+ * @NOTE   data format: heap size, avail, used, max (4 bytes each), heap
+ *         errors (2 bytes), seconds since reset (4 bytes), TCP_MSS,
+ *         TCP_SND_BUF, TCP_WND, PBUF_POOL_BUFSIZE (2 bytes each), pool count,
+ *         then for each pool name length (1 byte), name, element size, avail,
+ *         used, max and errors (2 bytes each), all big endian.
+ */
+static rt_uint16_t get_net_pool_stat(char *data)
+{
+    static struct net_pool_stat pools[MEMP_MAX];
+    struct net_heap_stat        heap;
+    rt_uint32_t                 words[5];
+    rt_uint16_t                 halves[5];
+    char                        *p = data;
+    char                        *count;
+    char                        *end = data + MAX_TCP_DATA_LENGTH - sizeof(struct tcp_pack_header) - 1;
+    int                         num, i;
+    
+    net_stat_heap(&heap);
+    words[0] = htonl(heap.size);
+    words[1] = htonl(heap.avail);
+    words[2] = htonl(heap.used);
+    words[3] = htonl(heap.max);
+    rt_memcpy(p, words, 4 * sizeof(words[0]));
+    p += 4 * sizeof(words[0]);
+    
+    halves[0] = htons(heap.err);
+    rt_memcpy(p, &halves[0], sizeof(halves[0]));
+    p += sizeof(halves[0]);
+    
+    words[4] = htonl(heap.seconds);
+    rt_memcpy(p, &words[4], sizeof(words[4]));
+    p += sizeof(words[4]);
+    
+    halves[0] = htons(TCP_MSS);
+    halves[1] = htons(TCP_SND_BUF);
+    halves[2] = htons(TCP_WND);
+    halves[3] = htons(PBUF_POOL_BUFSIZE);
+    rt_memcpy(p, halves, 4 * sizeof(halves[0]));
+    p += 4 * sizeof(halves[0]);
+    
+    num = net_stat_pools(pools, MEMP_MAX);
+    count = p++;
+    for(i = 0; i < num; i++)
+    {
+        rt_uint8_t name_len = (rt_uint8_t)rt_strlen(pools[i].name);
+        
+        if(p + 1 + name_len + sizeof(halves) > end)
+        {
+            break;
+        }
+        
+        *p++ = name_len;
+        rt_memcpy(p, pools[i].name, name_len);
+        p += name_len;
+        
+        halves[0] = htons(pools[i].size);
+        halves[1] = htons(pools[i].avail);
+        halves[2] = htons(pools[i].used);
+        halves[3] = htons(pools[i].max);
+        halves[4] = htons(pools[i].err);
+        rt_memcpy(p, halves, sizeof(halves));
+        p += sizeof(halves);
+    }
+    *count = (char)i;
+    
+    return ((rt_uint16_t)(p - data));
+}
+
+/**
+ * @brief  send reply of a v1 packet, in a v2 frame when the packet is tunneled
  * @param  fd: socket fd
+ * @param  data: pointer to reply packet
+ * @param  len: reply packet length
+ */
+static void tcp_reply(int fd, char *data, size_t len)
+{
+    if(tunnel_active)
+    {
+        /* v2 header space is just before tunneled packet */
+        v2_send(fd, data - sizeof(struct tcp_v2_header), TCP_V2_TUNNEL, 0, tunnel_req_id, len);
+    }
+    else
+    {
+        send(fd, data, len, 0);
+    }
+}
+
+/**
+ * @brief  analyze tcp commands
+ * @param  conn: pointer to connection
  * @param  data: pointer to command buffer
  * @param  len: command length 
  */
-static void analyze_command(int fd, char *data, size_t len)
+static void analyze_command(struct tcp_conn *conn, char *data, size_t len)
 {
+    int                 fd = conn->fd;
     tcp_pack_header_t   header;
     char                *payload;
     rt_uint16_t         data_len;
     
+    header = (tcp_pack_header_t)data;
+    
     if(xor_verify(data, (len - 1)) != data[len - 1])
     {
         /* checksum error */
         goto tcp_bad_cmd;
     }
     
-    header = (tcp_pack_header_t)data;
-    
     if((header->id != htonl(wnc_device.id)) &&
        (header->id != 0) && 
        (header->cmd != CMD_SET_DEV_ID_AND_MAC))
@@ -630,7 +1116,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     case CMD_ERASE_DEV_ID_AND_MAC:
@@ -640,7 +1126,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     case CMD_SOFT_REBOOT:
@@ -657,7 +1143,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     case CMD_ADJUST_MACHINE_CLOCK:
@@ -670,7 +1156,7 @@ static void analyze_command(int fd, char *data, size_t len)
         
         /* datalen not changed */
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);       
+        tcp_reply(fd, data, len);       
         break;
     }
     case CMD_READ_MACHINE_CLOCK:
@@ -681,7 +1167,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     case CMD_SET_SERVER_IP:
@@ -689,7 +1175,7 @@ static void analyze_command(int fd, char *data, size_t len)
         *payload = set_remote_server_ip(payload, data_len);
         /* datalen not changed */
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);          
+        tcp_reply(fd, data, len);          
         break;
     }
     case CMD_CONFIGURE_FILES_OPT:								//ءϴļ
@@ -708,7 +1194,7 @@ static void analyze_command(int fd, char *data, size_t len)
                 header->data_len = htons(data_len);
                 len = sizeof(struct tcp_pack_header) + data_len + 1;
                 *(data + len - 1) = xor_verify(data, (len - 1));                
-                send(fd, data, len, 0); 
+                tcp_reply(fd, data, len); 
                 header->pack_sn++;
                 
                 /**
@@ -729,7 +1215,7 @@ static void analyze_command(int fd, char *data, size_t len)
                 header->data_len = htons(data_len);
                 len = sizeof(struct tcp_pack_header) + data_len + 1;
                 *(data + len - 1) = xor_verify(data, (len - 1));
-                send(fd, data, len, 0);                
+                tcp_reply(fd, data, len);                
             }
         }
         else
@@ -751,7 +1237,7 @@ static void analyze_command(int fd, char *data, size_t len)
                 header->data_len = htons(data_len);
                 len = sizeof(struct tcp_pack_header) + data_len + 1;
                 *(data + len - 1) = xor_verify(data, (len - 1));
-                send(fd, data, len, 0);                
+                tcp_reply(fd, data, len);                
             }
         }
         break;
@@ -768,7 +1254,7 @@ static void analyze_command(int fd, char *data, size_t len)
             
             *payload = ret;
             *(data + len - 1) = xor_verify(data, (len - 1));
-            send(fd, data, len, 0);            
+            tcp_reply(fd, data, len);            
         }
         else  /* get */
         {
@@ -778,7 +1264,7 @@ static void analyze_command(int fd, char *data, size_t len)
             header->data_len = htons(data_len);
             len = sizeof(struct tcp_pack_header) + data_len + 1;
             *(data + len - 1) = xor_verify(data, (len - 1));
-            send(fd, data, len, 0);             
+            tcp_reply(fd, data, len);             
         }
         break;
     }
@@ -789,7 +1275,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     case CMD_GET_SLOT_INFOS:
@@ -798,7 +1284,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);        
+        tcp_reply(fd, data, len);        
         break;
     }
     case CMD_LORA_SEND_TEST:			//LORA߷Ͳ
@@ -824,7 +1310,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     case CMD_LORA_RECV_TEST:		//߽ղ
@@ -861,7 +1347,7 @@ static void analyze_command(int fd, char *data, size_t len)
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);        
+        tcp_reply(fd, data, len);        
         break;
     }
     case CMD_LOCAL_LORA_PARAMS_OPT:
@@ -876,7 +1362,25 @@ static void analyze_command(int fd, char *data, size_t len)
             
             *payload = ret;
             *(data + len - 1) = xor_verify(data, (len - 1));
-            send(fd, data, len, 0);             
+            tcp_reply(fd, data, len);             
+        }
+        else if(operate == 2 /* set channels */)
+        {
+            rt_uint8_t ret;
+            
+            ret = set_lora_channels(payload, data_len);
+            
+            *payload = ret;
+            *(data + len - 1) = xor_verify(data, (len - 1));
+            tcp_reply(fd, data, len);
+        }
+        else if(operate == 3 /* get channels */)
+        {
+            data_len = get_lora_channels(payload);
+            header->data_len = htons(data_len);
+            len = sizeof(struct tcp_pack_header) + data_len + 1;
+            *(data + len - 1) = xor_verify(data, (len - 1));
+            tcp_reply(fd, data, len);
         }
         else  /* get */
         {
@@ -884,7 +1388,7 @@ static void analyze_command(int fd, char *data, size_t len)
             header->data_len = htons(data_len);
             len = sizeof(struct tcp_pack_header) + data_len + 1;
             *(data + len - 1) = xor_verify(data, (len - 1));
-            send(fd, data, len, 0);
+            tcp_reply(fd, data, len);
         }
             
         break;
@@ -904,7 +1408,7 @@ static void analyze_command(int fd, char *data, size_t len)
             header->data_len = htons(data_len);
             len = sizeof(struct tcp_pack_header) + data_len + 1;
             *(data + len - 1) = xor_verify(data, (len - 1));
-            send(fd, data, len, 0);             
+            tcp_reply(fd, data, len);             
         }
         else  /* get */
         {
@@ -912,28 +1416,192 @@ static void analyze_command(int fd, char *data, size_t len)
             header->data_len = htons(data_len);
             len = sizeof(struct tcp_pack_header) + data_len + 1;
             *(data + len - 1) = xor_verify(data, (len - 1));
-            send(fd, data, len, 0);            
+            tcp_reply(fd, data, len);            
         }
         break;
         
     }
-    case CMD_LORA_CONFIG_NODE_BY_RANGE:
+    case CMD_THREAD_STALL_STAT:
     {
-        stu_lora_msg    msg;
-        int *           p_data;
-        
-        p_data = (int *)msg.data;
-        
-        /* send message to system control thread */
-        rt_memset(&msg, 0, sizeof(msg));        
-        msg.type = MSG_LORA_CONFIG_NODE_BY_RANGE;
-        *p_data++ = fd;
-        rt_memcpy(p_data, payload, data_len);
-        rt_mq_send(mq_data_proc, &msg, sizeof(msg));
+        rt_uint8_t operate = *payload;
         
+        if(operate == 1 /* set deadline */ || operate == 2 /* clear */)
+        {
+            rt_uint8_t ret = 1;
+            
+            if(operate == 1)
+            {
+                ret = set_thread_deadline(payload, data_len);
+            }
+            else
+            {
+                threads_clear_dog_stat();
+            }
+            
+            *payload = ret;
+            data_len = 1;
+            header->data_len = htons(data_len);
+            len = sizeof(struct tcp_pack_header) + data_len + 1;
+            *(data + len - 1) = xor_verify(data, (len - 1));
+            tcp_reply(fd, data, len);
+        }
+        else  /* get */
+        {
+            data_len = get_thread_stall_stat(payload);
+            header->data_len = htons(data_len);
+            len = sizeof(struct tcp_pack_header) + data_len + 1;
+            *(data + len - 1) = xor_verify(data, (len - 1));
+            tcp_reply(fd, data, len);
+        }
         break;
     }
-    case CMD_LORA_INIT_NODE:
+    case CMD_CPU_PROFILE:
+    {
+        rt_uint8_t operate = *payload;
+        
+        if(operate == 1 /* reset */)
+        {
+            profiler_reset();
+            
+            *payload = 1;
+            data_len = 1;
+        }
+        else if(operate == 2 /* get switch events */)
+        {
+            data_len = get_cpu_events(payload);
+        }
+        else  /* get */
+        {
+            data_len = get_cpu_profile(payload);
+        }
+        header->data_len = htons(data_len);
+        len = sizeof(struct tcp_pack_header) + data_len + 1;
+        *(data + len - 1) = xor_verify(data, (len - 1));
+        tcp_reply(fd, data, len);
+        break;
+    }
+    case CMD_NET_PERF:
+    {
+        rt_uint8_t operate = *payload;
+        
+        if(operate == 1 /* start server */ || operate == 2 /* start client */ ||
+           operate == 3 /* stop */)
+        {
+            rt_uint8_t ret = 0;
+            
+            if(operate == 1)
+            {
+                ret = (net_perf_server() == 0);
+            }
+            else if(operate == 2)
+            {
+                /* server ip (network order), port and seconds (big endian) */
+                if(data_len >= 9)
+                {
+                    rt_uint8_t  *arg = (rt_uint8_t *)payload + 1;
+                    rt_uint32_t ip;
+                    
+                    rt_memcpy(&ip, arg, sizeof(ip));
+                    ret = (net_perf_client(ip, (arg[4] << 8) | arg[5],
+                                           (arg[6] << 8) | arg[7]) == 0);
+                }
+            }
+            else
+            {
+                net_perf_stop();
+                ret = 1;
+            }
+            
+            *payload = ret;
+            data_len = 1;
+        }
+        else  /* get */
+        {
+            data_len = get_net_perf(payload);
+        }
+        header->data_len = htons(data_len);
+        len = sizeof(struct tcp_pack_header) + data_len + 1;
+        *(data + len - 1) = xor_verify(data, (len - 1));
+        tcp_reply(fd, data, len);
+        break;
+    }
+    case CMD_NET_POOL_STAT:
+    {
+        if((data_len >= 1) && (*payload == 1))  /* reset */
+        {
+            net_stat_reset();
+            *payload = 1;
+            data_len = 1;
+        }
+        else  /* get */
+        {
+            data_len = get_net_pool_stat(payload);
+        }
+        header->data_len = htons(data_len);
+        len = sizeof(struct tcp_pack_header) + data_len + 1;
+        *(data + len - 1) = xor_verify(data, (len - 1));
+        tcp_reply(fd, data, len);
+        break;
+    }
+    case CMD_MQTT_BROKER_OPT:
+    {
+        if((data_len >= 1) && (*payload == 1))  /* set */
+        {
+            *payload = set_mqtt_broker(payload, data_len);
+            data_len = 1;
+        }
+        else  /* get */
+        {
+            data_len = get_mqtt_broker(payload);
+        }
+        header->data_len = htons(data_len);
+        len = sizeof(struct tcp_pack_header) + data_len + 1;
+        *(data + len - 1) = xor_verify(data, (len - 1));
+        tcp_reply(fd, data, len);
+        break;
+    }
+    case CMD_PROTO_V2:
+    {
+        /* host gives the highest version it knows, v2 frames work from now */
+        if((data_len >= 1) && ((rt_uint8_t)*payload >= TCP_V2_VERSION))
+        {
+            conn->v2 = 1;
+            
+            *payload       = 1;
+            *(payload + 1) = TCP_V2_VERSION;
+            *(payload + 2) = (char)(TCP_V2_MAX_PAYLOAD >> 8);
+            *(payload + 3) = (char)(TCP_V2_MAX_PAYLOAD & 0xff);
+            *(payload + 4) = TCP_V2_MAX_WINDOW;
+            data_len = 5;
+        }
+        else
+        {
+            *payload = 0;
+            data_len = 1;
+        }
+        header->data_len = htons(data_len);
+        len = sizeof(struct tcp_pack_header) + data_len + 1;
+        *(data + len - 1) = xor_verify(data, (len - 1));
+        tcp_reply(fd, data, len);
+        break;
+    }
+    case CMD_LORA_CONFIG_NODE_BY_RANGE:
+    {
+        stu_lora_msg    msg;
+        int *           p_data;
+        
+        p_data = (int *)msg.data;
+        
+        /* send message to system control thread */
+        rt_memset(&msg, 0, sizeof(msg));        
+        msg.type = MSG_LORA_CONFIG_NODE_BY_RANGE;
+        *p_data++ = fd;
+        rt_memcpy(p_data, payload, data_len);
+        rt_mq_send(mq_data_proc, &msg, sizeof(msg));
+        
+        break;
+    }
+    case CMD_LORA_INIT_NODE:
     {
         stu_lora_msg    msg;
         int *           p_data;
@@ -975,66 +1643,442 @@ tcp_bad_cmd:
         header->data_len = htons(data_len);
         len = sizeof(struct tcp_pack_header) + data_len + 1;
         *(data + len - 1) = xor_verify(data, (len - 1));
-        send(fd, data, len, 0);
+        tcp_reply(fd, data, len);
         break;
     }
     }
 }
 
+/**
+ * @brief  send a v2 frame
+ * @param  fd: socket fd
+ * @param  frame: pointer to frame buffer, payload is after header space
+ * @param  cmd: v2 command
+ * @param  flags: TCP_V2_FLAG_xxx
+ * @param  req_id: request id, network order
+ * @param  data_len: payload length
+ */
+static void v2_send(int fd, char *frame, rt_uint8_t cmd, rt_uint8_t flags,
+                    rt_uint16_t req_id, rt_uint16_t data_len)
+{
+    tcp_v2_header_t header;
+    rt_uint32_t     crc;
+    
+    header = (tcp_v2_header_t)frame;
+    header->magic    = TCP_V2_MAGIC;
+    header->version  = TCP_V2_VERSION;
+    header->cmd      = cmd;
+    header->flags    = flags;
+    header->req_id   = req_id;
+    header->data_len = htons(data_len);
+    
+    crc = crc32_verify(0, frame, sizeof(struct tcp_v2_header) - sizeof(header->crc));
+    crc = crc32_verify(crc, frame + sizeof(struct tcp_v2_header), data_len);
+    header->crc = htonl(crc);
+    
+    send(fd, frame, sizeof(struct tcp_v2_header) + data_len, 0);
+}
+
+/**
+ * @brief  open read stream of a connection, chunks are sent when socket writable
+ * @param  conn: pointer to connection
+ * @param  req_id: request id, network order
+ * @param  payload: offset(4), window in chunks(1), name length(1), name
+ * @param  data_len: payload length
+ *
+ * @NOTE   reply is result(1), file size(4), offset(4)
+ */
+static void v2_read_open(struct tcp_conn *conn, rt_uint16_t req_id,
+                         char *payload, rt_uint16_t data_len)
+{
+    struct tcp_read_stream *stream = &conn->read;
+    rt_uint32_t             offset = 0;
+    rt_uint32_t             window = 1;
+    rt_uint8_t              name_len;
+    char                    name[256];
+    rt_int32_t              size = -1;
+    
+    name_len = (data_len >= 6) ? (rt_uint8_t)payload[5] : 0;
+    
+    /* one read stream for a connection */
+    if((data_len >= 6 + name_len) && !stream->active)
+    {
+        rt_memcpy(&offset, payload, sizeof(offset));
+        offset = ntohl(offset);
+        window = (rt_uint8_t)payload[4];
+        window = (window == 0) ? 1 : min(window, TCP_V2_MAX_WINDOW);
+        rt_memcpy(name, payload + 6, name_len);
+        name[name_len] = '\0';
+        
+        size = file_stream_open(&stream->file, name, offset, conn->fd);
+    }
+    
+    if(size < 0)
+    {
+        /* file not exist, stream running or log read by another connection */
+        *payload = 0;
+        data_len = 1;
+    }
+    else
+    {
+        stream->active = 1;
+        stream->req_id = req_id;
+        stream->offset = offset;
+        stream->acked  = offset;
+        stream->window = window * TCP_V2_CHUNK_SIZE;
+        
+        *payload = 1;
+        size   = htonl(size);
+        offset = htonl(offset);
+        rt_memcpy(payload + 1, &size, 4);
+        rt_memcpy(payload + 5, &offset, 4);
+        data_len = 9;
+    }
+    
+    v2_send(conn->fd, conn->buf, TCP_V2_READ_OPEN, 0, req_id, data_len);
+}
+
+/**
+ * @brief  open a download, new or resumed
+ * @param  conn: pointer to connection
+ * @param  req_id: request id, network order
+ * @param  payload: file size(4), offset(4) 0 for new, name length(1), name
+ * @param  data_len: payload length
+ *
+ * @NOTE   reply is result(1), offset(4) host should send from
+ */
+static void v2_write_open(struct tcp_conn *conn, rt_uint16_t req_id,
+                          char *payload, rt_uint16_t data_len)
+{
+    rt_uint32_t size;
+    rt_uint32_t offset = 0;
+    rt_uint8_t  name_len;
+    char        name[256];
+    rt_uint8_t  ret = 0;
+    
+    name_len = (data_len >= 9) ? (rt_uint8_t)payload[8] : 0;
+    
+    if(data_len >= 9 + name_len)
+    {
+        rt_memcpy(&size, payload, sizeof(size));
+        rt_memcpy(&offset, payload + 4, sizeof(offset));
+        size   = ntohl(size);
+        offset = ntohl(offset);
+        rt_memcpy(name, payload + 9, name_len);
+        name[name_len] = '\0';
+        
+        ret = download_open(name, size, &offset);
+    }
+    
+    *payload = ret;
+    offset   = htonl(offset);
+    rt_memcpy(payload + 1, &offset, 4);
+    
+    v2_send(conn->fd, conn->buf, TCP_V2_WRITE_OPEN, 0, req_id, 5);
+}
+
+/**
+ * @brief  save a chunk of download opened by TCP_V2_WRITE_OPEN
+ * @param  conn: pointer to connection
+ * @param  req_id: request id, network order
+ * @param  payload: offset(4), data
+ * @param  data_len: payload length
+ *
+ * @NOTE   reply is result(1) as download_file(), offset(4) of next data.
+ *         host may send chunks without waiting replies, data after a
+ *         DOWNLOAD_ERR reply is sent again from offset of the reply.
+ */
+static void v2_write_data(struct tcp_conn *conn, rt_uint16_t req_id,
+                          char *payload, rt_uint16_t data_len)
+{
+    rt_uint32_t offset = 0xffffffff;    /* only get offset needed when bad chunk */
+    rt_uint8_t  ret;
+    
+    if(data_len >= 4)
+    {
+        rt_memcpy(&offset, payload, sizeof(offset));
+        offset   = ntohl(offset);
+        data_len = data_len - 4;
+    }
+    else
+    {
+        data_len = 0;
+    }
+    
+    ret = download_write(&offset, payload + 4, data_len);
+    
+    *payload = ret;
+    offset   = htonl(offset);
+    rt_memcpy(payload + 1, &offset, 4);
+    
+    v2_send(conn->fd, conn->buf, TCP_V2_WRITE_DATA, 0, req_id, 5);
+}
+
+/**
+ * @brief  analyze a completed v2 frame in connection buffer
+ * @param  conn: pointer to connection
+ */
+static void analyze_v2_frame(struct tcp_conn *conn)
+{
+    tcp_v2_header_t header;
+    char            *payload;
+    rt_uint16_t     data_len;
+    rt_uint32_t     crc;
+    
+    header   = (tcp_v2_header_t)conn->buf;
+    payload  = conn->buf + sizeof(struct tcp_v2_header);
+    data_len = ntohs(header->data_len);
+    
+    crc = crc32_verify(0, conn->buf, sizeof(struct tcp_v2_header) - sizeof(header->crc));
+    crc = crc32_verify(crc, payload, data_len);
+    if(crc != ntohl(header->crc))
+    {
+        if(header->cmd == TCP_V2_WRITE_DATA)
+        {
+            /* host sends again from offset in reply */
+            v2_write_data(conn, header->req_id, payload, 0);
+            return;
+        }
+        
+        *payload = TCP_V2_ERR_CRC;
+        v2_send(conn->fd, conn->buf, header->cmd, TCP_V2_FLAG_ERR, header->req_id, 1);
+        return;
+    }
+    
+    switch(header->cmd)
+    {
+    case TCP_V2_TUNNEL:
+    {
+        tcp_pack_header_t v1_header = (tcp_pack_header_t)payload;
+        
+        if((data_len < sizeof(struct tcp_pack_header) + 1) ||
+           (data_len != sizeof(struct tcp_pack_header) + ntohs(v1_header->data_len) + 1))
+        {
+            goto v2_bad_cmd;
+        }
+        
+        tunnel_active = 1;
+        tunnel_req_id = header->req_id;
+        analyze_command(conn, payload, data_len);
+        tunnel_active = 0;
+        break;
+    }
+    case TCP_V2_CANCEL:
+    {
+        if(conn->read.active && (conn->read.req_id == header->req_id))
+        {
+            stream_stop(conn);
+            *payload = 1;
+        }
+        else
+        {
+            *payload = 0;
+        }
+        v2_send(conn->fd, conn->buf, TCP_V2_CANCEL, 0, header->req_id, 1);
+        break;
+    }
+    case TCP_V2_READ_OPEN:
+    {
+        v2_read_open(conn, header->req_id, payload, data_len);
+        break;
+    }
+    case TCP_V2_READ_ACK:
+    {
+        rt_uint32_t acked;
+        
+        /* no reply, window of stream moves on */
+        if(conn->read.active && (conn->read.req_id == header->req_id) && (data_len >= 4))
+        {
+            rt_memcpy(&acked, payload, sizeof(acked));
+            acked = ntohl(acked);
+            if((acked > conn->read.acked) && (acked <= conn->read.offset))
+            {
+                conn->read.acked = acked;
+            }
+        }
+        break;
+    }
+    case TCP_V2_WRITE_OPEN:
+    {
+        v2_write_open(conn, header->req_id, payload, data_len);
+        break;
+    }
+    case TCP_V2_WRITE_DATA:
+    {
+        v2_write_data(conn, header->req_id, payload, data_len);
+        break;
+    }
+    default:
+v2_bad_cmd:
+    {
+        *payload = TCP_V2_ERR_CMD;
+        v2_send(conn->fd, conn->buf, header->cmd, TCP_V2_FLAG_ERR, header->req_id, 1);
+        break;
+    }
+    }
+}
+
+/**
+ * @brief  check if read stream of a connection could send a chunk
+ * @param  conn: pointer to connection
+ * @retval 1 for window not full, 0 for no stream or waiting acks
+ */
+static rt_uint8_t stream_can_send(struct tcp_conn *conn)
+{
+    return (conn->read.active &&
+            ((conn->read.offset - conn->read.acked) < conn->read.window));
+}
+
+/**
+ * @brief  send chunks of read stream until window full, at most
+ *         TCP_V2_PUMP_CHUNKS once
+ * @param  conn: pointer to connection
+ */
+static void stream_pump(struct tcp_conn *conn)
+{
+    struct tcp_read_stream  *stream = &conn->read;
+    char                    *payload;
+    rt_uint32_t             size;
+    rt_uint32_t             offset;
+    rt_uint8_t              flags;
+    int                     i;
+    
+    payload = stream_buf + sizeof(struct tcp_v2_header);
+    
+    for(i = 0; (i < TCP_V2_PUMP_CHUNKS) && stream_can_send(conn); i++)
+    {
+        size = min(TCP_V2_CHUNK_SIZE, stream->file.file_size - stream->offset);
+        size = file_stream_read(&stream->file, payload + 4, size);
+        
+        offset = htonl(stream->offset);
+        rt_memcpy(payload, &offset, 4);
+        stream->offset += size;
+        
+        flags = 0;
+        if((stream->offset >= stream->file.file_size) || (size == 0))
+        {
+            /* end of file, or log shorter than it was, host may read again from offset */
+            flags = TCP_V2_FLAG_FIN;
+            stream_stop(conn);
+        }
+        
+        v2_send(conn->fd, stream_buf, TCP_V2_READ_DATA, flags, stream->req_id, size + 4);
+    }
+}
+
+/**
+ * @brief  stop read stream of a connection, a log it reads is free for others
+ * @param  conn: pointer to connection with an active stream
+ */
+static void stream_stop(struct tcp_conn *conn)
+{
+    file_stream_close(&conn->read.file);
+    conn->read.active = 0;
+}
+
+/**
+ * @brief  check header collected in buf of a connection, and get length of
+ *         the packet or frame it starts
+ * @param  conn: pointer to connection with TCP_HEADER_LEN bytes in buf
+ * @retval 1: a v1 packet or v2 frame starts, 0: not a header
+ */
+static rt_uint8_t check_pack_header(struct tcp_conn *conn)
+{
+    tcp_pack_header_t   header    = (tcp_pack_header_t)conn->buf;
+    tcp_v2_header_t     v2_header = (tcp_v2_header_t)conn->buf;
+    
+    if(conn->v2 && ((rt_uint8_t)conn->buf[0] == TCP_V2_MAGIC))
+    {
+        if((v2_header->version != TCP_V2_VERSION) ||
+           (ntohs(v2_header->data_len) > TCP_V2_MAX_PAYLOAD))
+        {
+            return 0;
+        }
+        
+        conn->v2_frame = 1;
+        conn->pack_len = sizeof(struct tcp_v2_header) + ntohs(v2_header->data_len);
+    }
+    else if(!rt_strncmp(header->device_type, DEVICE_TYPE, rt_strlen(DEVICE_TYPE)) &&
+            (sizeof(struct tcp_pack_header) + ntohs(header->data_len) + 1 <= sizeof(conn->buf)))
+    {
+        conn->v2_frame = 0;
+        conn->pack_len = sizeof(struct tcp_pack_header) + ntohs(header->data_len) + 1;
+    }
+    else
+    {
+        return 0;
+    }
+    
+    return 1;
+}
+
 /**
  * @brief  a packet use user protocol may be divided by tcp low level,
  *         check if we received a completed packet and combine them together again
- * @brief  fd: socket fd
+ * @param  conn: pointer to connection receiving data
  * @param  data: pointer to recv data buf.
  * @param  len: data length
+ * @NOTE   a header is checked when all its bytes are received. bytes of a
+ *         rejected header are searched again from its second byte, a packet
+ *         may start inside it.
  */
-static void handle_recv_pack(int fd, char *data, size_t len)
+static void handle_recv_pack(struct tcp_conn *conn, char *data, size_t len)
 {
     size_t              copy_len;               /* data length for once copy */
-    static size_t       pack_len;               /* completed packet length */
-    
-    tcp_pack_header_t   header;
-    static rt_uint8_t   new_pack = 1;
     
     while(len > 0)
     {
         /* new packet need calculate packet length again */
-        if(new_pack)
+        if(conn->new_pack)
         {
-            header = (tcp_pack_header_t)data;
-            if(!rt_strncmp(header->device_type, DEVICE_TYPE, rt_strlen(DEVICE_TYPE)))
+            copy_len = min((TCP_HEADER_LEN - conn->buf_len), len);
+            rt_memcpy(&conn->buf[conn->buf_len], data, copy_len);
+            conn->buf_len += copy_len;
+            data          += copy_len;
+            len           -= copy_len;
+            
+            if(conn->buf_len < TCP_HEADER_LEN)
             {
-                new_pack = 0;            
-                pack_len = sizeof(struct tcp_pack_header) + ntohs(header->data_len) + 1;
-                
-                /* reset command buffer */
-                cmd_buf_len = 0;
-                rt_memset(cmd_buf, 0, sizeof(cmd_buf));
+                /* wait for rest of header */
+                continue;
             }
-            else
+            
+            if(!check_pack_header(conn))
             {
-                data++;
-                len--;
+                /* not a header, drop its first byte only */
+                conn->buf_len--;
+                rt_memmove(conn->buf, &conn->buf[1], conn->buf_len);
                 continue;
             }
+            
+            /* reset command buffer after header */
+            conn->new_pack = 0;
+            rt_memset(&conn->buf[TCP_HEADER_LEN], 0, sizeof(conn->buf) - TCP_HEADER_LEN);
         }
 
-        copy_len = min((MAX_TCP_DATA_LENGTH - cmd_buf_len), len);
-        copy_len = min(copy_len, (pack_len - cmd_buf_len));
+        copy_len = min(len, (conn->pack_len - conn->buf_len));
         
         /* copy data to command buffer */
-        rt_memcpy(&cmd_buf[cmd_buf_len], data, copy_len);
-        cmd_buf_len += copy_len;
-        data        += copy_len;
-        len         -= copy_len;
+        rt_memcpy(&conn->buf[conn->buf_len], data, copy_len);
+        conn->buf_len += copy_len;
+        data          += copy_len;
+        len           -= copy_len;
         
-        if(cmd_buf_len == pack_len)
+        if(conn->buf_len == conn->pack_len)
         {
             /* get a completed command */
-            analyze_command(fd, cmd_buf, pack_len);       
+            if(conn->v2_frame)
+            {
+                analyze_v2_frame(conn);
+            }
+            else
+            {
+                analyze_command(conn, conn->buf, conn->pack_len);
+            }
 
             /* followed data should be new packet */
-            new_pack = 1;
+            conn->new_pack = 1;
+            conn->buf_len  = 0;
         }
     }
 }
@@ -1080,6 +2124,34 @@ char xor_verify(const char *data, int len)
 	return result;
 }
 
+/**
+ * @brief  calculate crc32 (same as zlib), 4 bits once to keep table small
+ * @param  crc: crc of data before, 0 for the first
+ * @param  data: pointer to data buffer
+ * @param  len:  data length
+ * @retval crc32 result
+ */
+rt_uint32_t crc32_verify(rt_uint32_t crc, const char *data, int len)
+{
+    static const rt_uint32_t crc_table[16] =
+    {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    
+    crc = ~crc;
+    while(len-- > 0)
+    {
+        crc ^= (rt_uint8_t)*data++;
+        crc  = (crc >> 4) ^ crc_table[crc & 0x0f];
+        crc  = (crc >> 4) ^ crc_table[crc & 0x0f];
+    }
+    
+    return ~crc;
+}
+
 /**
  * @brief  read datetime to data
  * @param  data: pointer to buffer
@@ -1088,7 +2160,7 @@ void get_datetime(char *data)
 {
 	RTC_T datetime;
 
-	if(pcf8563_get_datetime(&datetime) != RT_EOK)
+	if(wall_clock_get(&datetime) != RT_EOK)
     {
         return;
     }
@@ -1108,12 +2180,14 @@ void get_datetime(char *data)
  */
 void thread_tcp_server(void* parameter)
 {
-    int server_fd, client_fd[MAX_TCP_CONNECT], max_fd, new_fd;
+    int server_fd, max_fd, new_fd;
     int connect_num;
     struct sockaddr_in server_addr;
-    fd_set rdst;
+    fd_set rdst, wrst;
+    struct tcp_conn *conn;
     int i, j;
     int ret;
+    int wait_write;
     
     int32_t recv_len;
     
@@ -1143,24 +2217,34 @@ void thread_tcp_server(void* parameter)
         // need send to sysctrl
     }
     
-    rt_memset(client_fd, 0, sizeof(client_fd));
+    rt_memset(tcp_conns, 0, sizeof(tcp_conns));
     connect_num = 0;
 
     while(1)
     {
         FD_ZERO(&rdst);
+        FD_ZERO(&wrst);
         FD_SET(server_fd, &rdst);
         
         /* find maximum fd */
         max_fd = server_fd;        
+        wait_write = 0;
         for(i = 0; i < connect_num; i++)
         {
-            FD_SET(client_fd[i], &rdst);
-            max_fd = (client_fd[i] > max_fd) ? client_fd[i] : max_fd;
+            conn = &tcp_conns[i];
+            FD_SET(conn->fd, &rdst);
+            max_fd = (conn->fd > max_fd) ? conn->fd : max_fd;
+            
+            /* read stream has chunks to send */
+            if(stream_can_send(conn))
+            {
+                FD_SET(conn->fd, &wrst);
+                wait_write = 1;
+            }
         }
 
-        /* wait forever until have data or accept */
-        ret = select(max_fd + 1, &rdst, RT_NULL, RT_NULL, RT_NULL);
+        /* wait forever until have data, accept or stream could send */
+        ret = select(max_fd + 1, &rdst, wait_write ? &wrst : RT_NULL, RT_NULL, RT_NULL);
         
         /* select error */
         if(ret < 0) continue;
@@ -1168,31 +2252,46 @@ void thread_tcp_server(void* parameter)
         /* check connects */
         for(i = 0; i < connect_num; i++)
         {
-            if(FD_ISSET(client_fd[i], &rdst))
+            conn = &tcp_conns[i];
+            if(FD_ISSET(conn->fd, &rdst))
             {
                 rt_memset(tcp_buf, 0, sizeof(tcp_buf));
-                recv_len = recv(client_fd[i], tcp_buf, MAX_TCP_DATA_LENGTH, 0);
+                recv_len = recv(conn->fd, tcp_buf, MAX_TCP_DATA_LENGTH, 0);
                 if(recv_len <= 0)
                 {
-                    DEBUG_PRINTF("client %d disconnect\r\n", client_fd[i]);
+                    DEBUG_PRINTF("client %d disconnect\r\n", conn->fd);
+                    if(conn->read.active)
+                    {
+                        stream_stop(conn);
+                    }
                     /* disconnect */
-                    close(client_fd[i]);
-                    FD_CLR(client_fd[i], &rdst);
-                    client_fd[i] = 0;
+                    close(conn->fd);
+                    FD_CLR(conn->fd, &rdst);
+                    FD_CLR(conn->fd, &wrst);
+                    conn->fd = 0;
                 }
                 else
                 {
-                    handle_recv_pack(client_fd[i], tcp_buf, (size_t)recv_len);
+                    handle_recv_pack(conn, tcp_buf, (size_t)recv_len);
                 }
             }
+            
+            if((conn->fd != 0) && FD_ISSET(conn->fd, &wrst))
+            {
+                stream_pump(conn);
+            }
         }
         
         /* refresh connect list */
         for(i = 0, j = 0; i < connect_num; i++)
         {
-            if(client_fd[i] != 0)
+            if(tcp_conns[i].fd != 0)
             {
-                client_fd[j++] = client_fd[i];
+                if(i != j)
+                {
+                    tcp_conns[j] = tcp_conns[i];
+                }
+                j++;
             }            
         }
         connect_num = j;
@@ -1217,8 +2316,11 @@ void thread_tcp_server(void* parameter)
             if(connect_num < MAX_TCP_CONNECT)
             {
                 DEBUG_PRINTF("new clinet connect %d\r\n", new_fd);
-                client_fd[connect_num] = new_fd;
-                FD_SET(client_fd[connect_num], &rdst);
+                conn = &tcp_conns[connect_num];
+                rt_memset(conn, 0, sizeof(*conn));
+                conn->fd       = new_fd;
+                conn->new_pack = 1;
+                FD_SET(conn->fd, &rdst);
                 connect_num++;
             }
             else
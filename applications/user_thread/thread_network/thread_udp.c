@@ -14,6 +14,8 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-05-04      Test          First version.
+ * 2017-06-29      Test          Report to multicast group, new node reported
+ *                               only by the gateway hearing it best.
  ******************************************************************************
  */
  
@@ -33,6 +35,10 @@
 #include "external_flash.h"
 #include "wnc_data_base.h"
 
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif /* RT_USING_FINSH */
+
 /**
  ******************************************************************************
  *                                   MACROS
@@ -47,6 +53,24 @@
 
 #define PC_RESP_STRING                  "PCNC"
 
+#define UDP_RECV_BUF_LEN                (256)
+
+/* report to a multicast group of gateways and pc instead of broadcast, 
+   gateways share new node sightings by the group and only the one with best
+   rssi reports a new node. broadcast is used until group joined */
+#define UDP_MULTICAST_ENABLE            LWIP_IGMP
+#define UDP_MULTICAST_GROUP             "239.255.82.10"
+#define UDP_MULTICAST_TTL               (1)                             /* not routed */
+
+/* new node sightings: id(4), type string(4), seq(2), num(1), nodes, xor(1) */
+#define SIGHT_TYPE_STRING               "LNNS"
+#define SIGHT_HEAD_LEN                  (11)
+#define SIGHT_NODE_LEN                  (8)                             /* id(4), type(1), rssi(2), snr(1) */
+#define MAX_NODE_NUM_IN_SIGHT           ((UDP_RECV_BUF_LEN - SIGHT_HEAD_LEN - 1) / SIGHT_NODE_LEN)
+
+#define MAX_UDP_PEER_NUM                (16)
+#define UDP_PEER_DUP_TIME               (UDP_SEND_PERIOD / 2)           /* older seq after it: restarted */
+
 /* timers */
 #define RT_TIMER_NAME_UDP_ALL           "udp_send_all"
 #define RT_TIMER_TIMEOUT_UDP_ALL        (15 * 60 * RT_TICK_PER_SECOND)  /* 15min */
@@ -66,6 +90,16 @@
  ******************************************************************************
  */
  
+/**
+ * @brief  gateway in multicast group, known by its sightings
+ */
+struct udp_peer
+{
+    rt_uint32_t id;                     /* gateway id, 0 for free */
+    rt_uint16_t seq;                    /* last sequence number received */
+    rt_uint16_t lost;                   /* sightings lost by sequence gaps */
+    rt_tick_t   tick;                   /* tick of last sighting */
+};
 
 /**
  ******************************************************************************
@@ -75,6 +109,8 @@
 
 rt_thread_t tid_udp_client = RT_NULL;
 rt_thread_t tid_udp_server = RT_NULL;
+
+extern struct rt_mutex   mutex_new_node_list;
  
  /**
  ******************************************************************************
@@ -86,6 +122,17 @@ static int  send_all  = 0;
 static int  socket_fd = -1;         /* udp socket handler */
 
 static char send_buf[1024];         /* udp send buffer */
+
+static rt_uint8_t   report_seq;     /* sequence number of reports */
+
+#if UDP_MULTICAST_ENABLE
+static int          multicast_joined = 0;
+
+static char         sight_buf[UDP_RECV_BUF_LEN];
+static rt_uint16_t  sight_seq;      /* sequence number of sightings */
+
+static struct udp_peer udp_peers[MAX_UDP_PEER_NUM];
+#endif /* UDP_MULTICAST_ENABLE */
  
 /**
  ******************************************************************************
@@ -94,6 +141,12 @@ static char send_buf[1024];         /* udp send buffer */
  */
 
 static size_t fill_udp_buffer(char *data_buf);
+#if UDP_MULTICAST_ENABLE
+static int  join_udp_multicast  (void);
+static void send_sightings      (struct sockaddr_in *group_addr);
+static int  accept_udp_peer     (rt_uint32_t id, rt_uint16_t seq);
+static void analyze_sightings   (const char *data, int len);
+#endif /* UDP_MULTICAST_ENABLE */
 
 /**
  ******************************************************************************
@@ -178,8 +231,8 @@ static size_t fill_udp_buffer(char *data_buf)
     rt_memcpy(buf, &tmp32, 4);
     buf += 4;
     
-    /* reserved */
-    *buf++ = 0;
+    /* report sequence number, reserved before */
+    *buf++ = report_seq++;
     
     /* lora node device number */
     lora_node_num = buf++;
@@ -233,6 +286,7 @@ static size_t fill_udp_buffer(char *data_buf)
 		buf    += 3;		
 	}
 
+    rt_mutex_take(&mutex_new_node_list, RT_WAITING_FOREVER);
 	for(i = 0; i < g_new_node_list.num; i++)
 	{
 		if((*lora_node_num) >= MAX_NODE_NUM_IN_UDP)
@@ -242,6 +296,23 @@ static size_t fill_udp_buffer(char *data_buf)
 
 		if(g_new_node_list.node[i].time_left)
 		{
+#if UDP_MULTICAST_ENABLE
+            if(multicast_joined)
+            {
+                /* not compared with other gateways yet */
+                if(!(g_new_node_list.node[i].sync & NEW_NODE_SYNC_SENT))
+                {
+                    continue;
+                }
+
+                /* reported by the gateway hearing it better */
+                if(g_new_node_list.node[i].sync & NEW_NODE_SYNC_BEATEN)
+                {
+                    g_new_node_list.node[i].time_left--;
+                    continue;
+                }
+            }
+#endif /* UDP_MULTICAST_ENABLE */
 			(*lora_node_num)++;
 			g_new_node_list.node[i].time_left--;
 			*buf++  = g_new_node_list.node[i].device_type;
@@ -254,6 +325,7 @@ static size_t fill_udp_buffer(char *data_buf)
 			buf    += 3;
 		}
 	}    
+    rt_mutex_release(&mutex_new_node_list);
     
     send_all = 0;
     
@@ -288,10 +360,233 @@ int init_udp_socket_handler(void)
     {
         return -1;
     }
+
+#if UDP_MULTICAST_ENABLE
+    /* netif may be not ready, joined again by client thread */
+    join_udp_multicast();
+#endif /* UDP_MULTICAST_ENABLE */
     
     return 0;
 }
 
+#if UDP_MULTICAST_ENABLE
+/**
+ * @brief  join multicast group of gateways on all interfaces
+ * @retval 0 for success, -1 for failure
+ */
+static int join_udp_multicast(void)
+{
+    struct ip_mreq  mreq;
+    u8_t            ttl = UDP_MULTICAST_TTL;
+
+    mreq.imr_multiaddr.s_addr = inet_addr(UDP_MULTICAST_GROUP);
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    if(setsockopt(socket_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0)
+    {
+        return -1;
+    }
+    setsockopt(socket_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    multicast_joined = 1;
+
+    return 0;
+}
+
+/**
+ * @brief  send new nodes still to report and their rssi to gateways in group,
+ *         gateways hearing them worse will not report them. rssi sent first
+ *         is kept till reported, so all gateways compare same values.
+ * @param  group_addr: multicast group address and port
+ */
+static void send_sightings(struct sockaddr_in *group_addr)
+{
+    int         i = 0;
+    int         num;
+    size_t      len;
+    rt_uint32_t tmp32;
+    rt_uint16_t tmp16;
+    char        *buf;
+
+    rt_mutex_take(&mutex_new_node_list, RT_WAITING_FOREVER);
+    do
+    {
+        buf = sight_buf;
+
+        /* device id */
+        tmp32 = htonl(wnc_device.id);
+        rt_memcpy(buf, &tmp32, 4);
+        buf += 4;
+
+        rt_memcpy(buf, SIGHT_TYPE_STRING, 4);
+        buf += 4;
+
+        tmp16 = htons(sight_seq);
+        rt_memcpy(buf, &tmp16, 2);
+        buf += 3;
+        sight_seq++;
+
+        /* sent even without nodes, as heartbeat of this gateway */
+        for(num = 0; (i < g_new_node_list.num) && (num < MAX_NODE_NUM_IN_SIGHT); i++)
+        {
+            single_new_node_t *node = &g_new_node_list.node[i];
+
+            if(node->time_left == 0)
+            {
+                continue;
+            }
+
+            if(!(node->sync & NEW_NODE_SYNC_SENT))
+            {
+                node->sync     |= NEW_NODE_SYNC_SENT;
+                node->sync_rssi = node->rssi;
+            }
+
+            tmp32 = htonl(node->id);
+            rt_memcpy(buf, &tmp32, 4);
+            buf    += 4;
+            *buf++  = node->device_type;
+            tmp16 = htons((rt_uint16_t)node->sync_rssi);
+            rt_memcpy(buf, &tmp16, 2);
+            buf    += 2;
+            *buf++  = node->snr;
+            num++;
+        }
+        sight_buf[SIGHT_HEAD_LEN - 1] = num;
+
+        len = buf - sight_buf;
+        *buf = xor_verify(sight_buf, len);
+
+        sendto(socket_fd, sight_buf, len + 1, 0,
+            (struct sockaddr *)group_addr, sizeof(struct sockaddr));
+    } while(i < g_new_node_list.num);
+    rt_mutex_release(&mutex_new_node_list);
+}
+
+/**
+ * @brief  check sequence number of a gateway, remember the gateway if new
+ * @param  id: gateway id
+ * @param  seq: sequence number of sightings
+ * @retval 1 for new sightings, 0 for duplicated or late
+ */
+static int accept_udp_peer(rt_uint32_t id, rt_uint16_t seq)
+{
+    int         i;
+    int         oldest = 0;
+    rt_int16_t  diff;
+    rt_tick_t   now = rt_tick_get();
+
+    for(i = 0; i < MAX_UDP_PEER_NUM; i++)
+    {
+        if(udp_peers[i].id == id)
+        {
+            break;
+        }
+        if((now - udp_peers[i].tick) > (now - udp_peers[oldest].tick))
+        {
+            oldest = i;
+        }
+    }
+
+    if(i >= MAX_UDP_PEER_NUM)
+    {
+        /* free one or the gateway silent longest */
+        i = oldest;
+        udp_peers[i].id   = id;
+        udp_peers[i].lost = 0;
+    }
+    else
+    {
+        diff = (rt_int16_t)(seq - udp_peers[i].seq);
+        if(diff > 0)
+        {
+            udp_peers[i].lost += diff - 1;
+        }
+        else if((now - udp_peers[i].tick) < UDP_PEER_DUP_TIME)
+        {
+            return 0;
+        }
+        /* else gateway restarted, counted from seq */
+    }
+
+    udp_peers[i].seq  = seq;
+    udp_peers[i].tick = now;
+
+    return 1;
+}
+
+/**
+ * @brief  compare new nodes of sightings from another gateway with ours,
+ *         the one with higher rssi, or lower id if equal, reports a node.
+ * @param  data: sightings received
+ * @param  len: length of data
+ */
+static void analyze_sightings(const char *data, int len)
+{
+    int         i, j;
+    int         num;
+    rt_uint32_t tmp32;
+    rt_uint16_t tmp16;
+    rt_uint32_t gateway_id;
+    rt_uint32_t node_id;
+    rt_int16_t  rssi;
+    rt_int16_t  own_rssi;
+
+    if((len < SIGHT_HEAD_LEN + 1) || (xor_verify(data, len - 1) != data[len - 1]))
+    {
+        return;
+    }
+
+    num = (rt_uint8_t)data[SIGHT_HEAD_LEN - 1];
+    if(len != SIGHT_HEAD_LEN + num * SIGHT_NODE_LEN + 1)
+    {
+        return;
+    }
+
+    rt_memcpy(&tmp32, data, 4);
+    gateway_id = ntohl(tmp32);
+    rt_memcpy(&tmp16, &data[8], 2);
+
+    /* our own sightings looped back */
+    if((gateway_id == wnc_device.id) || !accept_udp_peer(gateway_id, ntohs(tmp16)))
+    {
+        return;
+    }
+
+    data += SIGHT_HEAD_LEN;
+    rt_mutex_take(&mutex_new_node_list, RT_WAITING_FOREVER);
+    for(i = 0; i < num; i++, data += SIGHT_NODE_LEN)
+    {
+        rt_memcpy(&tmp32, data, 4);
+        node_id = ntohl(tmp32);
+        rt_memcpy(&tmp16, &data[5], 2);
+        rssi = (rt_int16_t)ntohs(tmp16);
+
+        for(j = 0; j < g_new_node_list.num; j++)
+        {
+            if(g_new_node_list.node[j].id == node_id)
+            {
+                break;
+            }
+        }
+
+        /* not heard by us or reported already */
+        if((j >= g_new_node_list.num) || (g_new_node_list.node[j].time_left == 0))
+        {
+            continue;
+        }
+
+        /* compare with what gateways have got from us, beaten till reported */
+        own_rssi = (g_new_node_list.node[j].sync & NEW_NODE_SYNC_SENT) ?
+                    g_new_node_list.node[j].sync_rssi : g_new_node_list.node[j].rssi;
+        if((rssi > own_rssi) || ((rssi == own_rssi) && (gateway_id < wnc_device.id)))
+        {
+            g_new_node_list.node[j].sync |= NEW_NODE_SYNC_BEATEN;
+        }
+    }
+    rt_mutex_release(&mutex_new_node_list);
+}
+#endif /* UDP_MULTICAST_ENABLE */
+
 /**
  * @brief  udp client thread entry.
  * @param  parameter: rt-thread param.
@@ -300,6 +595,9 @@ void thread_udp_client(void* parameter)
 {
     struct sockaddr_in  remote_addr;
     size_t              data_len;
+#if UDP_MULTICAST_ENABLE
+    struct sockaddr_in  group_addr;
+#endif /* UDP_MULTICAST_ENABLE */
     
     rt_timer_t          timer_udp_all;
     
@@ -315,6 +613,14 @@ void thread_udp_client(void* parameter)
     remote_addr.sin_family = AF_INET;
     remote_addr.sin_port   = htons(REMOTE_UDP_SERVER_PORT);    
     rt_memset(&(remote_addr.sin_zero), 0, sizeof(remote_addr.sin_zero));
+
+#if UDP_MULTICAST_ENABLE
+    /* sightings to udp server of gateways */
+    group_addr.sin_family      = AF_INET;
+    group_addr.sin_port        = htons(LOCAL_UDP_SERVER_PORT);
+    group_addr.sin_addr.s_addr = inet_addr(UDP_MULTICAST_GROUP);
+    rt_memset(&(group_addr.sin_zero), 0, sizeof(group_addr.sin_zero));
+#endif /* UDP_MULTICAST_ENABLE */
     
     while(1)
     {
@@ -322,6 +628,12 @@ void thread_udp_client(void* parameter)
         data_len = fill_udp_buffer(send_buf);
         
         remote_addr.sin_addr.s_addr = REMOTE_UDP_BROADCAST_ADDR;
+#if UDP_MULTICAST_ENABLE
+        if(multicast_joined || (join_udp_multicast() == 0))
+        {
+            remote_addr.sin_addr.s_addr = group_addr.sin_addr.s_addr;
+        }
+#endif /* UDP_MULTICAST_ENABLE */
         sendto(socket_fd, send_buf, data_len, 0, 
             (struct sockaddr *)&remote_addr, sizeof(struct sockaddr));
         
@@ -338,6 +650,14 @@ void thread_udp_client(void* parameter)
             sendto(socket_fd, send_buf, data_len, 0, 
                 (struct sockaddr *)&remote_addr, sizeof(struct sockaddr));            
         }
+
+#if UDP_MULTICAST_ENABLE
+        /* compared before next report */
+        if(multicast_joined)
+        {
+            send_sightings(&group_addr);
+        }
+#endif /* UDP_MULTICAST_ENABLE */
         DEBUG_PRINTF("UDP borad one time\n");
         rt_thread_delay(UDP_SEND_PERIOD);
         udp_clint_feed_dog();
@@ -350,13 +670,19 @@ void thread_udp_client(void* parameter)
  */
 void thread_udp_server(void* parameter)
 {
-    char recv_buf[256];
+    char recv_buf[UDP_RECV_BUF_LEN];
+    int  len;
 
     while(1)
     {
         rt_memset(recv_buf, 0, sizeof(recv_buf));
-        recvfrom(socket_fd, recv_buf, sizeof(recv_buf), 0, RT_NULL, RT_NULL);
+        len = recvfrom(socket_fd, recv_buf, sizeof(recv_buf), 0, RT_NULL, RT_NULL);
         
+        if(len < 8)
+        {
+            continue;
+        }
+
         if(rt_memcmp(&recv_buf[4], PC_RESP_STRING, strlen(PC_RESP_STRING)) == 0)
         {
             stu_sysctrl_msg msg;
@@ -370,8 +696,38 @@ void thread_udp_server(void* parameter)
             //receive pc response
             DEBUG_PRINTF("recv pc resp\r\n");
         }
+#if UDP_MULTICAST_ENABLE
+        else if(rt_memcmp(&recv_buf[4], SIGHT_TYPE_STRING, strlen(SIGHT_TYPE_STRING)) == 0)
+        {
+            analyze_sightings(recv_buf, len);
+        }
+#endif /* UDP_MULTICAST_ENABLE */
+    }
+}
+
+#if defined(RT_USING_FINSH) && UDP_MULTICAST_ENABLE
+/**
+ * @brief  print gateways in multicast group
+ */
+void udp_peers_list(void)
+{
+    int         i;
+    rt_tick_t   now = rt_tick_get();
+
+    rt_kprintf("multicast %s %s, seq %u\n", UDP_MULTICAST_GROUP,
+               multicast_joined ? "joined" : "not joined", sight_seq);
+    rt_kprintf("%-10s %5s %5s %8s\n", "gateway", "seq", "lost", "seconds");
+    for(i = 0; i < MAX_UDP_PEER_NUM; i++)
+    {
+        if(udp_peers[i].id != 0)
+        {
+            rt_kprintf("%-10u %5u %5u %8u\n", udp_peers[i].id, udp_peers[i].seq,
+                       udp_peers[i].lost, (now - udp_peers[i].tick) / RT_TICK_PER_SECOND);
+        }
     }
 }
+FINSH_FUNCTION_EXPORT(udp_peers_list, list gateways in udp multicast group);
+#endif /* RT_USING_FINSH && UDP_MULTICAST_ENABLE */
 
  
 /* ****************************** end of file ****************************** */
@@ -14,6 +14,15 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-25      Test          First version.
+ * 2017-06-26      Test          Check threads by heartbeat timestamps instead
+ *                               of feed dog messages.
+ * 2017-06-29      Test          Check stacks of threads periodically.
+ * 2017-06-29      Test          Advance wall clock and save it to pcf8563.
+ * 2017-06-29      Test          Check sx1301 module, restart and recalibrate
+ *                               it here.
+ * 2017-06-29      Test          lora_recv deadline covers lora restart.
+ * 2017-06-29      Test          Cold restart sx1301 after failed warm restarts,
+ *                               log lora restarts at most every 10 minutes.
  ******************************************************************************
  */
  
@@ -28,6 +37,8 @@
 #include "thread_lora.h"
 #include "thread_led.h"
 #include "log.h"
+#include "stack_monitor.h"
+#include "wall_clock.h"
 
 /**
  ******************************************************************************
@@ -43,6 +54,23 @@
 #define set_net_led_on()            set_led(ON, 7, 6);
 #define set_net_led_off()           set_led(OFF, 7, 6);
 
+/* a thread stalled longer is dead, reboot system */
+#define SOFT_DOG_DEAD_TIME          (60 * 1000)     /* 60s */
+
+#define TICK_TO_MS(t)               ((t) * (1000 / RT_TICK_PER_SECOND))
+
+/* restart sx1301 module after failing health checks for 3s */
+#define LORA_FAULT_MAX              (3)
+
+/* warm restarts in a row without a healthy check before a cold one */
+#define LORA_WARM_MAX               (2)
+
+/* log lora restarts at most once in 10 minutes */
+#define LORA_LOG_PERIOD             (600 * RT_TICK_PER_SECOND)
+
+/* recalibrate sx1301 module only after no packets for 1s */
+#define LORA_RECAL_IDLE             (RT_TICK_PER_SECOND)
+
 /* for debug */
 #define DEBUG_SYS_CTRL   0
 
@@ -72,6 +100,32 @@ const char thread_names[MAX_SOFT_DOG_NUM][16] =
     "udp_serv",
 };
 
+/* default stall deadline of threads in ms */
+const rt_uint32_t soft_dog_deadline[MAX_SOFT_DOG_NUM] =
+{
+    5000,       /* lora_recv: poll packets every 100ms, waits for the ~2.5s
+                   lgw_start of lora restart or recalibration */
+    5000,       /* lora_send: heartbeat every second when idle */
+    5000,       /* data_porc: heartbeat every second when idle */
+    30000,      /* udp_serv:  broadcast every 10s */
+};
+
+/* upper limit of loop interval histogram buckets in ms, last one no limit */
+const rt_uint32_t soft_dog_hist_ms[SOFT_DOG_HIST_NUM - 1] =
+{
+    10, 50, 100, 500, 1000, 2000, 10000,
+};
+
+/**
+ * @brief  heartbeat of a thread, written by the thread only
+ */
+struct soft_dog
+{
+    volatile rt_tick_t      last;               /* tick of last heartbeat */
+    rt_uint8_t              stalled;            /* stall has been counted */
+    struct soft_dog_stat    stat;
+};
+
 /**
  ******************************************************************************
  *                              GLOBAL VARIABLES
@@ -87,7 +141,7 @@ rt_mq_t     mq_sys_ctrl  = RT_NULL;
  ******************************************************************************
  */
 
-volatile static rt_uint8_t   thread_soft_dogs[MAX_SOFT_DOG_NUM];
+static struct soft_dog   thread_soft_dogs[MAX_SOFT_DOG_NUM];
  
 /**
  ******************************************************************************
@@ -96,7 +150,9 @@ volatile static rt_uint8_t   thread_soft_dogs[MAX_SOFT_DOG_NUM];
  */
 
 static void         callback_timer_sysctrl  (void* parameter);
+static void         init_soft_dogs          (void);
 static rt_err_t     check_threads_alive     (void);
+static void         check_lora_health       (void);
  
 /**
  ******************************************************************************
@@ -141,7 +197,22 @@ static void callback_timer_sysctrl(void* parameter)
 }
 
 /**
- * @brief  check if user threads is alived
+ * @brief  initailize soft dogs, threads have a full deadline to beat first
+ */
+static void init_soft_dogs(void)
+{
+    int i;
+
+    rt_memset((void*)thread_soft_dogs, 0, sizeof(thread_soft_dogs));
+    for(i = 0; i < MAX_SOFT_DOG_NUM; i++)
+    {
+        thread_soft_dogs[i].last = rt_tick_get();
+        thread_soft_dogs[i].stat.deadline = soft_dog_deadline[i];
+    }
+}
+
+/**
+ * @brief  check if user threads is alived, log threads stalled over deadline
  * @retval RT_EOK means no error, others means one or more threads is dead
  */
 static rt_err_t check_threads_alive(void)
@@ -151,10 +222,29 @@ static rt_err_t check_threads_alive(void)
     
     for(i = 0; i < MAX_SOFT_DOG_NUM; i++)
     {
-        if(thread_soft_dogs[i] == 0)
+        struct soft_dog *dog = &thread_soft_dogs[i];
+        rt_uint32_t stall = TICK_TO_MS(rt_tick_get() - dog->last);
+        char log_str[64];
+
+        if(stall <= dog->stat.deadline)
+        {
+            dog->stalled = 0;
+            continue;
+        }
+
+        /* count once for a stall */
+        if(!dog->stalled)
+        {
+            dog->stalled = 1;
+            dog->stat.stalls++;
+            rt_snprintf(log_str, sizeof(log_str), 
+                        "thread %s stalled", 
+                        thread_names[i]);
+            add_log(log_str);
+        }
+
+        if(stall > SOFT_DOG_DEAD_TIME)
         {
-            char log_str[256];
-            
             rt_snprintf(log_str, sizeof(log_str), 
                         "thread %s is dead", 
                         thread_names[i]);
@@ -162,40 +252,152 @@ static rt_err_t check_threads_alive(void)
             ret = RT_ERROR;
         }
     }
-    rt_memset((void*)thread_soft_dogs, 0, sizeof(thread_soft_dogs));
 
     return ret;
 }
 
 /**
- * @brief  request some user threads which suspend when wait messages to feed dog
+ * @brief  check sx1301 module every second and restart it after faults,
+ *         or recalibrate it when due and lora is idle. both may run
+ *         lgw_start, which takes about 2.5s and needs more stack than
+ *         lora_recv has.
  */
-static void request_feed_soft_dogs(void)
+static void check_lora_health(void)
 {
-    /* lora send thread */
+    static int          fault_cnt = 0;
+    static int          warm_cnt = 0;
+    static rt_uint32_t  restarts = 0;
+    static rt_uint32_t  failures = 0;
+    static rt_uint8_t   logged = 0;
+    static rt_tick_t    log_tick;
+    char                log_str[64];
+    int                 cold;
+    
+    if(check_lora_module() == 0)
     {
-        stu_lora_msg msg;
-        
-        msg.type = MSG_LORA_SEND_FEED_DOG;
-        rt_mq_send(mq_lora_send, &msg, sizeof(msg));
+        fault_cnt = 0;
+        warm_cnt = 0;
+        if((rt_tick_get() - lora_rx_tick) >= LORA_RECAL_IDLE &&
+           recalibrate_lora_module() != 0)
+        {
+            add_log("recalibrate lora failed");
+        }
+        return;
     }
     
-    /* data process thread */
+    if(++fault_cnt < LORA_FAULT_MAX)
     {
-        stu_lora_msg msg;
-        
-        msg.type = MSG_DATA_PROC_FEED_DOG;
-        rt_mq_send(mq_data_proc, &msg, sizeof(msg));        
+        return;
+    }
+    fault_cnt = 0;
+    
+    /* a warm restart does not touch a stalled concentrator, reset it */
+    cold = (warm_cnt >= LORA_WARM_MAX);
+    warm_cnt = cold ? 0 : (warm_cnt + 1);
+    
+    DEBUG_PRINTF("lora restart, cold %d\r\n", cold);
+    restarts++;
+    if(restart_lora_module(cold) != 0)
+    {
+        failures++;
     }
+    
+    /* a module failing for good must not write flash every few seconds */
+    if(logged && (rt_tick_get() - log_tick) < LORA_LOG_PERIOD)
+    {
+        return;
+    }
+    rt_snprintf(log_str, sizeof(log_str), 
+                "lora restarted %d times, %d failed", 
+                restarts, failures);
+    add_log(log_str);
+    logged = 1;
+    log_tick = rt_tick_get();
+    restarts = 0;
+    failures = 0;
 }
 
 /**
- * @brief  user threads feed soft dog to notic self is alive
+ * @brief  user threads beat in main loop to notic self is alive, the loop
+ *         interval is added to histogram
  * @param  index: threads index in thread_soft_dogs
  */
 void threads_feed_dog(enum threads_soft_dog index)
 {
-    thread_soft_dogs[index]++;
+    struct soft_dog *dog = &thread_soft_dogs[index];
+    rt_tick_t   now = rt_tick_get();
+    rt_uint32_t interval = TICK_TO_MS(now - dog->last);
+    int i;
+
+    for(i = 0; i < SOFT_DOG_HIST_NUM - 1; i++)
+    {
+        if(interval < soft_dog_hist_ms[i])
+        {
+            break;
+        }
+    }
+    dog->stat.hist[i]++;
+    dog->stat.loops++;
+    if(interval > dog->stat.max_interval)
+    {
+        dog->stat.max_interval = interval;
+    }
+
+    dog->last = now;
+}
+
+/**
+ * @brief  get heartbeat statistics of a thread
+ * @param  index: threads index in enum threads_soft_dog
+ * @param  stat: pointer to save statistics
+ * @retval 0 for success, -1 for wrong index
+ */
+int threads_get_dog_stat(int index, struct soft_dog_stat *stat)
+{
+    if(index < 0 || index >= MAX_SOFT_DOG_NUM)
+    {
+        return -1;
+    }
+
+    *stat = thread_soft_dogs[index].stat;
+
+    return 0;
+}
+
+/**
+ * @brief  set stall deadline of a thread
+ * @param  index: threads index in enum threads_soft_dog
+ * @param  deadline: deadline in ms, 0 for default
+ * @retval 0 for success, -1 for wrong parameters
+ */
+int threads_set_dog_deadline(int index, rt_uint32_t deadline)
+{
+    if(index < 0 || index >= MAX_SOFT_DOG_NUM || deadline > SOFT_DOG_DEAD_TIME)
+    {
+        return -1;
+    }
+
+    thread_soft_dogs[index].stat.deadline = deadline ? deadline : soft_dog_deadline[index];
+
+    return 0;
+}
+
+/**
+ * @brief  clear heartbeat statistics of all threads, deadlines are kept
+ */
+void threads_clear_dog_stat(void)
+{
+    int i;
+
+    for(i = 0; i < MAX_SOFT_DOG_NUM; i++)
+    {
+        struct soft_dog_stat *stat = &thread_soft_dogs[i].stat;
+
+        stat->loops = 0;
+        stat->max_interval = 0;
+        stat->stalls = 0;
+        rt_memset(stat->hist, 0, sizeof(stat->hist));
+    }
 }
 
 /**
@@ -219,6 +421,9 @@ void thread_system_control(void* parameter)
                                      RT_TIMER_FLAG_PERIODIC);
     RT_ASSERT(timer_sys_ctrl != RT_NULL);
     rt_timer_start(timer_sys_ctrl);
+
+    init_soft_dogs();
+    stack_monitor_init();
     
     while(1)
     {
@@ -271,18 +476,19 @@ void thread_system_control(void* parameter)
                 }
 #endif /* DEBUG_SYS_CTRL */
 
-                if((timer_cnt % 20) == 0)
+                /* check threads every second */
+                if(check_threads_alive() != RT_EOK)
                 {
-                    request_feed_soft_dogs();
+                    need_reboot |= 1;
                 }
-                
-                /* check threads every minitues */
-                if((timer_cnt % 60) == 0)
+
+                check_lora_health();
+
+                wall_clock_check();
+
+                if((timer_cnt % STACK_MON_PERIOD) == 0)
                 {
-                    if(check_threads_alive() != RT_EOK)
-                    {
-                        need_reboot |= 1;
-                    }
+                    stack_monitor_check();
                 }
 
                 if((timer_cnt % TIME_WRITE_WORK_STATE_LOG) == 0)
@@ -14,6 +14,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-25      Test          First version.
+ * 2017-06-26      Test          Soft dogs use heartbeat timestamps.
  ******************************************************************************
  */
 
@@ -52,6 +53,9 @@ enum threads_soft_dog
     UDP_CLINT_DOG,
     MAX_SOFT_DOG_NUM,
 };
+
+/* number of loop interval histogram buckets */
+#define SOFT_DOG_HIST_NUM               (8)
  
 /**
  ******************************************************************************
@@ -61,6 +65,18 @@ enum threads_soft_dog
 
 typedef struct ipc_base stu_sysctrl_msg;
 
+/**
+ * @brief  heartbeat statistics of a thread
+ */
+struct soft_dog_stat
+{
+    rt_uint32_t deadline;                       /* stall deadline in ms */
+    rt_uint32_t loops;                          /* heartbeats since cleared */
+    rt_uint32_t max_interval;                   /* longest loop interval in ms */
+    rt_uint32_t stalls;                         /* times deadline is missed */
+    rt_uint32_t hist[SOFT_DOG_HIST_NUM];        /* loop intervals, see soft_dog_hist_ms */
+};
+
 /**
  ******************************************************************************
  *                              GLOBAL VARIABLES
@@ -92,6 +108,9 @@ extern rt_mq_t     mq_sys_ctrl;     /* system control thread message queue */
 
 extern void     thread_system_control   (void* parameter); 
 extern void     threads_feed_dog        (enum threads_soft_dog index);
+extern int      threads_get_dog_stat    (int index, struct soft_dog_stat *stat);
+extern int      threads_set_dog_deadline(int index, rt_uint32_t deadline);
+extern void     threads_clear_dog_stat  (void);
 
 #define lora_recv_feed_dog()        threads_feed_dog(LORA_RECV_DOG);
 #define lora_send_feed_dog()        threads_feed_dog(LORA_SEND_DOG);
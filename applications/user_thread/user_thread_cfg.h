@@ -14,6 +14,10 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-07      Test          First version.
+ * 2017-06-23      Test          Add trace thread.
+ * 2017-06-29      Test          Add mqtt state push thread.
+ * 2017-06-29      Test          Larger sys_ctrl stack for lora restart.
+ * 2017-06-29      Test          Larger mqtt push stack for lwip mqtt client.
  ******************************************************************************
  */
 
@@ -40,9 +44,11 @@
 #define RT_THREAD_NAME_LORARECV         "lora_recv"
 #define RT_THREAD_NAME_DATAPROC         "data_proc"
 #define RT_THREAD_NAME_TCP_SERV         "tcp_server"
+#define RT_THREAD_NAME_MQTT_PUSH        "mqtt_push"
 #define RT_THREAD_NAME_UDP_CLI          "udp_client"
 #define RT_THREAD_NAME_UDP_SERV         "udp_server"
 #define RT_THREAD_NAME_SYSCTRL          "sys_ctrl"
+#define RT_THREAD_NAME_TRACE            "trace"
 
 /* thread priority */
 #define RT_THREAD_PRIORITY_INIT         (5)     /* user thread start at 5 */
@@ -51,20 +57,24 @@
 #define RT_THREAD_PRIORITY_LORARECV     (8)
 #define RT_THREAD_PRIORITY_DATAPROC     (9)
 #define RT_THREAD_PRIORITY_TCP_SERV     (10)
+#define RT_THREAD_PRIORITY_MQTT_PUSH    (11)
 #define RT_THREAD_PRIORITY_UDP_CLI      (12)
 #define RT_THREAD_PRIORITY_UDP_SERV     (13)
 #define RT_THREAD_PRIORITY_SYSCTRL      (23)
+#define RT_THREAD_PRIORITY_TRACE        (24)    /* print debug traces when idle */
 
 /* thread stack size */
-#define RT_THREAD_STACK_SIZE_INIT       (10 * 1024)     /* lgw_start need more than 8192 */
+#define RT_THREAD_STACK_SIZE_INIT       (3 * 1024)      /* upgrade_confirm uses 1K buffer */
 #define RT_THREAD_STACK_SIZE_LED        (512)
 #define RT_THREAD_STACK_SIZE_LORASEND   (1536)
 #define RT_THREAD_STACK_SIZE_LORARECV   (1024)
 #define RT_THREAD_STACK_SIZE_DATAPROC   (2560)
 #define RT_THREAD_STACK_SIZE_TCP_SERV   (2048)
+#define RT_THREAD_STACK_SIZE_MQTT_PUSH  (2048)          /* runs lwip mqtt client, tcpip core locked */
 #define RT_THREAD_STACK_SIZE_UDP_CLI    (768)
 #define RT_THREAD_STACK_SIZE_UDP_SERV   (1024)
-#define RT_THREAD_STACK_SIZE_SYSCTRL    (1536)
+#define RT_THREAD_STACK_SIZE_SYSCTRL    (2048)          /* runs lgw_start of lora restart */
+#define RT_THREAD_STACK_SIZE_TRACE      (768)
 
 /* thread time slice */
 #define RT_THREAD_TIME_SLICE_INIT       (20)    /* not very impotant because all */
@@ -74,9 +84,11 @@
 #define RT_THREAD_TIME_SLICE_LORARECV   (50)
 #define RT_THREAD_TIME_SLICE_DATAPROC   (20)
 #define RT_THREAD_TIME_SLICE_TCP_SERV   (20)
+#define RT_THREAD_TIME_SLICE_MQTT_PUSH  (20)
 #define RT_THREAD_TIME_SLICE_UDP_CLI    (20)
 #define RT_THREAD_TIME_SLICE_UDP_SERV   (20)
 #define RT_THREAD_TIME_SLICE_SYSCTRL    (20)
+#define RT_THREAD_TIME_SLICE_TRACE      (20)
  
  /**
  ******************************************************************************
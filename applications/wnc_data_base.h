@@ -14,6 +14,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-24      Test          First version. Copy from "WNC_struct_def.h"
+ * 2017-06-29      Test          Sync state of new node with other gateways.
  ******************************************************************************
  */
 
@@ -48,6 +49,10 @@
 #define NODE_STATE_OFFLINE              (251)
 #define NODE_STATE_NEW_DEVICE           (252)
 
+/* sync flags of new node between gateways */
+#define NEW_NODE_SYNC_SENT              (0x01)  /* sighting sent to gateways */
+#define NEW_NODE_SYNC_BEATEN            (0x02)  /* heard better by another gateway */
+
 /* light color */
 #define LIGHT_COLOR_OFF                 (0)
 #define LIGHT_COLOR_RED                 (1)
@@ -200,9 +205,11 @@ struct single_new_node
 {
 	unsigned int    id;
 	unsigned char   device_type;
-	signed   short  rssi;                   /* rssi on concentrator side */
     signed   char   snr;                    /* snr on concentrator side */
+	signed   short  rssi;                   /* rssi on concentrator side */
 	unsigned char   time_left;              /* udp need report times */
+	unsigned char   sync;                   /* NEW_NODE_SYNC_xxx */
+	signed   short  sync_rssi;              /* rssi sent to gateways till reported */
 };
 typedef struct single_new_node single_new_node_t;
 
@@ -14,6 +14,9 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-05      Test          First version.
+ * 2017-06-21      Test          Add rt_hw_get_temperature.
+ * 2017-06-29      Test          Add tickless idle.
+ * 2017-06-29      Test          Count cycles SysTick stops in tickless idle.
  ******************************************************************************
  */
  
@@ -33,6 +36,10 @@
 
 #include "gd32f20x.h"
 
+#if defined(RT_USING_TICKLESS) && defined(RT_USING_HOOK)
+#include "tickless.h"
+#endif /* RT_USING_TICKLESS && RT_USING_HOOK */
+
 #ifdef RT_USING_LWIP
 #include "gd32f20x_eth.h"
 #endif /* RT_USING_LWIP */
@@ -45,6 +52,14 @@
 
 #define PCF8563_ADDR        (0xa2)
 
+/* internal temperature sensor, typical values of gd32f20x datasheet */
+#define TEMP_V25_MV         (1450)      /* sensor voltage at 25 degrees */
+#define TEMP_SLOPE_UV       (4100)      /* sensor slope per degree */
+#define ADC_VREF_MV         (3300)
+
+/* sleep shorter than this runs SysTick as usual */
+#define TICKLESS_MIN_TICKS  (2)
+
 /**
  ******************************************************************************
  *                              GLOBAL VARIABLES
@@ -58,6 +73,7 @@
  ******************************************************************************
  */
 
+static rt_uint8_t   temp_adc_ready = 0;
  
 /**
  ******************************************************************************
@@ -79,6 +95,10 @@ static void rt_hw_i2c_init      (void);
 
 static void NVIC_Configuration  (void);
 
+#if defined(RT_USING_TICKLESS) && defined(RT_USING_HOOK)
+static void rt_hw_tickless_idle (void);
+#endif /* RT_USING_TICKLESS && RT_USING_HOOK */
+
 /**
  ******************************************************************************
  *                         GLOBAL FUNCTION DECLARATION
@@ -234,6 +254,143 @@ static void NVIC_Configuration(void)
 #endif /* VECT_TABLE_SET */
 }
 
+/**
+ * @brief  read the internal temperature sensor of gd32f207 with adc1,
+ *         the adc is initialized on first call.
+ * @retval chip temperature in degrees, about +/-5 degrees precision
+ */
+rt_int16_t rt_hw_get_temperature(void)
+{
+    rt_int32_t mv;
+    
+    if(temp_adc_ready == 0)
+    {
+        ADC_InitPara ADC_InitStructure;
+        
+        RCC_ADCCLKConfig(RCC_ADCCLK_APB2_DIV12);
+        RCC_APB2PeriphClock_Enable(RCC_APB2PERIPH_ADC1, ENABLE);
+        
+        ADC_InitStructure.ADC_Mode = ADC_MODE_INDEPENDENT;
+        ADC_InitStructure.ADC_Mode_Scan = DISABLE;
+        ADC_InitStructure.ADC_Mode_Continuous = DISABLE;
+        ADC_InitStructure.ADC_Trig_External = ADC_EXTERNAL_TRIGGER_MODE_NONE;
+        ADC_InitStructure.ADC_Data_Align = ADC_DATAALIGN_RIGHT;
+        ADC_InitStructure.ADC_Channel_Number = 1;
+        ADC_Init(ADC1, &ADC_InitStructure);
+        
+        ADC_RegularChannel_Config(ADC1, ADC_CHANNEL_TEMPSENSOR, 1, ADC_SAMPLETIME_239POINT5);
+        ADC_TempSensorVrefint_Enable(ENABLE);
+        ADC_ExternalTrigConv_Enable(ADC1, ENABLE);
+        ADC_Enable(ADC1, ENABLE);
+        ADC_Calibration(ADC1);
+        
+        temp_adc_ready = 1;
+    }
+    
+    ADC_ClearBitState(ADC1, ADC_FLAG_EOC);
+    ADC_SoftwareStartConv_Enable(ADC1, ENABLE);
+    while(ADC_GetBitState(ADC1, ADC_FLAG_EOC) == RESET);
+    
+    mv = (rt_int32_t)ADC_GetConversionValue(ADC1) * ADC_VREF_MV / 4096;
+    
+    return (rt_int16_t)((TEMP_V25_MV - mv) * 1000 / TEMP_SLOPE_UV + 25);
+}
+
+#if defined(RT_USING_TICKLESS) && defined(RT_USING_HOOK)
+/**
+ * @brief  idle hook, stop tick interrupts until the next timer timeout.
+ *         SysTick is loaded with the rest of the sleep, on wake the ticks
+ *         passed are added to system tick and SysTick is restarted at the
+ *         phase of the tick period. cycles SysTick is stopped at entry
+ *         and exit are counted by DWT CYCCNT, see tickless_compensate().
+ * @NOTE   the last tick passed is counted by SysTick_Handler, so timers
+ *         still time out in rt_timer_check() of the tick interrupt.
+ */
+static void rt_hw_tickless_idle(void)
+{
+    struct tickless_sample sample;
+    rt_uint32_t max_ticks, ctrl, passed, remain, start, mark, lag;
+    rt_tick_t   next, ticks;
+    rt_base_t   level;
+
+    sample.tick_cycles = SystemCoreClock / RT_TICK_PER_SECOND;
+    max_ticks = SysTick_LOAD_RELOAD_Msk / sample.tick_cycles;
+
+    level = rt_hw_interrupt_disable();
+
+    next = rt_timer_next_timeout_tick();
+    if(next == RT_TICK_MAX)
+    {
+        ticks = max_ticks;
+    }
+    else
+    {
+        ticks = next - rt_tick_get();
+        if((rt_int32_t)ticks < TICKLESS_MIN_TICKS)
+        {
+            /* timer times out soon, just wait for interrupts */
+            __WFI();
+            rt_hw_interrupt_enable(level);
+            return;
+        }
+        if(ticks > max_ticks)
+        {
+            ticks = max_ticks;
+        }
+    }
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    start = DWT->CYCCNT;
+
+    /* a pending tick is counted with the sleep */
+    sample.phase = tickless_phase(sample.tick_cycles, SysTick->VAL,
+                                  SCB->ICSR & SCB_ICSR_PENDSTSET_Msk);
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+
+    /* wrap at the end of the last tick of sleep */
+    sample.sleep_load = tickless_sleep_cycles(sample.tick_cycles, ticks, sample.phase,
+                                              DWT->CYCCNT - start);
+    SysTick->LOAD = sample.sleep_load - 1;
+    SysTick->VAL  = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    sample.stopped = DWT->CYCCNT - start;
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    /* COUNTFLAG is cleared by reading, read CTRL once */
+    ctrl = SysTick->CTRL;
+    SysTick->CTRL = ctrl & ~SysTick_CTRL_ENABLE_Msk;
+    start = DWT->CYCCNT;
+    sample.sleep_val = SysTick->VAL;
+    sample.wrapped   = (ctrl & SysTick_CTRL_COUNTFLAG_Msk) ? 1 : 0;
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+
+    mark = DWT->CYCCNT;
+    sample.stopped += mark - start;
+    passed = tickless_compensate(&sample, &remain);
+
+    /* take the calculation off the current tick period */
+    lag = DWT->CYCCNT - mark;
+    remain = (remain > lag + 1) ? (remain - lag) : 2;
+
+    /* finish current tick period, then run with one tick period again */
+    SysTick->LOAD = remain - 1;
+    SysTick->VAL  = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = sample.tick_cycles - 1;
+
+    if(passed > 0)
+    {
+        rt_tick_set(rt_tick_get() + passed - 1);
+        SCB->ICSR = SCB_ICSR_PENDSTSET_Msk;
+    }
+
+    rt_hw_interrupt_enable(level);
+}
+#endif /* RT_USING_TICKLESS && RT_USING_HOOK */
+
 /**
  * @brief  This function will initialize bwnc board.
  */
@@ -245,6 +402,13 @@ void rt_hw_board_init(void)
     /* Configure the SysTick */
     SysTick_Config( SystemCoreClock / RT_TICK_PER_SECOND );
 
+#if defined(RT_USING_TICKLESS) && defined(RT_USING_HOOK)
+    /* cycle counter for the cycles SysTick is stopped */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    rt_thread_idle_sethook(rt_hw_tickless_idle);
+#endif /* RT_USING_TICKLESS && RT_USING_HOOK */
+
     /* configure debug print interface */
     rt_hw_usart_init();
     rt_console_set_device(RT_CONSOLE_DEVICE_NAME);
@@ -14,6 +14,9 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-05      Test          First version.
+ * 2017-06-21      Test          Add rt_hw_get_temperature.
+ * 2017-06-29      Test          Add RT_USING_TICKLESS.
+ * 2017-06-29      Test          RT_USING_TICKLESS off by default.
  ******************************************************************************
  */
  
@@ -26,6 +29,7 @@
  ******************************************************************************
  */
 
+#include <rtthread.h>
 
 /**
  ******************************************************************************
@@ -59,6 +63,12 @@ extern int __bss_end;
 /* led module */
 #define RT_USING_LED
 
+/* stop SysTick in idle thread until next timer timeout, need RT_USING_HOOK.
+ * off by default: TIMER2 of thread_led interrupts at 400Hz and wakes the
+ * core every 2.5ms, so the sleeps stay short and save little.
+ */
+/* #define RT_USING_TICKLESS */
+
 /**
  ******************************************************************************
  *                              GLOBAL VARIABLES
@@ -86,7 +96,8 @@ extern int __bss_end;
  ******************************************************************************
  */
 
-extern void rt_hw_board_init(void);
+extern void        rt_hw_board_init        (void);
+extern rt_int16_t  rt_hw_get_temperature   (void);
  
 /**
  ******************************************************************************
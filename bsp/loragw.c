@@ -16,6 +16,7 @@
  ******************************************************************************
  * DATE            BY           DESCRIPTION
  * 2017-04-06      Test          First version.
+ * 2017-06-12      Test          Address and payload in one SPI transaction.
  ******************************************************************************
  */
  
@@ -65,6 +66,14 @@ static struct loragw_device _loragw_dev;
  ******************************************************************************
  */
 
+static rt_size_t loragw_transfer (
+    struct loragw_device * loragw, 
+    rt_uint8_t address, 
+    const void * send_buf, 
+    void * recv_buf, 
+    rt_size_t size
+);
+
 /* RT-Thread Device Driver Interface */
 static rt_err_t  rt_loragw_init  (rt_device_t dev);
 static rt_err_t  rt_loragw_open  (rt_device_t dev, rt_uint16_t oflag);
@@ -96,6 +105,50 @@ static rt_size_t rt_loragw_write (
  ******************************************************************************
  */    
 
+/**
+ * @brief  address phase and payload phase of one sx1301 access, sent as a 
+ *         single chained SPI transaction (one bus lock, one CS window).
+ * @param  loragw: loragw device.
+ * @param  address: sx1301 register address, with read/write access bit.
+ * @param  send_buf: payload to write, RT_NULL for read access.
+ * @param  recv_buf: payload to read, RT_NULL for write access.
+ * @param  size: payload size.
+ * @retval payload size transferred, 0 when got error.
+ */
+static rt_size_t loragw_transfer(
+    struct loragw_device * loragw, 
+    rt_uint8_t address, 
+    const void * send_buf, 
+    void * recv_buf, 
+    rt_size_t size
+)
+{
+    struct rt_spi_message message[2];
+    
+    RT_ASSERT(loragw->spi_device != RT_NULL);
+    RT_ASSERT(loragw->spi_device->bus != RT_NULL);
+    
+    /* address phase */
+    message[0].send_buf = &address;
+    message[0].recv_buf = RT_NULL;
+    message[0].length   = 1;
+    message[0].next     = &message[1];
+    
+    /* payload phase */
+    message[1].send_buf = send_buf;
+    message[1].recv_buf = recv_buf;
+    message[1].length   = size;
+    message[1].next     = RT_NULL;
+    
+    if (rt_spi_transfer_chain(loragw->spi_device, message) != (size + 1))
+    {
+        LORAGW_DEBUG("spi transfer of 0x%02x failed!\r\n", address);
+        return 0;
+    }
+    
+    return size;
+}
+
 /* RT-Thread Device Driver Interface */
 static rt_err_t rt_loragw_init(rt_device_t dev)
 {
@@ -135,62 +188,11 @@ static rt_size_t rt_loragw_read(
     rt_size_t size
 )
 {
-    rt_err_t result;
-    struct loragw_device * loragw;
-    struct rt_spi_message message;
-    
     /* check params */
     RT_ASSERT(dev != RT_NULL);
     if (size == 0) return 0;
-    loragw = (struct loragw_device *)dev;
-    RT_ASSERT(loragw->spi_device != RT_NULL);
-    RT_ASSERT(loragw->spi_device->bus != RT_NULL);
-    
-    result = rt_mutex_take(&(loragw->spi_device->bus->lock), RT_WAITING_FOREVER);
-    if (result == RT_EOK)
-    {
-        if (loragw->spi_device->bus->owner != loragw->spi_device)
-        {
-            /* not the same owner as current, re-configure SPI bus */
-            result = loragw->spi_device->bus->ops->configure(loragw->spi_device, &loragw->spi_device->config);
-            if (result == RT_EOK)
-            {
-                /* set SPI bus owner */
-                loragw->spi_device->bus->owner = loragw->spi_device;
-            }
-            else
-            {
-                /* configure SPI bus failed */
-                rt_mutex_release(&(loragw->spi_device->bus->lock));
-                return 0;
-            }
-        }
-
-        /* send address first */
-        message.send_buf = &pos;
-        message.recv_buf = RT_NULL;
-        message.length = 1;
-        message.cs_take = 1;
-        message.cs_release = 0;
-        loragw->spi_device->bus->ops->xfer(loragw->spi_device, &message);
-        
-        /* initial message */
-        message.send_buf = RT_NULL;
-        message.recv_buf = buffer;
-        message.length = size;
-        message.cs_take = 0;
-        message.cs_release = 1;
-
-        /* transfer message */
-        loragw->spi_device->bus->ops->xfer(loragw->spi_device, &message);
-    }
-    else
-    {
-        return 0;
-    }
     
-    rt_mutex_release(&(loragw->spi_device->bus->lock));
-    return size;
+    return loragw_transfer((struct loragw_device *)dev, (rt_uint8_t)pos, RT_NULL, buffer, size);
 }
 
 static rt_size_t rt_loragw_write (
@@ -200,62 +202,11 @@ static rt_size_t rt_loragw_write (
     rt_size_t size
 )
 {
-    rt_err_t result;
-    struct loragw_device * loragw;
-    struct rt_spi_message message;
-    
     /* check params */
     RT_ASSERT(dev != RT_NULL);
     if (size == 0) return 0;
-    loragw = (struct loragw_device *)dev;
-    RT_ASSERT(loragw->spi_device != RT_NULL);
-    RT_ASSERT(loragw->spi_device->bus != RT_NULL);
-    
-    result = rt_mutex_take(&(loragw->spi_device->bus->lock), RT_WAITING_FOREVER);
-    if (result == RT_EOK)
-    {
-        if (loragw->spi_device->bus->owner != loragw->spi_device)
-        {
-            /* not the same owner as current, re-configure SPI bus */
-            result = loragw->spi_device->bus->ops->configure(loragw->spi_device, &loragw->spi_device->config);
-            if (result == RT_EOK)
-            {
-                /* set SPI bus owner */
-                loragw->spi_device->bus->owner = loragw->spi_device;
-            }
-            else
-            {
-                /* configure SPI bus failed */
-                rt_mutex_release(&(loragw->spi_device->bus->lock));
-                return 0;
-            }
-        }
-
-        /* send address first */
-        message.send_buf = &pos;
-        message.recv_buf = RT_NULL;
-        message.length = 1;
-        message.cs_take = 1;
-        message.cs_release = 0;
-        loragw->spi_device->bus->ops->xfer(loragw->spi_device, &message);
-        
-        /* initial message */
-        message.send_buf = buffer;
-        message.recv_buf = RT_NULL;
-        message.length = size;
-        message.cs_take = 0;
-        message.cs_release = 1;
-
-        /* transfer message */
-        loragw->spi_device->bus->ops->xfer(loragw->spi_device, &message);
-    }
-    else
-    {
-        return 0;
-    }
     
-    rt_mutex_release(&(loragw->spi_device->bus->lock));
-    return size;
+    return loragw_transfer((struct loragw_device *)dev, (rt_uint8_t)pos, buffer, RT_NULL, size);
 }
 
 /* RT-Thread Device Driver Interface End */    
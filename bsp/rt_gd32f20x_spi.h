@@ -10,6 +10,12 @@
 
 //#define SPI_USE_DMA
 
+/* SPI2 Tx DMA is DMA1 channel 5, the only channel of the USART1 Rx request,
+ * which usart.c keeps running in circular mode for the console Rx ring */
+#if defined(SPI_USE_DMA) && defined(RT_USING_UART1)
+#error "SPI_USE_DMA shares DMA1 channel 5 with USART1 Rx DMA of usart.c"
+#endif
+
 struct gd32_spi_bus
 {
     struct rt_spi_bus parent;
@@ -0,0 +1,141 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : tickless.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include "tickless.h"
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+/**
+ * @brief  cycles since the last counted tick, from SysTick stopped in a
+ *         tick period.
+ * @param  tick_cycles: cycles of one tick period.
+ * @param  val: SysTick VAL after it is stopped.
+ * @param  pending: the tick interrupt is pending, its tick is not counted.
+ * @retval cycles since the last counted tick.
+ */
+rt_uint32_t tickless_phase(rt_uint32_t tick_cycles, rt_uint32_t val, rt_uint32_t pending)
+{
+    /* VAL reloads to LOAD one cycle after the tick, 0 at the tick */
+    rt_uint32_t phase = (tick_cycles - val) % tick_cycles;
+
+    if(pending)
+    {
+        phase += tick_cycles;
+    }
+
+    return phase;
+}
+
+/**
+ * @brief  SysTick LOAD + 1 for a sleep to end at a tick boundary.
+ * @param  tick_cycles: cycles of one tick period.
+ * @param  ticks: ticks to sleep, counted from the last counted tick.
+ * @param  phase: cycles since the last counted tick when SysTick stopped.
+ * @param  stopped: cycles SysTick has been stopped so far.
+ * @retval cycles of sleep, at least 2 as SysTick does not count with LOAD 0.
+ */
+rt_uint32_t tickless_sleep_cycles(rt_uint32_t tick_cycles, rt_uint32_t ticks,
+                                  rt_uint32_t phase, rt_uint32_t stopped)
+{
+    rt_uint32_t total = ticks * tick_cycles;
+
+    if(total < phase + stopped + 2)
+    {
+        /* already at the end, wake at once and let compensation count it */
+        return 2;
+    }
+
+    return total - phase - stopped;
+}
+
+/**
+ * @brief  ticks passed over a tickless sleep, and cycles to the next tick.
+ *         all cycles since the last counted tick are summed: the phase of
+ *         the tick period SysTick stopped in, the cycles it was stopped
+ *         and the cycles it counted in sleep, so no cycle is lost however
+ *         long entry and exit take.
+ * @param  sample: readings of the sleep.
+ * @param  remain: returns cycles from now to the next tick, 1..tick_cycles.
+ * @retval ticks passed since the last counted tick.
+ */
+rt_uint32_t tickless_compensate(const struct tickless_sample *sample, rt_uint32_t *remain)
+{
+    rt_uint32_t load = sample->sleep_load;
+    rt_uint32_t slept, total;
+
+    /* SysTick started from VAL 0, loads LOAD on its first cycle */
+    slept = (load - sample->sleep_val) % load;
+    if(sample->wrapped)
+    {
+        slept += load;
+    }
+
+    total   = sample->phase + sample->stopped + slept;
+    *remain = sample->tick_cycles - total % sample->tick_cycles;
+
+    return total / sample->tick_cycles;
+}
+
+/* ****************************** end of file ****************************** */
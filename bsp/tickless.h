@@ -0,0 +1,98 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : tickless.h
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+#ifndef __TICKLESS_H__
+#define __TICKLESS_H__
+
+/**
+ ******************************************************************************
+ *                                  INCLUDES
+ ******************************************************************************
+ */
+
+#include <rtthread.h>
+
+/**
+ ******************************************************************************
+ *                                   MACROS
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                               TYPE DEFINITION
+ ******************************************************************************
+ */
+
+/**
+ * @brief  SysTick and DWT readings of one tickless sleep, all in core cycles
+ */
+struct tickless_sample
+{
+    rt_uint32_t tick_cycles;    /* cycles of one tick period */
+    rt_uint32_t phase;          /* cycles since the last tick when SysTick stopped,
+                                   plus one period if that tick is still pending */
+    rt_uint32_t stopped;        /* cycles SysTick was stopped, counted by DWT */
+    rt_uint32_t sleep_load;     /* SysTick LOAD + 1 of sleep */
+    rt_uint32_t sleep_val;      /* SysTick VAL on wake */
+    rt_uint32_t wrapped;        /* SysTick COUNTFLAG on wake */
+};
+
+/**
+ ******************************************************************************
+ *                              GLOBAL VARIABLES
+ ******************************************************************************
+ */
+
+
+ /**
+ ******************************************************************************
+ *                              PRIVATE VARIABLES
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         PRIVATE FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+
+/**
+ ******************************************************************************
+ *                         GLOBAL FUNCTION DECLARATION
+ ******************************************************************************
+ */
+
+extern rt_uint32_t  tickless_phase          (rt_uint32_t tick_cycles, rt_uint32_t val, rt_uint32_t pending);
+extern rt_uint32_t  tickless_sleep_cycles   (rt_uint32_t tick_cycles, rt_uint32_t ticks,
+                                             rt_uint32_t phase, rt_uint32_t stopped);
+extern rt_uint32_t  tickless_compensate     (const struct tickless_sample *sample, rt_uint32_t *remain);
+
+/**
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+#endif /* __TICKLESS_H__ */
+
+/* ****************************** end of file ****************************** */
@@ -13,6 +13,9 @@
  * 2010-03-29     Bernard      remove interrupt Tx and DMA Rx mode
  * 2013-05-13     aozima       update for kehong-lingtai.
  * 2015-01-31     armink       make sure the serial transmit complete in putc()
+ * 2017-06-24     Test         add Tx ring with TBE interrupt, DMA Rx with idle line.
+ * 2017-06-29     Test         poll in exceptions and before scheduler starts.
+ * 2017-06-29     Test         note DMA1 channel 5 is shared with SPI2 Tx DMA.
  */
 
 #include "gd32f20x.h"
@@ -25,13 +28,92 @@
 #define UART1_GPIO_RX        GPIO_PIN_10
 #define UART1_GPIO           GPIOA
 
+/* USART1 Rx use DMA1 channel 5, the only channel of its request. SPI2 Tx
+ * DMA uses it too, rt_gd32f20x_spi.h refuses SPI_USE_DMA with UART1 */
+#define UART1_RX_DMA         DMA1_CHANNEL5
+#define UART1_RX_DMA_IRQ     DMA1_Channel5_IRQn
+#define UART1_RX_DMA_INT_HT  DMA1_INT_HT5
+#define UART1_RX_DMA_INT_TC  DMA1_INT_TC5
+#define UART1_RX_DMA_INT_GL  DMA1_INT_GL5
+
+/* buffer size, must be power of 2 */
+#define UART1_TX_RING_SIZE   512
+#define UART1_RX_DMA_SIZE    128
+
 /* gd32 uart driver */
 struct gd32_uart
 {
     USART_TypeDef* uart_device;
     IRQn_Type irq;
+
+    /* Tx ring, putc() write head and TBE interrupt read tail */
+    rt_uint8_t *tx_buf;
+    rt_uint16_t tx_size;
+    volatile rt_uint16_t tx_head;
+    volatile rt_uint16_t tx_tail;
+
+    /* Rx ring, written by DMA in circular mode and read by getc() */
+    DMA_Channel_TypeDef *rx_dma;
+    IRQn_Type rx_dma_irq;
+    rt_uint8_t *rx_buf;
+    rt_uint16_t rx_size;
+    rt_uint16_t rx_get;
+    rt_bool_t rx_dma_on;
+
+    struct gd32_uart_stat stat;
 };
 
+/* send queued bytes by polling, used when the TBE interrupt can not run */
+static void gd32_tx_flush(struct gd32_uart* uart)
+{
+    while (uart->tx_tail != uart->tx_head)
+    {
+        while (!(uart->uart_device->STR & USART_FLAG_TBE));
+        uart->uart_device->DR = uart->tx_buf[uart->tx_tail];
+        uart->tx_tail = (uart->tx_tail + 1) & (uart->tx_size - 1);
+    }
+    USART_INT_Set(uart->uart_device, USART_INT_TBE, DISABLE);
+}
+
+static void gd32_rx_dma_start(struct gd32_uart* uart)
+{
+    DMA_InitPara DMA_InitStructure;
+
+    DMA_Enable(uart->rx_dma, DISABLE);
+    DMA_DeInit(uart->rx_dma);
+
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&(uart->uart_device->DR);
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)uart->rx_buf;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PERIPHERALSRC;
+    DMA_InitStructure.DMA_BufferSize = uart->rx_size;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PERIPHERALINC_DISABLE;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MEMORYINC_ENABLE;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PERIPHERALDATASIZE_BYTE;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MEMORYDATASIZE_BYTE;
+    DMA_InitStructure.DMA_Mode = DMA_MODE_CIRCULAR;
+    DMA_InitStructure.DMA_Priority = DMA_PRIORITY_HIGH;
+    DMA_InitStructure.DMA_MTOM = DMA_MEMTOMEM_DISABLE;
+    DMA_Init(uart->rx_dma, &DMA_InitStructure);
+
+    uart->rx_get = 0;
+    uart->rx_dma_on = RT_TRUE;
+
+    /* half and full transfer interrupt for burst, idle line for the tail */
+    DMA_INTConfig(uart->rx_dma, DMA_INT_HT | DMA_INT_TC, ENABLE);
+    USART_DMA_Enable(uart->uart_device, USART_DMAREQ_RX, ENABLE);
+    USART_INT_Set(uart->uart_device, USART_INT_IDLEF, ENABLE);
+    DMA_Enable(uart->rx_dma, ENABLE);
+}
+
+static void gd32_rx_dma_stop(struct gd32_uart* uart)
+{
+    DMA_INTConfig(uart->rx_dma, DMA_INT_HT | DMA_INT_TC, DISABLE);
+    USART_INT_Set(uart->uart_device, USART_INT_IDLEF, DISABLE);
+    USART_DMA_Enable(uart->uart_device, USART_DMAREQ_RX, DISABLE);
+    DMA_Enable(uart->rx_dma, DISABLE);
+    uart->rx_dma_on = RT_FALSE;
+}
+
 static rt_err_t gd32_configure(struct rt_serial_device *serial, struct serial_configure *cfg)
 {
     struct gd32_uart* uart;
@@ -81,12 +163,21 @@ static rt_err_t gd32_control(struct rt_serial_device *serial, int cmd, void *arg
     RT_ASSERT(serial != RT_NULL);
     uart = (struct gd32_uart *)serial->parent.user_data;
 
+    /* Tx is always served by the Tx ring, only Rx interrupt is switched */
+    if ((rt_uint32_t)arg == RT_DEVICE_FLAG_INT_TX)
+    {
+        return RT_EOK;
+    }
+
     switch (cmd)
     {
         /* disable interrupt */
     case RT_DEVICE_CTRL_CLR_INT:
-        /* disable rx irq */
-        UART_DISABLE_IRQ(uart->irq);
+        /* keep uart irq enabled for the Tx ring */
+        if (uart->rx_dma_on)
+        {
+            gd32_rx_dma_stop(uart);
+        }
         /* disable interrupt */
         USART_INT_Set(uart->uart_device, USART_INT_RBNE, DISABLE);
         break;
@@ -94,8 +185,15 @@ static rt_err_t gd32_control(struct rt_serial_device *serial, int cmd, void *arg
     case RT_DEVICE_CTRL_SET_INT:
         /* enable rx irq */
         UART_ENABLE_IRQ(uart->irq);
-        /* enable interrupt */
-        USART_INT_Set(uart->uart_device, USART_INT_RBNE, ENABLE);
+        /* enable interrupt, DMA take the place of RBNE if there is a Rx ring */
+        if (uart->rx_dma != RT_NULL)
+        {
+            gd32_rx_dma_start(uart);
+        }
+        else
+        {
+            USART_INT_Set(uart->uart_device, USART_INT_RBNE, ENABLE);
+        }
         break;
     }
 
@@ -105,14 +203,52 @@ static rt_err_t gd32_control(struct rt_serial_device *serial, int cmd, void *arg
 static int gd32_putc(struct rt_serial_device *serial, char c)
 {
     struct gd32_uart* uart;
+    rt_base_t level;
+    rt_uint16_t next;
+    rt_bool_t waited = RT_FALSE;
 
     RT_ASSERT(serial != RT_NULL);
     uart = (struct gd32_uart *)serial->parent.user_data;
 
-    uart->uart_device->DR = c;
-    while (!(uart->uart_device->STR & USART_FLAG_TC));
+    /* no Tx ring, interrupt is masked (startup, critical section), in an
+     * exception (interrupt, hard fault printing with PRIMASK clear) or before
+     * scheduler: TBE interrupt may never drain the ring. send queued bytes
+     * first to keep the order, then send this one by polling */
+    if (uart->tx_buf == RT_NULL || __get_PRIMASK() != 0 ||
+        __get_IPSR() != 0 || rt_thread_self() == RT_NULL)
+    {
+        if (uart->tx_buf != RT_NULL)
+        {
+            gd32_tx_flush(uart);
+        }
+        uart->uart_device->DR = c;
+        while (!(uart->uart_device->STR & USART_FLAG_TC));
+
+        return 1;
+    }
 
-    return 1;
+    while (1)
+    {
+        level = rt_hw_interrupt_disable();
+        next = (uart->tx_head + 1) & (uart->tx_size - 1);
+        if (next != uart->tx_tail)
+        {
+            uart->tx_buf[uart->tx_head] = c;
+            uart->tx_head = next;
+            USART_INT_Set(uart->uart_device, USART_INT_TBE, ENABLE);
+            rt_hw_interrupt_enable(level);
+
+            return 1;
+        }
+        rt_hw_interrupt_enable(level);
+
+        /* ring is full: a thread waits until the ring has space */
+        if (waited == RT_FALSE)
+        {
+            waited = RT_TRUE;
+            uart->stat.tx_waited++;
+        }
+    }
 }
 
 static int gd32_getc(struct rt_serial_device *serial)
@@ -124,7 +260,19 @@ static int gd32_getc(struct rt_serial_device *serial)
     uart = (struct gd32_uart *)serial->parent.user_data;
 
     ch = -1;
-    if (uart->uart_device->STR & USART_FLAG_RBNE)
+    if (uart->rx_dma_on)
+    {
+        /* DMA write position in the Rx ring */
+        rt_uint16_t put = (uart->rx_size - DMA_GetCurrDataCounter(uart->rx_dma))
+                          & (uart->rx_size - 1);
+
+        if (uart->rx_get != put)
+        {
+            ch = uart->rx_buf[uart->rx_get];
+            uart->rx_get = (uart->rx_get + 1) & (uart->rx_size - 1);
+        }
+    }
+    else if (uart->uart_device->STR & USART_FLAG_RBNE)
     {
         ch = uart->uart_device->DR & 0xff;
     }
@@ -132,6 +280,20 @@ static int gd32_getc(struct rt_serial_device *serial)
     return ch;
 }
 
+/* serve Tx ring in uart interrupt */
+static void gd32_tx_isr(struct gd32_uart* uart)
+{
+    if (uart->tx_tail != uart->tx_head)
+    {
+        uart->uart_device->DR = uart->tx_buf[uart->tx_tail];
+        uart->tx_tail = (uart->tx_tail + 1) & (uart->tx_size - 1);
+    }
+    if (uart->tx_tail == uart->tx_head)
+    {
+        USART_INT_Set(uart->uart_device, USART_INT_TBE, DISABLE);
+    }
+}
+
 static const struct rt_uart_ops gd32_uart_ops =
 {
     gd32_configure,
@@ -141,11 +303,24 @@ static const struct rt_uart_ops gd32_uart_ops =
 };
 
 #if defined(RT_USING_UART1)
+static rt_uint8_t uart1_tx_buf[UART1_TX_RING_SIZE];
+static rt_uint8_t uart1_rx_buf[UART1_RX_DMA_SIZE];
+
 /* UART1 device driver structure */
 struct gd32_uart uart1 =
 {
     USART1,
     USART1_IRQn,
+    uart1_tx_buf,
+    UART1_TX_RING_SIZE,
+    0,
+    0,
+    UART1_RX_DMA,
+    UART1_RX_DMA_IRQ,
+    uart1_rx_buf,
+    UART1_RX_DMA_SIZE,
+    0,
+    RT_FALSE,
 };
 struct rt_serial_device serial1;
 
@@ -164,20 +339,69 @@ void USART1_IRQHandler(void)
         USART_ClearIntBitState(uart->uart_device, USART_INT_RBNE);
     }
 
+    if (USART_GetIntBitState(uart->uart_device, USART_INT_IDLEF) != RESET)
+    {
+        /* clear by reading STR then DR, DR is empty as DMA has read it */
+        (void)uart->uart_device->DR;
+        rt_hw_serial_isr(&serial1, RT_SERIAL_EVENT_RX_IND);
+    }
+
     if (USART_GetIntBitState(uart->uart_device, USART_INT_TBE) != RESET)
     {
-        /* clear interrupt */
-        USART_ClearIntBitState(uart->uart_device, USART_INT_TBE);
+        gd32_tx_isr(uart);
     }
     if (USART_GetBitState(uart->uart_device, USART_FLAG_ORE) == SET)
     {
-        gd32_getc(&serial1);
+        uart->stat.rx_overrun++;
+        (void)uart->uart_device->DR;
+    }
+    /* leave interrupt */
+    rt_interrupt_leave();
+}
+
+void DMA1_Channel5_IRQHandler(void)
+{
+    struct gd32_uart* uart;
+    rt_bool_t ht, tc;
+
+    uart = &uart1;
+
+    /* enter interrupt */
+    rt_interrupt_enter();
+    ht = (DMA_GetIntBitState(UART1_RX_DMA_INT_HT) != RESET);
+    tc = (DMA_GetIntBitState(UART1_RX_DMA_INT_TC) != RESET);
+    DMA_ClearIntBitState(UART1_RX_DMA_INT_GL);
+
+    /* both halves completed since last service, DMA has written over
+     * data not read yet */
+    if (ht && tc)
+    {
+        uart->stat.rx_overwrite += uart->rx_size / 2;
     }
+    rt_hw_serial_isr(&serial1, RT_SERIAL_EVENT_RX_IND);
+
     /* leave interrupt */
     rt_interrupt_leave();
 }
 #endif /* RT_USING_UART1 */
 
+/**
+ * get Tx ring and Rx DMA statistics of a uart device
+ *
+ * @param serial the serial device
+ * @param stat the buffer to save statistics
+ */
+void rt_hw_usart_get_stat(struct rt_serial_device *serial, struct gd32_uart_stat *stat)
+{
+    struct gd32_uart* uart;
+
+    RT_ASSERT(serial != RT_NULL);
+    RT_ASSERT(stat != RT_NULL);
+    uart = (struct gd32_uart *)serial->parent.user_data;
+
+    *stat = uart->stat;
+}
+
 
 static void RCC_Configuration(void)
 {
@@ -186,6 +410,7 @@ static void RCC_Configuration(void)
 #if defined(RT_USING_UART1)  
     RCC_APB2PeriphClock_Enable(RCC_APB2PERIPH_GPIOA, ENABLE);
     RCC_APB2PeriphClock_Enable(RCC_APB2PERIPH_USART1, ENABLE);
+    RCC_AHBPeriphClock_Enable(RCC_AHBPERIPH_DMA1, ENABLE);
 #endif /* RT_USING_UART1 */
 }
 
@@ -219,6 +444,13 @@ static void NVIC_Configuration(struct gd32_uart* uart)
     NVIC_InitStructure.NVIC_IRQSubPriority = 2;
     NVIC_InitStructure.NVIC_IRQEnable = ENABLE;
     NVIC_Init(&NVIC_InitStructure);
+
+    /* same priority as uart irq, they share the Rx ring without lock */
+    if (uart->rx_dma != RT_NULL)
+    {
+        NVIC_InitStructure.NVIC_IRQ = uart->rx_dma_irq;
+        NVIC_Init(&NVIC_InitStructure);
+    }
 }
 
 void rt_hw_usart_init(void)
@@ -10,6 +10,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2009-01-05     Bernard      the first version
+ * 2017-06-24     Test         add uart statistics.
  */
 
 #ifndef __USART_H__
@@ -21,6 +22,17 @@
 #define UART_ENABLE_IRQ(n)            NVIC_EnableIRQ((n))
 #define UART_DISABLE_IRQ(n)           NVIC_DisableIRQ((n))
 
+/* Tx ring and Rx DMA statistics */
+struct gd32_uart_stat
+{
+    rt_uint32_t tx_waited;      /* times a thread waited for Tx ring space */
+    rt_uint32_t rx_overrun;     /* hardware overrun errors */
+    rt_uint32_t rx_overwrite;   /* bytes written over by DMA before read */
+};
+
+struct rt_serial_device;
+
 void rt_hw_usart_init(void);
+void rt_hw_usart_get_stat(struct rt_serial_device *serial, struct gd32_uart_stat *stat);
 
 #endif
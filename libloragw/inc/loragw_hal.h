@@ -46,6 +46,12 @@ Maintainer: Sylvain Miermont
 #define LGW_HAL_ERROR       -1
 #define LGW_LBT_ISSUE       1
 
+/* 1 if a GPS PPS is wired to the concentrator, the trigger counter then holds
+   the counter value captured on the last pulse instead of the running counter */
+#ifndef LGW_GPS_PPS
+#define LGW_GPS_PPS         0
+#endif
+
 /* radio-specific parameters */
 #define LGW_XTAL_FREQU      32000000            /* frequency of the RF reference oscillator */
 #define LGW_RF_CHAIN_NB     2                   /* number of RF chains */
@@ -64,6 +70,9 @@ Maintainer: Sylvain Miermont
 #define LGW_DATABUFF_SIZE   1024    /* size in bytes of the RX data buffer (contains payload & metadata) */
 #define LGW_REF_BW          125000    /* typical bandwidth of data channel */
 #define LGW_MULTI_NB        8    /* number of LoRa 'multi SF' chains */
+#define LGW_TX_HEADER_SIZE  17    /* max size of TX metadata ahead of the payload (FSK adds a size byte) */
+#define LGW_CAL_OFFSET_NB   8    /* number of TX DC offsets per radio, for mixer gain 8 to 15 */
+#define LGW_CAL_IQ_NB       5    /* number of RX IQ mismatch coefficients set by calibration */
 #define LGW_IFMODEM_CONFIG {\
         IF_LORA_MULTI, \
         IF_LORA_MULTI, \
@@ -273,6 +282,21 @@ struct lgw_pkt_tx_s {
     uint8_t     payload[256];   /*!> buffer containing the payload */
 };
 
+/**
+@struct lgw_tx_desc_s
+@brief Prepared TX descriptor: metadata header and TX gain settings computed once for a packet configuration
+*/
+struct lgw_tx_desc_s {
+    uint32_t    generation;     /*!> HAL configuration the descriptor was built for, 0 if never prepared */
+    uint8_t     tx_mode;        /*!> select on what event/time the TX is triggered */
+    uint8_t     modulation;     /*!> modulation to use for the packet */
+    int8_t      offset_i;       /*!> TX I offset from calibration */
+    int8_t      offset_q;       /*!> TX Q offset from calibration */
+    uint8_t     dig_gain;       /*!> SX1301 digital gain from TX gain LUT */
+    uint8_t     header_size;    /*!> number of metadata bytes ahead of the payload */
+    uint8_t     header[LGW_TX_HEADER_SIZE]; /*!> TX metadata, timestamp and size are filled for each packet */
+};
+
 /**
 @struct lgw_tx_gain_s
 @brief Structure containing all gains of Tx chain
@@ -294,6 +318,21 @@ struct lgw_tx_gain_lut_s {
     uint8_t                 size;                       /*!> Number of LUT indexes */
 };
 
+/**
+@struct lgw_cal_data_s
+@brief Results of the SX1301 calibration, can be saved and given back to skip calibration on next start
+*/
+struct lgw_cal_data_s {
+    uint32_t    config_hash;    /*!> hash of the radio configuration and TX gain LUT the calibration was done with */
+    uint8_t     cal_status;     /*!> status returned by the calibration firmware */
+    bool        reused;         /*!> true if lgw_start loaded these results instead of running the calibration */
+    int8_t      offset_a_i[LGW_CAL_OFFSET_NB]; /*!> TX I offsets for radio A */
+    int8_t      offset_a_q[LGW_CAL_OFFSET_NB]; /*!> TX Q offsets for radio A */
+    int8_t      offset_b_i[LGW_CAL_OFFSET_NB]; /*!> TX I offsets for radio B */
+    int8_t      offset_b_q[LGW_CAL_OFFSET_NB]; /*!> TX Q offsets for radio B */
+    uint8_t     iq_mismatch[LGW_CAL_IQ_NB];    /*!> RX IQ mismatch registers: A amp, A phi, B amp, B sel I, B phi */
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
@@ -327,6 +366,24 @@ int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf);
 */
 int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf);
 
+/**
+@brief Change the frequency and spreading factors of a LoRa 'multi' IF chain while the concentrator is running
+@param if_chain number of the IF chain to update [0, LGW_MULTI_NB - 1]
+@param conf structure containing the configuration parameters, enable, freq_hz and datarate are used
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+No calibration nor firmware reload is needed, the RF chain of the IF chain cannot be changed.
+*/
+int lgw_rxif_update(uint8_t if_chain, struct lgw_conf_rxif_s conf);
+
+/**
+@brief Get the current configuration of an IF chain
+@param if_chain number of the IF chain [0, LGW_IF_CHAIN_NB - 1]
+@param conf pointer to the structure receiving the configuration parameters
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_rxif_getconf(uint8_t if_chain, struct lgw_conf_rxif_s *conf);
+
 /**
 @brief Configure the Tx gain LUT
 @param pointer to structure defining the LUT
@@ -334,12 +391,43 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf);
 */
 int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf);
 
+/**
+@brief Give the results of a previous calibration, so lgw_start can skip the calibration
+@param cal pointer to the calibration results, NULL to force a calibration on next start
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The results are only used if their config_hash matches lgw_cal_config_hash() when lgw_start runs.
+*/
+int lgw_cal_setconf(struct lgw_cal_data_s *cal);
+
+/**
+@brief Get the calibration results in use since the last lgw_start
+@param cal pointer to the structure receiving the calibration results
+@return LGW_HAL_ERROR if the concentrator was never started, LGW_HAL_SUCCESS else
+*/
+int lgw_cal_get(struct lgw_cal_data_s *cal);
+
+/**
+@brief Hash the current radio configuration and TX gain LUT, the calibration results depend on them
+@return 32 bits hash of the configuration
+*/
+uint32_t lgw_cal_config_hash(void);
+
 /**
 @brief Connect to the LoRa concentrator, reset it and configure it according to previously set parameters
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
 */
 int lgw_start(void);
 
+/**
+@brief Restart the LoRa concentrator, skipping firmware loading and calibration if it was not power-cycled
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+A warm restart keeps the configuration of the last lgw_start, a cold restart (lgw_start) is done if the
+concentrator is not started or if its clocks or MCU firmwares were lost.
+*/
+int lgw_restart(void);
+
 /**
 @brief Stop the LoRa concentrator and disconnect it
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
@@ -366,6 +454,35 @@ In 'triggered' mode (aka PPS/GPS mode), the packet, typically a beacon, is emitt
 */
 int lgw_send(struct lgw_pkt_tx_s pkt_data);
 
+/**
+@brief Precompute the TX metadata and gain settings of a packet configuration, for lgw_send_prepared
+@param pkt_data structure containing the packet configuration, payload and size are ignored
+@param desc pointer to the descriptor to fill
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The descriptor stays valid until the concentrator is restarted or its radio/TX gain configuration changes.
+*/
+int lgw_tx_prepare(struct lgw_pkt_tx_s *pkt_data, struct lgw_tx_desc_s *desc);
+
+/**
+@brief Check if a prepared TX descriptor is still valid for the current configuration
+@param desc pointer to the descriptor
+@return 1 if the descriptor can be used by lgw_send_prepared, 0 else
+*/
+int lgw_tx_is_prepared(struct lgw_tx_desc_s *desc);
+
+/**
+@brief Schedule a packet with a prepared TX descriptor, only the payload is copied
+@param desc pointer to a descriptor filled by lgw_tx_prepare
+@param count_us timestamp for TX trigger in 'timestamp' mode, ignored else
+@param payload pointer to the payload
+@param size payload size in bytes
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+Not available when LBT is enabled, use lgw_send instead.
+*/
+int lgw_send_prepared(struct lgw_tx_desc_s *desc, uint32_t count_us, uint8_t *payload, uint16_t size);
+
 /**
 @brief Give the the status of different part of the LoRa concentrator
 @param select is used to select what status we want to know
@@ -382,6 +499,7 @@ int lgw_abort_tx(void);
 
 /**
 @brief Return value of internal counter when latest event (eg GPS pulse) was captured
+@note Without LGW_GPS_PPS the event capture is off and the running value of the counter is returned
 @param trig_cnt_us pointer to receive timestamp value
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
 */
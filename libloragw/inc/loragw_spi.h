@@ -33,7 +33,12 @@ Maintainer: Sylvain Miermont
 
 #define LGW_SPI_SUCCESS     0
 #define LGW_SPI_ERROR       -1
-#define LGW_BURST_CHUNK     1024
+
+/* max bytes per SPI transaction of a burst access, 0 for no chunking (a whole
+   burst, e.g. a RX payload or a TX buffer load, is a single bus transaction) */
+#ifndef LGW_BURST_CHUNK
+#define LGW_BURST_CHUNK     0
+#endif
 
 #define LGW_SPI_MUX_MODE0   0x0     /* No FPGA */
 #define LGW_SPI_MUX_MODE1   0x1     /* FPGA, with spi mux header */
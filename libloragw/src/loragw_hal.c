@@ -64,6 +64,7 @@ Maintainer: Sylvain Miermont
 #define FW_VERSION_CAL      2 /* Expected version of calibration firmware */
 #define FW_VERSION_AGC      4 /* Expected version of AGC firmware */
 #define FW_VERSION_ARB      1 /* Expected version of arbiter firmware */
+#define FW_CHECK_CHUNK      256 /* firmware is read back and verified by chunks of this size */
 
 #define TX_METADATA_NB      16
 #define RX_METADATA_NB      16
@@ -156,10 +157,27 @@ static struct lgw_tx_gain_lut_s txgain_lut = {
 };
 
 /* TX I/Q imbalance coefficients for mixer gain = 8 to 15 */
-static int8_t cal_offset_a_i[8]; /* TX I offset for radio A */
-static int8_t cal_offset_a_q[8]; /* TX Q offset for radio A */
-static int8_t cal_offset_b_i[8]; /* TX I offset for radio B */
-static int8_t cal_offset_b_q[8]; /* TX Q offset for radio B */
+static int8_t cal_offset_a_i[LGW_CAL_OFFSET_NB]; /* TX I offset for radio A */
+static int8_t cal_offset_a_q[LGW_CAL_OFFSET_NB]; /* TX Q offset for radio A */
+static int8_t cal_offset_b_i[LGW_CAL_OFFSET_NB]; /* TX I offset for radio B */
+static int8_t cal_offset_b_q[LGW_CAL_OFFSET_NB]; /* TX Q offset for radio B */
+
+/* bumped each time calibration or TX gain LUT changes, outdates prepared TX descriptors */
+static uint32_t tx_desc_generation = 1;
+
+/* TX gain settings currently loaded in the SX1301, to skip rewriting them for each packet */
+static struct {
+    bool    valid;
+    int8_t  offset_i;
+    int8_t  offset_q;
+    uint8_t dig_gain;
+} tx_gain_applied;
+
+/* calibration results of the last start, and results given by the user to skip the next calibration */
+static struct lgw_cal_data_s cal_results;
+static bool cal_results_valid = false;
+static struct lgw_cal_data_s cal_cached;
+static bool cal_cached_valid = false;
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
@@ -171,6 +189,12 @@ void lgw_constant_adjust(void);
 int32_t lgw_sf_getval(int x);
 int32_t lgw_bw_getval(int x);
 
+static int tx_commit(struct lgw_tx_desc_s *desc, uint32_t count_us, uint8_t *payload, uint16_t size, struct lgw_pkt_tx_s *lbt_pkt);
+
+static uint32_t cal_hash(uint32_t hash, const void *data, int size);
+static int cal_run(void);
+static void cal_load(struct lgw_cal_data_s *cal);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -178,7 +202,8 @@ int32_t lgw_bw_getval(int x);
 int load_firmware(uint8_t target, uint8_t *firmware, uint16_t size) {
     int reg_rst;
     int reg_sel;
-    uint8_t fw_check[8192] = {0};
+    uint8_t fw_check[FW_CHECK_CHUNK];
+    uint16_t offset, chunk;
     int32_t dummy;
 
     /* check parameters */
@@ -212,12 +237,15 @@ int load_firmware(uint8_t target, uint8_t *firmware, uint16_t size) {
     /* write the program in one burst */
     lgw_reg_wb(LGW_MCU_PROM_DATA, firmware, size);
 
-    /* Read back firmware code for check */
+    /* Read back firmware code for check, chunk by chunk: program RAM address auto-increments */
     lgw_reg_r( LGW_MCU_PROM_DATA, &dummy ); /* bug workaround */
-    lgw_reg_rb( LGW_MCU_PROM_DATA, fw_check, size );
-    if (memcmp(firmware, fw_check, size) != 0) {
-        rt_kprintf ("ERROR: Failed to load fw %d\r\n", (int)target);
-        return -1;
+    for (offset = 0; offset < size; offset += chunk) {
+        chunk = ((size - offset) < FW_CHECK_CHUNK) ? (size - offset) : FW_CHECK_CHUNK;
+        lgw_reg_rb( LGW_MCU_PROM_DATA, fw_check, chunk );
+        if (memcmp(firmware + offset, fw_check, chunk) != 0) {
+            rt_kprintf ("ERROR: Failed to load fw %d at 0x%04x\r\n", (int)target, offset);
+            return -1;
+        }
     }
 
     /* give back control of the MCU program ram to the MCU */
@@ -376,6 +404,277 @@ int32_t lgw_sf_getval(int x) {
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* load TX gain settings, metadata and payload of a prepared descriptor, then trigger the TX */
+static int tx_commit(struct lgw_tx_desc_s *desc, uint32_t count_us, uint8_t *payload, uint16_t size, struct lgw_pkt_tx_s *lbt_pkt) {
+    int i, x;
+    uint8_t buff[256+TX_METADATA_NB]; /* buffer to prepare the packet to send + metadata before SPI write burst */
+    uint32_t count_trig = 0; /* timestamp value in trigger mode corrected for TX start delay */
+    bool tx_allowed = true;
+
+    if (size > 255) {
+        DEBUG_MSG("ERROR: PAYLOAD LENGTH TOO BIG FOR TX\r\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* loading TX imbalance correction and digital gain, only when they changed */
+    if ((tx_gain_applied.valid == false) || (tx_gain_applied.offset_i != desc->offset_i) || (tx_gain_applied.offset_q != desc->offset_q)) {
+        lgw_reg_w(LGW_TX_OFFSET_I, desc->offset_i);
+        lgw_reg_w(LGW_TX_OFFSET_Q, desc->offset_q);
+    }
+    if ((tx_gain_applied.valid == false) || (tx_gain_applied.dig_gain != desc->dig_gain)) {
+        lgw_reg_w(LGW_TX_GAIN, desc->dig_gain);
+    }
+    tx_gain_applied.offset_i = desc->offset_i;
+    tx_gain_applied.offset_q = desc->offset_q;
+    tx_gain_applied.dig_gain = desc->dig_gain;
+    tx_gain_applied.valid = true;
+
+    /* precomputed metadata */
+    memcpy((void *)buff, (void *)desc->header, desc->header_size);
+
+    /* metadata 3 to 6, timestamp trigger value */
+    /* TX state machine must be triggered at T0 - TX_START_DELAY for packet to start being emitted at T0 */
+    if (desc->tx_mode == TIMESTAMPED)
+    {
+        count_trig = count_us - TX_START_DELAY;
+        buff[3] = 0xFF & (count_trig >> 24);
+        buff[4] = 0xFF & (count_trig >> 16);
+        buff[5] = 0xFF & (count_trig >> 8);
+        buff[6] = 0xFF &  count_trig;
+    }
+
+    /* metadata 10, payload size */
+    buff[10] = size;
+    if (desc->modulation == MOD_FSK) {
+        /* insert payload size in the packet for variable mode */
+        buff[16] = size;
+    }
+
+    /* copy payload from user buffer to buffer containing metadata */
+    memcpy((void *)(buff + desc->header_size), (void *)payload, size);
+
+    /* reset TX command flags */
+    lgw_abort_tx();
+
+    /* put metadata + payload in the TX data buffer */
+    lgw_reg_w(LGW_TX_DATA_BUF_ADDR, 0);
+    lgw_reg_wb(LGW_TX_DATA_BUF_DATA, buff, desc->header_size + size);
+    DEBUG_ARRAY(i, desc->header_size + size, buff);
+
+    if (lbt_pkt != NULL) {
+        x = lbt_is_channel_free(lbt_pkt, &tx_allowed);
+        if (x != LGW_LBT_SUCCESS) {
+            DEBUG_MSG("ERROR: Failed to check channel availability for TX\r\n");
+            return LGW_HAL_ERROR;
+        }
+    }
+    if (tx_allowed == true) {
+        switch(desc->tx_mode) {
+            case IMMEDIATE:
+                lgw_reg_w(LGW_TX_TRIG_IMMEDIATE, 1);
+                break;
+
+            case TIMESTAMPED:
+                lgw_reg_w(LGW_TX_TRIG_DELAYED, 1);
+                break;
+
+            case ON_GPS:
+                lgw_reg_w(LGW_TX_TRIG_GPS, 1);
+                break;
+
+            default:
+                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", desc->tx_mode);
+                return LGW_HAL_ERROR;
+        }
+    } else {
+        DEBUG_MSG("ERROR: Cannot send packet, channel is busy (LBT)\r\n");
+        return LGW_LBT_ISSUE;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* FNV-1a, used to identify the configuration a calibration was done with */
+static uint32_t cal_hash(uint32_t hash, const void *data, int size) {
+    const uint8_t *p = (const uint8_t *)data;
+    int i;
+
+    for (i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* run the calibration firmware and read back its results, clocks must be enabled */
+static int cal_run(void) {
+    int i;
+    int32_t read_val;
+    uint8_t fw_version;
+    uint8_t cal_cmd;
+//    uint16_t cal_time;
+    uint8_t cal_status;
+
+    extern void feed_dog(void);
+
+    /* select calibration command */
+    cal_cmd = 0;
+    cal_cmd |= rf_enable[0] ? 0x01 : 0x00; /* Bit 0: Calibrate Rx IQ mismatch compensation on radio A */
+    cal_cmd |= rf_enable[1] ? 0x02 : 0x00; /* Bit 1: Calibrate Rx IQ mismatch compensation on radio B */
+    cal_cmd |= (rf_enable[0] && rf_tx_enable[0]) ? 0x04 : 0x00; /* Bit 2: Calibrate Tx DC offset on radio A */
+    cal_cmd |= (rf_enable[1] && rf_tx_enable[1]) ? 0x08 : 0x00; /* Bit 3: Calibrate Tx DC offset on radio B */
+    cal_cmd |= 0x10; /* Bit 4: 0: calibrate with DAC gain=2, 1: with DAC gain=3 (use 3) */
+
+    switch (rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
+        case LGW_RADIO_TYPE_SX1255:
+            cal_cmd |= 0x20; /* Bit 5: 0: SX1257, 1: SX1255 */
+            break;
+        case LGW_RADIO_TYPE_SX1257:
+            cal_cmd |= 0x00; /* Bit 5: 0: SX1257, 1: SX1255 */
+            break;
+        default:
+            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\r\n", rf_radio_type[0]);
+            break;
+    }
+
+    cal_cmd |= 0x00; /* Bit 6-7: Board type 0: ref, 1: FPGA, 3: board X */
+//    cal_time = 2300; /* measured between 2.1 and 2.2 sec, because 1 TX only */
+
+    /* Load the calibration firmware  */
+    load_firmware(MCU_AGC, cal_firmware, MCU_AGC_FW_BYTE);
+    lgw_reg_w(LGW_FORCE_HOST_RADIO_CTRL, 0); /* gives to AGC MCU the control of the radios */
+    lgw_reg_w(LGW_RADIO_SELECT, cal_cmd); /* send calibration configuration word */
+    lgw_reg_w(LGW_MCU_RST_1, 0);
+
+    /* Check firmware version */
+    lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, FW_VERSION_ADDR);
+    wait_ms(1);
+    lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+    fw_version = (uint8_t)read_val;
+    if (fw_version != FW_VERSION_CAL) {
+        rt_kprintf("ERROR: Version of calibration firmware not expected, actual:%d expected:%d\r\n", fw_version, FW_VERSION_CAL);
+//        return -1;
+    }
+
+    lgw_reg_w(LGW_PAGE_REG, 3); /* Calibration will start on this condition as soon as MCU can talk to concentrator registers */
+    lgw_reg_w(LGW_EMERGENCY_FORCE_HOST_CTRL, 0); /* Give control of concentrator registers to MCU */
+
+    /* Wait for calibration to end */
+    DEBUG_PRINTF("Note: calibration started (time: %u ms)\r\n", cal_time);
+//    wait_ms(cal_time); /* Wait for end of calibration */
+
+	for(i = 0; i < 5; i++) 
+    {
+	    wait_ms(500);
+	    feed_dog();
+	}
+
+    lgw_reg_w(LGW_EMERGENCY_FORCE_HOST_CTRL, 1); /* Take back control */
+
+    /* Get calibration status */
+    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
+    cal_status = (uint8_t)read_val;
+    /*
+        bit 7: calibration finished
+        bit 0: could access SX1301 registers
+        bit 1: could access radio A registers
+        bit 2: could access radio B registers
+        bit 3: radio A RX image rejection successful
+        bit 4: radio B RX image rejection successful
+        bit 5: radio A TX DC Offset correction successful
+        bit 6: radio B TX DC Offset correction successful
+    */
+    if ((cal_status & 0x81) != 0x81) {
+        DEBUG_PRINTF("ERROR: CALIBRATION FAILURE (STATUS = %u)\r\n", cal_status);
+        return LGW_HAL_ERROR;
+    } else {
+        DEBUG_PRINTF("Note: calibration finished (status = %u)\r\n", cal_status);
+    }
+    if (rf_enable[0] && ((cal_status & 0x02) == 0)) {
+        DEBUG_MSG("WARNING: calibration could not access radio A\r\n");
+    }
+    if (rf_enable[1] && ((cal_status & 0x04) == 0)) {
+        DEBUG_MSG("WARNING: calibration could not access radio B\r\n");
+    }
+    if (rf_enable[0] && ((cal_status & 0x08) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio A for image rejection\r\n");
+    }
+    if (rf_enable[1] && ((cal_status & 0x10) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio B for image rejection\r\n");
+    }
+    if (rf_enable[0] && rf_tx_enable[0] && ((cal_status & 0x20) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio A for TX DC offset\r\n");
+    }
+    if (rf_enable[1] && rf_tx_enable[1] && ((cal_status & 0x40) == 0)) {
+        DEBUG_MSG("WARNING: problem in calibration of radio B for TX DC offset\r\n");
+    }
+
+    /* Get TX DC offset values */
+    for(i=0; i<=7; ++i) {
+        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xA0+i);
+        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+        cal_offset_a_i[i] = (int8_t)read_val;
+        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xA8+i);
+        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+        cal_offset_a_q[i] = (int8_t)read_val;
+        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xB0+i);
+        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+        cal_offset_b_i[i] = (int8_t)read_val;
+        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xB8+i);
+        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+        cal_offset_b_q[i] = (int8_t)read_val;
+    }
+
+    /* Get RX IQ mismatch coefficients, set by the calibration firmware */
+    lgw_reg_r(LGW_IQ_MISMATCH_A_AMP_COEFF, &read_val);
+    cal_results.iq_mismatch[0] = (uint8_t)read_val;
+    lgw_reg_r(LGW_IQ_MISMATCH_A_PHI_COEFF, &read_val);
+    cal_results.iq_mismatch[1] = (uint8_t)read_val;
+    lgw_reg_r(LGW_IQ_MISMATCH_B_AMP_COEFF, &read_val);
+    cal_results.iq_mismatch[2] = (uint8_t)read_val;
+    lgw_reg_r(LGW_IQ_MISMATCH_B_SEL_I, &read_val);
+    cal_results.iq_mismatch[3] = (uint8_t)read_val;
+    lgw_reg_r(LGW_IQ_MISMATCH_B_PHI_COEFF, &read_val);
+    cal_results.iq_mismatch[4] = (uint8_t)read_val;
+
+    cal_results.config_hash = lgw_cal_config_hash();
+    cal_results.cal_status = cal_status;
+    cal_results.reused = false;
+    memcpy(cal_results.offset_a_i, cal_offset_a_i, sizeof cal_offset_a_i);
+    memcpy(cal_results.offset_a_q, cal_offset_a_q, sizeof cal_offset_a_q);
+    memcpy(cal_results.offset_b_i, cal_offset_b_i, sizeof cal_offset_b_i);
+    memcpy(cal_results.offset_b_q, cal_offset_b_q, sizeof cal_offset_b_q);
+    cal_results_valid = true;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/* restore the results of a previous calibration instead of running it */
+static void cal_load(struct lgw_cal_data_s *cal) {
+    lgw_reg_w(LGW_IQ_MISMATCH_A_AMP_COEFF, cal->iq_mismatch[0]);
+    lgw_reg_w(LGW_IQ_MISMATCH_A_PHI_COEFF, cal->iq_mismatch[1]);
+    lgw_reg_w(LGW_IQ_MISMATCH_B_AMP_COEFF, cal->iq_mismatch[2]);
+    lgw_reg_w(LGW_IQ_MISMATCH_B_SEL_I, cal->iq_mismatch[3]);
+    lgw_reg_w(LGW_IQ_MISMATCH_B_PHI_COEFF, cal->iq_mismatch[4]);
+
+    memcpy(cal_offset_a_i, cal->offset_a_i, sizeof cal_offset_a_i);
+    memcpy(cal_offset_a_q, cal->offset_a_q, sizeof cal_offset_a_q);
+    memcpy(cal_offset_b_i, cal->offset_b_i, sizeof cal_offset_b_i);
+    memcpy(cal_offset_b_q, cal->offset_b_q, sizeof cal_offset_b_q);
+
+    memcpy(&cal_results, cal, sizeof cal_results);
+    cal_results.reused = true;
+    cal_results_valid = true;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -452,6 +751,9 @@ int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s conf) {
     rf_tx_enable[rf_chain] = conf.tx_enable;
     rf_tx_notch_freq[rf_chain] = conf.tx_notch_freq;
 
+    /* prepared TX descriptors depend on the radio type */
+    ++tx_desc_generation;
+
     DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f radio_type:%d tx_enable:%d tx_notch_freq:%u\r\n", rf_chain, rf_enable[rf_chain], rf_rx_freq[rf_chain], rf_rssi_offset[rf_chain], rf_radio_type[rf_chain], rf_tx_enable[rf_chain], rf_tx_notch_freq[rf_chain]);
 
     return LGW_HAL_SUCCESS;
@@ -614,6 +916,96 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_rxif_update(uint8_t if_chain, struct lgw_conf_rxif_s conf) {
+    uint8_t sfmask;
+
+    /* check if the concentrator is running */
+    if (lgw_is_started == false) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, USE LGW_RXIF_SETCONF\r\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* only LoRa 'multi' chains can be changed on the fly */
+    if ((if_chain >= LGW_MULTI_NB) || (ifmod_config[if_chain] != IF_LORA_MULTI)) {
+        DEBUG_PRINTF("ERROR: IF CHAIN %d CANNOT BE UPDATED WHILE RUNNING\r\n", if_chain);
+        return LGW_HAL_ERROR;
+    }
+
+    if (conf.enable == false) {
+        if_enable[if_chain] = false;
+        lgw_reg_w(LGW_CORR0_DETECT_EN + if_chain, 0);
+        DEBUG_PRINTF("Note: if_chain %d disabled\r\n", if_chain);
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* IF to radio mapping is given to the AGC firmware on start */
+    if (conf.rf_chain != if_rf_chain[if_chain]) {
+        DEBUG_PRINTF("ERROR: RF CHAIN OF IF CHAIN %d CANNOT BE CHANGED WHILE RUNNING\r\n", if_chain);
+        return LGW_HAL_ERROR;
+    }
+    if (((conf.freq_hz + LGW_REF_BW/2) > ((int32_t)LGW_RF_RX_BANDWIDTH_125KHZ/2)) ||
+        ((conf.freq_hz - LGW_REF_BW/2) < -((int32_t)LGW_RF_RX_BANDWIDTH_125KHZ/2))) {
+        DEBUG_PRINTF("ERROR: IF FREQUENCY %d OUT OF RANGE\r\n", conf.freq_hz);
+        return LGW_HAL_ERROR;
+    }
+    if (conf.datarate == DR_UNDEFINED) {
+        conf.datarate = DR_LORA_MULTI;
+    }
+    if (!IS_LORA_MULTI_DR(conf.datarate)) {
+        DEBUG_MSG("ERROR: DATARATE(S) NOT SUPPORTED BY LORA_MULTI IF CHAIN\r\n");
+        return LGW_HAL_ERROR;
+    }
+    sfmask = (uint8_t)(DR_LORA_MULTI & conf.datarate);
+
+    /* disable detection while the frequency is moved, then apply the new SF mask */
+    lgw_reg_w(LGW_CORR0_DETECT_EN + if_chain, 0);
+    lgw_reg_w(LGW_IF_FREQ_0 + if_chain, IF_HZ_TO_REG(conf.freq_hz));
+    lgw_reg_w(LGW_CORR0_DETECT_EN + if_chain, sfmask);
+
+    if_enable[if_chain] = true;
+    if_freq[if_chain] = conf.freq_hz;
+    lora_multi_sfmask[if_chain] = sfmask;
+
+    DEBUG_PRINTF("Note: LoRa 'multi' if_chain %d updated; freq:%d SF_mask:0x%02x\r\n", if_chain, if_freq[if_chain], lora_multi_sfmask[if_chain]);
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxif_getconf(uint8_t if_chain, struct lgw_conf_rxif_s *conf) {
+    CHECK_NULL(conf);
+
+    if (if_chain >= LGW_IF_CHAIN_NB) {
+        DEBUG_PRINTF("ERROR: %d NOT A VALID IF_CHAIN NUMBER\r\n", if_chain);
+        return LGW_HAL_ERROR;
+    }
+
+    memset(conf, 0, sizeof *conf);
+    conf->enable = if_enable[if_chain];
+    conf->rf_chain = if_rf_chain[if_chain];
+    conf->freq_hz = if_freq[if_chain];
+    switch (ifmod_config[if_chain]) {
+        case IF_LORA_MULTI:
+            conf->bandwidth = BW_125KHZ;
+            conf->datarate = lora_multi_sfmask[if_chain];
+            break;
+        case IF_LORA_STD:
+            conf->bandwidth = lora_rx_bw;
+            conf->datarate = lora_rx_sf;
+            break;
+        case IF_FSK_STD:
+            conf->bandwidth = fsk_rx_bw;
+            conf->datarate = fsk_rx_dr;
+            break;
+        default:
+            break;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
     int i;
 
@@ -655,11 +1047,59 @@ int lgw_txgain_setconf(struct lgw_tx_gain_lut_s *conf) {
         txgain_lut.lut[i].rf_power = conf->lut[i].rf_power;
     }
 
+    /* prepared TX descriptors refer to the previous LUT */
+    ++tx_desc_generation;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cal_setconf(struct lgw_cal_data_s *cal) {
+    if (cal == NULL) {
+        cal_cached_valid = false;
+        return LGW_HAL_SUCCESS;
+    }
+
+    memcpy(&cal_cached, cal, sizeof cal_cached);
+    cal_cached_valid = true;
+
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_cal_get(struct lgw_cal_data_s *cal) {
+    CHECK_NULL(cal);
+
+    if (cal_results_valid == false) {
+        return LGW_HAL_ERROR;
+    }
+
+    memcpy(cal, &cal_results, sizeof cal_results);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint32_t lgw_cal_config_hash(void) {
+    uint32_t hash = 2166136261U;
+    uint8_t fw_version = FW_VERSION_CAL;
+
+    hash = cal_hash(hash, &fw_version, sizeof fw_version);
+    hash = cal_hash(hash, rf_enable, sizeof rf_enable);
+    hash = cal_hash(hash, rf_tx_enable, sizeof rf_tx_enable);
+    hash = cal_hash(hash, rf_radio_type, sizeof rf_radio_type);
+    hash = cal_hash(hash, rf_rx_freq, sizeof rf_rx_freq);
+    hash = cal_hash(hash, &rf_clkout, sizeof rf_clkout);
+    hash = cal_hash(hash, &txgain_lut, sizeof txgain_lut);
+
+    return hash;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_start(void) {
     int i, err;
     int reg_stat;
@@ -668,9 +1108,6 @@ int lgw_start(void) {
     int32_t read_val;
     uint8_t load_val;
     uint8_t fw_version;
-    uint8_t cal_cmd;
-//    uint16_t cal_time;
-    uint8_t cal_status;
 
     uint64_t fsk_sync_word_reg;
     
@@ -748,113 +1185,20 @@ int lgw_start(void) {
     DGPIO4 -> TX ON
     */
 
-    /* select calibration command */
-    cal_cmd = 0;
-    cal_cmd |= rf_enable[0] ? 0x01 : 0x00; /* Bit 0: Calibrate Rx IQ mismatch compensation on radio A */
-    cal_cmd |= rf_enable[1] ? 0x02 : 0x00; /* Bit 1: Calibrate Rx IQ mismatch compensation on radio B */
-    cal_cmd |= (rf_enable[0] && rf_tx_enable[0]) ? 0x04 : 0x00; /* Bit 2: Calibrate Tx DC offset on radio A */
-    cal_cmd |= (rf_enable[1] && rf_tx_enable[1]) ? 0x08 : 0x00; /* Bit 3: Calibrate Tx DC offset on radio B */
-    cal_cmd |= 0x10; /* Bit 4: 0: calibrate with DAC gain=2, 1: with DAC gain=3 (use 3) */
-
-    switch (rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
-        case LGW_RADIO_TYPE_SX1255:
-            cal_cmd |= 0x20; /* Bit 5: 0: SX1257, 1: SX1255 */
-            break;
-        case LGW_RADIO_TYPE_SX1257:
-            cal_cmd |= 0x00; /* Bit 5: 0: SX1257, 1: SX1255 */
-            break;
-        default:
-            DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\r\n", rf_radio_type[0]);
-            break;
-    }
-
-    cal_cmd |= 0x00; /* Bit 6-7: Board type 0: ref, 1: FPGA, 3: board X */
-//    cal_time = 2300; /* measured between 2.1 and 2.2 sec, because 1 TX only */
-
-    /* Load the calibration firmware  */
-    load_firmware(MCU_AGC, cal_firmware, MCU_AGC_FW_BYTE);
-    lgw_reg_w(LGW_FORCE_HOST_RADIO_CTRL, 0); /* gives to AGC MCU the control of the radios */
-    lgw_reg_w(LGW_RADIO_SELECT, cal_cmd); /* send calibration configuration word */
-    lgw_reg_w(LGW_MCU_RST_1, 0);
-
-    /* Check firmware version */
-    lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, FW_VERSION_ADDR);
-    wait_ms(1);
-    lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-    fw_version = (uint8_t)read_val;
-    if (fw_version != FW_VERSION_CAL) {
-        rt_kprintf("ERROR: Version of calibration firmware not expected, actual:%d expected:%d\r\n", fw_version, FW_VERSION_CAL);
-//        return -1;
-    }
-
-    lgw_reg_w(LGW_PAGE_REG, 3); /* Calibration will start on this condition as soon as MCU can talk to concentrator registers */
-    lgw_reg_w(LGW_EMERGENCY_FORCE_HOST_CTRL, 0); /* Give control of concentrator registers to MCU */
-
-    /* Wait for calibration to end */
-    DEBUG_PRINTF("Note: calibration started (time: %u ms)\r\n", cal_time);
-//    wait_ms(cal_time); /* Wait for end of calibration */
-
-	for(i = 0; i < 5; i++) 
-    {
-	    wait_ms(500);
-	    feed_dog();
-	}
-
-    lgw_reg_w(LGW_EMERGENCY_FORCE_HOST_CTRL, 1); /* Take back control */
-
-    /* Get calibration status */
-    lgw_reg_r(LGW_MCU_AGC_STATUS, &read_val);
-    cal_status = (uint8_t)read_val;
-    /*
-        bit 7: calibration finished
-        bit 0: could access SX1301 registers
-        bit 1: could access radio A registers
-        bit 2: could access radio B registers
-        bit 3: radio A RX image rejection successful
-        bit 4: radio B RX image rejection successful
-        bit 5: radio A TX DC Offset correction successful
-        bit 6: radio B TX DC Offset correction successful
-    */
-    if ((cal_status & 0x81) != 0x81) {
-        DEBUG_PRINTF("ERROR: CALIBRATION FAILURE (STATUS = %u)\r\n", cal_status);
-        return LGW_HAL_ERROR;
+    /* calibrate the radios, or reuse the results of a calibration done with the same configuration */
+    if ((cal_cached_valid == true) && (cal_cached.config_hash == lgw_cal_config_hash())) {
+        DEBUG_MSG("Note: calibration skipped, reusing previous results\r\n");
+        cal_load(&cal_cached);
     } else {
-        DEBUG_PRINTF("Note: calibration finished (status = %u)\r\n", cal_status);
-    }
-    if (rf_enable[0] && ((cal_status & 0x02) == 0)) {
-        DEBUG_MSG("WARNING: calibration could not access radio A\r\n");
-    }
-    if (rf_enable[1] && ((cal_status & 0x04) == 0)) {
-        DEBUG_MSG("WARNING: calibration could not access radio B\r\n");
-    }
-    if (rf_enable[0] && ((cal_status & 0x08) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio A for image rejection\r\n");
-    }
-    if (rf_enable[1] && ((cal_status & 0x10) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio B for image rejection\r\n");
-    }
-    if (rf_enable[0] && rf_tx_enable[0] && ((cal_status & 0x20) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio A for TX DC offset\r\n");
-    }
-    if (rf_enable[1] && rf_tx_enable[1] && ((cal_status & 0x40) == 0)) {
-        DEBUG_MSG("WARNING: problem in calibration of radio B for TX DC offset\r\n");
+        err = cal_run();
+        if (err != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
     }
 
-    /* Get TX DC offset values */
-    for(i=0; i<=7; ++i) {
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xA0+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_a_i[i] = (int8_t)read_val;
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xA8+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_a_q[i] = (int8_t)read_val;
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xB0+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_b_i[i] = (int8_t)read_val;
-        lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, 0xB8+i);
-        lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
-        cal_offset_b_q[i] = (int8_t)read_val;
-    }
+    /* new TX DC offsets: outdate prepared TX descriptors, registers were reset */
+    ++tx_desc_generation;
+    tx_gain_applied.valid = false;
 
     /* load adjusted parameters */
     lgw_constant_adjust();
@@ -1055,8 +1399,9 @@ int lgw_start(void) {
         return LGW_HAL_ERROR;
     }
 
-    /* enable GPS event capture */
-    lgw_reg_w(LGW_GPS_EN, 1);
+    /* enable GPS event capture, without a GPS keep it off so the trigger
+       counter follows the running internal counter */
+    lgw_reg_w(LGW_GPS_EN, LGW_GPS_PPS);
 
     /* */
     if (lbt_is_enabled() == true) {
@@ -1070,10 +1415,56 @@ int lgw_start(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_restart(void) {
+    int32_t read_val;
+
+    /* not running, nothing to keep */
+    if (lgw_is_started == false) {
+        return lgw_start();
+    }
+
+    /* reopen the SPI link, this does not reset the concentrator */
+    if (lgw_connect(false, rf_tx_notch_freq[rf_tx_enable[1]?1:0]) == LGW_REG_ERROR) {
+        DEBUG_MSG("ERROR: FAIL TO CONNECT BOARD\r\n");
+        lgw_is_started = false;
+        return LGW_HAL_ERROR;
+    }
+
+    /* clocks and MCU firmwares are lost if the concentrator was power-cycled or reset */
+    lgw_reg_r(LGW_GLOBAL_EN, &read_val);
+    if (read_val != 1) {
+        DEBUG_MSG("Note: concentrator clocks are off, cold restart\r\n");
+        return lgw_start();
+    }
+    lgw_reg_w(LGW_DBG_AGC_MCU_RAM_ADDR, FW_VERSION_ADDR);
+    lgw_reg_r(LGW_DBG_AGC_MCU_RAM_DATA, &read_val);
+    if ((uint8_t)read_val != FW_VERSION_AGC) {
+        DEBUG_MSG("Note: AGC firmware is not running, cold restart\r\n");
+        return lgw_start();
+    }
+    lgw_reg_w(LGW_DBG_ARB_MCU_RAM_ADDR, FW_VERSION_ADDR);
+    lgw_reg_r(LGW_DBG_ARB_MCU_RAM_DATA, &read_val);
+    if ((uint8_t)read_val != FW_VERSION_ARB) {
+        DEBUG_MSG("Note: arbiter firmware is not running, cold restart\r\n");
+        return lgw_start();
+    }
+
+    /* firmwares and calibration are still in place, only reset the TX state */
+    lgw_abort_tx();
+    tx_gain_applied.valid = false;
+
+    DEBUG_MSG("Note: concentrator warm restart\r\n");
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_stop(void) {
     lgw_soft_reset();
     lgw_disconnect();
 
+    tx_gain_applied.valid = false;
+
     lgw_is_started = false;
     return LGW_HAL_SUCCESS;
 }
@@ -1310,74 +1701,60 @@ int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_send(struct lgw_pkt_tx_s pkt_data) {
-    int i, x;
-    uint8_t buff[256+TX_METADATA_NB]; /* buffer to prepare the packet to send + metadata before SPI write burst */
+int lgw_tx_prepare(struct lgw_pkt_tx_s *pkt_data, struct lgw_tx_desc_s *desc) {
     uint32_t part_int = 0; /* integer part for PLL register value calculation */
     uint32_t part_frac = 0; /* fractional part for PLL register value calculation */
     uint16_t fsk_dr_div; /* divider to configure for target datarate */
-    int transfer_size = 0; /* data to transfer from host to TX databuffer */
-    int payload_offset = 0; /* start of the payload content in the databuffer */
+    uint16_t preamble; /* preamble size actually sent */
     uint8_t pow_index = 0; /* 4-bit value to set the firmware TX power */
     uint8_t target_mix_gain = 0; /* used to select the proper I/Q offset correction */
-    uint32_t count_trig = 0; /* timestamp value in trigger mode corrected for TX start delay */
-    bool tx_allowed = false;
+    uint8_t *buff;
 
-    /* check if the concentrator is running */
-    if (lgw_is_started == false) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\r\n");
-        return LGW_HAL_ERROR;
-    }
+    /* check input variables */
+    CHECK_NULL(pkt_data);
+    CHECK_NULL(desc);
 
     /* check input range (segfault prevention) */
-    if (pkt_data.rf_chain >= LGW_RF_CHAIN_NB) {
+    if (pkt_data->rf_chain >= LGW_RF_CHAIN_NB) {
         DEBUG_MSG("ERROR: INVALID RF_CHAIN TO SEND PACKETS\r\n");
         return LGW_HAL_ERROR;
     }
 
     /* check input variables */
-    if (rf_tx_enable[pkt_data.rf_chain] == false) {
+    if (rf_tx_enable[pkt_data->rf_chain] == false) {
         DEBUG_MSG("ERROR: SELECTED RF_CHAIN IS DISABLED FOR TX ON SELECTED BOARD\r\n");
         return LGW_HAL_ERROR;
     }
-    if (rf_enable[pkt_data.rf_chain] == false) {
+    if (rf_enable[pkt_data->rf_chain] == false) {
         DEBUG_MSG("ERROR: SELECTED RF_CHAIN IS DISABLED\r\n");
         return LGW_HAL_ERROR;
     }
-    if (!IS_TX_MODE(pkt_data.tx_mode)) {
+    if (!IS_TX_MODE(pkt_data->tx_mode)) {
         DEBUG_MSG("ERROR: TX_MODE NOT SUPPORTED\r\n");
         return LGW_HAL_ERROR;
     }
-    if (pkt_data.modulation == MOD_LORA) {
-        if (!IS_LORA_BW(pkt_data.bandwidth)) {
+    if (pkt_data->modulation == MOD_LORA) {
+        if (!IS_LORA_BW(pkt_data->bandwidth)) {
             DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY LORA TX\r\n");
             return LGW_HAL_ERROR;
         }
-        if (!IS_LORA_STD_DR(pkt_data.datarate)) {
+        if (!IS_LORA_STD_DR(pkt_data->datarate)) {
             DEBUG_MSG("ERROR: DATARATE NOT SUPPORTED BY LORA TX\r\n");
             return LGW_HAL_ERROR;
         }
-        if (!IS_LORA_CR(pkt_data.coderate)) {
+        if (!IS_LORA_CR(pkt_data->coderate)) {
             DEBUG_MSG("ERROR: CODERATE NOT SUPPORTED BY LORA TX\r\n");
             return LGW_HAL_ERROR;
         }
-        if (pkt_data.size > 255) {
-            DEBUG_MSG("ERROR: PAYLOAD LENGTH TOO BIG FOR LORA TX\r\n");
-            return LGW_HAL_ERROR;
-        }
-    } else if (pkt_data.modulation == MOD_FSK) {
-        if((pkt_data.f_dev < 1) || (pkt_data.f_dev > 200)) {
+    } else if (pkt_data->modulation == MOD_FSK) {
+        if((pkt_data->f_dev < 1) || (pkt_data->f_dev > 200)) {
             DEBUG_MSG("ERROR: TX FREQUENCY DEVIATION OUT OF ACCEPTABLE RANGE\r\n");
             return LGW_HAL_ERROR;
         }
-        if(!IS_FSK_DR(pkt_data.datarate)) {
+        if(!IS_FSK_DR(pkt_data->datarate)) {
             DEBUG_MSG("ERROR: DATARATE NOT SUPPORTED BY FSK IF CHAIN\r\n");
             return LGW_HAL_ERROR;
         }
-        if (pkt_data.size > 255) {
-            DEBUG_MSG("ERROR: PAYLOAD LENGTH TOO BIG FOR FSK TX\r\n");
-            return LGW_HAL_ERROR;
-        }
     } else {
         DEBUG_MSG("ERROR: INVALID TX MODULATION\r\n");
         return LGW_HAL_ERROR;
@@ -1385,37 +1762,37 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
 
     /* interpretation of TX power */
     for (pow_index = txgain_lut.size-1; pow_index > 0; pow_index--) {
-        if (txgain_lut.lut[pow_index].rf_power <= pkt_data.rf_power) {
+        if (txgain_lut.lut[pow_index].rf_power <= pkt_data->rf_power) {
             break;
         }
     }
 
-    /* loading TX imbalance correction */
+    /* TX imbalance correction and digital gain to load before TX */
     target_mix_gain = txgain_lut.lut[pow_index].mix_gain;
-    if (pkt_data.rf_chain == 0) { /* use radio A calibration table */
-        lgw_reg_w(LGW_TX_OFFSET_I, cal_offset_a_i[target_mix_gain - 8]);
-        lgw_reg_w(LGW_TX_OFFSET_Q, cal_offset_a_q[target_mix_gain - 8]);
+    if (pkt_data->rf_chain == 0) { /* use radio A calibration table */
+        desc->offset_i = cal_offset_a_i[target_mix_gain - 8];
+        desc->offset_q = cal_offset_a_q[target_mix_gain - 8];
     } else { /* use radio B calibration table */
-        lgw_reg_w(LGW_TX_OFFSET_I, cal_offset_b_i[target_mix_gain - 8]);
-        lgw_reg_w(LGW_TX_OFFSET_Q, cal_offset_b_q[target_mix_gain - 8]);
+        desc->offset_i = cal_offset_b_i[target_mix_gain - 8];
+        desc->offset_q = cal_offset_b_q[target_mix_gain - 8];
     }
+    desc->dig_gain = txgain_lut.lut[pow_index].dig_gain;
 
-    /* Set digital gain from LUT */
-    lgw_reg_w(LGW_TX_GAIN, txgain_lut.lut[pow_index].dig_gain);
-
-    /* fixed metadata, useful payload and misc metadata compositing */
-    transfer_size = TX_METADATA_NB + pkt_data.size; /*  */
-    payload_offset = TX_METADATA_NB; /* start the payload just after the metadata */
+    desc->tx_mode = pkt_data->tx_mode;
+    desc->modulation = pkt_data->modulation;
+    desc->header_size = TX_METADATA_NB; /* the payload starts just after the metadata */
+    buff = desc->header;
+    memset(buff, 0, sizeof(desc->header));
 
     /* metadata 0 to 2, TX PLL frequency */
     switch (rf_radio_type[0]) { /* we assume that there is only one radio type on the board */
         case LGW_RADIO_TYPE_SX1255:
-            part_int = pkt_data.freq_hz / (SX125x_32MHz_FRAC << 7); /* integer part, gives the MSB */
-            part_frac = ((pkt_data.freq_hz % (SX125x_32MHz_FRAC << 7)) << 9) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
+            part_int = pkt_data->freq_hz / (SX125x_32MHz_FRAC << 7); /* integer part, gives the MSB */
+            part_frac = ((pkt_data->freq_hz % (SX125x_32MHz_FRAC << 7)) << 9) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
             break;
         case LGW_RADIO_TYPE_SX1257:
-            part_int = pkt_data.freq_hz / (SX125x_32MHz_FRAC << 8); /* integer part, gives the MSB */
-            part_frac = ((pkt_data.freq_hz % (SX125x_32MHz_FRAC << 8)) << 8) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
+            part_int = pkt_data->freq_hz / (SX125x_32MHz_FRAC << 8); /* integer part, gives the MSB */
+            part_frac = ((pkt_data->freq_hz % (SX125x_32MHz_FRAC << 8)) << 8) / SX125x_32MHz_FRAC; /* fractional part, gives middle part and LSB */
             break;
         default:
             DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d FOR RADIO TYPE\r\n", rf_radio_type[0]);
@@ -1426,76 +1803,67 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
     buff[1] = 0xFF & (part_frac >> 8); /* middle byte */
     buff[2] = 0xFF & part_frac; /* Least Significant Byte */
 
-    /* metadata 3 to 6, timestamp trigger value */
-    /* TX state machine must be triggered at T0 - TX_START_DELAY for packet to start being emitted at T0 */
-    if (pkt_data.tx_mode == TIMESTAMPED)
-    {
-        count_trig = pkt_data.count_us - TX_START_DELAY;
-        buff[3] = 0xFF & (count_trig >> 24);
-        buff[4] = 0xFF & (count_trig >> 16);
-        buff[5] = 0xFF & (count_trig >> 8);
-        buff[6] = 0xFF &  count_trig;
-    }
+    /* metadata 3 to 6, timestamp trigger value, filled for each packet */
 
     /* parameters depending on modulation  */
-    if (pkt_data.modulation == MOD_LORA) {
+    if (pkt_data->modulation == MOD_LORA) {
         /* metadata 7, modulation type, radio chain selection and TX power */
-        buff[7] = (0x20 & (pkt_data.rf_chain << 5)) | (0x0F & pow_index); /* bit 4 is 0 -> LoRa modulation */
+        buff[7] = (0x20 & (pkt_data->rf_chain << 5)) | (0x0F & pow_index); /* bit 4 is 0 -> LoRa modulation */
 
         buff[8] = 0; /* metadata 8, not used */
 
         /* metadata 9, CRC, LoRa CR & SF */
-        switch (pkt_data.datarate) {
+        switch (pkt_data->datarate) {
             case DR_LORA_SF7: buff[9] = 7; break;
             case DR_LORA_SF8: buff[9] = 8; break;
             case DR_LORA_SF9: buff[9] = 9; break;
             case DR_LORA_SF10: buff[9] = 10; break;
             case DR_LORA_SF11: buff[9] = 11; break;
             case DR_LORA_SF12: buff[9] = 12; break;
-            default: DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data.datarate);
+            default: DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data->datarate);
         }
-        switch (pkt_data.coderate) {
+        switch (pkt_data->coderate) {
             case CR_LORA_4_5: buff[9] |= 1 << 4; break;
             case CR_LORA_4_6: buff[9] |= 2 << 4; break;
             case CR_LORA_4_7: buff[9] |= 3 << 4; break;
             case CR_LORA_4_8: buff[9] |= 4 << 4; break;
-            default: DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data.coderate);
+            default: DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data->coderate);
         }
-        if (pkt_data.no_crc == false) {
+        if (pkt_data->no_crc == false) {
             buff[9] |= 0x80; /* set 'CRC enable' bit */
         } else {
             DEBUG_MSG("Info: packet will be sent without CRC\r\n");
         }
 
-        /* metadata 10, payload size */
-        buff[10] = pkt_data.size;
+        /* metadata 10, payload size, filled for each packet */
 
         /* metadata 11, implicit header, modulation bandwidth, PPM offset & polarity */
-        switch (pkt_data.bandwidth) {
+        switch (pkt_data->bandwidth) {
             case BW_125KHZ: buff[11] = 0; break;
             case BW_250KHZ: buff[11] = 1; break;
             case BW_500KHZ: buff[11] = 2; break;
-            default: DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data.bandwidth);
+            default: DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data->bandwidth);
         }
-        if (pkt_data.no_header == true) {
+        if (pkt_data->no_header == true) {
             buff[11] |= 0x04; /* set 'implicit header' bit */
         }
-        if (SET_PPM_ON(pkt_data.bandwidth,pkt_data.datarate)) {
+        if (SET_PPM_ON(pkt_data->bandwidth,pkt_data->datarate)) {
             buff[11] |= 0x08; /* set 'PPM offset' bit at 1 */
         }
-        if (pkt_data.invert_pol == true) {
+        if (pkt_data->invert_pol == true) {
             buff[11] |= 0x10; /* set 'TX polarity' bit at 1 */
         }
 
         /* metadata 12 & 13, LoRa preamble size */
-        if (pkt_data.preamble == 0) { /* if not explicit, use recommended LoRa preamble size */
-            pkt_data.preamble = STD_LORA_PREAMBLE;
-        } else if (pkt_data.preamble < MIN_LORA_PREAMBLE) { /* enforce minimum preamble size */
-            pkt_data.preamble = MIN_LORA_PREAMBLE;
+        preamble = pkt_data->preamble;
+        if (preamble == 0) { /* if not explicit, use recommended LoRa preamble size */
+            preamble = STD_LORA_PREAMBLE;
+        } else if (preamble < MIN_LORA_PREAMBLE) { /* enforce minimum preamble size */
+            preamble = MIN_LORA_PREAMBLE;
             DEBUG_MSG("Note: preamble length adjusted to respect minimum LoRa preamble size\r\n");
         }
-        buff[12] = 0xFF & (pkt_data.preamble >> 8);
-        buff[13] = 0xFF & pkt_data.preamble;
+        buff[12] = 0xFF & (preamble >> 8);
+        buff[13] = 0xFF & preamble;
 
         /* metadata 14 & 15, not used */
         buff[14] = 0;
@@ -1503,97 +1871,108 @@ int lgw_send(struct lgw_pkt_tx_s pkt_data) {
 
         /* MSB of RF frequency is now used in AGC firmware to implement large/narrow filtering in SX1257/55 */
         buff[0] &= 0x3F; /* Unset 2 MSBs of frequency code */
-        if (pkt_data.bandwidth == BW_500KHZ) {
+        if (pkt_data->bandwidth == BW_500KHZ) {
             buff[0] |= 0x80; /* Set MSB bit to enlarge analog filter for 500kHz BW */
         }
-        else if (pkt_data.bandwidth == BW_125KHZ){
+        else if (pkt_data->bandwidth == BW_125KHZ){
             buff[0] |= 0x40; /* Set MSB-1 bit to enable digital filter for 125kHz BW */
         }
 
-    } else if (pkt_data.modulation == MOD_FSK) {
+    } else {
         /* metadata 7, modulation type, radio chain selection and TX power */
-        buff[7] = (0x20 & (pkt_data.rf_chain << 5)) | 0x10 | (0x0F & pow_index); /* bit 4 is 1 -> FSK modulation */
+        buff[7] = (0x20 & (pkt_data->rf_chain << 5)) | 0x10 | (0x0F & pow_index); /* bit 4 is 1 -> FSK modulation */
 
         buff[8] = 0; /* metadata 8, not used */
 
         /* metadata 9, frequency deviation */
-        buff[9] = pkt_data.f_dev;
+        buff[9] = pkt_data->f_dev;
 
-        /* metadata 10, payload size */
-        buff[10] = pkt_data.size;
+        /* metadata 10, payload size, filled for each packet */
         /* TODO: how to handle 255 bytes packets ?!? */
 
         /* metadata 11, packet mode, CRC, encoding */
-        buff[11] = 0x01 | (pkt_data.no_crc?0:0x02) | (0x02 << 2); /* always in variable length packet mode, whitening, and CCITT CRC if CRC is not disabled  */
+        buff[11] = 0x01 | (pkt_data->no_crc?0:0x02) | (0x02 << 2); /* always in variable length packet mode, whitening, and CCITT CRC if CRC is not disabled  */
 
         /* metadata 12 & 13, FSK preamble size */
-        if (pkt_data.preamble == 0) { /* if not explicit, use LoRa MAC preamble size */
-            pkt_data.preamble = STD_FSK_PREAMBLE;
-        } else if (pkt_data.preamble < MIN_FSK_PREAMBLE) { /* enforce minimum preamble size */
-            pkt_data.preamble = MIN_FSK_PREAMBLE;
+        preamble = pkt_data->preamble;
+        if (preamble == 0) { /* if not explicit, use LoRa MAC preamble size */
+            preamble = STD_FSK_PREAMBLE;
+        } else if (preamble < MIN_FSK_PREAMBLE) { /* enforce minimum preamble size */
+            preamble = MIN_FSK_PREAMBLE;
             DEBUG_MSG("Note: preamble length adjusted to respect minimum FSK preamble size\r\n");
         }
-        buff[12] = 0xFF & (pkt_data.preamble >> 8);
-        buff[13] = 0xFF & pkt_data.preamble;
+        buff[12] = 0xFF & (preamble >> 8);
+        buff[13] = 0xFF & preamble;
 
         /* metadata 14 & 15, FSK baudrate */
-        fsk_dr_div = (uint16_t)((uint32_t)LGW_XTAL_FREQU / pkt_data.datarate); /* Ok for datarate between 500bps and 250kbps */
+        fsk_dr_div = (uint16_t)((uint32_t)LGW_XTAL_FREQU / pkt_data->datarate); /* Ok for datarate between 500bps and 250kbps */
         buff[14] = 0xFF & (fsk_dr_div >> 8);
         buff[15] = 0xFF & fsk_dr_div;
 
-        /* insert payload size in the packet for variable mode */
-        buff[16] = pkt_data.size;
-        ++transfer_size; /* one more byte to transfer to the TX modem */
-        ++payload_offset; /* start the payload with one more byte of offset */
+        /* payload size inserted in the packet for variable mode, filled for each packet */
+        ++desc->header_size; /* start the payload with one more byte of offset */
 
         /* MSB of RF frequency is now used in AGC firmware to implement large/narrow filtering in SX1257/55 */
         buff[0] &= 0x7F; /* Always use narrow band for FSK (force MSB to 0) */
+    }
 
-    } else {
-        DEBUG_MSG("ERROR: INVALID TX MODULATION..\r\n");
+    desc->generation = tx_desc_generation;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_tx_is_prepared(struct lgw_tx_desc_s *desc) {
+
+    return ((desc != NULL) && (desc->generation == tx_desc_generation)) ? 1 : 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_send(struct lgw_pkt_tx_s pkt_data) {
+    struct lgw_tx_desc_s desc;
+
+    /* check if the concentrator is running */
+    if (lgw_is_started == false) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\r\n");
         return LGW_HAL_ERROR;
     }
 
-    /* copy payload from user struct to buffer containing metadata */
-    memcpy((void *)(buff + payload_offset), (void *)(pkt_data.payload), pkt_data.size);
+    if (lgw_tx_prepare(&pkt_data, &desc) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
 
-    /* reset TX command flags */
-    lgw_abort_tx();
+    return tx_commit(&desc, pkt_data.count_us, pkt_data.payload, pkt_data.size, &pkt_data);
+}
 
-    /* put metadata + payload in the TX data buffer */
-    lgw_reg_w(LGW_TX_DATA_BUF_ADDR, 0);
-    lgw_reg_wb(LGW_TX_DATA_BUF_DATA, buff, transfer_size);
-    DEBUG_ARRAY(i, transfer_size, buff);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    x = lbt_is_channel_free(&pkt_data, &tx_allowed);
-    if (x != LGW_LBT_SUCCESS) {
-        DEBUG_MSG("ERROR: Failed to check channel availability for TX\r\n");
+int lgw_send_prepared(struct lgw_tx_desc_s *desc, uint32_t count_us, uint8_t *payload, uint16_t size) {
+
+    /* check input variables */
+    CHECK_NULL(desc);
+    CHECK_NULL(payload);
+
+    /* check if the concentrator is running */
+    if (lgw_is_started == false) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS NOT RUNNING, START IT BEFORE SENDING\r\n");
         return LGW_HAL_ERROR;
     }
-    if (tx_allowed == true) {
-        switch(pkt_data.tx_mode) {
-            case IMMEDIATE:
-                lgw_reg_w(LGW_TX_TRIG_IMMEDIATE, 1);
-                break;
-
-            case TIMESTAMPED:
-                lgw_reg_w(LGW_TX_TRIG_DELAYED, 1);
-                break;
 
-            case ON_GPS:
-                lgw_reg_w(LGW_TX_TRIG_GPS, 1);
-                break;
+    /* descriptor must match the current calibration & TX gain configuration */
+    if (desc->generation != tx_desc_generation) {
+        DEBUG_MSG("ERROR: TX DESCRIPTOR IS OUTDATED, PREPARE IT AGAIN\r\n");
+        return LGW_HAL_ERROR;
+    }
 
-            default:
-                DEBUG_PRINTF("ERROR: UNEXPECTED VALUE %d IN SWITCH STATEMENT\r\n", pkt_data.tx_mode);
-                return LGW_HAL_ERROR;
-        }
-    } else {
-        DEBUG_MSG("ERROR: Cannot send packet, channel is busy (LBT)\r\n");
-        return LGW_LBT_ISSUE;
+    /* LBT needs the full packet description, use lgw_send instead */
+    if (lbt_is_enabled() == true) {
+        DEBUG_MSG("ERROR: PREPARED TX NOT SUPPORTED WITH LBT\r\n");
+        return LGW_HAL_ERROR;
     }
 
-    return LGW_HAL_SUCCESS;
+    return tx_commit(desc, count_us, payload, size, NULL);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -23,6 +23,9 @@ Maintainer: Sylvain Miermont
  * 2017/2/10 by sue
  * Change platform from linux to uc/OS on cortex-M3(stm32xx or gd32xx).
  *
+ * 2017/6/12 by Test
+ * Burst chunking is configurable by LGW_BURST_CHUNK, no chunking by default.
+ *
  *
  ******************************************************************************
  */
@@ -56,6 +59,12 @@ Maintainer: Sylvain Miermont
 #define READ_ACCESS     0x00
 #define WRITE_ACCESS    0x80
 
+#if LGW_BURST_CHUNK > 0
+    #define BURST_CHUNK_SIZE(to_do)     (((to_do) < LGW_BURST_CHUNK) ? (to_do) : LGW_BURST_CHUNK)
+#else
+    #define BURST_CHUNK_SIZE(to_do)     (to_do)
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -143,9 +152,9 @@ int lgw_spi_r(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, ui
 int lgw_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
 
     rt_device_t dev_id;
-    int size_to_do, chunk_size, offset;
+    int size_to_do, chunk_size;
+    int offset = 0;
     int byte_transfered = 0;
-    int i;
     
     /* check input parameters */
     CHECK_NULL(spi_target);
@@ -161,12 +170,12 @@ int lgw_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, u
     dev_id = *(rt_device_t *)spi_target; /* must check that spi_target is not null beforehand */
 
     size_to_do = size; 
-    for (i=0; size_to_do > 0; ++i) {
-        chunk_size = (size_to_do < LGW_BURST_CHUNK) ? size_to_do : LGW_BURST_CHUNK;
-        offset = i * LGW_BURST_CHUNK;
+    while (size_to_do > 0) {
+        chunk_size = BURST_CHUNK_SIZE(size_to_do);
         byte_transfered += rt_device_write(dev_id, (WRITE_ACCESS | (address & 0x7F)), (data + offset), chunk_size);
         DEBUG_PRINTF("BURST WRITE: to trans %d # chunk %d # transferred %d \n", size_to_do, chunk_size, byte_transfered);
         size_to_do -= chunk_size; /* subtract the quantity of data already transferred */
+        offset += chunk_size;
     }
     
     /* determine return code */
@@ -185,9 +194,9 @@ int lgw_spi_wb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, u
 int lgw_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, uint8_t address, uint8_t *data, uint16_t size) {
 
     rt_device_t dev_id;
-    int size_to_do, chunk_size, offset;
+    int size_to_do, chunk_size;
+    int offset = 0;
     int byte_transfered = 0;
-    int i;
     
     /* check input parameters */
     CHECK_NULL(spi_target);
@@ -203,12 +212,12 @@ int lgw_spi_rb(void *spi_target, uint8_t spi_mux_mode, uint8_t spi_mux_target, u
     dev_id = *(rt_device_t *)spi_target; /* must check that spi_target is not null beforehand */
 
     size_to_do = size;    
-    for (i=0; size_to_do > 0; ++i) {
-        chunk_size = (size_to_do < LGW_BURST_CHUNK) ? size_to_do : LGW_BURST_CHUNK;
-        offset = i * LGW_BURST_CHUNK;
+    while (size_to_do > 0) {
+        chunk_size = BURST_CHUNK_SIZE(size_to_do);
         byte_transfered += rt_device_read(dev_id, (READ_ACCESS | (address & 0x7F)), (data + offset), chunk_size);
         DEBUG_PRINTF("BURST WRITE: to trans %d # chunk %d # transferred %d \n", size_to_do, chunk_size, byte_transfered);
         size_to_do -= chunk_size; /* subtract the quantity of data already transferred */
+        offset += chunk_size;
     }
     
     /* determine return code */
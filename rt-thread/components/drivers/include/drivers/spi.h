@@ -20,6 +20,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2012-11-23     Bernard      Add extern "C"
+ * 2017-06-12     Test         Add rt_spi_transfer_chain
  */
 
 #ifndef __SPI_H__
@@ -212,6 +213,19 @@ rt_size_t rt_spi_transfer(struct rt_spi_device *device,
 struct rt_spi_message *rt_spi_transfer_message(struct rt_spi_device  *device,
                                                struct rt_spi_message *message);
 
+/**
+ * This function transfers a message list to the SPI device as one transaction:
+ * the bus lock is taken once and CS stays asserted from the first message to
+ * the last one. The cs_take/cs_release flags of the list are overwritten.
+ *
+ * @param device the SPI device attached to SPI bus
+ * @param message the message list to be transmitted to SPI device
+ *
+ * @return the total length of the transmitted messages.
+ */
+rt_size_t rt_spi_transfer_chain(struct rt_spi_device  *device,
+                                struct rt_spi_message *message);
+
 rt_inline rt_size_t rt_spi_recv(struct rt_spi_device *device,
                                 void                 *recv_buf,
                                 rt_size_t             length)
@@ -25,6 +25,9 @@
  * 2012-05-18     bernard      Changed SPI message to message list.
  *                             Added take/release SPI device/bus interface.
  * 2012-09-28     aozima       fixed rt_spi_release_bus assert error.
+ * 2017-06-12     Test         add rt_spi_transfer_chain, one lock and one CS
+ *                             window for a whole message list.
+ * 2017-06-29     Test         rt_spi_transfer_chain uses rt_spi_transfer_message.
  */
 
 #include <drivers/spi.h>
@@ -386,6 +389,47 @@ __exit:
     return index;
 }
 
+rt_size_t rt_spi_transfer_chain(struct rt_spi_device  *device,
+                                struct rt_spi_message *message)
+{
+    rt_size_t length = 0;
+    struct rt_spi_message *index;
+    struct rt_spi_message *failed;
+
+    RT_ASSERT(device != RT_NULL);
+    RT_ASSERT(device->bus != RT_NULL);
+
+    if (message == RT_NULL)
+        return 0;
+
+    /* CS is taken by the first message and released by the last one only */
+    for (index = message; index != RT_NULL; index = index->next)
+    {
+        index->cs_take    = (index == message) ? 1 : 0;
+        index->cs_release = (index->next == RT_NULL) ? 1 : 0;
+    }
+
+    /* hold the bus over the list and the CS release of a failed one, the
+     * bus lock is taken again by rt_spi_transfer_message */
+    if (rt_spi_take_bus(device) != RT_EOK)
+        return 0;
+
+    failed = rt_spi_transfer_message(device, message);
+
+    /* do not leave the device selected */
+    if (failed != RT_NULL && failed->next != RT_NULL)
+        rt_spi_release(device);
+
+    for (index = message; index != failed; index = index->next)
+    {
+        length += index->length;
+    }
+
+    rt_spi_release_bus(device);
+
+    return length;
+}
+
 rt_err_t rt_spi_take_bus(struct rt_spi_device *device)
 {
     rt_err_t result = RT_EOK;
@@ -167,11 +167,9 @@ static void lwiperf_tcp_err(void *arg, err_t err);
 static void
 lwiperf_list_add(lwiperf_state_base_t* item)
 {
-  if (lwiperf_all_connections == NULL) {
-    lwiperf_all_connections = item;
-  } else {
-    item = lwiperf_all_connections;
-  }
+  /* the old code only kept the first session, later ones could not be aborted */
+  item->next = lwiperf_all_connections;
+  lwiperf_all_connections = item;
 }
 
 /** Remove an iperf session from the 'active' list */
@@ -185,7 +183,7 @@ lwiperf_list_remove(lwiperf_state_base_t* item)
       if (prev == NULL) {
         lwiperf_all_connections = iter->next;
       } else {
-        prev->next = item;
+        prev->next = iter->next;
       }
       /* @debug: ensure this item is listed only once */
       for (iter = iter->next; iter != NULL; iter = iter->next) {
@@ -209,10 +207,16 @@ lwip_tcp_conn_report(lwiperf_state_tcp_t* conn, enum lwiperf_report_type report_
     } else {
       bandwidth_kbitpsec = (conn->bytes_transferred / duration_ms) * 8U;
     }
-    conn->report_fn(conn->report_arg, report_type,
-      &conn->conn_pcb->local_ip, conn->conn_pcb->local_port,
-      &conn->conn_pcb->remote_ip, conn->conn_pcb->remote_port,
-      conn->bytes_transferred, duration_ms, bandwidth_kbitpsec);
+    if (conn->conn_pcb != NULL) {
+      conn->report_fn(conn->report_arg, report_type,
+        &conn->conn_pcb->local_ip, conn->conn_pcb->local_port,
+        &conn->conn_pcb->remote_ip, conn->conn_pcb->remote_port,
+        conn->bytes_transferred, duration_ms, bandwidth_kbitpsec);
+    } else {
+      /* pcb freed by an error */
+      conn->report_fn(conn->report_arg, report_type, NULL, 0, NULL, 0,
+        conn->bytes_transferred, duration_ms, bandwidth_kbitpsec);
+    }
   }
 }
 
@@ -235,10 +239,10 @@ lwiperf_tcp_close(lwiperf_state_tcp_t* conn, enum lwiperf_report_type report_typ
       /* don't want to wait for free memory here... */
       tcp_abort(conn->conn_pcb);
     }
-  } else {
+  } else if (conn->server_pcb != NULL) {
     /* no conn pcb, this is the server pcb */
     err = tcp_close(conn->server_pcb);
-    LWIP_ASSERT("error", err != ERR_OK);
+    LWIP_ASSERT("error", err == ERR_OK);
   }
   LWIPERF_FREE(lwiperf_state_tcp_t, conn);
 }
@@ -273,7 +277,7 @@ lwiperf_tcp_client_send_more(lwiperf_state_tcp_t* conn)
       /* this session is byte-limited */
       u32_t amount_bytes = lwip_htonl(conn->settings.amount);
       /* @todo: this can send up to 1*MSS more than requested... */
-      if (amount_bytes >= conn->bytes_transferred) {
+      if (conn->bytes_transferred >= amount_bytes) {
         /* all requested bytes transferred -> close the connection */
         lwiperf_tcp_close(conn, LWIPERF_TCP_DONE_CLIENT);
         return ERR_OK;
@@ -432,40 +436,36 @@ lwiperf_tcp_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
 
   conn->poll_count = 0;
 
-  if ((!conn->have_settings_buf) || ((conn->bytes_transferred -24) % (1024*128) == 0)) {
+  /* the header is only read at the start. iperf 2 repeats it every 128 KB it
+     writes and the lwiperf client sends it twice, the copies count as data.
+     checking it again at segments starting 128 KB on failed on data there. */
+  if (!conn->have_settings_buf) {
     /* wait for 24-byte header */
     if (p->tot_len < sizeof(lwiperf_settings_t)) {
       lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL_DATAERROR);
       pbuf_free(p);
       return ERR_VAL;
     }
-    if (!conn->have_settings_buf) {
-      if (pbuf_copy_partial(p, &conn->settings, sizeof(lwiperf_settings_t), 0) != sizeof(lwiperf_settings_t)) {
-        lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL);
-        pbuf_free(p);
-        return ERR_VAL;
-      }
-      conn->have_settings_buf = 1;
-      if ((conn->settings.flags & PP_HTONL(LWIPERF_FLAGS_ANSWER_TEST|LWIPERF_FLAGS_ANSWER_NOW)) ==
-        PP_HTONL(LWIPERF_FLAGS_ANSWER_TEST|LWIPERF_FLAGS_ANSWER_NOW)) {
-          /* client requested parallel transmission test */
-          err_t err2 = lwiperf_tx_start(conn);
-          if (err2 != ERR_OK) {
-            lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL_TXERROR);
-            pbuf_free(p);
-            return err2;
-          }
-      }
-    } else {
-      if (pbuf_memcmp(p, 0, &conn->settings, sizeof(lwiperf_settings_t)) != 0) {
-        lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL_DATAERROR);
-        pbuf_free(p);
-        return ERR_VAL;
-      }
+    if (pbuf_copy_partial(p, &conn->settings, sizeof(lwiperf_settings_t), 0) != sizeof(lwiperf_settings_t)) {
+      lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL);
+      pbuf_free(p);
+      return ERR_VAL;
+    }
+    conn->have_settings_buf = 1;
+    if ((conn->settings.flags & PP_HTONL(LWIPERF_FLAGS_ANSWER_TEST|LWIPERF_FLAGS_ANSWER_NOW)) ==
+      PP_HTONL(LWIPERF_FLAGS_ANSWER_TEST|LWIPERF_FLAGS_ANSWER_NOW)) {
+        /* client requested parallel transmission test */
+        err_t err2 = lwiperf_tx_start(conn);
+        if (err2 != ERR_OK) {
+          lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL_TXERROR);
+          pbuf_free(p);
+          return err2;
+        }
     }
     conn->bytes_transferred += sizeof(lwiperf_settings_t);
-    if (conn->bytes_transferred <= 24) {
-      conn->time_started = sys_now();
+    conn->time_started = sys_now();
+    /* data after the header in the same segment is counted below */
+    if (p->tot_len == sizeof(lwiperf_settings_t)) {
       tcp_recved(tpcb, p->tot_len);
       pbuf_free(p);
       return ERR_OK;
@@ -510,6 +510,9 @@ lwiperf_tcp_err(void *arg, err_t err)
 {
   lwiperf_state_tcp_t* conn = (lwiperf_state_tcp_t*)arg;
   LWIP_UNUSED_ARG(err);
+  /* pcb is freed already, server pcb is the listener of a server session */
+  conn->conn_pcb = NULL;
+  conn->server_pcb = NULL;
   lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_REMOTE);
 }
 
@@ -636,7 +639,68 @@ lwiperf_start_tcp_server(const ip_addr_t* local_addr, u16_t local_port,
 
 /**
  * @ingroup iperf
- * Abort an iperf session (handle returned by lwiperf_start_tcp_server*())
+ * Start a TCP iperf client to a specific IP address and port, sending for
+ * the given time. The remote side must run an iperf server.
+ *
+ * @returns a connection handle that can be used to abort the client
+ *          by calling @ref lwiperf_abort()
+ */
+void*
+lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
+  u32_t duration_sec, lwiperf_report_fn report_fn, void* report_arg)
+{
+  err_t err;
+  struct tcp_pcb* pcb;
+  lwiperf_state_tcp_t* conn;
+
+  if ((remote_addr == NULL) || (duration_sec == 0)) {
+    return NULL;
+  }
+
+  conn = (lwiperf_state_tcp_t*)LWIPERF_ALLOC(lwiperf_state_tcp_t);
+  if (conn == NULL) {
+    return NULL;
+  }
+  pcb = tcp_new();
+  if (pcb == NULL) {
+    LWIPERF_FREE(lwiperf_state_tcp_t, conn);
+    return NULL;
+  }
+
+  memset(conn, 0, sizeof(lwiperf_state_tcp_t));
+  conn->base.tcp = 1;
+  conn->base.server = 0;
+  conn->conn_pcb = pcb;
+  conn->time_started = sys_now();
+  conn->report_fn = report_fn;
+  conn->report_arg = report_arg;
+  conn->next_num = 4; /* initial nr is '4' since the header has 24 byte */
+  conn->settings.num_threads = PP_HTONL(1);
+  conn->settings.remote_port = PP_HTONL(LWIPERF_TCP_PORT_DEFAULT);
+  /* negative amount: time in 10ms units */
+  conn->settings.amount = lwip_htonl((u32_t)-(s32_t)(duration_sec * 100));
+
+  tcp_arg(pcb, conn);
+  tcp_sent(pcb, lwiperf_tcp_client_sent);
+  tcp_poll(pcb, lwiperf_tcp_poll, 2U);
+  tcp_err(pcb, lwiperf_tcp_err);
+
+  err = tcp_connect(pcb, remote_addr, remote_port, lwiperf_tcp_client_connected);
+  if (err != ERR_OK) {
+    tcp_arg(pcb, NULL);
+    tcp_err(pcb, NULL);
+    tcp_abort(pcb);
+    LWIPERF_FREE(lwiperf_state_tcp_t, conn);
+    return NULL;
+  }
+  lwiperf_list_add(&conn->base);
+  return conn;
+}
+
+/**
+ * @ingroup iperf
+ * Abort an iperf session (handle returned by lwiperf_start_tcp_server*() or
+ * lwiperf_start_tcp_client()), no report is given.
  */
 void
 lwiperf_abort(void* lwiperf_session)
@@ -649,6 +713,23 @@ lwiperf_abort(void* lwiperf_session)
       i = i->next;
       if (last != NULL) {
         last->next = i;
+      } else {
+        lwiperf_all_connections = i;
+      }
+      if (dealloc->tcp) {
+        /* pcbs must not call back into the freed state */
+        lwiperf_state_tcp_t* conn = (lwiperf_state_tcp_t*)dealloc;
+        if (conn->conn_pcb != NULL) {
+          tcp_arg(conn->conn_pcb, NULL);
+          tcp_poll(conn->conn_pcb, NULL, 0);
+          tcp_sent(conn->conn_pcb, NULL);
+          tcp_recv(conn->conn_pcb, NULL);
+          tcp_err(conn->conn_pcb, NULL);
+          tcp_abort(conn->conn_pcb);
+        } else if (conn->server_pcb != NULL) {
+          tcp_arg(conn->server_pcb, NULL);
+          tcp_close(conn->server_pcb);
+        }
       }
       LWIPERF_FREE(lwiperf_state_tcp_t, dealloc); /* @todo: type? */
     } else {
@@ -0,0 +1,213 @@
+/*
+ * File      : chksum.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-06-29     Test         first version, LWIP_CHKSUM and LWIP_CHKSUM_COPY
+ *                             by 32-bit words for Cortex-M3
+ */
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+
+/*
+ * Sum of 16-bit words in memory order, as lwip_standard_chksum(). 32-bit
+ * words are added into a 64-bit accumulator, an add with carry on Cortex-M3,
+ * the carries are folded at the end. An odd start address is summed from
+ * the next byte and the result swapped.
+ */
+
+/* fold a 64-bit sum of words to 16 bits */
+static u16_t chksum_fold(unsigned long long acc)
+{
+    u32_t sum;
+
+    acc = (acc >> 32) + (acc & 0xffffffffUL);
+    acc = (acc >> 32) + (acc & 0xffffffffUL);
+    sum = (u32_t)acc;
+    sum = FOLD_U32T(sum);
+    sum = FOLD_U32T(sum);
+
+    return (u16_t)sum;
+}
+
+/**
+ * Calculate checksum of data, used as LWIP_CHKSUM.
+ *
+ * @param dataptr points to start of data to be summed at any boundary
+ * @param len length of data to be summed
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+u16_t lwip_fast_chksum(const void *dataptr, int len)
+{
+    const u8_t  *pb = (const u8_t *)dataptr;
+    const u32_t *pw;
+    unsigned long long acc = 0;
+    u16_t t = 0;
+    int odd = ((mem_ptr_t)pb & 1);
+    u16_t sum;
+
+    /* first byte is the high byte of a word */
+    if (odd && len > 0)
+    {
+        ((u8_t *)&t)[1] = *pb++;
+        len--;
+        acc += t;
+    }
+    /* align to 32 bits */
+    if (((mem_ptr_t)pb & 2) && len >= 2)
+    {
+        acc += *(const u16_t *)pb;
+        pb  += 2;
+        len -= 2;
+    }
+
+    pw = (const u32_t *)pb;
+    while (len >= 32)
+    {
+        acc += pw[0];
+        acc += pw[1];
+        acc += pw[2];
+        acc += pw[3];
+        acc += pw[4];
+        acc += pw[5];
+        acc += pw[6];
+        acc += pw[7];
+        pw  += 8;
+        len -= 32;
+    }
+    while (len >= 4)
+    {
+        acc += *pw++;
+        len -= 4;
+    }
+
+    pb = (const u8_t *)pw;
+    if (len >= 2)
+    {
+        acc += *(const u16_t *)pb;
+        pb  += 2;
+        len -= 2;
+    }
+    /* last byte is the low byte of a word */
+    if (len > 0)
+    {
+        t = 0;
+        ((u8_t *)&t)[0] = *pb;
+        acc += t;
+    }
+
+    sum = chksum_fold(acc);
+    if (odd)
+    {
+        sum = SWAP_BYTES_IN_WORD(sum);
+    }
+
+    return sum;
+}
+
+#if LWIP_CHECKSUM_ON_COPY
+/**
+ * Copy data and calculate its checksum in one pass, used as
+ * LWIP_CHKSUM_COPY. words are copied when dst and src share alignment,
+ * other data is copied first and summed from dst.
+ *
+ * @param dst copy to
+ * @param src copy from
+ * @param len length of data
+ * @return host order (!) lwip checksum (non-inverted Internet sum)
+ */
+u16_t lwip_fast_chksum_copy(void *dst, const void *src, u16_t len)
+{
+    const u8_t  *sb = (const u8_t *)src;
+    u8_t        *db = (u8_t *)dst;
+    const u32_t *sw;
+    u32_t       *dw;
+    unsigned long long acc = 0;
+    u16_t t = 0;
+    int odd = ((mem_ptr_t)sb & 1);
+    u16_t sum;
+
+    if ((((mem_ptr_t)sb ^ (mem_ptr_t)db) & 3) != 0)
+    {
+        MEMCPY(dst, src, len);
+        return lwip_fast_chksum(dst, len);
+    }
+
+    if (odd && len > 0)
+    {
+        ((u8_t *)&t)[1] = *db++ = *sb++;
+        len--;
+        acc += t;
+    }
+    if (((mem_ptr_t)sb & 2) && len >= 2)
+    {
+        t = *(const u16_t *)sb;
+        *(u16_t *)db = t;
+        acc += t;
+        sb  += 2;
+        db  += 2;
+        len -= 2;
+    }
+
+    sw = (const u32_t *)sb;
+    dw = (u32_t *)db;
+    while (len >= 16)
+    {
+        u32_t w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+
+        dw[0] = w0;
+        dw[1] = w1;
+        dw[2] = w2;
+        dw[3] = w3;
+        acc += w0;
+        acc += w1;
+        acc += w2;
+        acc += w3;
+        sw  += 4;
+        dw  += 4;
+        len -= 16;
+    }
+    while (len >= 4)
+    {
+        u32_t w = *sw++;
+
+        *dw++ = w;
+        acc += w;
+        len -= 4;
+    }
+
+    sb = (const u8_t *)sw;
+    db = (u8_t *)dw;
+    if (len >= 2)
+    {
+        t = *(const u16_t *)sb;
+        *(u16_t *)db = t;
+        acc += t;
+        sb  += 2;
+        db  += 2;
+        len -= 2;
+    }
+    if (len > 0)
+    {
+        t = 0;
+        ((u8_t *)&t)[0] = *db = *sb;
+        acc += t;
+    }
+
+    sum = chksum_fold(acc);
+    if (odd)
+    {
+        sum = SWAP_BYTES_IN_WORD(sum);
+    }
+
+    return sum;
+}
+#endif /* LWIP_CHECKSUM_ON_COPY */
@@ -97,6 +97,12 @@ void sys_arch_assert(const char* file, int line);
 
 #include "string.h"
 
+/* checksum by 32-bit words, in arch/chksum.c */
+#define LWIP_CHKSUM                     lwip_fast_chksum
+#define LWIP_CHKSUM_COPY(dst, src, len) lwip_fast_chksum_copy(dst, src, len)
+rt_uint16_t lwip_fast_chksum(const void *dataptr, int len);
+rt_uint16_t lwip_fast_chksum_copy(void *dst, const void *src, rt_uint16_t len);
+
 #define SYS_ARCH_DECL_PROTECT(level)	
 #define SYS_ARCH_PROTECT(level)		rt_enter_critical()
 #define SYS_ARCH_UNPROTECT(level) 	rt_exit_critical()
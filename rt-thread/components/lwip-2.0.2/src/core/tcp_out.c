@@ -1404,8 +1404,12 @@ tcp_rexmit_rto(struct tcp_pcb *pcb)
     return;
   }
 
-  /* Move all unacked segments to the head of the unsent queue */
-  for (seg = pcb->unacked; seg->next != NULL; seg = seg->next);
+  /* Move all unacked segments to the head of the unsent queue, all are
+     sent again and counted as tcp_rexmit counts its segment */
+  for (seg = pcb->unacked; seg->next != NULL; seg = seg->next) {
+    MIB2_STATS_INC(mib2.tcpretranssegs);
+  }
+  MIB2_STATS_INC(mib2.tcpretranssegs);
   /* concatenate unsent queue after unacked queue */
   seg->next = pcb->unsent;
 #if TCP_OVERSIZE_DBGCHECK
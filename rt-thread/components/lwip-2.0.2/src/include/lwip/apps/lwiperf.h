@@ -74,6 +74,8 @@ typedef void (*lwiperf_report_fn)(void *arg, enum lwiperf_report_type report_typ
 void* lwiperf_start_tcp_server(const ip_addr_t* local_addr, u16_t local_port,
                                lwiperf_report_fn report_fn, void* report_arg);
 void* lwiperf_start_tcp_server_default(lwiperf_report_fn report_fn, void* report_arg);
+void* lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
+                               u32_t duration_sec, lwiperf_report_fn report_fn, void* report_arg);
 void  lwiperf_abort(void* lwiperf_session);
 
 
@@ -5,6 +5,8 @@
 #include <rtthread.h>
 
 #define NIOCTL_GADDR		0x01
+#define NIOCTL_ADD_MCAST	0x02	/* args: multicast mac address to receive */
+#define NIOCTL_DEL_MCAST	0x03	/* args: multicast mac address to drop */
 #ifndef RT_LWIP_ETH_MTU
 #define ETHERNET_MTU		1500
 #else
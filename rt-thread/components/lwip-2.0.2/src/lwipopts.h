@@ -39,7 +39,9 @@
 #define LWIP_HAVE_LOOPIF            0
 
 #define LWIP_PLATFORM_BYTESWAP      0
+#ifndef BYTE_ORDER
 #define BYTE_ORDER                  LITTLE_ENDIAN
+#endif
 
 #ifdef RT_LWIP_DEBUG
 #define LWIP_DEBUG
@@ -292,15 +294,57 @@
 #define DEFAULT_RAW_RECVMBOX_SIZE   1
 #define DEFAULT_ACCEPTMBOX_SIZE     10
 
+/* ---------- Checksum options ---------- */
+/* RT_LWIP_USING_HW_CHECKSUM: MAC of the netif driver inserts IP/TCP/UDP/ICMP
+   checksums and drops received frames with bad ones (CHECKSUM_BY_HARDWARE).
+   the driver turns off software checksums of its netif only, lwip still
+   computes them for other netifs, or for all when the option is not set. */
+#ifdef RT_LWIP_USING_HW_CHECKSUM
+#define CHECKSUM_BY_HARDWARE            1
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+#else
+#define CHECKSUM_BY_HARDWARE            0
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    0
+#endif
+
+/* checksum of TCP/UDP data is calculated while copied from application
+   (LWIP_CHKSUM_COPY), not needed when MAC does it */
+#define LWIP_CHECKSUM_ON_COPY           (!CHECKSUM_BY_HARDWARE)
+
+/* ---------- Ethernet interface options ---------- */
+/* RT_LWIP_ETH_DIRECT_TX: tcpip thread calls eth_tx of the driver directly,
+   no eth tx thread and ack for each frame. driver must hold the pbuf until
+   sent, as the gd32 eth driver does with pbuf_ref for PBUF_RAM/PBUF_POOL and
+   a copy of PBUF_REF/PBUF_ROM. throughput against the tx thread is not
+   measured on target yet, compare with iperf (net_perf) before enabling. */
+#ifdef RT_LWIP_ETH_DIRECT_TX
+#define LWIP_NO_TX_THREAD
+#endif
+
+/* ---------- MQTT options ---------- */
+/* one publish of the state push with up to 32 records and its topic */
+#define MQTT_OUTPUT_RINGBUF_SIZE        512
+/* mqtt clients, each one takes a timeout when connected */
+#define MQTT_CLIENT_NUM                 1
+
+/* ---------- SNTP options ---------- */
+/* sntp disciplines the wall clock of application, which writes pcf8563 */
+#include <rtdef.h>
+extern void wall_clock_sntp_set(rt_uint32_t sec, rt_uint32_t us);
+#define SNTP_SET_SYSTEM_TIME_US(sec, us)    wall_clock_sntp_set(sec, us)
+#define SNTP_UPDATE_DELAY               3600000     /* 1 hour */
+
 /* ---------- Statistics options ---------- */
 #ifdef RT_LWIP_STATS
 #define LWIP_STATS                  1
 #define LWIP_STATS_DISPLAY          1
 #else
-#define LWIP_STATS                  0
+/* heap and pool usage only, read by net_stat of application */
+#define LWIP_STATS                  1
+#define LWIP_STATS_DISPLAY          0
 #endif
 
-#if LWIP_STATS
+#ifdef RT_LWIP_STATS
 #define LINK_STATS                  1
 #define IP_STATS                    1
 #define ICMP_STATS                  1
@@ -312,7 +356,22 @@
 #define MEMP_STATS                  1
 #define PBUF_STATS                  1
 #define SYS_STATS                   1
-#endif /* LWIP_STATS */
+#define MIB2_STATS                  1      /* tcp retransmits of net_perf */
+#else
+#define LINK_STATS                  0
+#define ETHARP_STATS                0
+#define IP_STATS                    0
+#define ICMP_STATS                  0
+#define IGMP_STATS                  0
+#define IPFRAG_STATS                0
+#define UDP_STATS                   0
+#define TCP_STATS                   0
+#define MEM_STATS                   1
+#define MEMP_STATS                  (MEMP_MEM_MALLOC == 0)
+#define PBUF_STATS                  0
+#define SYS_STATS                   0
+#define MIB2_STATS                  0
+#endif /* RT_LWIP_STATS */
 
 /* ---------- PPP options ---------- */
 #ifdef RT_LWIP_PPP
@@ -355,7 +414,7 @@
 #define LWIP_NETIF_API  1
 
 /* MEMP_NUM_SYS_TIMEOUT: the number of simulateously active timeouts. */
-#define MEMP_NUM_SYS_TIMEOUT       (LWIP_TCP + IP_REASSEMBLY + LWIP_ARP + (2*LWIP_DHCP) + LWIP_AUTOIP + LWIP_IGMP + LWIP_DNS + PPP_SUPPORT)
+#define MEMP_NUM_SYS_TIMEOUT       (LWIP_TCP + IP_REASSEMBLY + LWIP_ARP + (2*LWIP_DHCP) + LWIP_AUTOIP + LWIP_IGMP + LWIP_DNS + PPP_SUPPORT + MQTT_CLIENT_NUM + 1 /* sntp */)
 #ifdef LWIP_IGMP
 #include <stdlib.h>
 #define LWIP_RAND                  rand
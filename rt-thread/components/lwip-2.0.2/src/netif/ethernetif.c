@@ -16,6 +16,9 @@
  *                             after lwIP initialization.
  * 2013-02-28     aozima       fixed list_tcps bug: ipaddr_ntoa isn't reentrant.
  * 2016-08-18     Bernard      port to lwIP 2.0.0
+ * 2017-06-29     Test         tcpip thread calls eth_tx directly with
+ *                             RT_LWIP_ETH_DIRECT_TX, full ring is ERR_MEM.
+ * 2017-06-29     Test         igmp mac filter by NIOCTL_ADD_MCAST/DEL_MCAST.
  */
 
 /*
@@ -135,11 +138,18 @@ static err_t ethernetif_linkoutput(struct netif *netif, struct pbuf *p)
     }
 #else
     struct eth_device* enetif;
+    rt_err_t result;
 
     RT_ASSERT(netif != RT_NULL);
     enetif = (struct eth_device*)netif->state;
 
-    if (enetif->eth_tx(&(enetif->parent), p) != RT_EOK)
+    /* driver holds p until sent, returns -RT_EFULL when tx ring is full */
+    result = enetif->eth_tx(&(enetif->parent), p);
+    if (result == -RT_EFULL)
+    {
+        return ERR_MEM;
+    }
+    else if (result != RT_EOK)
     {
         return ERR_IF;
     }
@@ -147,6 +157,31 @@ static err_t ethernetif_linkoutput(struct netif *netif, struct pbuf *p)
     return ERR_OK;
 }
 
+#if LWIP_IGMP
+/* let the device receive frames of an igmp group, 01:00:5e + low 23 bits */
+static err_t ethernetif_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group,
+                                        enum netif_mac_filter_action action)
+{
+    rt_uint8_t mac[6];
+    rt_uint32_t addr;
+    rt_err_t result;
+
+    addr = lwip_ntohl(ip4_addr_get_u32(group));
+    mac[0] = 0x01;
+    mac[1] = 0x00;
+    mac[2] = 0x5e;
+    mac[3] = (addr >> 16) & 0x7f;
+    mac[4] = (addr >> 8) & 0xff;
+    mac[5] = addr & 0xff;
+
+    result = rt_device_control((rt_device_t)netif->state,
+                               (action == NETIF_ADD_MAC_FILTER) ? NIOCTL_ADD_MCAST : NIOCTL_DEL_MCAST,
+                               mac);
+
+    return (result == RT_EOK) ? ERR_OK : ERR_IF;
+}
+#endif /* LWIP_IGMP */
+
 static err_t eth_netif_device_init(struct netif *netif)
 {
     struct eth_device *ethif;
@@ -168,6 +203,11 @@ static err_t eth_netif_device_init(struct netif *netif)
         /* copy device flags to netif flags */
         netif->flags = (ethif->flags & 0xff);
 
+#if LWIP_IGMP
+        /* netif_add() starts igmp with all systems group after init */
+        netif_set_igmp_mac_filter(netif, ethernetif_igmp_mac_filter);
+#endif /* LWIP_IGMP */
+
         /* set default netif */
         if (netif_default == RT_NULL)
             netif_set_default(ethif->netif);
@@ -0,0 +1,119 @@
+#include "test_chksum.h"
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+
+#include <string.h>
+
+/* arch/chksum.c of the RT-Thread port is not in the file lists of the unix
+   port, build it here. LWIP_CHKSUM_COPY is compiled in even when the test
+   lwipopts.h leaves LWIP_CHECKSUM_ON_COPY off, no other code of this file
+   depends on it */
+#undef LWIP_CHECKSUM_ON_COPY
+#define LWIP_CHECKSUM_ON_COPY 1
+#include "../../../src/arch/chksum.c"
+
+/* reference, algorithm of inet_chksum.c */
+u16_t lwip_standard_chksum(const void *dataptr, int len);
+
+/* Setups/teardown functions */
+
+static void
+chksum_setup(void)
+{
+}
+
+static void
+chksum_teardown(void)
+{
+}
+
+
+#define TEST_OFFSETS    8
+#define TEST_LEN_ALL    300
+#define TEST_LEN_MAX    1600
+#define TEST_GUARD      0xa5
+
+static u8_t src_buf[TEST_LEN_MAX + 2 * TEST_OFFSETS];
+static u8_t dst_buf[TEST_LEN_MAX + 2 * TEST_OFFSETS];
+static u8_t ref_buf[TEST_LEN_MAX + 2 * TEST_OFFSETS];
+
+/* random bytes, or runs of 0xff to carry through every fold */
+static void
+chksum_fill(u8_t *buf, size_t len, unsigned seed)
+{
+  size_t i;
+  srand(seed);
+  for (i = 0; i < len; i++) {
+    buf[i] = (seed % 3 == 0) ? 0xff : (u8_t)rand();
+  }
+}
+
+/* lengths 0..TEST_LEN_ALL, then larger ones in odd steps */
+static int
+chksum_next_len(int len)
+{
+  return (len < TEST_LEN_ALL) ? len + 1 : len + 37;
+}
+
+/* Test functions */
+
+/** lwip_fast_chksum equals lwip_standard_chksum at every start offset */
+START_TEST(test_chksum_fast)
+{
+  int off, len;
+  unsigned seed = 1;
+  LWIP_UNUSED_ARG(_i);
+
+  for (len = 0; len <= TEST_LEN_MAX; len = chksum_next_len(len)) {
+    chksum_fill(src_buf, sizeof(src_buf), seed++);
+    for (off = 0; off < TEST_OFFSETS; off++) {
+      u16_t ref = lwip_standard_chksum(src_buf + off, len);
+      u16_t sum = lwip_fast_chksum(src_buf + off, len);
+      fail_unless(sum == ref,
+        "len %d offset %d: sum %04X, expected %04X", len, off, sum, ref);
+    }
+  }
+}
+END_TEST
+
+/** lwip_fast_chksum_copy copies exactly len bytes and sums as
+    lwip_standard_chksum at every source and destination offset */
+START_TEST(test_chksum_copy)
+{
+  int soff, doff, len;
+  unsigned seed = 1;
+  LWIP_UNUSED_ARG(_i);
+
+  for (len = 0; len <= TEST_LEN_MAX; len = chksum_next_len(len)) {
+    chksum_fill(src_buf, sizeof(src_buf), seed++);
+    for (soff = 0; soff < TEST_OFFSETS; soff++) {
+      u16_t ref = lwip_standard_chksum(src_buf + soff, len);
+      for (doff = 0; doff < TEST_OFFSETS; doff++) {
+        u16_t sum;
+        memset(dst_buf, TEST_GUARD, sizeof(dst_buf));
+        memset(ref_buf, TEST_GUARD, sizeof(ref_buf));
+        memcpy(ref_buf + doff, src_buf + soff, len);
+
+        sum = lwip_fast_chksum_copy(dst_buf + doff, src_buf + soff, (u16_t)len);
+        fail_unless(sum == ref,
+          "len %d src %d dst %d: sum %04X, expected %04X", len, soff, doff, sum, ref);
+        fail_unless(memcmp(dst_buf, ref_buf, sizeof(dst_buf)) == 0,
+          "len %d src %d dst %d: bad copy", len, soff, doff);
+      }
+    }
+  }
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+chksum_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_chksum_fast),
+    TESTFUNC(test_chksum_copy)
+  };
+  return create_suite("CHKSUM", tests, sizeof(tests)/sizeof(testfunc), chksum_setup, chksum_teardown);
+}
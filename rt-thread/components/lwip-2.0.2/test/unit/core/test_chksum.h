@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_CHKSUM_H
+#define LWIP_HDR_TEST_CHKSUM_H
+
+#include "../lwip_check.h"
+
+Suite *chksum_suite(void);
+
+#endif
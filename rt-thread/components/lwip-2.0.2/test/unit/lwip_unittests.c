@@ -5,6 +5,7 @@
 #include "tcp/test_tcp_oos.h"
 #include "core/test_mem.h"
 #include "core/test_pbuf.h"
+#include "core/test_chksum.h"
 #include "etharp/test_etharp.h"
 #include "dhcp/test_dhcp.h"
 #include "mdns/test_mdns.h"
@@ -42,6 +43,7 @@ int main(void)
     tcp_oos_suite,
     mem_suite,
     pbuf_suite,
+    chksum_suite,
     etharp_suite,
     dhcp_suite,
     mdns_suite
@@ -2,6 +2,10 @@
 
 #include "lwip/udp.h"
 #include "lwip/stats.h"
+#include "lwip/netif.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
 
 #if !LWIP_STATS || !UDP_STATS || !MEMP_STATS
 #error "This tests needs UDP- and MEMP-statistics enabled"
@@ -22,6 +26,80 @@ udp_remove_all(void)
   fail_unless(MEMP_STATS_GET(used, MEMP_UDP_PCB) == 0);
 }
 
+static struct netif test_netif;
+static struct pbuf *test_sent;
+
+static err_t
+test_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(ipaddr);
+  fail_unless(test_sent == NULL);
+  pbuf_ref(p);
+  test_sent = p;
+  return ERR_OK;
+}
+
+static err_t
+test_netif_init(struct netif *netif)
+{
+  netif->output = test_netif_output;
+  netif->mtu = 1500;
+  netif->name[0] = 't';
+  netif->name[1] = 'e';
+  return ERR_OK;
+}
+
+static void
+test_netif_add(void)
+{
+  ip4_addr_t addr, netmask, gw;
+
+  IP4_ADDR(&addr, 192, 168, 0, 2);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 192, 168, 0, 1);
+  test_sent = NULL;
+  netif_add(&test_netif, &addr, &netmask, &gw, NULL, test_netif_init, netif_input);
+  netif_set_up(&test_netif);
+}
+
+static void
+test_netif_remove(void)
+{
+  if (test_sent != NULL) {
+    pbuf_free(test_sent);
+    test_sent = NULL;
+  }
+  netif_remove(&test_netif);
+}
+
+/* send a udp datagram by test_netif and return its ip packet, NULL on error */
+static struct pbuf *
+test_udp_send(u16_t len)
+{
+  struct udp_pcb *pcb;
+  struct pbuf *p;
+  ip_addr_t dst;
+  u16_t i;
+  err_t err;
+
+  pcb = udp_new();
+  EXPECT_RETNULL(pcb != NULL);
+  p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  EXPECT_RETNULL(p != NULL);
+  for (i = 0; i < len; i++) {
+    ((u8_t *)p->payload)[i] = (u8_t)(i * 7 + 1);
+  }
+
+  IP_ADDR4(&dst, 192, 168, 0, 10);
+  err = udp_sendto_if(pcb, p, &dst, 5212, &test_netif);
+  pbuf_free(p);
+  udp_remove(pcb);
+  EXPECT_RETNULL(err == ERR_OK);
+
+  return test_sent;
+}
+
 /* Setups/teardown functions */
 
 static void
@@ -57,12 +135,82 @@ START_TEST(test_udp_new_remove)
 END_TEST
 
 
+/** Software checksums, the build without RT_LWIP_USING_HW_CHECKSUM:
+    ip header and udp checksums of a sent datagram verify */
+START_TEST(test_udp_sw_checksum)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  struct udp_hdr *udphdr;
+  ip_addr_t src, dst;
+  u16_t hlen, len;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(CHECKSUM_GEN_IP && CHECKSUM_GEN_UDP);
+
+  test_netif_add();
+  for (len = 0; len < 64; len += 7) {
+    p = test_udp_send(len);
+    fail_unless(p != NULL);
+    if (p == NULL) {
+      break;
+    }
+    fail_unless(p->tot_len == p->len);
+
+    iphdr = (struct ip_hdr *)p->payload;
+    hlen = IPH_HL(iphdr) * 4;
+    fail_unless(IPH_CHKSUM(iphdr) != 0);
+    fail_unless(inet_chksum(iphdr, hlen) == 0);
+
+    udphdr = (struct udp_hdr *)((u8_t *)p->payload + hlen);
+    fail_unless(udphdr->chksum != 0);
+    ip_addr_copy_from_ip4(src, iphdr->src);
+    ip_addr_copy_from_ip4(dst, iphdr->dest);
+    pbuf_header(p, -(s16_t)hlen);
+    fail_unless(ip_chksum_pseudo(p, IP_PROTO_UDP, p->tot_len, &src, &dst) == 0);
+
+    pbuf_free(p);
+    test_sent = NULL;
+  }
+  test_netif_remove();
+}
+END_TEST
+
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+/** Checksums turned off on a netif, as the gd32 driver with
+    RT_LWIP_USING_HW_CHECKSUM, are left to hardware */
+START_TEST(test_udp_netif_checksum_off)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  struct udp_hdr *udphdr;
+  LWIP_UNUSED_ARG(_i);
+
+  test_netif_add();
+  NETIF_SET_CHECKSUM_CTRL(&test_netif, NETIF_CHECKSUM_DISABLE_ALL);
+  p = test_udp_send(20);
+  fail_unless(p != NULL);
+  if (p != NULL) {
+    iphdr = (struct ip_hdr *)p->payload;
+    udphdr = (struct udp_hdr *)((u8_t *)p->payload + IPH_HL(iphdr) * 4);
+    fail_unless(IPH_CHKSUM(iphdr) == 0);
+    fail_unless(udphdr->chksum == 0);
+  }
+  test_netif_remove();
+}
+END_TEST
+#endif /* LWIP_CHECKSUM_CTRL_PER_NETIF */
+
 /** Create the suite including all tests for this module */
 Suite *
 udp_suite(void)
 {
   testfunc tests[] = {
     TESTFUNC(test_udp_new_remove),
+    TESTFUNC(test_udp_sw_checksum),
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+    TESTFUNC(test_udp_netif_checksum_off),
+#endif /* LWIP_CHECKSUM_CTRL_PER_NETIF */
   };
   return create_suite("UDP", tests, sizeof(tests)/sizeof(testfunc), udp_setup, udp_teardown);
 }
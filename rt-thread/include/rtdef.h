@@ -30,6 +30,8 @@
  * 2012-12-30     Bernard      add more control command for graphic.
  * 2013-01-09     Bernard      change version number.
  * 2015-02-01     Bernard      change version number to v2.1.0
+ * 2017-06-28     Test         add message queue and mutex statistics.
+ * 2017-06-29     Test         add TLSF heap statistics.
  */
 
 #ifndef __RT_DEF_H__
@@ -545,6 +547,12 @@ typedef struct rt_thread *rt_thread_t;
 
 #define RT_IPC_CMD_UNKNOWN              0x00            /**< unknown IPC command */
 #define RT_IPC_CMD_RESET                0x01            /**< reset IPC object */
+#define RT_IPC_CMD_GET_STAT             0x02            /**< get statistics of IPC object */
+#define RT_IPC_CMD_RESET_STAT           0x03            /**< reset statistics of IPC object */
+
+#ifdef RT_USING_IPC_STAT
+#define RT_IPC_STAT_HIST_NUM            8               /**< buckets of latency histogram */
+#endif
 
 #define RT_WAITING_FOREVER              -1              /**< Block forever until get resource. */
 #define RT_WAITING_NO                   0               /**< Non-block. */
@@ -586,6 +594,19 @@ struct rt_mutex
     rt_uint8_t           hold;                          /**< numbers of thread hold the mutex */
 
     struct rt_thread    *owner;                         /**< current owner of mutex */
+
+#ifdef RT_USING_IPC_STAT
+    rt_tick_t            take_tick;                     /**< tick the owner took the mutex */
+    struct rt_mutex_stat
+    {
+        rt_uint32_t      takes;                         /**< times taken by a new owner */
+        rt_uint32_t      contended;                     /**< times a thread had to wait */
+        rt_tick_t        max_hold;                      /**< longest hold time in ticks */
+        rt_tick_t        max_wait;                      /**< longest wait time in ticks */
+        struct rt_thread *max_hold_thread;              /**< thread held the mutex longest */
+        struct rt_thread *max_wait_owner;               /**< owner blocked the longest wait */
+    } stat;
+#endif
 };
 typedef struct rt_mutex *rt_mutex_t;
 #endif
@@ -649,6 +670,16 @@ struct rt_messagequeue
     void                *msg_queue_head;                /**< list head */
     void                *msg_queue_tail;                /**< list tail */
     void                *msg_queue_free;                /**< pointer indicated the free node of queue */
+
+#ifdef RT_USING_IPC_STAT
+    struct rt_mq_stat
+    {
+        rt_uint16_t      max_entry;                     /**< high water mark of entry */
+        rt_uint32_t      send_fail;                     /**< messages lost as queue full */
+        rt_uint32_t      latency[RT_IPC_STAT_HIST_NUM]; /**< ticks from send to recv,
+                                                             bucket n for less than 2^n */
+    } stat;
+#endif
 };
 typedef struct rt_messagequeue *rt_mq_t;
 #endif
@@ -704,6 +735,30 @@ struct rt_memheap
 };
 #endif
 
+#ifdef RT_USING_TLSF
+/**
+ * statistics of a first level size class of TLSF heap
+ */
+struct rt_tlsf_class_stat
+{
+    rt_uint32_t             min_size;                   /**< smallest block size of the class */
+    rt_uint32_t             allocs;                     /**< blocks allocated */
+    rt_uint32_t             frees;                      /**< blocks released */
+    rt_uint32_t             fails;                      /**< allocations failed */
+    rt_uint32_t             max_used;                   /**< maximum blocks in use */
+};
+
+/**
+ * fragmentation of TLSF heap
+ */
+struct rt_tlsf_frag_info
+{
+    rt_uint32_t             free_size;                  /**< bytes in free blocks */
+    rt_uint32_t             free_blocks;                /**< number of free blocks */
+    rt_uint32_t             largest_free;               /**< largest free block size */
+};
+#endif
+
 #ifdef RT_USING_MEMPOOL
 /**
  * Base structure of Memory pool object
@@ -27,6 +27,7 @@
  * 2010-04-11     yi.qiu       add module feature
  * 2013-06-24     Bernard      add rt_kprintf re-define when not use RT_USING_CONSOLE.
  * 2016-08-09     ArdaFu       add new thread and interrupt hook.
+ * 2017-06-29     Test         add TLSF heap statistics interface.
  */
 
 #ifndef __RT_THREAD_H__
@@ -240,6 +241,11 @@ void rt_memory_info(rt_uint32_t *total,
                     rt_uint32_t *used,
                     rt_uint32_t *max_used);
 
+#ifdef RT_USING_TLSF
+int rt_tlsf_class_stat(int index, struct rt_tlsf_class_stat *stat);
+void rt_tlsf_frag_info(struct rt_tlsf_frag_info *info);
+#endif
+
 #ifdef RT_USING_SLAB
 void *rt_page_alloc(rt_size_t npages);
 void rt_page_free(void *addr, rt_size_t npages);
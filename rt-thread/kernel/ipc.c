@@ -46,6 +46,7 @@
  * 2010-11-10     Bernard      add IPC reset command implementation.
  * 2011-12-18     Bernard      add more parameter checking in message queue
  * 2013-09-14     Grissiom     add an option check in rt_event_recv
+ * 2017-06-28     Test         add message queue and mutex statistics
  */
 
 #include <rtthread.h>
@@ -57,6 +58,21 @@ extern void (*rt_object_take_hook)(struct rt_object *object);
 extern void (*rt_object_put_hook)(struct rt_object *object);
 #endif
 
+#ifdef RT_USING_IPC_STAT
+/*
+ * get histogram bucket of ticks, bucket n for less than 2^n ticks
+ */
+rt_inline int rt_ipc_stat_bucket(rt_tick_t delta)
+{
+    int n = 0;
+
+    while (n < RT_IPC_STAT_HIST_NUM - 1 && delta >= ((rt_tick_t)1 << n))
+        n ++;
+
+    return n;
+}
+#endif
+
 /**
  * @addtogroup IPC
  */
@@ -536,6 +552,9 @@ rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
     mutex->owner = RT_NULL;
     mutex->original_priority = 0xFF;
     mutex->hold  = 0;
+#ifdef RT_USING_IPC_STAT
+    rt_memset(&(mutex->stat), 0, sizeof(mutex->stat));
+#endif
 
     /* set flag */
     mutex->parent.parent.flag = flag;
@@ -596,6 +615,9 @@ rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag)
     mutex->owner              = RT_NULL;
     mutex->original_priority  = 0xFF;
     mutex->hold               = 0;
+#ifdef RT_USING_IPC_STAT
+    rt_memset(&(mutex->stat), 0, sizeof(mutex->stat));
+#endif
 
     /* set flag */
     mutex->parent.parent.flag = flag;
@@ -683,6 +705,10 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
             mutex->owner             = thread;
             mutex->original_priority = thread->current_priority;
             mutex->hold ++;
+#ifdef RT_USING_IPC_STAT
+            mutex->take_tick = rt_tick_get();
+            mutex->stat.takes ++;
+#endif
         }
         else
         {
@@ -699,6 +725,12 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
             }
             else
             {
+#ifdef RT_USING_IPC_STAT
+                struct rt_thread *blocker = mutex->owner;
+                rt_tick_t wait_tick = rt_tick_get();
+
+                mutex->stat.contended ++;
+#endif
                 /* mutex is unavailable, push to suspend list */
                 RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_take: suspend thread: %s\n",
                                             thread->name));
@@ -747,6 +779,14 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
                     /* the mutex is taken successfully. */
                     /* disable interrupt */
                     temp = rt_hw_interrupt_disable();
+#ifdef RT_USING_IPC_STAT
+                    wait_tick = rt_tick_get() - wait_tick;
+                    if (wait_tick > mutex->stat.max_wait)
+                    {
+                        mutex->stat.max_wait       = wait_tick;
+                        mutex->stat.max_wait_owner = blocker;
+                    }
+#endif
                 }
             }
         }
@@ -808,6 +848,16 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
     /* if no hold */
     if (mutex->hold == 0)
     {
+#ifdef RT_USING_IPC_STAT
+        rt_tick_t hold_tick = rt_tick_get() - mutex->take_tick;
+
+        if (hold_tick > mutex->stat.max_hold)
+        {
+            mutex->stat.max_hold        = hold_tick;
+            mutex->stat.max_hold_thread = mutex->owner;
+        }
+#endif
+
         /* change the owner thread to original priority */
         if (mutex->original_priority != mutex->owner->current_priority)
         {
@@ -831,6 +881,10 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
             mutex->owner             = thread;
             mutex->original_priority = thread->current_priority;
             mutex->hold ++;
+#ifdef RT_USING_IPC_STAT
+            mutex->take_tick = rt_tick_get();
+            mutex->stat.takes ++;
+#endif
 
             /* resume thread */
             rt_ipc_list_resume(&(mutex->parent.suspend_thread));
@@ -870,6 +924,32 @@ RTM_EXPORT(rt_mutex_release);
  */
 rt_err_t rt_mutex_control(rt_mutex_t mutex, rt_uint8_t cmd, void *arg)
 {
+#ifdef RT_USING_IPC_STAT
+    rt_ubase_t level;
+
+    RT_ASSERT(mutex != RT_NULL);
+
+    if (cmd == RT_IPC_CMD_GET_STAT)
+    {
+        RT_ASSERT(arg != RT_NULL);
+
+        /* take a snapshot */
+        level = rt_hw_interrupt_disable();
+        *(struct rt_mutex_stat *)arg = mutex->stat;
+        rt_hw_interrupt_enable(level);
+
+        return RT_EOK;
+    }
+    else if (cmd == RT_IPC_CMD_RESET_STAT)
+    {
+        level = rt_hw_interrupt_disable();
+        rt_memset(&(mutex->stat), 0, sizeof(mutex->stat));
+        rt_hw_interrupt_enable(level);
+
+        return RT_EOK;
+    }
+#endif
+
     return -RT_ERROR;
 }
 RTM_EXPORT(rt_mutex_control);
@@ -1722,6 +1802,9 @@ RTM_EXPORT(rt_mb_control);
 struct rt_mq_message
 {
     struct rt_mq_message *next;
+#ifdef RT_USING_IPC_STAT
+    rt_tick_t             tick;                         /* tick of sending */
+#endif
 };
 
 /**
@@ -1782,6 +1865,9 @@ rt_err_t rt_mq_init(rt_mq_t     mq,
 
     /* the initial entry is zero */
     mq->entry = 0;
+#ifdef RT_USING_IPC_STAT
+    rt_memset(&(mq->stat), 0, sizeof(mq->stat));
+#endif
 
     return RT_EOK;
 }
@@ -1873,6 +1959,9 @@ rt_mq_t rt_mq_create(const char *name,
 
     /* the initial entry is zero */
     mq->entry = 0;
+#ifdef RT_USING_IPC_STAT
+    rt_memset(&(mq->stat), 0, sizeof(mq->stat));
+#endif
 
     return mq;
 }
@@ -1946,6 +2035,9 @@ rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)
     /* message queue is full */
     if (msg == RT_NULL)
     {
+#ifdef RT_USING_IPC_STAT
+        mq->stat.send_fail ++;
+#endif
         /* enable interrupt */
         rt_hw_interrupt_enable(temp);
 
@@ -1979,6 +2071,11 @@ rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)
 
     /* increase message entry */
     mq->entry ++;
+#ifdef RT_USING_IPC_STAT
+    msg->tick = rt_tick_get();
+    if (mq->entry > mq->stat.max_entry)
+        mq->stat.max_entry = mq->entry;
+#endif
 
     /* resume suspended thread */
     if (!rt_list_isempty(&mq->parent.suspend_thread))
@@ -2034,6 +2131,9 @@ rt_err_t rt_mq_urgent(rt_mq_t mq, void *buffer, rt_size_t size)
     /* message queue is full */
     if (msg == RT_NULL)
     {
+#ifdef RT_USING_IPC_STAT
+        mq->stat.send_fail ++;
+#endif
         /* enable interrupt */
         rt_hw_interrupt_enable(temp);
 
@@ -2061,6 +2161,11 @@ rt_err_t rt_mq_urgent(rt_mq_t mq, void *buffer, rt_size_t size)
 
     /* increase message entry */
     mq->entry ++;
+#ifdef RT_USING_IPC_STAT
+    msg->tick = rt_tick_get();
+    if (mq->entry > mq->stat.max_entry)
+        mq->stat.max_entry = mq->entry;
+#endif
 
     /* resume suspended thread */
     if (!rt_list_isempty(&mq->parent.suspend_thread))
@@ -2202,6 +2307,9 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
 
     /* decrease message entry */
     mq->entry --;
+#ifdef RT_USING_IPC_STAT
+    mq->stat.latency[rt_ipc_stat_bucket(rt_tick_get() - msg->tick)] ++;
+#endif
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
@@ -2275,6 +2383,29 @@ rt_err_t rt_mq_control(rt_mq_t mq, rt_uint8_t cmd, void *arg)
 
         return RT_EOK;
     }
+#ifdef RT_USING_IPC_STAT
+    else if (cmd == RT_IPC_CMD_GET_STAT)
+    {
+        RT_ASSERT(arg != RT_NULL);
+
+        /* take a snapshot */
+        level = rt_hw_interrupt_disable();
+        *(struct rt_mq_stat *)arg = mq->stat;
+        rt_hw_interrupt_enable(level);
+
+        return RT_EOK;
+    }
+    else if (cmd == RT_IPC_CMD_RESET_STAT)
+    {
+        level = rt_hw_interrupt_disable();
+        rt_memset(&(mq->stat), 0, sizeof(mq->stat));
+        /* queue keeps its current messages */
+        mq->stat.max_entry = mq->entry;
+        rt_hw_interrupt_enable(level);
+
+        return RT_EOK;
+    }
+#endif
 
     return -RT_ERROR;
 }
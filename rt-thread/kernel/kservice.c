@@ -31,6 +31,8 @@
  * 2013-06-24     Bernard      remove rt_kprintf if RT_USING_CONSOLE is not defined.
  * 2013-09-24     aozima       make sure the device is in STREAM mode when used by rt_kprintf.
  * 2015-07-06     Bernard      Add rt_assert_handler routine.
+ * 2017-06-29     Test         copy and set words in bursts after aligning the
+ *                             destination, compare words in rt_memcmp.
  */
 
 #include <rtthread.h>
@@ -143,43 +145,45 @@ void *rt_memset(void *s, int c, rt_ubase_t count)
 
     return s;
 #else
-#define LBLOCKSIZE      (sizeof(rt_int32_t))
-#define UNALIGNED(X)    ((rt_int32_t)X & (LBLOCKSIZE - 1))
-#define TOO_SMALL(LEN)  ((LEN) < LBLOCKSIZE)
+#define LBLOCKSIZE      (sizeof(rt_uint32_t))
+#define UNALIGNED(X)    ((rt_ubase_t)(X) & (LBLOCKSIZE - 1))
+#define TOO_SMALL(LEN)  ((LEN) < LBLOCKSIZE * 2)
 
-    int i;
     char *m = (char *)s;
     rt_uint32_t buffer;
     rt_uint32_t *aligned_addr;
     rt_uint32_t d = c & 0xff;
 
-    if (!TOO_SMALL(count) && !UNALIGNED(s))
+    if (!TOO_SMALL(count))
     {
-        /* If we get this far, we know that n is large and m is word-aligned. */
-        aligned_addr = (rt_uint32_t *)s;
+        /* set the unaligned head bytewise */
+        while (UNALIGNED(m))
+        {
+            *m++ = (char)d;
+            count--;
+        }
+
+        aligned_addr = (rt_uint32_t *)m;
 
         /* Store D into each char sized location in BUFFER so that
          * we can set large blocks quickly.
          */
-        if (LBLOCKSIZE == 4)
-        {
-            buffer = (d << 8) | d;
-            buffer |= (buffer << 16);
-        }
-        else
-        {
-            buffer = 0;
-            for (i = 0; i < LBLOCKSIZE; i ++)
-                buffer = (buffer << 8) | d;
-        }
+        buffer = (d << 8) | d;
+        buffer |= (buffer << 16);
 
-        while (count >= LBLOCKSIZE * 4)
+        /* 8 words in a loop, compiled to STM bursts */
+        while (count >= LBLOCKSIZE * 8)
         {
-            *aligned_addr++ = buffer;
-            *aligned_addr++ = buffer;
-            *aligned_addr++ = buffer;
-            *aligned_addr++ = buffer;
-            count -= 4 * LBLOCKSIZE;
+            aligned_addr[0] = buffer;
+            aligned_addr[1] = buffer;
+            aligned_addr[2] = buffer;
+            aligned_addr[3] = buffer;
+            aligned_addr[4] = buffer;
+            aligned_addr[5] = buffer;
+            aligned_addr[6] = buffer;
+            aligned_addr[7] = buffer;
+            aligned_addr += 8;
+            count -= 8 * LBLOCKSIZE;
         }
 
         while (count >= LBLOCKSIZE)
@@ -227,52 +231,119 @@ void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)
     return dst;
 #else
 
-#define UNALIGNED(X, Y)                                               \
-                        (((rt_int32_t)X & (sizeof(rt_int32_t) - 1)) | \
-                         ((rt_int32_t)Y & (sizeof(rt_int32_t) - 1)))
-#define BIGBLOCKSIZE    (sizeof(rt_int32_t) << 2)
-#define LITTLEBLOCKSIZE (sizeof(rt_int32_t))
-#define TOO_SMALL(LEN)  ((LEN) < BIGBLOCKSIZE)
+#define UNALIGNED(X)    ((rt_ubase_t)(X) & (sizeof(rt_uint32_t) - 1))
+#define BIGBLOCKSIZE    (sizeof(rt_uint32_t) << 3)
+#define LITTLEBLOCKSIZE (sizeof(rt_uint32_t))
+#define TOO_SMALL(LEN)  ((LEN) < (LITTLEBLOCKSIZE << 2))
+#if (defined(__CC_ARM) && defined(__BIG_ENDIAN)) || defined(__ARMEB__) || \
+    (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))
+#define MERGE(LO, HI, SH)   (((LO) << (SH)) | ((HI) >> (32 - (SH))))
+#else
+#define MERGE(LO, HI, SH)   (((LO) >> (SH)) | ((HI) << (32 - (SH))))
+#endif
 
     char *dst_ptr = (char *)dst;
-    char *src_ptr = (char *)src;
-    rt_int32_t *aligned_dst;
-    rt_int32_t *aligned_src;
-    int len = count;
-
-    /* If the size is small, or either SRC or DST is unaligned,
-    then punt into the byte copy loop.  This should be rare. */
-    if (!TOO_SMALL(len) && !UNALIGNED(src_ptr, dst_ptr))
-    {
-        aligned_dst = (rt_int32_t *)dst_ptr;
-        aligned_src = (rt_int32_t *)src_ptr;
+    const char *src_ptr = (const char *)src;
+    rt_uint32_t *aligned_dst;
+    const rt_uint32_t *aligned_src;
+    rt_ubase_t len = count;
 
-        /* Copy 4X long words at a time if possible. */
-        while (len >= BIGBLOCKSIZE)
+    if (!TOO_SMALL(len))
+    {
+        /* copy the head bytewise until the destination is word aligned */
+        while (UNALIGNED(dst_ptr))
         {
-            *aligned_dst++ = *aligned_src++;
-            *aligned_dst++ = *aligned_src++;
-            *aligned_dst++ = *aligned_src++;
-            *aligned_dst++ = *aligned_src++;
-            len -= BIGBLOCKSIZE;
+            *dst_ptr++ = *src_ptr++;
+            len--;
         }
+        aligned_dst = (rt_uint32_t *)dst_ptr;
 
-        /* Copy one long word at a time if possible. */
-        while (len >= LITTLEBLOCKSIZE)
+        if (!UNALIGNED(src_ptr))
         {
-            *aligned_dst++ = *aligned_src++;
-            len -= LITTLEBLOCKSIZE;
+            aligned_src = (const rt_uint32_t *)src_ptr;
+
+            /* Copy 8X long words at a time, compiled to LDM/STM bursts. */
+            while (len >= BIGBLOCKSIZE)
+            {
+                rt_uint32_t w0, w1, w2, w3, w4, w5, w6, w7;
+
+                w0 = aligned_src[0];
+                w1 = aligned_src[1];
+                w2 = aligned_src[2];
+                w3 = aligned_src[3];
+                w4 = aligned_src[4];
+                w5 = aligned_src[5];
+                w6 = aligned_src[6];
+                w7 = aligned_src[7];
+                aligned_dst[0] = w0;
+                aligned_dst[1] = w1;
+                aligned_dst[2] = w2;
+                aligned_dst[3] = w3;
+                aligned_dst[4] = w4;
+                aligned_dst[5] = w5;
+                aligned_dst[6] = w6;
+                aligned_dst[7] = w7;
+                aligned_src += 8;
+                aligned_dst += 8;
+                len -= BIGBLOCKSIZE;
+            }
+
+            /* Copy one long word at a time if possible. */
+            while (len >= LITTLEBLOCKSIZE)
+            {
+                *aligned_dst++ = *aligned_src++;
+                len -= LITTLEBLOCKSIZE;
+            }
+
+            src_ptr = (const char *)aligned_src;
+        }
+        else
+        {
+            /* The source is not aligned: load aligned words and shift
+             * them together, no word access goes past the bytes needed. */
+            rt_uint32_t shift = UNALIGNED(src_ptr) << 3;
+            rt_uint32_t lo, h0, h1, h2, h3;
+
+            aligned_src = (const rt_uint32_t *)(src_ptr - UNALIGNED(src_ptr));
+            lo = *aligned_src++;
+
+            while (len >= LITTLEBLOCKSIZE * 4)
+            {
+                h0 = aligned_src[0];
+                h1 = aligned_src[1];
+                h2 = aligned_src[2];
+                h3 = aligned_src[3];
+                aligned_dst[0] = MERGE(lo, h0, shift);
+                aligned_dst[1] = MERGE(h0, h1, shift);
+                aligned_dst[2] = MERGE(h1, h2, shift);
+                aligned_dst[3] = MERGE(h2, h3, shift);
+                lo = h3;
+                aligned_src += 4;
+                aligned_dst += 4;
+                len -= LITTLEBLOCKSIZE * 4;
+            }
+
+            while (len >= LITTLEBLOCKSIZE)
+            {
+                h0 = *aligned_src++;
+                *aligned_dst++ = MERGE(lo, h0, shift);
+                lo = h0;
+                len -= LITTLEBLOCKSIZE;
+            }
+
+            /* lo is the word last loaded, the rest begins inside it */
+            src_ptr = (const char *)aligned_src - LITTLEBLOCKSIZE + (shift >> 3);
         }
 
         /* Pick up any residual with a byte copier. */
         dst_ptr = (char *)aligned_dst;
-        src_ptr = (char *)aligned_src;
     }
 
     while (len--)
         *dst_ptr++ = *src_ptr++;
 
     return dst;
+#undef MERGE
 #undef UNALIGNED
 #undef BIGBLOCKSIZE
 #undef LITTLEBLOCKSIZE
@@ -324,10 +395,35 @@ RTM_EXPORT(rt_memmove);
  */
 rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_ubase_t count)
 {
-    const unsigned char *su1, *su2;
+    const unsigned char *su1 = cs, *su2 = ct;
     int res = 0;
 
-    for (su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
+#ifndef RT_TINY_SIZE
+    /* compare word by word when both areas have the same alignment */
+    if (count >= sizeof(rt_uint32_t) * 2 &&
+        (((rt_ubase_t)su1 ^ (rt_ubase_t)su2) & (sizeof(rt_uint32_t) - 1)) == 0)
+    {
+        while ((rt_ubase_t)su1 & (sizeof(rt_uint32_t) - 1))
+        {
+            if ((res = *su1 - *su2) != 0)
+                return res;
+            su1 ++;
+            su2 ++;
+            count --;
+        }
+
+        /* stop at the first different word, the byte loop finds the byte */
+        while (count >= sizeof(rt_uint32_t) &&
+               *(const rt_uint32_t *)su1 == *(const rt_uint32_t *)su2)
+        {
+            su1 += sizeof(rt_uint32_t);
+            su2 += sizeof(rt_uint32_t);
+            count -= sizeof(rt_uint32_t);
+        }
+    }
+#endif
+
+    for (; 0 < count; ++su1, ++su2, count--)
         if ((res = *su1 - *su2) != 0)
             break;
 
@@ -0,0 +1,734 @@
+/*
+ * File      : tlsf.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2008 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-06-29     Test         the first version
+ */
+
+/*
+ * Two-Level Segregated Fit heap.
+ *
+ * Free blocks are kept in lists indexed by a first level class (power of two
+ * of the block size) and a second level class (linear subdivision of the
+ * first level). Two bitmaps tell which lists are not empty, so a suitable
+ * free block is found by two find-first-set operations and rt_malloc/rt_free
+ * take bounded time whatever the heap fragmentation is.
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#ifndef RT_USING_MEMHEAP_AS_HEAP
+
+#if defined (RT_USING_HEAP) && defined (RT_USING_TLSF)
+
+extern int __rt_ffs(int value);
+
+#ifdef RT_USING_HOOK
+static void (*rt_malloc_hook)(void *ptr, rt_size_t size);
+static void (*rt_free_hook)(void *ptr);
+
+/**
+ * @addtogroup Hook
+ */
+
+/**@{*/
+
+/**
+ * This function will set a hook function, which will be invoked when a memory
+ * block is allocated from heap memory.
+ *
+ * @param hook the hook function
+ */
+void rt_malloc_sethook(void (*hook)(void *ptr, rt_size_t size))
+{
+    rt_malloc_hook = hook;
+}
+
+/**
+ * This function will set a hook function, which will be invoked when a memory
+ * block is released to heap memory.
+ *
+ * @param hook the hook function
+ */
+void rt_free_sethook(void (*hook)(void *ptr))
+{
+    rt_free_hook = hook;
+}
+
+/**@}*/
+
+#endif
+
+/* block sizes are multiple of 8 bytes, low bits of size hold the flags */
+#define TLSF_ALIGN          8
+#define TLSF_BLOCK_FREE     0x01
+#define TLSF_FLAG_MASK      (TLSF_ALIGN - 1)
+
+/* 8 second level lists in each first level class */
+#define TLSF_SL_LOG2        3
+#define TLSF_SL_COUNT       (1 << TLSF_SL_LOG2)
+
+/* blocks smaller than 64 bytes are in class 0, split linearly by 8 bytes */
+#define TLSF_FL_SHIFT       (TLSF_SL_LOG2 + 3)
+#define TLSF_SMALL_SIZE     (1 << TLSF_FL_SHIFT)
+
+/* highest bit of block size, blocks are smaller than 2MB */
+#define TLSF_FL_INDEX_MAX   20
+#define TLSF_FL_COUNT       (TLSF_FL_INDEX_MAX - TLSF_FL_SHIFT + 2)
+
+#define TLSF_BLOCK_MAX      ((1UL << (TLSF_FL_INDEX_MAX + 1)) - TLSF_ALIGN)
+#define TLSF_REQUEST_MAX    (1UL << TLSF_FL_INDEX_MAX)
+
+struct tlsf_block
+{
+    /* physical previous block, always valid */
+    struct tlsf_block *prev_phys;
+    /* data size and free flag */
+    rt_size_t size;
+
+    /* the free list links are in data area, used by free blocks only */
+    struct tlsf_block *next_free;
+    struct tlsf_block *prev_free;
+};
+
+#define TLSF_HEADER_SIZE    RT_ALIGN(2 * sizeof(void *), TLSF_ALIGN)
+#define TLSF_MIN_SIZE       RT_ALIGN(2 * sizeof(void *), TLSF_ALIGN)
+
+#define BLOCK_SIZE(b)       ((b)->size & ~(rt_size_t)TLSF_FLAG_MASK)
+#define BLOCK_IS_FREE(b)    ((b)->size & TLSF_BLOCK_FREE)
+#define BLOCK_DATA(b)       ((rt_uint8_t *)(b) + TLSF_HEADER_SIZE)
+#define BLOCK_NEXT(b)       ((struct tlsf_block *)(BLOCK_DATA(b) + BLOCK_SIZE(b)))
+#define DATA_BLOCK(p)       ((struct tlsf_block *)((rt_uint8_t *)(p) - TLSF_HEADER_SIZE))
+
+static rt_uint32_t fl_bitmap;
+static rt_uint32_t sl_bitmap[TLSF_FL_COUNT];
+static struct tlsf_block *free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+static rt_uint8_t *heap_ptr;
+static struct tlsf_block *heap_end;
+
+static struct rt_semaphore heap_sem;
+static rt_size_t mem_size_aligned;
+static rt_size_t used_mem, max_mem;
+
+static rt_size_t free_size;
+static rt_uint32_t free_blocks;
+static struct rt_tlsf_class_stat class_stat[TLSF_FL_COUNT];
+
+/* index of the highest bit set, value must not be 0 */
+static int tlsf_fls(rt_uint32_t value)
+{
+    int bit = 0;
+
+    if (value & 0xffff0000) { value >>= 16; bit += 16; }
+    if (value & 0xff00)     { value >>= 8;  bit += 8;  }
+    if (value & 0xf0)       { value >>= 4;  bit += 4;  }
+    if (value & 0x0c)       { value >>= 2;  bit += 2;  }
+    if (value & 0x02)       { bit += 1; }
+
+    return bit;
+}
+
+/* index of the lowest bit set, value must not be 0 */
+rt_inline int tlsf_ffs(rt_uint32_t value)
+{
+    return __rt_ffs(value) - 1;
+}
+
+/* the list a block of this size is kept in */
+static void tlsf_mapping_insert(rt_size_t size, int *fl, int *sl)
+{
+    int bit;
+
+    if (size < TLSF_SMALL_SIZE)
+    {
+        *fl = 0;
+        *sl = size / (TLSF_SMALL_SIZE / TLSF_SL_COUNT);
+    }
+    else
+    {
+        bit = tlsf_fls(size);
+        *sl = (size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = bit - TLSF_FL_SHIFT + 1;
+    }
+}
+
+/* the first list whose blocks are all large enough for this size */
+static void tlsf_mapping_search(rt_size_t size, int *fl, int *sl)
+{
+    if (size >= TLSF_SMALL_SIZE)
+        size += (1UL << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+
+    tlsf_mapping_insert(size, fl, sl);
+}
+
+static struct tlsf_block *tlsf_find_suitable(int *fl, int *sl)
+{
+    rt_uint32_t map;
+
+    map = sl_bitmap[*fl] & (~0UL << *sl);
+    if (map == 0)
+    {
+        /* no block in this first level class, try larger classes */
+        map = fl_bitmap & (~0UL << (*fl + 1));
+        if (map == 0)
+            return RT_NULL;
+
+        *fl = tlsf_ffs(map);
+        map = sl_bitmap[*fl];
+    }
+    *sl = tlsf_ffs(map);
+
+    return free_lists[*fl][*sl];
+}
+
+static void tlsf_insert_free(struct tlsf_block *block)
+{
+    struct tlsf_block *head;
+    int fl, sl;
+
+    tlsf_mapping_insert(BLOCK_SIZE(block), &fl, &sl);
+
+    head = free_lists[fl][sl];
+    block->size     |= TLSF_BLOCK_FREE;
+    block->next_free = head;
+    block->prev_free = RT_NULL;
+    if (head != RT_NULL)
+        head->prev_free = block;
+    free_lists[fl][sl] = block;
+
+    fl_bitmap     |= 1UL << fl;
+    sl_bitmap[fl] |= 1UL << sl;
+    free_size += BLOCK_SIZE(block);
+    free_blocks ++;
+}
+
+static void tlsf_remove_free(struct tlsf_block *block)
+{
+    int fl, sl;
+
+    tlsf_mapping_insert(BLOCK_SIZE(block), &fl, &sl);
+
+    if (block->prev_free != RT_NULL)
+        block->prev_free->next_free = block->next_free;
+    else
+        free_lists[fl][sl] = block->next_free;
+    if (block->next_free != RT_NULL)
+        block->next_free->prev_free = block->prev_free;
+
+    if (free_lists[fl][sl] == RT_NULL)
+    {
+        sl_bitmap[fl] &= ~(1UL << sl);
+        if (sl_bitmap[fl] == 0)
+            fl_bitmap &= ~(1UL << fl);
+    }
+
+    block->size &= ~(rt_size_t)TLSF_BLOCK_FREE;
+    free_size -= BLOCK_SIZE(block);
+    free_blocks --;
+}
+
+/* merge a free block with its physical neighbours and put it on free list */
+static void tlsf_release(struct tlsf_block *block)
+{
+    struct tlsf_block *next;
+
+    if (block->prev_phys != RT_NULL && BLOCK_IS_FREE(block->prev_phys))
+    {
+        struct tlsf_block *prev = block->prev_phys;
+
+        tlsf_remove_free(prev);
+        prev->size += TLSF_HEADER_SIZE + BLOCK_SIZE(block);
+        BLOCK_NEXT(prev)->prev_phys = prev;
+        block = prev;
+    }
+
+    next = BLOCK_NEXT(block);
+    if (BLOCK_IS_FREE(next))
+    {
+        tlsf_remove_free(next);
+        block->size += TLSF_HEADER_SIZE + BLOCK_SIZE(next);
+        BLOCK_NEXT(block)->prev_phys = block;
+    }
+
+    tlsf_insert_free(block);
+}
+
+/* cut a used block down to size, the remainder goes back to free lists */
+static void tlsf_trim(struct tlsf_block *block, rt_size_t size)
+{
+    struct tlsf_block *remain;
+
+    if (BLOCK_SIZE(block) < size + TLSF_HEADER_SIZE + TLSF_MIN_SIZE)
+        return;
+
+    remain = (struct tlsf_block *)(BLOCK_DATA(block) + size);
+    remain->size      = BLOCK_SIZE(block) - size - TLSF_HEADER_SIZE;
+    remain->prev_phys = block;
+    BLOCK_NEXT(remain)->prev_phys = remain;
+    block->size = size;
+
+    tlsf_release(remain);
+}
+
+static int tlsf_class(rt_size_t size)
+{
+    int fl, sl;
+
+    if (size > TLSF_BLOCK_MAX)
+        return TLSF_FL_COUNT - 1;
+
+    tlsf_mapping_insert(size, &fl, &sl);
+
+    return fl;
+}
+
+static void tlsf_stat_alloc(struct tlsf_block *block)
+{
+    struct rt_tlsf_class_stat *stat;
+
+    stat = &class_stat[tlsf_class(BLOCK_SIZE(block))];
+    stat->allocs ++;
+    if (stat->allocs - stat->frees > stat->max_used)
+        stat->max_used = stat->allocs - stat->frees;
+
+    used_mem += BLOCK_SIZE(block) + TLSF_HEADER_SIZE;
+    if (max_mem < used_mem)
+        max_mem = used_mem;
+}
+
+static void tlsf_stat_free(struct tlsf_block *block)
+{
+    class_stat[tlsf_class(BLOCK_SIZE(block))].frees ++;
+    used_mem -= BLOCK_SIZE(block) + TLSF_HEADER_SIZE;
+}
+
+/**
+ * @ingroup SystemInit
+ *
+ * This function will initialize system heap memory.
+ *
+ * @param begin_addr the beginning address of system heap memory.
+ * @param end_addr the end address of system heap memory.
+ */
+void rt_system_heap_init(void *begin_addr, void *end_addr)
+{
+    struct tlsf_block *block;
+    rt_uint32_t begin_align = RT_ALIGN((rt_uint32_t)begin_addr, TLSF_ALIGN);
+    rt_uint32_t end_align = RT_ALIGN_DOWN((rt_uint32_t)end_addr, TLSF_ALIGN);
+    int i;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+    RT_ASSERT(RT_ALIGN_SIZE <= TLSF_ALIGN);
+
+    /* one free block and the end stub */
+    if ((end_align > (2 * TLSF_HEADER_SIZE + TLSF_MIN_SIZE)) &&
+        ((end_align - 2 * TLSF_HEADER_SIZE - TLSF_MIN_SIZE) >= begin_align))
+    {
+        mem_size_aligned = end_align - begin_align - 2 * TLSF_HEADER_SIZE;
+    }
+    else
+    {
+        rt_kprintf("mem init, error begin address 0x%x, and end address 0x%x\n",
+                   (rt_uint32_t)begin_addr, (rt_uint32_t)end_addr);
+
+        return;
+    }
+
+    if (mem_size_aligned > TLSF_BLOCK_MAX)
+    {
+        rt_kprintf("mem init, heap is cut to %d bytes\n", (rt_uint32_t)TLSF_BLOCK_MAX);
+        mem_size_aligned = TLSF_BLOCK_MAX;
+    }
+
+    heap_ptr = (rt_uint8_t *)begin_align;
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM, ("mem init, heap begin address 0x%x, size %d\n",
+                                (rt_uint32_t)heap_ptr, mem_size_aligned));
+
+    fl_bitmap = 0;
+    for (i = 0; i < TLSF_FL_COUNT; i ++)
+    {
+        sl_bitmap[i] = 0;
+        rt_memset(free_lists[i], 0, sizeof(free_lists[i]));
+
+        rt_memset(&class_stat[i], 0, sizeof(class_stat[i]));
+        class_stat[i].min_size = (i == 0) ? 0 : (1UL << (i + TLSF_FL_SHIFT - 1));
+    }
+    free_size = free_blocks = 0;
+    used_mem = max_mem = 0;
+
+    /* initialize the whole heap as a free block */
+    block            = (struct tlsf_block *)heap_ptr;
+    block->prev_phys = RT_NULL;
+    block->size      = mem_size_aligned;
+
+    /* the end stub is always used, so no block merges over it */
+    heap_end            = BLOCK_NEXT(block);
+    heap_end->prev_phys = block;
+    heap_end->size      = 0;
+
+    tlsf_insert_free(block);
+
+    rt_sem_init(&heap_sem, "heap", 1, RT_IPC_FLAG_FIFO);
+}
+
+/**
+ * @addtogroup MM
+ */
+
+/**@{*/
+
+/**
+ * Allocate a block of memory with a minimum of 'size' bytes.
+ *
+ * @param size is the minimum size of the requested block in bytes.
+ *
+ * @return pointer to allocated memory or NULL if no free memory was found.
+ */
+void *rt_malloc(rt_size_t size)
+{
+    struct tlsf_block *block;
+    int fl, sl;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    if (size == 0)
+        return RT_NULL;
+
+    if (size > TLSF_REQUEST_MAX)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("no memory\n"));
+
+        /* statistics are changed under the heap semaphore only */
+        rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+        class_stat[TLSF_FL_COUNT - 1].fails ++;
+        rt_sem_release(&heap_sem);
+
+        return RT_NULL;
+    }
+
+    /* alignment size, every block can hold the free list links */
+    size = RT_ALIGN(size, TLSF_ALIGN);
+    if (size < TLSF_MIN_SIZE)
+        size = TLSF_MIN_SIZE;
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM, ("malloc size %d\n", size));
+
+    /* take memory semaphore */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    tlsf_mapping_search(size, &fl, &sl);
+    block = tlsf_find_suitable(&fl, &sl);
+    if (block == RT_NULL)
+    {
+        class_stat[tlsf_class(size)].fails ++;
+        rt_sem_release(&heap_sem);
+
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("no memory\n"));
+
+        return RT_NULL;
+    }
+
+    tlsf_remove_free(block);
+    tlsf_trim(block, size);
+    tlsf_stat_alloc(block);
+
+    rt_sem_release(&heap_sem);
+
+    RT_ASSERT((rt_uint32_t)BLOCK_DATA(block) % RT_ALIGN_SIZE == 0);
+    RT_ASSERT(BLOCK_NEXT(block) <= heap_end);
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM,
+                 ("allocate memory at 0x%x, size: %d\n",
+                  (rt_uint32_t)BLOCK_DATA(block), (rt_uint32_t)BLOCK_SIZE(block)));
+
+    RT_OBJECT_HOOK_CALL(rt_malloc_hook, ((void *)BLOCK_DATA(block), size));
+
+    return BLOCK_DATA(block);
+}
+RTM_EXPORT(rt_malloc);
+
+/**
+ * This function will change the previously allocated memory block.
+ *
+ * @param rmem pointer to memory allocated by rt_malloc
+ * @param newsize the required new size
+ *
+ * @return the changed memory block address
+ */
+void *rt_realloc(void *rmem, rt_size_t newsize)
+{
+    struct tlsf_block *block, *next;
+    rt_size_t size;
+    void *nmem;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    /* allocate a new memory block */
+    if (rmem == RT_NULL)
+        return rt_malloc(newsize);
+
+    if (newsize == 0)
+    {
+        rt_free(rmem);
+
+        return RT_NULL;
+    }
+
+    if (newsize > TLSF_REQUEST_MAX)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("realloc: out of memory\n"));
+
+        return RT_NULL;
+    }
+
+    /* alignment size */
+    newsize = RT_ALIGN(newsize, TLSF_ALIGN);
+    if (newsize < TLSF_MIN_SIZE)
+        newsize = TLSF_MIN_SIZE;
+
+    if ((rt_uint8_t *)rmem < heap_ptr ||
+        (rt_uint8_t *)rmem >= (rt_uint8_t *)heap_end)
+    {
+        /* illegal memory */
+        return rmem;
+    }
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    block = DATA_BLOCK(rmem);
+    RT_ASSERT(!BLOCK_IS_FREE(block));
+
+    size = BLOCK_SIZE(block);
+    next = BLOCK_NEXT(block);
+    if (newsize <= size ||
+        (BLOCK_IS_FREE(next) &&
+         size + TLSF_HEADER_SIZE + BLOCK_SIZE(next) >= newsize))
+    {
+        /* shrink, or grow into the free block behind */
+        tlsf_stat_free(block);
+        if (newsize > size)
+        {
+            tlsf_remove_free(next);
+            block->size += TLSF_HEADER_SIZE + BLOCK_SIZE(next);
+            BLOCK_NEXT(block)->prev_phys = block;
+        }
+        tlsf_trim(block, newsize);
+        tlsf_stat_alloc(block);
+
+        rt_sem_release(&heap_sem);
+
+        return rmem;
+    }
+    rt_sem_release(&heap_sem);
+
+    /* expand memory */
+    nmem = rt_malloc(newsize);
+    if (nmem != RT_NULL) /* check memory */
+    {
+        rt_memcpy(nmem, rmem, size);
+        rt_free(rmem);
+    }
+
+    return nmem;
+}
+RTM_EXPORT(rt_realloc);
+
+/**
+ * This function will contiguously allocate enough space for count objects
+ * that are size bytes of memory each and returns a pointer to the allocated
+ * memory.
+ *
+ * The allocated memory is filled with bytes of value zero.
+ *
+ * @param count number of objects to allocate
+ * @param size size of the objects to allocate
+ *
+ * @return pointer to allocated memory / NULL pointer if there is an error
+ */
+void *rt_calloc(rt_size_t count, rt_size_t size)
+{
+    void *p;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    /* allocate 'count' objects of size 'size' */
+    p = rt_malloc(count * size);
+
+    /* zero the memory */
+    if (p)
+        rt_memset(p, 0, count * size);
+
+    return p;
+}
+RTM_EXPORT(rt_calloc);
+
+/**
+ * This function will release the previously allocated memory block by
+ * rt_malloc. The released memory block is taken back to system heap.
+ *
+ * @param rmem the address of memory which will be released
+ */
+void rt_free(void *rmem)
+{
+    struct tlsf_block *block;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    if (rmem == RT_NULL)
+        return;
+    RT_ASSERT((((rt_uint32_t)rmem) & (RT_ALIGN_SIZE-1)) == 0);
+    RT_ASSERT((rt_uint8_t *)rmem >= heap_ptr &&
+              (rt_uint8_t *)rmem < (rt_uint8_t *)heap_end);
+
+    RT_OBJECT_HOOK_CALL(rt_free_hook, (rmem));
+
+    if ((rt_uint8_t *)rmem < heap_ptr ||
+        (rt_uint8_t *)rmem >= (rt_uint8_t *)heap_end)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("illegal memory\n"));
+
+        return;
+    }
+
+    block = DATA_BLOCK(rmem);
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM,
+                 ("release memory 0x%x, size: %d\n",
+                  (rt_uint32_t)rmem, (rt_uint32_t)BLOCK_SIZE(block)));
+
+    /* protect the heap from concurrent access */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    /* the block has to be in a used state */
+    RT_ASSERT(!BLOCK_IS_FREE(block));
+    RT_ASSERT(BLOCK_NEXT(block)->prev_phys == block);
+
+    tlsf_stat_free(block);
+    tlsf_release(block);
+
+    rt_sem_release(&heap_sem);
+}
+RTM_EXPORT(rt_free);
+
+void rt_memory_info(rt_uint32_t *total,
+                    rt_uint32_t *used,
+                    rt_uint32_t *max_used)
+{
+    if (total != RT_NULL)
+        *total = mem_size_aligned;
+    if (used  != RT_NULL)
+        *used = used_mem;
+    if (max_used != RT_NULL)
+        *max_used = max_mem;
+}
+
+/**
+ * This function will get statistics of a first level size class, class n
+ * holds blocks from min_size up to min_size of class n + 1.
+ *
+ * @param index the class index, from 0
+ * @param stat the statistics of the class
+ *
+ * @return 0 on success, -1 if there is no such class
+ */
+int rt_tlsf_class_stat(int index, struct rt_tlsf_class_stat *stat)
+{
+    if (index < 0 || index >= TLSF_FL_COUNT)
+        return -1;
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    *stat = class_stat[index];
+    rt_sem_release(&heap_sem);
+
+    return 0;
+}
+
+/**
+ * This function will get the fragmentation of heap. The largest free block
+ * is searched in the highest non-empty free list only, so its cost is the
+ * length of one list.
+ *
+ * @param info the fragmentation information
+ */
+void rt_tlsf_frag_info(struct rt_tlsf_frag_info *info)
+{
+    struct tlsf_block *block;
+    int fl;
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    info->free_size    = free_size;
+    info->free_blocks  = free_blocks;
+    info->largest_free = 0;
+    if (fl_bitmap != 0)
+    {
+        fl = tlsf_fls(fl_bitmap);
+        for (block = free_lists[fl][tlsf_fls(sl_bitmap[fl])];
+             block != RT_NULL;
+             block = block->next_free)
+        {
+            if (BLOCK_SIZE(block) > info->largest_free)
+                info->largest_free = BLOCK_SIZE(block);
+        }
+    }
+
+    rt_sem_release(&heap_sem);
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+void list_mem(void)
+{
+    struct rt_tlsf_frag_info frag;
+    struct rt_tlsf_class_stat stat;
+    int i;
+
+    rt_kprintf("total memory: %d\n", mem_size_aligned);
+    rt_kprintf("used memory : %d\n", used_mem);
+    rt_kprintf("maximum allocated memory: %d\n", max_mem);
+
+    rt_tlsf_frag_info(&frag);
+    rt_kprintf("free blocks : %d, largest %d, fragmentation %d%%\n",
+               frag.free_blocks, frag.largest_free,
+               frag.free_size ? 100 - frag.largest_free * 100 / frag.free_size : 0);
+
+    rt_kprintf(" size from  allocs    frees     used  max used  fails\n");
+    rt_kprintf("---------- -------- -------- -------- -------- ------\n");
+    for (i = 0; rt_tlsf_class_stat(i, &stat) == 0; i ++)
+    {
+        if (stat.allocs == 0 && stat.fails == 0)
+            continue;
+
+        rt_kprintf("%10d %8d %8d %8d %8d %6d\n", stat.min_size,
+                   stat.allocs, stat.frees, stat.allocs - stat.frees,
+                   stat.max_used, stat.fails);
+    }
+}
+FINSH_FUNCTION_EXPORT(list_mem, list memory usage information)
+#endif
+
+/**@}*/
+
+#endif /* end of RT_USING_HEAP */
+#endif /* end of RT_USING_MEMHEAP_AS_HEAP */
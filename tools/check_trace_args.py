@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+check_trace_args.py - find trace_printf calls with more arguments than a
+trace record keeps.
+
+  check_trace_args.py [SOURCE_DIR...]
+
+trace.c saves TRACE_MAX_ARGS (trace.h) arguments with a format and prints
+"[trace] too many arguments" for a call with more. The check reads every
+trace_printf call, and DEBUG_PRINTF calls of files that define DEBUG_PRINTF
+as trace_printf, and counts both the arguments passed and the conversions
+of the format. A call over the limit is listed and the exit status is 1.
+"""
+
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir)
+TRACE_H = os.path.join(ROOT, "applications", "user_components", "trace.h")
+
+MAX_ARGS = re.compile(r"#define\s+TRACE_MAX_ARGS\s+\(?(\d+)\)?")
+TRACE_MACRO = re.compile(r"#define\s+(\w+)\s+trace_printf\b")
+STRING = re.compile(r'"((?:[^"\\]|\\.)*)"')
+
+
+def max_args():
+    with open(TRACE_H) as f:
+        m = MAX_ARGS.search(f.read())
+    if m is None:
+        sys.exit("TRACE_MAX_ARGS not found in %s" % TRACE_H)
+    return int(m.group(1))
+
+
+def call_args(text, start):
+    """arguments of the call whose '(' is at start, split at top level commas"""
+    args, depth, i, arg = [], 0, start + 1, start + 1
+    while i < len(text):
+        c = text[i]
+        if c in "\"'":
+            # skip a string or char literal
+            i += 1
+            while i < len(text) and text[i] != c:
+                i += 2 if text[i] == "\\" else 1
+        elif c in "([{":
+            depth += 1
+        elif c in ")]}":
+            if depth == 0:
+                args.append(text[arg:i].strip())
+                return args
+            depth -= 1
+        elif c == "," and depth == 0:
+            args.append(text[arg:i].strip())
+            arg = i + 1
+        i += 1
+    return None
+
+
+def count_conversions(fmt):
+    """count_args of trace.c on the concatenated literals of a format"""
+    text = "".join(STRING.findall(fmt))
+    return len(re.findall(r"%(?!%)", text.replace("%%", "")))
+
+
+def strip_comments(text):
+    # keep line numbers, blank out comment bodies
+    return re.sub(r"/\*.*?\*/|//[^\n]*",
+                  lambda m: re.sub(r"[^\n]", " ", m.group(0)), text, flags=re.S)
+
+
+def check_file(path, limit):
+    with open(path, encoding="latin-1") as f:
+        text = strip_comments(f.read())
+    names = {"trace_printf"} | set(TRACE_MACRO.findall(text))
+    calls = re.compile(r"\b(%s)\s*\(" % "|".join(sorted(names)))
+    bad = 0
+    for m in calls.finditer(text):
+        line_start = text.rfind("\n", 0, m.start()) + 1
+        if text[line_start:m.start()].lstrip().startswith("#"):
+            continue
+        args = call_args(text, m.end() - 1)
+        if not args or not STRING.search(args[0]):
+            # declaration or a call without a literal format
+            continue
+        passed = len(args) - 1
+        wanted = count_conversions(args[0])
+        if max(passed, wanted) > limit:
+            row = text.count("\n", 0, m.start()) + 1
+            print("%s:%d: %s with %d arguments, %d conversions, limit %d" %
+                  (os.path.relpath(path, ROOT), row, m.group(1), passed, wanted, limit))
+            bad += 1
+    return bad
+
+
+def main(argv=None):
+    argv = sys.argv[1:] if argv is None else argv
+    dirs = argv or [os.path.join(ROOT, "applications")]
+    limit = max_args()
+    bad = 0
+    for top in dirs:
+        for path, _, files in os.walk(top):
+            for name in sorted(files):
+                if name.endswith(".c"):
+                    bad += check_file(os.path.join(path, name), limit)
+    return 1 if bad else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
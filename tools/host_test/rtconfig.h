@@ -0,0 +1,20 @@
+/* rtconfig.h of host tests, only what the code under test needs */
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_NAME_MAX             8
+#define RT_ALIGN_SIZE           4
+#define RT_THREAD_PRIORITY_MAX  32
+#define RT_TICK_PER_SECOND      1000
+
+#define RT_USING_SEMAPHORE
+#define RT_USING_MUTEX
+#define RT_USING_EVENT
+#define RT_USING_MAILBOX
+#define RT_USING_MESSAGEQUEUE
+#define RT_USING_HEAP
+#define RT_USING_DEVICE
+#define RT_USING_CONSOLE
+#define RT_CONSOLEBUF_SIZE      128
+
+#endif /* RT_CONFIG_H__ */
@@ -0,0 +1,265 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_kservice.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * conformance test of rt_memcpy, rt_memset and rt_memcmp of kservice.c
+ * against libc, at every source and destination alignment and every length
+ * up to TEST_LEN_ALL, then a micro-benchmark of the sizes the firmware
+ * copies. bench_mem of mem_bench.c runs the same benchmark on target.
+ *
+ *   test_kservice          conformance
+ *   test_kservice -b       conformance, then benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rtthread.h>
+
+#define TEST_OFFSETS    (8)
+#define TEST_LEN_ALL    (300)
+#define TEST_LEN_MAX    (1600)
+#define TEST_GUARD      (32)
+#define TEST_BUF_SIZE   (TEST_LEN_MAX + TEST_OFFSETS + 2 * TEST_GUARD)
+
+#define BENCH_BYTES     (64UL * 1024 * 1024)
+
+static int errors;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(errors++ < 10) { \
+    printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while(0)
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+/* kservice.c calls these for rt_kprintf and rt_strdup, unused here */
+rt_thread_t rt_thread_self(void)                                    { return RT_NULL; }
+rt_uint8_t rt_interrupt_get_nest(void)                              { return 0; }
+void *rt_malloc(rt_size_t size)                                     { return malloc(size); }
+void rt_free(void *ptr)                                             { free(ptr); }
+rt_device_t rt_device_find(const char *name)                        { return RT_NULL; }
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag)         { return -RT_ERROR; }
+rt_err_t rt_device_close(rt_device_t dev)                           { return -RT_ERROR; }
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    return 0;
+}
+
+/**
+ ******************************************************************************
+ *                                 CONFORMANCE
+ ******************************************************************************
+ */
+
+static unsigned char src_buf[TEST_BUF_SIZE];
+static unsigned char dst_buf[TEST_BUF_SIZE];
+static unsigned char ref_buf[TEST_BUF_SIZE];
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+/* lengths 0..TEST_LEN_ALL, then larger ones in odd steps */
+static int next_len(int len)
+{
+    return (len < TEST_LEN_ALL) ? len + 1 : len + 37;
+}
+
+static void fill(unsigned char *buf, size_t len)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        buf[i] = (unsigned char)rand();
+    }
+}
+
+static void test_memcpy(void)
+{
+    int len, soff, doff;
+
+    for(len = 0; len <= TEST_LEN_MAX; len = next_len(len))
+    {
+        fill(src_buf, sizeof(src_buf));
+        for(soff = 0; soff < TEST_OFFSETS; soff++)
+        {
+            for(doff = 0; doff < TEST_OFFSETS; doff++)
+            {
+                unsigned char *src = src_buf + TEST_GUARD + soff;
+                void *ret;
+
+                fill(dst_buf, sizeof(dst_buf));
+                memcpy(ref_buf, dst_buf, sizeof(ref_buf));
+                memcpy(ref_buf + TEST_GUARD + doff, src, len);
+
+                ret = rt_memcpy(dst_buf + TEST_GUARD + doff, src, len);
+                CHECK(ret == dst_buf + TEST_GUARD + doff, "memcpy return len %d", len);
+                CHECK(memcmp(dst_buf, ref_buf, sizeof(dst_buf)) == 0,
+                      "memcpy len %d src %d dst %d", len, soff, doff);
+            }
+        }
+    }
+}
+
+static void test_memset(void)
+{
+    int len, doff;
+    int values[] = { 0, 0xff, 0x5a, 0x1a5, -1 };
+    unsigned int v;
+
+    for(len = 0; len <= TEST_LEN_MAX; len = next_len(len))
+    {
+        for(doff = 0; doff < TEST_OFFSETS; doff++)
+        {
+            for(v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+            {
+                void *ret;
+
+                fill(dst_buf, sizeof(dst_buf));
+                memcpy(ref_buf, dst_buf, sizeof(ref_buf));
+                memset(ref_buf + TEST_GUARD + doff, values[v], len);
+
+                ret = rt_memset(dst_buf + TEST_GUARD + doff, values[v], len);
+                CHECK(ret == dst_buf + TEST_GUARD + doff, "memset return len %d", len);
+                CHECK(memcmp(dst_buf, ref_buf, sizeof(dst_buf)) == 0,
+                      "memset len %d dst %d value %x", len, doff, values[v]);
+            }
+        }
+    }
+}
+
+/* equal areas, then one byte changed at the start, middle and end */
+static void test_memcmp(void)
+{
+    int len, aoff, boff, pos, k;
+
+    for(len = 0; len <= TEST_LEN_MAX; len = next_len(len))
+    {
+        fill(src_buf, sizeof(src_buf));
+        for(aoff = 0; aoff < TEST_OFFSETS; aoff++)
+        {
+            for(boff = 0; boff < TEST_OFFSETS; boff++)
+            {
+                unsigned char *a = src_buf + TEST_GUARD + aoff;
+                unsigned char *b = dst_buf + TEST_GUARD + boff;
+
+                fill(dst_buf, sizeof(dst_buf));
+                memcpy(b, a, len);
+                CHECK(rt_memcmp(a, b, len) == 0, "memcmp equal len %d a %d b %d", len, aoff, boff);
+
+                for(k = 0; k < 3 && len > 0; k++)
+                {
+                    pos = (k == 0) ? 0 : (k == 1) ? len / 2 : len - 1;
+                    b[pos] = (unsigned char)(a[pos] + 1 + rand() % 255);
+                    CHECK(sign(rt_memcmp(a, b, len)) == sign(memcmp(a, b, len)),
+                          "memcmp len %d a %d b %d diff at %d", len, aoff, boff, pos);
+                    CHECK(sign(rt_memcmp(b, a, len)) == sign(memcmp(b, a, len)),
+                          "memcmp len %d a %d b %d diff at %d", len, aoff, boff, pos);
+                    b[pos] = a[pos];
+                }
+            }
+        }
+    }
+}
+
+/**
+ ******************************************************************************
+ *                                  BENCHMARK
+ ******************************************************************************
+ */
+
+/* the byte loops of RT_TINY_SIZE, as all copies were before word bursts */
+static void *byte_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    volatile char *d = (volatile char *)dst;
+    const char *s = (const char *)src;
+
+    while(count--)
+    {
+        *d++ = *s++;
+    }
+    return dst;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* MB/s of a copy of len bytes repeated over BENCH_BYTES */
+static double bench_copy(void *(*copy)(void *, const void *, rt_ubase_t),
+                         int len, int soff, int doff)
+{
+    unsigned long i, loops = BENCH_BYTES / len;
+    double start = now_sec();
+
+    for(i = 0; i < loops; i++)
+    {
+        copy(dst_buf + TEST_GUARD + doff, src_buf + TEST_GUARD + soff, len);
+        __asm__ volatile("" ::: "memory");
+    }
+    return BENCH_BYTES / (now_sec() - start) / 1e6;
+}
+
+static void benchmark(void)
+{
+    /* lwip segments, mq_data_proc messages, spi frames and small headers */
+    static const int sizes[] = { 16, 64, 264, 1024 };
+    static const int offs[][2] = { { 0, 0 }, { 2, 0 }, { 1, 3 } };
+    unsigned i, k;
+
+    printf("%6s %8s %12s %12s\n", "size", "src/dst", "rt_memcpy", "byte loop");
+    for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        for(k = 0; k < sizeof(offs) / sizeof(offs[0]); k++)
+        {
+            printf("%6d %5d/%-2d %8.0f MB/s %7.0f MB/s\n", sizes[i], offs[k][0], offs[k][1],
+                   bench_copy(rt_memcpy, sizes[i], offs[k][0], offs[k][1]),
+                   bench_copy(byte_memcpy, sizes[i], offs[k][0], offs[k][1]));
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    srand(1);
+    test_memcpy();
+    test_memset();
+    test_memcmp();
+    printf("kservice: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    if(errors == 0 && argc > 1 && strcmp(argv[1], "-b") == 0)
+    {
+        benchmark();
+    }
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
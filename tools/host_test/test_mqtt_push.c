@@ -0,0 +1,474 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_mqtt_push.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host test of mqtt state push of thread_mqtt.c against a local broker: the
+ * lwip mqtt client calls are answered in place, publishes are decoded and
+ * kept. the push thread runs a script, one step each time it waits, and
+ * leaves when the script ends. thread_mqtt.c is built into this file for
+ * its state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <setjmp.h>
+
+#include "wnc_data_base.h"
+#include "../../applications/user_thread/thread_network/thread_mqtt.c"
+
+#define BROKER_A        (0x0201a8c0)    /* 192.168.1.2 */
+#define BROKER_B        (0x0301a8c0)    /* 192.168.1.3 */
+#define MAX_PUBLISHED   (1024)
+#define MQ_SIZE         (MQTT_PUSH_MQ_NUM)
+
+static int fails;
+
+#define CHECK(cond) do { if(!(cond)) { fails++; if(fails < 10) \
+    printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); } } while(0)
+
+/* globals of other modules */
+device_params_t         wnc_device;
+detector_info_list_t    g_detector_info_list;
+light_info_list_t       g_light_info_list;
+wnc_cfg_t               g_wnc_config;
+wnc_cfg_t               g_wnc_config_bak;
+struct rt_mutex         mutex_detector_list;
+struct rt_mutex         mutex_light_list;
+sys_mutex_t             lock_tcpip_core;
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+void *rt_memset(void *s, int c, rt_ubase_t n)                       { return memset(s, c, n); }
+void trace_printf(const char *fmt, ...)                             { }
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *format, ...)
+{
+    va_list args;
+    int ret;
+
+    va_start(args, format);
+    ret = vsnprintf(buf, size, format, args);
+    va_end(args);
+
+    return ret;
+}
+
+/* list mutexes, publishes must not hold them */
+static int detector_held, light_held;
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    (mutex == &mutex_detector_list) ? detector_held++ : light_held++;
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    (mutex == &mutex_detector_list) ? detector_held-- : light_held--;
+    return RT_EOK;
+}
+
+/* lwip mqtt client is called with tcpip core locked */
+static int core_locked;
+
+void sys_mutex_lock(sys_mutex_t *mutex)
+{
+    CHECK(mutex == &lock_tcpip_core && core_locked == 0);
+    core_locked++;
+}
+
+void sys_mutex_unlock(sys_mutex_t *mutex)
+{
+    core_locked--;
+}
+
+/* callbacks of the local broker run before the thread takes the semaphore */
+static int sem_count;
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    sem_count = value;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_control(rt_sem_t sem, rt_uint8_t cmd, void *arg)
+{
+    sem_count = (int)(long)arg;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    sem_count++;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    if(sem_count == 0)
+    {
+        return -RT_ETIMEOUT;
+    }
+    sem_count--;
+    return RT_EOK;
+}
+
+/**
+ ******************************************************************************
+ *                                   SCRIPT
+ ******************************************************************************
+ */
+
+/* the thread waits for a retry in rt_thread_delay or for changes in
+   rt_mq_recv, a step runs there and the thread leaves when no step is left.
+   the short wait to batch changes runs no step. */
+static jmp_buf              script_end;
+static void               (*script)(int step);
+static int                  script_steps;
+static int                  script_step;
+
+static void script_wait(void)
+{
+    if(script_step == script_steps)
+    {
+        longjmp(script_end, 1);
+    }
+    script(script_step++);
+}
+
+static void run_script(void (*steps)(int step), int num)
+{
+    script       = steps;
+    script_steps = num;
+    script_step  = 0;
+    if(setjmp(script_end) == 0)
+    {
+        thread_mqtt_push(RT_NULL);
+    }
+}
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    if(tick >= MQTT_PUSH_RETRY_TICKS)
+    {
+        script_wait();
+    }
+    return RT_EOK;
+}
+
+static struct mqtt_push_record  mq_buf[MQ_SIZE];
+static int                      mq_head, mq_num;
+static struct rt_messagequeue   mq;
+
+rt_mq_t rt_mq_create(const char *name, rt_size_t msg_size, rt_size_t max_msgs, rt_uint8_t flag)
+{
+    CHECK(msg_size == sizeof(struct mqtt_push_record));
+    mq_head = mq_num = 0;
+    return &mq;
+}
+
+rt_err_t rt_mq_send(rt_mq_t q, void *buffer, rt_size_t size)
+{
+    if(mq_num == MQ_SIZE)
+    {
+        return -RT_EFULL;
+    }
+    memcpy(&mq_buf[(mq_head + mq_num++) % MQ_SIZE], buffer, size);
+    return RT_EOK;
+}
+
+rt_err_t rt_mq_recv(rt_mq_t q, void *buffer, rt_size_t size, rt_int32_t timeout)
+{
+    if((mq_num == 0) && (timeout != 0))
+    {
+        script_wait();
+    }
+    if(mq_num == 0)
+    {
+        return -RT_ETIMEOUT;
+    }
+    memcpy(buffer, &mq_buf[mq_head], size);
+    mq_head = (mq_head + 1) % MQ_SIZE;
+    mq_num--;
+    return RT_EOK;
+}
+
+/**
+ ******************************************************************************
+ *                                LOCAL BROKER
+ ******************************************************************************
+ */
+
+static int                      broker_up = 1;
+static rt_uint32_t              broker_ip;          /* connected to, 0 for none */
+static int                      connects, publishes;
+static struct mqtt_push_record  published[MAX_PUBLISHED];
+static int                      published_num;
+
+err_t mqtt_client_connect(mqtt_client_t *client, const ip_addr_t *ipaddr, u16_t port,
+                          mqtt_connection_cb_t cb, void *arg,
+                          const struct mqtt_connect_client_info_t *client_info)
+{
+    CHECK(core_locked == 1);
+    CHECK(broker_ip == 0);
+    CHECK(port == MQTT_PUSH_PORT);
+    CHECK(strcmp(client_info->client_id, "LN7") == 0);
+    connects++;
+    if(broker_up)
+    {
+        broker_ip = ip4_addr_get_u32(ip_2_ip4(ipaddr));
+    }
+    cb(client, arg, broker_up ? MQTT_CONNECT_ACCEPTED : MQTT_CONNECT_REFUSED_SERVER);
+    return ERR_OK;
+}
+
+void mqtt_disconnect(mqtt_client_t *client)
+{
+    CHECK(core_locked == 1);
+    broker_ip = 0;
+}
+
+err_t mqtt_publish(mqtt_client_t *client, const char *topic, const void *payload,
+                   u16_t payload_length, u8_t qos, u8_t retain, mqtt_request_cb_t cb, void *arg)
+{
+    const rt_uint8_t *p = payload;
+    int i;
+
+    CHECK(core_locked == 1);
+    CHECK(broker_ip != 0);
+    CHECK(detector_held == 0 && light_held == 0);
+    CHECK(strcmp(topic, "LN/7/state") == 0);
+    CHECK(p[0] == MQTT_PUSH_VERSION);
+    CHECK(p[1] >= 1 && p[1] <= MQTT_PUSH_MAX_RECORDS);
+    CHECK(payload_length == 2 + p[1] * 7);
+
+    publishes++;
+    for(i = 0, p += 2; (i < payload_length / 7) && (published_num < MAX_PUBLISHED); i++, p += 7)
+    {
+        struct mqtt_push_record *rec = &published[published_num++];
+
+        rec->type  = p[0];
+        rec->id    = ((rt_uint32_t)p[1] << 24) | ((rt_uint32_t)p[2] << 16) | (p[3] << 8) | p[4];
+        rec->state = p[5];
+        rec->value = p[6];
+    }
+
+    cb(arg, ERR_OK);
+    return ERR_OK;
+}
+
+static void broker_clear(void)
+{
+    connects      = 0;
+    publishes     = 0;
+    published_num = 0;
+}
+
+/* records published for a node, the last one in *last */
+static int published_of(rt_uint8_t type, rt_uint32_t id, struct mqtt_push_record *last)
+{
+    int i, n = 0;
+
+    for(i = 0; i < published_num; i++)
+    {
+        if(published[i].type == type && published[i].id == id)
+        {
+            *last = published[i];
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ ******************************************************************************
+ *                                    TESTS
+ ******************************************************************************
+ */
+
+static void set_nodes(int detectors, int lights)
+{
+    int i;
+
+    g_detector_info_list.num = detectors;
+    for(i = 0; i < detectors; i++)
+    {
+        g_detector_info_list.detector_info[i].id      = 0x1000 + i;
+        g_detector_info_list.detector_info[i].state   = i & 1;
+        g_detector_info_list.detector_info[i].battery = i;
+    }
+    g_light_info_list.num = lights;
+    for(i = 0; i < lights; i++)
+    {
+        g_light_info_list.light_info[i].id            = 0x2000 + i;
+        g_light_info_list.light_info[i].state         = 0;
+        g_light_info_list.light_info[i].current_color = 1;
+        g_light_info_list.light_info[i].correct_color = 2;
+    }
+    g_light_info_list.light_info[0].state = NODE_STATE_OFFLINE;
+}
+
+/* all nodes in batches, lists read under their mutex, publish with them released */
+static void test_push_all(void)
+{
+    struct mqtt_push_record rec;
+    int i;
+
+    set_nodes(MAX_DETECTOR_PER_WNC, MAX_LIGHT_PER_WNC);
+    broker_clear();
+    push_broker_ip = 0;
+    g_wnc_config.mqtt_ip = BROKER_A;
+    CHECK(mqtt_push_connect() == 0);
+    CHECK(broker_ip == BROKER_A);
+
+    CHECK(mqtt_push_all() == 0);
+    CHECK(published_num == MAX_DETECTOR_PER_WNC + MAX_LIGHT_PER_WNC);
+    CHECK(publishes == 4);      /* 60 detectors, 40 lights in batches of 32 */
+    CHECK(detector_held == 0 && light_held == 0);
+    for(i = 0; i < MAX_DETECTOR_PER_WNC; i++)
+    {
+        CHECK(published_of(NODE_DEVICE_TYPE_DETECTOR, 0x1000 + i, &rec) == 1);
+        CHECK(rec.state == (i & 1) && rec.value == i);
+    }
+    CHECK(published_of(NODE_DEVICE_TYPE_LIGHT, 0x2000, &rec) == 1);
+    CHECK(rec.state == NODE_STATE_OFFLINE && rec.value == 2);
+    CHECK(published_of(NODE_DEVICE_TYPE_LIGHT, 0x2000 + MAX_LIGHT_PER_WNC - 1, &rec) == 1);
+    CHECK(rec.state == 1 && rec.value == 2);
+
+    /* exactly one batch, and empty lists */
+    broker_clear();
+    set_nodes(MQTT_PUSH_MAX_RECORDS, 0);
+    CHECK(mqtt_push_all() == 0);
+    CHECK(publishes == 1 && published_num == MQTT_PUSH_MAX_RECORDS);
+    broker_clear();
+    set_nodes(0, 0);
+    CHECK(mqtt_push_all() == 0);
+    CHECK(publishes == 0);
+
+    mqtt_push_disconnect();
+    CHECK(broker_ip == 0);
+}
+
+/* broker from config: snapshot on connect, changes, reconnect on a new broker, off */
+static void script_broker(int step)
+{
+    switch(step)
+    {
+    case 0:     /* disabled, nothing queued and no connect */
+        mqtt_push_state(NODE_DEVICE_TYPE_DETECTOR, 0x1000, 1, 50);
+        CHECK(mq_num == 0);
+        CHECK(connects == 0);
+        g_wnc_config.mqtt_ip = BROKER_A;
+        break;
+    case 1:     /* connected to A, snapshot sent, a batch for each list */
+        CHECK(broker_ip == BROKER_A);
+        CHECK(publishes == 2 && published_num == 3);
+        mqtt_push_state(NODE_DEVICE_TYPE_DETECTOR, 0x1001, 0, 40);
+        break;
+    case 2:     /* change sent alone, move to B */
+        CHECK(publishes == 3 && published_num == 4);
+        CHECK(published[3].id == 0x1001 && published[3].state == 0 && published[3].value == 40);
+        g_wnc_config.mqtt_ip = BROKER_B;
+        break;
+    case 3:     /* reconnected to B with a snapshot */
+        CHECK(broker_ip == BROKER_B);
+        CHECK(connects == 2);
+        CHECK(publishes == 5 && published_num == 7);
+        mqtt_push_state(NODE_DEVICE_TYPE_LIGHT, 0x2001, 1, 2);
+        g_wnc_config.mqtt_ip = 0;
+        break;
+    case 4:     /* the change was sent before push was turned off */
+        CHECK(publishes == 6);
+        break;
+    case 5:     /* off: disconnected and changes dropped */
+        CHECK(broker_ip == 0);
+        mqtt_push_state(NODE_DEVICE_TYPE_DETECTOR, 0x1000, 0, 50);
+        CHECK(mq_num == 0);
+        break;
+    }
+}
+
+static void test_broker(void)
+{
+    set_nodes(2, 1);
+    broker_clear();
+    g_wnc_config.mqtt_ip = 0;
+    run_script(script_broker, 6);
+    CHECK(script_step == 6);
+    CHECK(publishes == 6 && connects == 2);
+}
+
+/* a refused connect is retried, a full queue gives a snapshot */
+static void script_retry(int step)
+{
+    int i;
+
+    switch(step)
+    {
+    case 0:     /* refused */
+        CHECK(connects == 1 && broker_ip == 0 && publishes == 0);
+        broker_up = 1;
+        break;
+    case 1:     /* connected, fill the queue and lose one change */
+        CHECK(broker_ip == BROKER_A && publishes == 2);
+        for(i = 0; i <= MQTT_PUSH_MQ_NUM; i++)
+        {
+            mqtt_push_state(NODE_DEVICE_TYPE_DETECTOR, 0x1000, i & 1, i);
+        }
+        CHECK(push_snapshot == 1);
+        broker_clear();
+        break;
+    case 2:     /* queued changes and a snapshot sent */
+        CHECK(mq_num == 0);
+        CHECK(published_num == MQTT_PUSH_MQ_NUM + 3);
+        break;
+    }
+}
+
+static void test_retry(void)
+{
+    set_nodes(2, 1);
+    broker_clear();
+    broker_up = 0;
+    g_wnc_config.mqtt_ip = BROKER_A;
+    run_script(script_retry, 3);
+    CHECK(script_step == 3);
+    mqtt_push_disconnect();
+}
+
+int main(void)
+{
+    wnc_device.id = 7;
+
+    test_push_all();
+    test_broker();
+    test_retry();
+
+    printf("mqtt push: %s, %d errors\n", fails ? "FAIL" : "PASS", fails);
+
+    return fails ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
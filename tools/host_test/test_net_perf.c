@@ -0,0 +1,372 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_net_perf.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host test of applications/user_components/net_perf.c on lwip tcp of the
+ * firmware lwipopts.h. the iperf peer is a second lwiperf session in the
+ * same stack: its client tests net_perf_server, its server takes the tests
+ * of net_perf_client. packets go through a wire netif that queues them for
+ * a ms, time is simulated and tcp timers run every TCP_TMR_INTERVAL.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lwip/opt.h>
+#include <lwip/sys.h>
+#include <lwip/mem.h>
+#include <lwip/memp.h>
+#include <lwip/pbuf.h>
+#include <lwip/netif.h>
+#include <lwip/ip4.h>
+#include <lwip/tcp.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/stats.h>
+#include <lwip/tcpip.h>
+#include <lwip/apps/lwiperf.h>
+
+#include "net_perf.h"
+#include "net_stat.h"
+
+#define DEVICE_IP       (0x0a01a8c0)    /* 192.168.1.10, network order */
+#define PEER_PORT       (5002)          /* iperf server of the peer */
+#define WIRE_QUEUE      (64)            /* packets on the wire */
+
+static int errors;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(errors++ < 10) { \
+    printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while(0)
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+static u32_t now_ms;
+
+u32_t sys_now(void)                                                 { return now_ms; }
+rt_tick_t rt_tick_get(void)                                         { return now_ms; }
+void rt_enter_critical(void)                                        { }
+void rt_exit_critical(void)                                         { }
+void *rt_memset(void *s, int c, rt_ubase_t count)                   { return memset(s, c, count); }
+err_t sys_mutex_new(sys_mutex_t *mutex)                             { return ERR_OK; }
+void rt_kprintf(const char *fmt, ...)                               { }
+void tcp_timer_needed(void)                                         { }
+
+/* netif.c of the firmware restarts dhcp on link up, the wire has no ethernet */
+int is_dhcp_enable;
+void dhcp_network_changed(struct netif *netif)                      { }
+void dhcp_cleanup(struct netif *netif)                              { }
+void dhcp_stop(struct netif *netif)                                 { }
+err_t ethernet_input(struct pbuf *p, struct netif *netif)           { return ERR_ARG; }
+err_t etharp_request(struct netif *netif, const ip4_addr_t *ipaddr) { return ERR_ARG; }
+void etharp_cleanup_netif(struct netif *netif)                      { }
+
+/* pbuf.c frees out of sequence data of tcp in the tcpip thread, next ms here */
+static tcpip_callback_fn    callback_fn;
+static void                 *callback_ctx;
+
+err_t tcpip_callback_with_block(tcpip_callback_fn function, void *ctx, u8_t block)
+{
+    CHECK(callback_fn == NULL, "second tcpip callback");
+    callback_fn  = function;
+    callback_ctx = ctx;
+    return ERR_OK;
+}
+
+/* tcpip core lock of net_perf calls, not taken inside lwip */
+sys_mutex_t lock_tcpip_core;
+static int  core_locked;
+
+void sys_mutex_lock(sys_mutex_t *mutex)
+{
+    if(mutex == &lock_tcpip_core)
+    {
+        CHECK(core_locked == 0, "tcpip core locked twice");
+        core_locked++;
+    }
+}
+
+void sys_mutex_unlock(sys_mutex_t *mutex)
+{
+    if(mutex == &lock_tcpip_core)
+    {
+        core_locked--;
+    }
+}
+
+void sys_arch_assert(const char *file, int line)
+{
+    printf("lwip assert at %s:%d\n", file, line);
+    abort();
+}
+
+/**
+ ******************************************************************************
+ *                                    WIRE
+ ******************************************************************************
+ */
+
+static struct netif     wire;
+static struct
+{
+    u16_t   len;
+    u8_t    data[1600];
+}                       wire_queue[WIRE_QUEUE];
+static int              wire_num;
+static int              wire_sent;
+static int              wire_drop_every;    /* drop every nth packet, 0 for none */
+
+static err_t wire_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+    wire_sent++;
+    if((wire_num == WIRE_QUEUE) || (wire_drop_every && (wire_sent % wire_drop_every) == 0))
+    {
+        return ERR_OK;
+    }
+    CHECK(p->tot_len <= sizeof(wire_queue[0].data), "packet of %u bytes", p->tot_len);
+    wire_queue[wire_num].len = pbuf_copy_partial(p, wire_queue[wire_num].data, p->tot_len, 0);
+    wire_num++;
+    return ERR_OK;
+}
+
+static err_t wire_init(struct netif *netif)
+{
+    netif->name[0] = 'w';
+    netif->name[1] = 'r';
+    netif->output  = wire_output;
+    netif->mtu     = 1500;
+    netif->flags   = NETIF_FLAG_LINK_UP;
+    return ERR_OK;
+}
+
+/* packets sent in the last ms arrive as a driver gives them, from the pbuf pool */
+static void wire_deliver(void)
+{
+    static struct { u16_t len; u8_t data[1600]; } packets[WIRE_QUEUE];
+    int i, num = wire_num;
+
+    memcpy(packets, wire_queue, sizeof(wire_queue[0]) * num);
+    wire_num = 0;
+    for(i = 0; i < num; i++)
+    {
+        struct pbuf *p = pbuf_alloc(PBUF_RAW, packets[i].len, PBUF_POOL);
+
+        if(p == NULL)
+        {
+            continue;
+        }
+        pbuf_take(p, packets[i].data, packets[i].len);
+        if(wire.input(p, &wire) != ERR_OK)
+        {
+            pbuf_free(p);
+        }
+    }
+}
+
+/* run the stack for some ms */
+static void run(u32_t ms)
+{
+    u32_t end = now_ms + ms;
+
+    while(now_ms != end)
+    {
+        now_ms++;
+        if(callback_fn != NULL)
+        {
+            tcpip_callback_fn fn = callback_fn;
+
+            callback_fn = NULL;
+            fn(callback_ctx);
+        }
+        wire_deliver();
+        if((now_ms % TCP_TMR_INTERVAL) == 0)
+        {
+            tcp_tmr();
+        }
+    }
+}
+
+/**
+ ******************************************************************************
+ *                                    PEER
+ ******************************************************************************
+ */
+
+static struct
+{
+    int     reports;
+    int     type;
+    u32_t   bytes;
+}                       peer;
+
+static void peer_report(void *arg, enum lwiperf_report_type report_type,
+                        const ip_addr_t *local_addr, u16_t local_port,
+                        const ip_addr_t *remote_addr, u16_t remote_port,
+                        u32_t bytes, u32_t ms, u32_t kbps)
+{
+    peer.reports++;
+    peer.type  = report_type;
+    peer.bytes = bytes;
+}
+
+static void *peer_client(u32_t seconds)
+{
+    ip_addr_t addr;
+
+    ip4_addr_set_u32(ip_2_ip4(&addr), DEVICE_IP);
+    memset(&peer, 0, sizeof(peer));
+    return lwiperf_start_tcp_client(&addr, NET_PERF_PORT, seconds, peer_report, NULL);
+}
+
+/**
+ ******************************************************************************
+ *                                    TESTS
+ ******************************************************************************
+ */
+
+/* the device serves a test of the peer client and goes on for the next */
+static void test_server(void)
+{
+    struct net_perf_stat stat;
+
+    CHECK(net_perf_server() == 0, "server start");
+    CHECK(net_perf_server() == -1, "second server start");
+    net_perf_get(&stat);
+    CHECK(stat.state == NET_PERF_SERVER && stat.tests == 0, "state %u tests %u", stat.state, stat.tests);
+
+    CHECK(peer_client(2) != NULL, "peer client");
+    run(3000);
+    CHECK(peer.reports == 1 && peer.type == LWIPERF_TCP_DONE_CLIENT, "peer report %d type %d",
+          peer.reports, peer.type);
+
+    net_perf_get(&stat);
+    CHECK(stat.state == NET_PERF_SERVER && stat.tests == 1, "state %u tests %u", stat.state, stat.tests);
+    CHECK(stat.report == LWIPERF_TCP_DONE_SERVER, "report %u", stat.report);
+    CHECK(stat.remote_ip == DEVICE_IP, "remote %08x", stat.remote_ip);
+    CHECK(stat.bytes > 100000 && stat.bytes == peer.bytes, "bytes %u peer %u", stat.bytes, peer.bytes);
+    CHECK(stat.ms >= 2000 && stat.ms < 2100, "ms %u", stat.ms);
+    CHECK(stat.kbps == stat.bytes * 8 / stat.ms, "kbps %u", stat.kbps);
+    CHECK(stat.retrans == 0, "retrans %u", stat.retrans);
+    CHECK(stat.pbuf_avail == PBUF_POOL_SIZE, "pbuf avail %u", stat.pbuf_avail);
+    CHECK(stat.pbuf_max > 0 && stat.pbuf_max <= PBUF_POOL_SIZE, "pbuf max %u", stat.pbuf_max);
+    CHECK(stat.mem_max > 0 && stat.mem_max <= MEM_SIZE, "heap max %u", stat.mem_max);
+
+    /* next test, then the port closes with the server */
+    CHECK(peer_client(1) != NULL, "peer client");
+    run(2000);
+    net_perf_get(&stat);
+    CHECK(stat.tests == 2 && stat.bytes == peer.bytes, "tests %u bytes %u", stat.tests, stat.bytes);
+
+    net_perf_stop();
+    net_perf_get(&stat);
+    CHECK(stat.state == NET_PERF_IDLE && stat.tests == 2, "state %u tests %u", stat.state, stat.tests);
+    CHECK(peer_client(1) != NULL, "peer client");
+    run(1000);
+    CHECK(peer.reports == 1 && peer.type == LWIPERF_TCP_ABORTED_REMOTE, "refused, peer type %d", peer.type);
+    CHECK(core_locked == 0, "tcpip core left locked");
+}
+
+/* the device sends to the peer server for a time, lost packets are retransmits */
+static void test_client(void)
+{
+    struct net_perf_stat stat;
+    void *server;
+
+    server = lwiperf_start_tcp_server(IP_ADDR_ANY, PEER_PORT, peer_report, NULL);
+    CHECK(server != NULL, "peer server");
+
+    CHECK(net_perf_client(DEVICE_IP, PEER_PORT, 0) == -1, "0 seconds");
+    CHECK(net_perf_client(DEVICE_IP, PEER_PORT, NET_PERF_MAX_SECONDS + 1) == -1, "too long");
+    CHECK(net_perf_client(0, PEER_PORT, 1) == -1, "no server");
+
+    memset(&peer, 0, sizeof(peer));
+    /* odd, data and acks alternate and an even count drops acks only */
+    wire_drop_every = 49;
+    CHECK(net_perf_client(DEVICE_IP, PEER_PORT, 2) == 0, "client start");
+    CHECK(net_perf_client(DEVICE_IP, PEER_PORT, 2) == -1, "second client start");
+    CHECK(net_perf_server() == -1, "server while client runs");
+    run(5000);
+    wire_drop_every = 0;
+
+    net_perf_get(&stat);
+    CHECK(stat.state == NET_PERF_IDLE && stat.tests == 3, "state %u tests %u", stat.state, stat.tests);
+    CHECK(stat.report == LWIPERF_TCP_DONE_CLIENT, "report %u", stat.report);
+    CHECK(peer.reports == 1 && peer.type == LWIPERF_TCP_DONE_SERVER, "peer report %d type %d",
+          peer.reports, peer.type);
+    CHECK(stat.bytes > 10000 && stat.bytes == peer.bytes, "bytes %u peer %u", stat.bytes, peer.bytes);
+    CHECK(stat.ms >= 2000, "ms %u", stat.ms);
+    CHECK(stat.retrans > 0, "no retransmits with packets lost");
+
+    /* stop in a test, no result */
+    memset(&peer, 0, sizeof(peer));
+    CHECK(net_perf_client(DEVICE_IP, PEER_PORT, 10) == 0, "client start");
+    run(500);
+    net_perf_stop();
+    run(1000);
+    net_perf_get(&stat);
+    CHECK(stat.state == NET_PERF_IDLE && stat.tests == 3, "state %u tests %u", stat.state, stat.tests);
+    CHECK(peer.reports == 1 && peer.type == LWIPERF_TCP_ABORTED_REMOTE, "peer report %d type %d",
+          peer.reports, peer.type);
+
+    lwiperf_abort(server);
+    CHECK(core_locked == 0, "tcpip core left locked");
+}
+
+/* no pcb or session memory left after time wait */
+static void test_leaks(void)
+{
+    run(2 * TCP_MSL + 1000);
+    CHECK(lwip_stats.memp[MEMP_TCP_PCB]->used == 0, "%u tcp pcbs", lwip_stats.memp[MEMP_TCP_PCB]->used);
+    CHECK(lwip_stats.memp[MEMP_TCP_PCB_LISTEN]->used == 0, "%u listen pcbs",
+          lwip_stats.memp[MEMP_TCP_PCB_LISTEN]->used);
+    CHECK(lwip_stats.memp[MEMP_TCP_SEG]->used == 0, "%u tcp segments", lwip_stats.memp[MEMP_TCP_SEG]->used);
+    CHECK(lwip_stats.memp[MEMP_PBUF_POOL]->used == 0, "%u pool pbufs", lwip_stats.memp[MEMP_PBUF_POOL]->used);
+    CHECK(lwip_stats.mem.used == 0, "%u heap bytes", (unsigned)lwip_stats.mem.used);
+}
+
+int main(void)
+{
+    ip4_addr_t ip, mask, gw;
+
+    stats_init();
+    mem_init();
+    memp_init();
+    pbuf_init();
+    tcp_init();
+
+    ip4_addr_set_u32(&ip, DEVICE_IP);
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    IP4_ADDR(&gw, 192, 168, 1, 1);
+    netif_add(&wire, &ip, &mask, &gw, NULL, wire_init, ip4_input);
+    netif_set_default(&wire);
+    netif_set_up(&wire);
+
+    test_server();
+    test_client();
+    test_leaks();
+
+    printf("net perf: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
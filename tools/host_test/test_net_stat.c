@@ -0,0 +1,203 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_net_stat.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host test of applications/user_components/net_stat.c on the lwip heap,
+ * pools and stats.c of the firmware lwipopts.h. checks the pool and heap
+ * figures, net_stat_reset and the perf test windows, which keep their own
+ * max when the max of stats.c is reset during a test.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lwip/opt.h>
+#include <lwip/sys.h>
+#include <lwip/mem.h>
+#include <lwip/memp.h>
+#include <lwip/stats.h>
+
+#include "net_stat.h"
+
+static int errors;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(errors++ < 10) { \
+    printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while(0)
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+static rt_tick_t tick;
+
+rt_tick_t rt_tick_get(void)                                         { return tick; }
+void rt_enter_critical(void)                                        { }
+void rt_exit_critical(void)                                         { }
+void *rt_memset(void *s, int c, rt_ubase_t count)                   { return memset(s, c, count); }
+err_t sys_mutex_new(sys_mutex_t *mutex)                             { return ERR_OK; }
+void sys_mutex_lock(sys_mutex_t *mutex)                             { }
+void sys_mutex_unlock(sys_mutex_t *mutex)                           { }
+void rt_kprintf(const char *fmt, ...)                               { }
+
+/**
+ ******************************************************************************
+ *                                    TEST
+ ******************************************************************************
+ */
+
+static struct net_pool_stat pools[MEMP_MAX];
+
+static struct net_pool_stat *pool(int index)
+{
+    CHECK(net_stat_pools(pools, MEMP_MAX) == MEMP_MAX, "pool count");
+    return &pools[index];
+}
+
+/* figures of a pool and the heap follow allocations, reset keeps used */
+static void test_figures(void)
+{
+    struct net_heap_stat heap;
+    void *pbuf[MEMP_NUM_PBUF + 1], *mem;
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        pbuf[i] = memp_malloc(MEMP_PBUF);
+    }
+    mem = mem_malloc(1000);
+
+    CHECK(pool(MEMP_PBUF)->used == 3 && pools[MEMP_PBUF].max == 3, "pbuf used %u max %u",
+          pools[MEMP_PBUF].used, pools[MEMP_PBUF].max);
+    CHECK(pools[MEMP_PBUF].avail == MEMP_NUM_PBUF, "pbuf avail %u", pools[MEMP_PBUF].avail);
+    CHECK(pools[MEMP_PBUF].name != NULL && pools[MEMP_PBUF].size > 0, "pbuf description");
+
+    net_stat_heap(&heap);
+    CHECK(heap.size == MEM_SIZE, "heap size %u", heap.size);
+    CHECK(heap.used >= 1000 && heap.max >= heap.used, "heap used %u max %u", heap.used, heap.max);
+
+    /* exhaust the pool, failures are counted */
+    for(i = 3; i < MEMP_NUM_PBUF + 1; i++)
+    {
+        pbuf[i] = memp_malloc(MEMP_PBUF);
+    }
+    CHECK(pbuf[MEMP_NUM_PBUF] == NULL, "pbuf over pool size");
+    CHECK(pool(MEMP_PBUF)->err == 1 && pools[MEMP_PBUF].max == MEMP_NUM_PBUF,
+          "pbuf err %u max %u", pools[MEMP_PBUF].err, pools[MEMP_PBUF].max);
+    for(i = 2; i < MEMP_NUM_PBUF; i++)
+    {
+        memp_free(MEMP_PBUF, pbuf[i]);
+    }
+    mem_free(mem);
+
+    tick = 5 * RT_TICK_PER_SECOND;
+    net_stat_reset();
+    CHECK(pool(MEMP_PBUF)->used == 2 && pools[MEMP_PBUF].max == 2 && pools[MEMP_PBUF].err == 0,
+          "after reset used %u max %u err %u",
+          pools[MEMP_PBUF].used, pools[MEMP_PBUF].max, pools[MEMP_PBUF].err);
+
+    tick += 3 * RT_TICK_PER_SECOND;
+    net_stat_heap(&heap);
+    CHECK(heap.seconds == 3, "%u seconds since reset", heap.seconds);
+    CHECK(heap.max == heap.used, "heap max %u used %u after reset", heap.max, heap.used);
+
+    memp_free(MEMP_PBUF, pbuf[0]);
+    memp_free(MEMP_PBUF, pbuf[1]);
+}
+
+/* windows of perf tests, independent of net_stat_reset */
+static void test_window(void)
+{
+    struct net_heap_stat heap;
+    void *a[3];
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        a[i] = memp_malloc(MEMP_PBUF);
+    }
+    for(i = 0; i < 3; i++)
+    {
+        memp_free(MEMP_PBUF, a[i]);
+    }
+    net_stat_reset();
+    for(i = 0; i < 3; i++)
+    {
+        a[i] = memp_malloc(MEMP_PBUF);
+    }
+    for(i = 0; i < 3; i++)
+    {
+        memp_free(MEMP_PBUF, a[i]);
+    }
+
+    /* a window starts at the current use, the max before it is kept */
+    net_stat_window_start();
+    for(i = 0; i < 2; i++)
+    {
+        a[i] = memp_malloc(MEMP_PBUF);
+    }
+    CHECK(net_stat_window_pool_max(MEMP_PBUF) == 2, "window max %u", net_stat_window_pool_max(MEMP_PBUF));
+    CHECK(pool(MEMP_PBUF)->max == 3, "pool max %u lost by window", pools[MEMP_PBUF].max);
+
+    /* reset during a test does not lose the window */
+    net_stat_reset();
+    CHECK(pool(MEMP_PBUF)->max == 2 && net_stat_window_pool_max(MEMP_PBUF) == 2,
+          "after reset max %u window %u", pools[MEMP_PBUF].max, net_stat_window_pool_max(MEMP_PBUF));
+    a[2] = memp_malloc(MEMP_PBUF);
+    memp_free(MEMP_PBUF, a[2]);
+    CHECK(net_stat_window_pool_max(MEMP_PBUF) == 3, "window max %u", net_stat_window_pool_max(MEMP_PBUF));
+    for(i = 0; i < 2; i++)
+    {
+        memp_free(MEMP_PBUF, a[i]);
+    }
+    net_stat_reset();
+    CHECK(pool(MEMP_PBUF)->max == 0 && net_stat_window_pool_max(MEMP_PBUF) == 3,
+          "all freed, reset max %u window %u", pools[MEMP_PBUF].max, net_stat_window_pool_max(MEMP_PBUF));
+
+    /* next window */
+    net_stat_window_start();
+    CHECK(net_stat_window_pool_max(MEMP_PBUF) == 0 && pool(MEMP_PBUF)->max == 0,
+          "new window %u pool max %u", net_stat_window_pool_max(MEMP_PBUF), pools[MEMP_PBUF].max);
+    CHECK(net_stat_window_pool_max(MEMP_MAX) == 0, "window of no pool");
+
+    /* heap in use when a window starts counts in it */
+    a[0] = mem_malloc(500);
+    net_stat_window_start();
+    mem_free(a[0]);
+    net_stat_heap(&heap);
+    CHECK(heap.max >= 500 && net_stat_window_heap_max() >= 500, "heap max %u window %u",
+          heap.max, net_stat_window_heap_max());
+}
+
+int main(void)
+{
+    stats_init();
+    mem_init();
+    memp_init();
+
+    test_figures();
+    test_window();
+
+    printf("net stat: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,748 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_tcp_v2.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ * 2017-06-29      Test          Set and get mqtt broker.
+ ******************************************************************************
+ */
+
+/*
+ * host test of tcp protocol v2 of thread_tcp_server.c: framing of packets
+ * split or joined by tcp and search of a packet after bytes that are not one,
+ * downloads with pipelined chunks, go back to a bad chunk and resume, and
+ * windowed read streams, and the mqtt broker saved in wnc config.
+ * thread_tcp_server.c is built into this file for its
+ * connection state, external_flash.c runs on a flash kept in memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "wnc_data_base.h"
+#include "../../applications/user_thread/thread_network/thread_tcp_server.c"
+
+#define FLASH_SIZE      (4 * 1024 * 1024)
+#define LOG_SIZE        (6000)
+
+static int fails;
+
+#define CHECK(cond) do { if(!(cond)) { fails++; if(fails < 10) \
+    printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); } } while(0)
+
+/* globals of other modules */
+uint32_t                SystemCoreClock = 120000000;
+device_params_t         wnc_device;
+detector_info_list_t    g_detector_info_list;
+light_info_list_t       g_light_info_list;
+relation_list_t         g_relation_list;
+rt_mq_t                 mq_data_proc;
+rt_mq_t                 mq_led;
+rt_mq_t                 mq_lora_send;
+rt_mq_t                 mq_sys_ctrl;
+int                     is_dhcp_enable;
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+void *rt_memset(void *s, int c, rt_ubase_t n)                       { return memset(s, c, n); }
+void *rt_memcpy(void *d, const void *s, rt_ubase_t n)               { return memcpy(d, s, n); }
+void *rt_memmove(void *d, const void *s, rt_ubase_t n)              { return memmove(d, s, n); }
+rt_int32_t rt_memcmp(const void *a, const void *b, rt_ubase_t n)    { return memcmp(a, b, n); }
+rt_size_t rt_strlen(const char *s)                                  { return strlen(s); }
+rt_int32_t rt_strncmp(const char *a, const char *b, rt_ubase_t n)   { return strncmp(a, b, n); }
+char *rt_strncpy(char *d, const char *s, rt_ubase_t n)              { return strncpy(d, s, n); }
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *format, ...)
+{
+    va_list args;
+    int ret;
+
+    va_start(args, format);
+    ret = vsnprintf(buf, size, format, args);
+    va_end(args);
+
+    return ret;
+}
+
+rt_int32_t rt_sprintf(char *buf, const char *format, ...)
+{
+    va_list args;
+    int ret;
+
+    va_start(args, format);
+    ret = vsprintf(buf, format, args);
+    va_end(args);
+
+    return ret;
+}
+
+u32_t lwip_htonl(u32_t x)                                           { return __builtin_bswap32(x); }
+u16_t lwip_htons(u16_t x)                                           { return __builtin_bswap16(x); }
+rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)       { return RT_EOK; }
+rt_err_t rt_thread_delay(rt_tick_t tick)                            { return RT_EOK; }
+void trace_printf(const char *fmt, ...)                             { }
+void add_log(const char *data)                                      { }
+void feed_dog(void)                                                 { }
+
+rt_uint32_t get_ip_addr(void)                                       { return 0; }
+rt_uint32_t get_gw_addr(void)                                       { return 0; }
+rt_uint32_t get_netmask(void)                                       { return 0; }
+rt_uint16_t get_self_detector_info(char *data)                      { return 0; }
+rt_err_t init_device_param(void)                                    { return RT_EOK; }
+rt_err_t save_device_params(const rt_uint16_t *data)                { return RT_EOK; }
+int get_lora_channel(rt_uint8_t if_chain, rt_uint8_t *enable,
+                     rt_uint32_t *freq_hz, rt_uint8_t *sf_mask)     { return -1; }
+int set_lora_channel(rt_uint8_t if_chain, rt_uint8_t enable,
+                     rt_uint32_t freq_hz, rt_uint8_t sf_mask)       { return -1; }
+int net_perf_client(rt_uint32_t ip, rt_uint16_t port, rt_uint32_t seconds) { return -1; }
+int net_perf_server(void)                                           { return -1; }
+void net_perf_get(struct net_perf_stat *stat)                       { memset(stat, 0, sizeof(*stat)); }
+void net_perf_stop(void)                                            { }
+void net_stat_heap(struct net_heap_stat *stat)                      { memset(stat, 0, sizeof(*stat)); }
+int net_stat_pools(struct net_pool_stat *stat, int max)             { return 0; }
+void net_stat_reset(void)                                           { }
+int profiler_get(int index, struct profiler_stat *stat)             { return -1; }
+int profiler_get_events(struct profiler_event *events, int num)     { return 0; }
+void profiler_reset(void)                                           { }
+void threads_clear_dog_stat(void)                                   { }
+int threads_get_dog_stat(int index, struct soft_dog_stat *stat)     { return -1; }
+int threads_set_dog_deadline(int index, rt_uint32_t deadline)       { return -1; }
+rt_err_t wall_clock_get(RTC_T *rtc)                                 { return -RT_ERROR; }
+rt_err_t wall_clock_set(RTC_T *rtc)                                 { return -RT_ERROR; }
+rt_size_t prepare_read_system_log(void)                             { return 0; }
+rt_size_t read_system_log(char *buf, rt_uint32_t max_size)          { return 0; }
+
+int lwip_socket(int domain, int type, int protocol)                 { return -1; }
+int lwip_bind(int s, const struct sockaddr *name, socklen_t namelen) { return -1; }
+int lwip_listen(int s, int backlog)                                 { return -1; }
+int lwip_accept(int s, struct sockaddr *addr, socklen_t *addrlen)   { return -1; }
+int lwip_close(int s)                                               { return 0; }
+int lwip_recv(int s, void *mem, size_t len, int flags)              { return -1; }
+int lwip_fcntl(int s, int cmd, int val)                             { return 0; }
+int lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t optlen)
+{
+    return 0;
+}
+int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset,
+                struct timeval *timeout)
+{
+    return -1;
+}
+
+/**
+ ******************************************************************************
+ *                                    FLASH
+ ******************************************************************************
+ */
+
+static unsigned char        flash[FLASH_SIZE];
+static struct rt_device     flash_dev;
+
+rt_device_t rt_device_find(const char *name)                        { return &flash_dev; }
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag)         { return RT_EOK; }
+
+rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    memcpy(buffer, &flash[pos], size);
+    return size;
+}
+
+/* nor flash only clears bits, data must be written to erased area */
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    const unsigned char *data = buffer;
+    rt_size_t i;
+
+    for(i = 0; i < size; i++)
+    {
+        CHECK((flash[pos + i] & data[i]) == data[i]);
+        flash[pos + i] = data[i];
+    }
+    return size;
+}
+
+rt_err_t rt_device_control(rt_device_t dev, rt_uint8_t cmd, void *args)
+{
+    unsigned long addr = (unsigned long)args;
+    unsigned long size = (cmd == GD_FLASH_CTRL_SCT_ERASE) ? 4096 : 65536;
+
+    memset(&flash[addr & ~(size - 1)], 0xff, size);
+    return RT_EOK;
+}
+
+/* work state log, read in sequence as log modules do */
+static char                 work_log[LOG_SIZE];
+static rt_uint32_t          work_log_pos;
+
+rt_size_t prepare_read_work_state_log(void)
+{
+    work_log_pos = 0;
+    return LOG_SIZE;
+}
+
+rt_size_t read_work_state_log(char *buf, rt_uint32_t max_size)
+{
+    rt_uint32_t size = min(max_size, LOG_SIZE - work_log_pos);
+
+    if(buf != RT_NULL)
+    {
+        memcpy(buf, &work_log[work_log_pos], size);
+    }
+    work_log_pos += size;
+    return size;
+}
+
+/**
+ ******************************************************************************
+ *                                    HOST
+ ******************************************************************************
+ */
+
+/* bytes device sent, read back by next_reply() */
+static unsigned char        sent[1 << 20];
+static size_t               sent_len;
+static size_t               sent_read;
+
+int lwip_send(int s, const void *dataptr, size_t size, int flags)
+{
+    memcpy(&sent[sent_len], dataptr, size);
+    sent_len += size;
+    return size;
+}
+
+static struct tcp_conn *conn = &tcp_conns[0];
+
+/* data given to handle_recv_pack in pieces as tcp may split it, recv gets tcp_buf full at most */
+static void feed(const void *data, size_t len, size_t piece)
+{
+    static char segment[sizeof(tcp_buf)];
+    size_t i, n;
+
+    piece = min(piece, sizeof(segment));
+    for(i = 0; i < len; i += n)
+    {
+        n = min(piece, len - i);
+        memcpy(segment, (const char *)data + i, n);
+        handle_recv_pack(conn, segment, n);
+    }
+}
+
+static size_t v1_packet(unsigned char *buf, rt_uint8_t cmd, const void *payload, rt_uint16_t len)
+{
+    tcp_pack_header_t header = (tcp_pack_header_t)buf;
+
+    memset(buf, 0, sizeof(struct tcp_pack_header));
+    header->cmd      = cmd;
+    header->data_len = htons(len);
+    memcpy(header->device_type, DEVICE_TYPE, strlen(DEVICE_TYPE));
+    memcpy(buf + sizeof(struct tcp_pack_header), payload, len);
+    len += sizeof(struct tcp_pack_header);
+    buf[len] = xor_verify((char *)buf, len);
+
+    return len + 1;
+}
+
+static size_t v2_frame(unsigned char *buf, rt_uint8_t cmd, rt_uint16_t req_id,
+                       const void *payload, rt_uint16_t len)
+{
+    tcp_v2_header_t header = (tcp_v2_header_t)buf;
+    rt_uint32_t crc;
+
+    memset(buf, 0, sizeof(struct tcp_v2_header));
+    header->magic    = TCP_V2_MAGIC;
+    header->version  = TCP_V2_VERSION;
+    header->cmd      = cmd;
+    header->req_id   = htons(req_id);
+    header->data_len = htons(len);
+    if(len > 0)
+    {
+        memcpy(buf + sizeof(struct tcp_v2_header), payload, len);
+    }
+
+    crc = crc32_verify(0, (char *)buf, sizeof(struct tcp_v2_header) - sizeof(header->crc));
+    crc = crc32_verify(crc, (char *)buf + sizeof(struct tcp_v2_header), len);
+    header->crc = htonl(crc);
+
+    return sizeof(struct tcp_v2_header) + len;
+}
+
+/* next v2 frame device sent, -1 when none */
+static int next_reply(tcp_v2_header_t *header, unsigned char **payload)
+{
+    unsigned char *frame = &sent[sent_read];
+    rt_uint32_t crc;
+    int len;
+
+    if(sent_read + sizeof(struct tcp_v2_header) > sent_len)
+    {
+        return -1;
+    }
+
+    *header  = (tcp_v2_header_t)frame;
+    *payload = frame + sizeof(struct tcp_v2_header);
+    len      = ntohs((*header)->data_len);
+    crc = crc32_verify(0, (char *)frame, sizeof(struct tcp_v2_header) - sizeof((*header)->crc));
+    crc = crc32_verify(crc, (char *)*payload, len);
+    CHECK(frame[0] == TCP_V2_MAGIC);
+    CHECK(crc == ntohl((*header)->crc));
+
+    sent_read += sizeof(struct tcp_v2_header) + len;
+    return len;
+}
+
+static rt_uint32_t get_be32(const unsigned char *p)
+{
+    return ((rt_uint32_t)p[0] << 24) | ((rt_uint32_t)p[1] << 16) | ((rt_uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(unsigned char *p, rt_uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/**
+ ******************************************************************************
+ *                                    TESTS
+ ******************************************************************************
+ */
+
+static unsigned char        frame[2 * sizeof(conn->buf)];
+static unsigned char        stream[16 * sizeof(conn->buf)];
+
+static void test_negotiate(void)
+{
+    unsigned char packet[64], version = TCP_V2_VERSION;
+    size_t len;
+
+    /* v2 frame before negotiation is not a packet */
+    len = v2_frame(frame, TCP_V2_CANCEL, 1, RT_NULL, 0);
+    feed(frame, len, 1);
+    CHECK(sent_len == 0);
+
+    len = v1_packet(packet, CMD_PROTO_V2, &version, 1);
+    feed(packet, len, len);
+    CHECK(conn->v2 == 1);
+    CHECK(sent_len == sizeof(struct tcp_pack_header) + 5 + 1);
+    CHECK(sent[sizeof(struct tcp_pack_header)] == 1);
+    CHECK(sent[sizeof(struct tcp_pack_header) + 1] == TCP_V2_VERSION);
+    CHECK(sent[sizeof(struct tcp_pack_header) + 4] == TCP_V2_MAX_WINDOW);
+    sent_read = sent_len;
+}
+
+static void test_framing(void)
+{
+    tcp_v2_header_t header;
+    unsigned char *payload;
+    unsigned char packet[64], version = TCP_V2_VERSION;
+    size_t len, v1_len, piece;
+    int n;
+
+    v1_len = v1_packet(packet, CMD_PROTO_V2, &version, 1);
+
+    /* v1 packet tunneled in a v2 frame, split in every piece size */
+    for(piece = 1; piece <= 20; piece++)
+    {
+        len = v2_frame(frame, TCP_V2_TUNNEL, 0x1234, packet, v1_len);
+        feed(frame, len, piece);
+        n = next_reply(&header, &payload);
+        CHECK(n == sizeof(struct tcp_pack_header) + 5 + 1);
+        CHECK(header->cmd == TCP_V2_TUNNEL && ntohs(header->req_id) == 0x1234);
+        CHECK(payload[0] == CMD_PROTO_V2 && payload[sizeof(struct tcp_pack_header)] == 1);
+    }
+
+    /* frames joined in a segment */
+    len  = v2_frame(frame, TCP_V2_CANCEL, 1, RT_NULL, 0);
+    len += v2_frame(frame + len, TCP_V2_CANCEL, 2, RT_NULL, 0);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 1);
+    CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 2);
+
+    /* frame after bytes of no packet */
+    memset(frame, 0x33, 7);
+    len = 7 + v2_frame(frame + 7, TCP_V2_CANCEL, 3, RT_NULL, 0);
+    feed(frame, len, 5);
+    CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 3);
+
+    /*
+     * a magic byte followed by a bad version is a rejected header, a frame
+     * and a v1 packet starting in it are still found
+     */
+    for(piece = 1; piece <= 13; piece += 4)
+    {
+        frame[0] = TCP_V2_MAGIC;
+        frame[1] = 0x7f;
+        len = 2 + v2_frame(frame + 2, TCP_V2_CANCEL, 4, RT_NULL, 0);
+        feed(frame, len, piece);
+        CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 4);
+
+        frame[0] = TCP_V2_MAGIC;
+        frame[1] = 0x7f;
+        frame[2] = 0x55;
+        len = 3 + v1_packet(frame + 3, CMD_PROTO_V2, &version, 1);
+        feed(frame, len, piece);
+        CHECK(sent_len - sent_read == v1_len + 4);
+        CHECK(sent[sent_read] == CMD_PROTO_V2);
+        sent_read = sent_len;
+    }
+
+    /* a header with too long payload is rejected the same */
+    len = v2_frame(frame, TCP_V2_CANCEL, 5, RT_NULL, 0);
+    frame[6] = 0xff;
+    len += v2_frame(frame + len, TCP_V2_CANCEL, 6, RT_NULL, 0);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 6);
+    CHECK(next_reply(&header, &payload) == -1);
+
+    /* crc error and unknown command are refused with their request id */
+    len = v2_frame(frame, TCP_V2_CANCEL, 7, RT_NULL, 0);
+    frame[9] ^= 1;
+    feed(frame, len, 3);
+    CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 7);
+    CHECK(header->flags == TCP_V2_FLAG_ERR && payload[0] == TCP_V2_ERR_CRC);
+
+    len = v2_frame(frame, 0x77, 8, "ab", 2);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &payload) == 1 && ntohs(header->req_id) == 8);
+    CHECK(header->flags == TCP_V2_FLAG_ERR && payload[0] == TCP_V2_ERR_CMD);
+}
+
+/* WRITE_OPEN payload of upgrade file */
+static size_t write_open(unsigned char *payload, rt_uint32_t size, rt_uint32_t offset)
+{
+    const char *name = "LN_upgrade_7.bin";
+
+    put_be32(payload, size);
+    put_be32(payload + 4, offset);
+    payload[8] = strlen(name);
+    memcpy(payload + 9, name, strlen(name));
+
+    return 9 + strlen(name);
+}
+
+static void test_download(void)
+{
+    enum { CHUNK = 1000, CHUNKS = 5, IMAGE = CHUNK * CHUNKS };
+    static unsigned char image[IMAGE];
+    unsigned char payload[CHUNK + 4];
+    tcp_v2_header_t header;
+    unsigned char *reply;
+    size_t len = 0;
+    int i;
+
+    for(i = 0; i < IMAGE; i++)
+    {
+        image[i] = rand();
+    }
+
+    len = write_open(payload, IMAGE, 0);
+    len = v2_frame(frame, TCP_V2_WRITE_OPEN, 20, payload, len);
+    feed(frame, len, 7);
+    CHECK(next_reply(&header, &reply) == 5);
+    CHECK(header->cmd == TCP_V2_WRITE_OPEN && reply[0] == 1 && get_be32(reply + 1) == 0);
+
+    /* all chunks sent without waiting, chunk 1 is damaged on its way */
+    for(i = 0, len = 0; i < CHUNKS; i++)
+    {
+        put_be32(payload, i * CHUNK);
+        memcpy(payload + 4, &image[i * CHUNK], CHUNK);
+        len += v2_frame(&stream[len], TCP_V2_WRITE_DATA, 100 + i, payload, CHUNK + 4);
+        if(i == 1)
+        {
+            stream[len - 1] ^= 0x55;
+        }
+    }
+    feed(stream, len, 1460);
+
+    /* chunks after the bad one are refused, host goes back to its offset */
+    for(i = 0; i < CHUNKS; i++)
+    {
+        CHECK(next_reply(&header, &reply) == 5);
+        CHECK(header->cmd == TCP_V2_WRITE_DATA && ntohs(header->req_id) == 100 + i);
+        CHECK(reply[0] == ((i == 0) ? DOWNLOAD_DOWNLOADING : DOWNLOAD_ERR));
+        CHECK(get_be32(reply + 1) == CHUNK);
+    }
+
+    /* connection lost, host resumes at 4000, device has saved up to 1000 */
+    len = write_open(payload, IMAGE, 4000);
+    len = v2_frame(frame, TCP_V2_WRITE_OPEN, 21, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 5);
+    CHECK(reply[0] == 1 && get_be32(reply + 1) == CHUNK);
+
+    for(i = 1; i < CHUNKS; i++)
+    {
+        put_be32(payload, i * CHUNK);
+        memcpy(payload + 4, &image[i * CHUNK], CHUNK);
+        len = v2_frame(frame, TCP_V2_WRITE_DATA, 200 + i, payload, CHUNK + 4);
+        feed(frame, len, 1460);
+        CHECK(next_reply(&header, &reply) == 5);
+        CHECK(reply[0] == ((i == CHUNKS - 1) ? DOWNLOAD_OVER : DOWNLOAD_DOWNLOADING));
+        CHECK(get_be32(reply + 1) == (i + 1) * CHUNK);
+    }
+
+    CHECK(memcmp(&flash[FIRMWAREUPGRADE_BASE_SCT * FLASH_BYTES_PER_SECTOR], image, IMAGE) == 0);
+    CHECK(memcmp(&flash[FIRMUPINFO_BASE_ADDR], "\xa5\xa5\xa5\xa5", 4) == 0);
+}
+
+/* READ_OPEN payload of work state log */
+static size_t read_open(unsigned char *payload, rt_uint32_t offset, rt_uint8_t window)
+{
+    const char *name = "LN_work_state.log";
+
+    put_be32(payload, offset);
+    payload[4] = window;
+    payload[5] = strlen(name);
+    memcpy(payload + 6, name, strlen(name));
+
+    return 6 + strlen(name);
+}
+
+static void test_read_stream(void)
+{
+    unsigned char payload[64];
+    tcp_v2_header_t header;
+    unsigned char *reply;
+    size_t len;
+    int i, n;
+
+    for(i = 0; i < LOG_SIZE; i++)
+    {
+        work_log[i] = 'a' + i % 26;
+    }
+
+    /* window of 2 chunks from 500, log ends in the second one */
+    len = read_open(payload, 500, 2);
+    len = v2_frame(frame, TCP_V2_READ_OPEN, 30, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 9);
+    CHECK(reply[0] == 1 && get_be32(reply + 1) == LOG_SIZE && get_be32(reply + 5) == 500);
+
+    /* a second stream is refused while one runs */
+    len = read_open(payload, 0, 1);
+    len = v2_frame(frame, TCP_V2_READ_OPEN, 31, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 1 && reply[0] == 0);
+
+    /* 2 chunks, then window full until acked */
+    CHECK(stream_can_send(conn));
+    stream_pump(conn);
+    CHECK(!stream_can_send(conn));
+    for(i = 0; i < 2; i++)
+    {
+        n = next_reply(&header, &reply);
+        CHECK(n == TCP_V2_MAX_PAYLOAD);
+        CHECK(header->cmd == TCP_V2_READ_DATA && ntohs(header->req_id) == 30 && header->flags == 0);
+        CHECK(get_be32(reply) == 500 + i * TCP_V2_CHUNK_SIZE);
+        CHECK(memcmp(reply + 4, &work_log[500 + i * TCP_V2_CHUNK_SIZE], n - 4) == 0);
+    }
+
+    /* an ack of more than sent is ignored, then the first chunk is acked */
+    put_be32(payload, 500 + 3 * TCP_V2_CHUNK_SIZE);
+    len = v2_frame(frame, TCP_V2_READ_ACK, 30, payload, 4);
+    feed(frame, len, len);
+    CHECK(!stream_can_send(conn));
+
+    put_be32(payload, 500 + TCP_V2_CHUNK_SIZE);
+    len = v2_frame(frame, TCP_V2_READ_ACK, 30, payload, 4);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == -1);
+    CHECK(stream_can_send(conn));
+
+    /* chunks up to end of log, last one is marked */
+    while(stream_can_send(conn))
+    {
+        stream_pump(conn);
+        put_be32(payload, conn->read.offset);
+        len = v2_frame(frame, TCP_V2_READ_ACK, 30, payload, 4);
+        feed(frame, len, len);
+    }
+    for(i = 500 + 2 * TCP_V2_CHUNK_SIZE; i < LOG_SIZE; i += n - 4)
+    {
+        n = next_reply(&header, &reply);
+        CHECK(n > 4 && get_be32(reply) == (rt_uint32_t)i);
+        CHECK(memcmp(reply + 4, &work_log[i], n - 4) == 0);
+        CHECK(header->flags == ((i + n - 4 >= LOG_SIZE) ? TCP_V2_FLAG_FIN : 0));
+    }
+    CHECK(next_reply(&header, &reply) == -1);
+
+    /* cancel of a stream of window 1 */
+    len = read_open(payload, 0, 1);
+    len = v2_frame(frame, TCP_V2_READ_OPEN, 32, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 9 && reply[0] == 1);
+    stream_pump(conn);
+    CHECK(next_reply(&header, &reply) == TCP_V2_MAX_PAYLOAD && get_be32(reply) == 0);
+    CHECK(!stream_can_send(conn));
+
+    len = v2_frame(frame, TCP_V2_CANCEL, 32, RT_NULL, 0);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 1 && reply[0] == 1);
+    CHECK(!conn->read.active);
+}
+
+/* a log held by a stream of one connection is refused to others until closed */
+static void test_log_owner(void)
+{
+    static const char v1_name[] = "\0\x11LN_work_state.log";
+    struct tcp_conn *first = &tcp_conns[0], *second = &tcp_conns[1];
+    unsigned char payload[64], packet[64];
+    tcp_v2_header_t header;
+    unsigned char *reply;
+    size_t len, v1_len;
+
+    rt_memset(second, 0, sizeof(*second));
+    second->fd       = 2;
+    second->v2       = 1;
+    second->new_pack = 1;
+
+    len = read_open(payload, 0, 1);
+    len = v2_frame(frame, TCP_V2_READ_OPEN, 40, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 9 && reply[0] == 1);
+    stream_pump(conn);
+    CHECK(next_reply(&header, &reply) == TCP_V2_MAX_PAYLOAD && get_be32(reply) == 0);
+    put_be32(payload, TCP_V2_CHUNK_SIZE);
+    len = v2_frame(frame, TCP_V2_READ_ACK, 40, payload, 4);
+    feed(frame, len, len);
+
+    /* READ_OPEN and a tunneled v1 upload of the log on another connection */
+    conn = second;
+    len = read_open(payload, 0, 1);
+    len = v2_frame(frame, TCP_V2_READ_OPEN, 41, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 1 && reply[0] == 0);
+
+    v1_len = v1_packet(packet, CMD_CONFIGURE_FILES_OPT, v1_name, sizeof(v1_name));
+    ((tcp_pack_header_t)packet)->pack_sn = 1;
+    packet[v1_len - 1] = xor_verify((char *)packet, v1_len - 1);
+    len = v2_frame(frame, TCP_V2_TUNNEL, 42, packet, v1_len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == sizeof(struct tcp_pack_header) + 1 + 1);
+    CHECK(header->cmd == TCP_V2_TUNNEL && reply[sizeof(struct tcp_pack_header)] == 0);
+    CHECK(next_reply(&header, &reply) == -1);
+
+    /* the stream goes on from where it was */
+    conn = first;
+    stream_pump(conn);
+    CHECK(next_reply(&header, &reply) == TCP_V2_MAX_PAYLOAD);
+    CHECK(get_be32(reply) == TCP_V2_CHUNK_SIZE);
+    CHECK(memcmp(reply + 4, &work_log[TCP_V2_CHUNK_SIZE], TCP_V2_CHUNK_SIZE) == 0);
+
+    /* free after cancel */
+    len = v2_frame(frame, TCP_V2_CANCEL, 40, RT_NULL, 0);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 1 && reply[0] == 1);
+
+    conn = second;
+    len = read_open(payload, 0, 1);
+    len = v2_frame(frame, TCP_V2_READ_OPEN, 43, payload, len);
+    feed(frame, len, len);
+    CHECK(next_reply(&header, &reply) == 9 && reply[0] == 1);
+    stream_stop(conn);
+    conn = first;
+}
+
+/* v1 command tunneled by v2, length of reply data and the data in *data */
+static int v1_command(rt_uint8_t cmd, const void *payload, rt_uint16_t len, unsigned char **data)
+{
+    unsigned char packet[64];
+    tcp_v2_header_t header;
+    unsigned char *reply;
+    size_t v1_len;
+    int n;
+
+    v1_len = v1_packet(packet, cmd, payload, len);
+    len = v2_frame(frame, TCP_V2_TUNNEL, 50, packet, v1_len);
+    feed(frame, len, len);
+    n = next_reply(&header, &reply);
+    if(n < (int)sizeof(struct tcp_pack_header) + 1)
+    {
+        return -1;
+    }
+    CHECK(reply[n - 1] == (unsigned char)xor_verify((char *)reply, n - 1));
+    *data = reply + sizeof(struct tcp_pack_header);
+    return ntohs(((tcp_pack_header_t)reply)->data_len);
+}
+
+static void test_mqtt_broker(void)
+{
+    static const char set_a[]     = "\x01\x0b" "192.168.1.2";
+    static const char set_bad[]   = "\x01\x09" "192.168.1";
+    static const char set_short[] = "\x01\x0b" "192.168.1.";
+    static const char set_off[]   = "\x01\x00";
+    unsigned char get = 0, *data;
+
+    /* no broker by default */
+    get_wnc_config();
+    CHECK(g_wnc_config.mqtt_ip == 0);
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, &get, 1, &data) == 1 && data[0] == 0);
+
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, set_a, sizeof(set_a) - 1, &data) == 1 && data[0] == 1);
+    CHECK(g_wnc_config.mqtt_ip == 0x0201a8c0);
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, &get, 1, &data) == 12);
+    CHECK(data[0] == 11 && memcmp(&data[1], "192.168.1.2", 11) == 0);
+
+    /* saved over a reboot */
+    rt_memset(&g_wnc_config, 0, sizeof(g_wnc_config));
+    get_wnc_config();
+    CHECK(g_wnc_config.mqtt_ip == 0x0201a8c0);
+
+    /* bad address or length keeps the broker */
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, set_bad, sizeof(set_bad) - 1, &data) == 1 && data[0] == 0);
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, set_short, sizeof(set_short) - 1, &data) == 1 && data[0] == 0);
+    CHECK(g_wnc_config.mqtt_ip == 0x0201a8c0);
+
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, set_off, sizeof(set_off) - 1, &data) == 1 && data[0] == 1);
+    CHECK(g_wnc_config.mqtt_ip == 0);
+    CHECK(v1_command(CMD_MQTT_BROKER_OPT, &get, 1, &data) == 1 && data[0] == 0);
+
+    /* a config saved before mqtt_ip was added reads erased flash */
+    g_wnc_config_bak.mqtt_ip = 0xffffffff;
+    set_wnc_config();
+    get_wnc_config();
+    CHECK(g_wnc_config.mqtt_ip == 0);
+}
+
+int main(void)
+{
+    srand(1);
+    memset(flash, 0xff, sizeof(flash));
+    ext_flash_init("flash");
+
+    rt_memset(conn, 0, sizeof(*conn));
+    conn->fd       = 1;
+    conn->new_pack = 1;
+
+    test_negotiate();
+    test_framing();
+    test_download();
+    test_read_stream();
+    test_log_owner();
+    test_mqtt_broker();
+
+    printf("tcp v2: %s, %d errors\n", fails ? "FAIL" : "PASS", fails);
+
+    return fails ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
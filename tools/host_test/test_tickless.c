@@ -0,0 +1,142 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_tickless.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host test of bsp/tickless.c. SysTick is modelled as the Cortex-M3 counts:
+ * written VAL 0, LOAD is loaded on the first cycle, COUNTFLAG is set and
+ * the tick fires on the 1 to 0 count. A free running cycle count is the
+ * truth, and system tick has to equal the tick boundaries it passed after
+ * any number of sleeps with any entry and exit time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tickless.h"
+
+#define MAX_RELOAD      (0x00FFFFFFUL)
+#define SLEEPS          (200000)
+
+static int errors;
+
+#define CHECK(cond) do { if(!(cond)) { errors++; if(errors < 10) \
+    printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); } } while(0)
+
+static rt_uint32_t rand_range(rt_uint32_t lo, rt_uint32_t hi)
+{
+    return lo + (rt_uint32_t)(((unsigned long long)rand() << 16 ^ rand()) % (hi - lo + 1));
+}
+
+/* SysTick VAL and COUNTFLAG after k cycles from VAL 0 with LOAD + 1 = load */
+static void systick_model(rt_uint32_t load, rt_uint32_t k, rt_uint32_t *val, rt_uint32_t *wrapped)
+{
+    *val     = (k == 0) ? 0 : (load - 1) - (k - 1) % load;
+    *wrapped = (k >= load) ? 1 : 0;
+}
+
+/* cycles a sleep lasts, early wake, full sleep or woken late after the tick */
+static rt_uint32_t sleep_length(rt_uint32_t load)
+{
+    switch(rand() % 4)
+    {
+        case 0:  return load;
+        case 1:  return load + rand_range(1, 40);
+        default: return rand_range(0, load);
+    }
+}
+
+static void run(rt_uint32_t tick_cycles)
+{
+    unsigned long long now = 1;         /* true cycles, ticks at multiples */
+    unsigned long long tick = 0;        /* system tick, tick 0 is counted */
+    unsigned long long from;
+    rt_uint32_t max_ticks = MAX_RELOAD / tick_cycles;
+    rt_uint32_t i, val, pending, ticks, entry, exit, k, passed, remain;
+    rt_uint32_t restarted = 0;
+    struct tickless_sample s;
+
+    for(i = 0; i < SLEEPS; i++)
+    {
+        /* awake, SysTick runs and counts every tick before now */
+        from = now;
+        now += rand_range(0, 3 * tick_cycles);
+        if(now > from)
+        {
+            tick += restarted + (now - 1) / tick_cycles - from / tick_cycles;
+            restarted = 0;
+        }
+
+        /* idle entry, a tick exactly now is pending */
+        pending = (now % tick_cycles == 0) ? 1 : 0;
+        val     = (rt_uint32_t)((tick_cycles - now % tick_cycles) % tick_cycles);
+
+        s.tick_cycles = tick_cycles;
+        s.phase = tickless_phase(tick_cycles, val, pending);
+        CHECK(now - s.phase == tick * tick_cycles);
+
+        ticks = rand_range(2, max_ticks);
+        entry = rand_range(0, 600);
+        s.sleep_load = tickless_sleep_cycles(tick_cycles, ticks, s.phase, entry);
+        CHECK(s.sleep_load >= 2 && s.sleep_load <= MAX_RELOAD + 1);
+        if(s.sleep_load > 2)
+        {
+            /* a full sleep ends on the tick of the next timeout */
+            CHECK(s.phase + entry + s.sleep_load == ticks * tick_cycles);
+        }
+
+        k    = sleep_length(s.sleep_load);
+        exit = rand_range(0, 600);
+        systick_model(s.sleep_load, k, &s.sleep_val, &s.wrapped);
+        s.stopped = entry + exit;
+        now += entry + k + exit;
+
+        passed = tickless_compensate(&s, &remain);
+        tick  += passed;
+
+        /* system tick counts every tick up to now, SysTick fires on the next */
+        CHECK(tick == now / tick_cycles);
+        CHECK(remain >= 1 && remain <= tick_cycles);
+        CHECK(now + remain == (now / tick_cycles + 1) * tick_cycles);
+
+        /* SysTick restarts, its first tick is pending at the new now */
+        now += remain;
+        restarted = 1;
+    }
+
+    /* no drift after all sleeps */
+    CHECK(tick + 1 == now / tick_cycles);
+}
+
+int main(void)
+{
+    static const rt_uint32_t clocks[] = { 120000, 72000, 8000, 1000, 3 };
+    rt_uint32_t i;
+
+    srand(1);
+    for(i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++)
+    {
+        run(clocks[i]);
+    }
+
+    printf("tickless: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,568 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_tlsf.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host test of the TLSF heap of rt-thread/kernel/tlsf.c, then a replay of an
+ * allocation trace on it and on the small memory heap of mem.c, which is
+ * linked under small_ names. a trace is the log of mem_trace of mem_trace.c,
+ * "m <address> <size>" and "f <address>" lines, without one the trace is
+ * generated from a model of the allocation sites of the gateway.
+ *
+ *   test_tlsf              test, replay of the model trace
+ *   test_tlsf -b [trace]   test, then benchmark of the replay
+ *
+ * heaps are static arrays of a -no-pie binary, tlsf.c and mem.c keep
+ * addresses in rt_uint32_t.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include <rtthread.h>
+
+#define HEAP_SIZE       (96 * 1024)     /* heap of the gateway after bss */
+#define STRESS_OPS      (200000)
+#define STRESS_SLOTS    (500)
+
+#define TRACE_SLOTS     (512)
+#define TRACE_OPS       (200000)
+
+static int errors;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(errors++ < 10) { \
+    printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while(0)
+
+/* mem.c, symbols renamed by objcopy */
+extern void  small_system_heap_init (void *begin_addr, void *end_addr);
+extern void *small_malloc           (rt_size_t size);
+extern void  small_free             (void *rmem);
+extern void  small_memory_info      (rt_uint32_t *total, rt_uint32_t *used, rt_uint32_t *max_used);
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+int __rt_ffs(int value)                                             { return __builtin_ffs(value); }
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    return RT_EOK;
+}
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)                 { return RT_EOK; }
+rt_err_t rt_sem_release(rt_sem_t sem)                               { return RT_EOK; }
+void *rt_memset(void *s, int c, rt_ubase_t count)                   { return memset(s, c, count); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)       { return memcpy(dst, src, count); }
+
+void rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+/**
+ ******************************************************************************
+ *                                    TEST
+ ******************************************************************************
+ */
+
+static rt_uint8_t heap[HEAP_SIZE] __attribute__((aligned(8)));
+
+static void fill(void *ptr, rt_size_t size, int tag)
+{
+    memset(ptr, tag, size);
+}
+
+static int intact(const void *ptr, rt_size_t size, int tag)
+{
+    const rt_uint8_t *p = ptr;
+    rt_size_t i;
+
+    for(i = 0; i < size; i++)
+    {
+        if(p[i] != (rt_uint8_t)tag)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* the heap is one free block again, and every class freed what it allocated */
+static void check_empty(const char *when)
+{
+    struct rt_tlsf_frag_info frag;
+    struct rt_tlsf_class_stat stat;
+    rt_uint32_t total, used, max_used, allocs = 0, frees = 0;
+    int i;
+
+    rt_memory_info(&total, &used, &max_used);
+    rt_tlsf_frag_info(&frag);
+    CHECK(used == 0, "%s: used %u", when, used);
+    CHECK(frag.free_blocks == 1 && frag.free_size == total && frag.largest_free == total,
+          "%s: %u free blocks, free %u largest %u of %u", when,
+          frag.free_blocks, frag.free_size, frag.largest_free, total);
+
+    for(i = 0; rt_tlsf_class_stat(i, &stat) == 0; i++)
+    {
+        allocs += stat.allocs;
+        frees  += stat.frees;
+    }
+    CHECK(allocs == frees, "%s: %u allocs %u frees", when, allocs, frees);
+}
+
+/* random malloc, realloc and free, blocks keep their contents */
+static void test_stress(void)
+{
+    static void *ptr[STRESS_SLOTS];
+    static rt_size_t len[STRESS_SLOTS];
+    rt_size_t size;
+    void *p;
+    int n, i;
+
+    rt_system_heap_init(heap + 3, heap + sizeof(heap));
+    for(n = 0; n < STRESS_OPS; n++)
+    {
+        i = rand() % STRESS_SLOTS;
+        if(ptr[i] == RT_NULL)
+        {
+            len[i] = rand() % ((rand() % 10) ? 200 : 3000) + 1;
+            ptr[i] = rt_malloc(len[i]);
+            if(ptr[i] != RT_NULL)
+            {
+                CHECK((rt_ubase_t)ptr[i] % RT_ALIGN_SIZE == 0, "malloc %p not aligned", ptr[i]);
+                fill(ptr[i], len[i], i);
+            }
+            continue;
+        }
+
+        CHECK(intact(ptr[i], len[i], i), "block %d of %u bytes changed", i, (rt_uint32_t)len[i]);
+        if(rand() % 4 == 0)
+        {
+            size = rand() % 700 + 1;
+            p = rt_realloc(ptr[i], size);
+            if(p != RT_NULL)
+            {
+                CHECK(intact(p, (size < len[i]) ? size : len[i], i), "realloc %d lost data", i);
+                fill(p, size, i);
+                ptr[i] = p;
+                len[i] = size;
+            }
+        }
+        else
+        {
+            rt_free(ptr[i]);
+            ptr[i] = RT_NULL;
+        }
+    }
+
+    for(i = 0; i < STRESS_SLOTS; i++)
+    {
+        rt_free(ptr[i]);
+        ptr[i] = RT_NULL;
+    }
+    check_empty("stress");
+}
+
+/* requests beyond the heap or the largest class fail and are counted */
+static void test_exhaust(void)
+{
+    static void *ptr[HEAP_SIZE / 32];
+    struct rt_tlsf_class_stat stat;
+    rt_uint32_t fails = 0, last;
+    int n, i;
+
+    rt_system_heap_init(heap, heap + sizeof(heap));
+
+    for(last = 0; rt_tlsf_class_stat(last + 1, &stat) == 0; last++);
+    CHECK(rt_malloc(4UL * 1024 * 1024) == RT_NULL, "oversize malloc");
+    rt_tlsf_class_stat(last, &stat);
+    CHECK(stat.fails == 1, "oversize fail counted %u", stat.fails);
+    CHECK(rt_malloc(HEAP_SIZE) == RT_NULL, "malloc of whole heap");
+
+    for(n = 0; n < (int)(sizeof(ptr) / sizeof(ptr[0])); n++)
+    {
+        ptr[n] = rt_malloc(40);
+        if(ptr[n] == RT_NULL)
+        {
+            break;
+        }
+    }
+    CHECK(n > 0 && n < (int)(sizeof(ptr) / sizeof(ptr[0])), "heap not exhausted, %d blocks", n);
+
+    for(i = 0; rt_tlsf_class_stat(i, &stat) == 0; i++)
+    {
+        fails += stat.fails;
+    }
+    CHECK(fails == 3, "%u fails counted", fails);
+
+    /* free in an order that merges both neighbours */
+    for(i = 0; i < n; i += 2)
+    {
+        rt_free(ptr[i]);
+    }
+    for(i = 1; i < n; i += 2)
+    {
+        rt_free(ptr[i]);
+    }
+    check_empty("exhaust");
+}
+
+/**
+ ******************************************************************************
+ *                                   REPLAY
+ ******************************************************************************
+ */
+
+struct trace_op
+{
+    rt_uint16_t slot;
+    rt_uint16_t free;
+    rt_uint32_t size;
+};
+
+struct trace
+{
+    struct trace_op *ops;
+    int              num;
+    int              max;
+};
+
+/* allocation sites of the gateway, rt_malloc serves lwip with RT_LWIP_USING_RT_MEM */
+struct trace_site
+{
+    rt_uint16_t     min;
+    rt_uint16_t     max;
+    rt_uint16_t     life_min;           /* lifetime in trace ops */
+    rt_uint16_t     life_max;
+    rt_uint8_t      weight;
+};
+
+static const struct trace_site sites[] =
+{
+    {   60, 1100,    1,    8, 20 },     /* PBUF_RAM of PUSH_DATA and tcp replies */
+    { 1096, 1096,    1,    4, 12 },     /* PBUF_POOL of received frames */
+    {   16,   16,    1,    4, 12 },     /* netbuf of socket receive */
+    {   20,   20,    2,   20, 16 },     /* tcp_seg */
+    {   16,   16,   10,  100,  8 },     /* sys_timeo */
+    {   40,   40,    1,    3,  8 },     /* PBUF_RAM of PULL_DATA and acks */
+    {  100,  400,    5,   50,  4 },     /* mqtt push requests */
+    {  156,  156,  200, 5000,  1 },     /* tcp_pcb of a tcp server session */
+    {   80,   80,  200, 5000,  1 },     /* mailbox of a netconn */
+};
+
+/* boot allocations that live forever, thread stacks and objects */
+static const rt_uint16_t boot_sizes[] =
+{
+    3 * 1024, 128, 512, 128, 1536, 128, 1024, 128, 2560, 128, 2048, 128,
+    2048, 128, 768, 128, 1024, 128, 2048, 128, 768, 128, 4, 156, 80, 64, 64
+};
+
+static void trace_add(struct trace *t, int slot, int free, rt_uint32_t size)
+{
+    if(t->num == t->max)
+    {
+        t->max = t->max ? 2 * t->max : 1024;
+        t->ops = realloc(t->ops, t->max * sizeof(t->ops[0]));
+    }
+    t->ops[t->num].slot = slot;
+    t->ops[t->num].free = free;
+    t->ops[t->num].size = size;
+    t->num++;
+}
+
+static int rand_range(int lo, int hi)
+{
+    return lo + rand() % (hi - lo + 1);
+}
+
+/* trace of the site model, sessions interleave with short lived buffers */
+static void trace_model(struct trace *t)
+{
+    static int expire[TRACE_SLOTS];
+    int slot, now, weights = 0, w;
+    unsigned i;
+
+    for(i = 0; i < sizeof(sites) / sizeof(sites[0]); i++)
+    {
+        weights += sites[i].weight;
+    }
+    for(slot = 0; slot < TRACE_SLOTS; slot++)
+    {
+        expire[slot] = -1;
+    }
+    for(i = 0; i < sizeof(boot_sizes) / sizeof(boot_sizes[0]); i++)
+    {
+        trace_add(t, i, 0, boot_sizes[i]);
+        expire[i] = 0x7fffffff;
+    }
+
+    for(now = 0; t->num < TRACE_OPS; now++)
+    {
+        for(slot = 0; slot < TRACE_SLOTS; slot++)
+        {
+            if(expire[slot] >= 0 && expire[slot] <= now)
+            {
+                trace_add(t, slot, 1, 0);
+                expire[slot] = -1;
+            }
+        }
+
+        for(slot = 0; slot < TRACE_SLOTS && expire[slot] >= 0; slot++);
+        if(slot == TRACE_SLOTS)
+        {
+            continue;
+        }
+        w = rand() % weights;
+        for(i = 0; w >= sites[i].weight; i++)
+        {
+            w -= sites[i].weight;
+        }
+        trace_add(t, slot, 0, rand_range(sites[i].min, sites[i].max));
+        expire[slot] = now + rand_range(sites[i].life_min, sites[i].life_max);
+    }
+}
+
+/* trace of a mem_trace log, frees of blocks allocated before the log are skipped */
+static int trace_load(struct trace *t, const char *file)
+{
+    static unsigned long addr[TRACE_SLOTS];
+    char line[128];
+    unsigned long a;
+    unsigned size;
+    int slot;
+    FILE *fp;
+
+    fp = fopen(file, "r");
+    if(fp == NULL)
+    {
+        return -1;
+    }
+    memset(addr, 0, sizeof(addr));
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        if(sscanf(line, "m %lx %u", &a, &size) == 2)
+        {
+            for(slot = 0; slot < TRACE_SLOTS && addr[slot] != a; slot++);
+            if(slot < TRACE_SLOTS)
+            {
+                /* realloc in place logs no free */
+                trace_add(t, slot, 1, 0);
+            }
+            else
+            {
+                for(slot = 0; slot < TRACE_SLOTS && addr[slot] != 0; slot++);
+                if(slot == TRACE_SLOTS)
+                {
+                    printf("%s: more than %d blocks\n", file, TRACE_SLOTS);
+                    break;
+                }
+            }
+            addr[slot] = a;
+            trace_add(t, slot, 0, size);
+        }
+        else if(sscanf(line, "f %lx", &a) == 1)
+        {
+            for(slot = 0; slot < TRACE_SLOTS && addr[slot] != a; slot++);
+            if(slot < TRACE_SLOTS)
+            {
+                addr[slot] = 0;
+                trace_add(t, slot, 1, 0);
+            }
+        }
+    }
+    fclose(fp);
+
+    return 0;
+}
+
+struct heap_impl
+{
+    const char *name;
+    void  (*init)(void *begin_addr, void *end_addr);
+    void *(*malloc)(rt_size_t size);
+    void  (*free)(void *rmem);
+    void  (*info)(rt_uint32_t *total, rt_uint32_t *used, rt_uint32_t *max_used);
+    void  (*check)(const char *when);
+};
+
+static const struct heap_impl heaps[] =
+{
+    { "tlsf",   rt_system_heap_init,    rt_malloc,      rt_free,    rt_memory_info,     check_empty },
+    { "mem",    small_system_heap_init, small_malloc,   small_free, small_memory_info,  RT_NULL },
+};
+
+struct replay_result
+{
+    rt_uint32_t mallocs, frees, fails, max_used;
+    double      malloc_ns, free_ns;     /* sums */
+    double      malloc_max, free_max;
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void replay(const struct heap_impl *h, const struct trace *t, struct replay_result *r)
+{
+    static void *ptr[TRACE_SLOTS];
+    static rt_uint32_t len[TRACE_SLOTS];
+    const struct trace_op *op;
+    double start, ns;
+    rt_uint32_t used;
+    int n;
+
+    memset(r, 0, sizeof(*r));
+    memset(ptr, 0, sizeof(ptr));
+    h->init(heap, heap + sizeof(heap));
+
+    for(n = 0; n < t->num; n++)
+    {
+        op = &t->ops[n];
+        if(op->free)
+        {
+            if(ptr[op->slot] == RT_NULL)
+            {
+                continue;
+            }
+            CHECK(intact(ptr[op->slot], len[op->slot], op->slot),
+                  "%s: op %d, block of slot %d changed", h->name, n, op->slot);
+
+            start = now_ns();
+            h->free(ptr[op->slot]);
+            ns = now_ns() - start;
+
+            ptr[op->slot] = RT_NULL;
+            r->frees++;
+            r->free_ns += ns;
+            if(ns > r->free_max)
+            {
+                r->free_max = ns;
+            }
+            continue;
+        }
+
+        start = now_ns();
+        ptr[op->slot] = h->malloc(op->size);
+        ns = now_ns() - start;
+
+        r->mallocs++;
+        r->malloc_ns += ns;
+        if(ns > r->malloc_max)
+        {
+            r->malloc_max = ns;
+        }
+        if(ptr[op->slot] == RT_NULL)
+        {
+            r->fails++;
+            continue;
+        }
+        len[op->slot] = op->size;
+        fill(ptr[op->slot], op->size, op->slot);
+    }
+
+    for(n = 0; n < TRACE_SLOTS; n++)
+    {
+        if(ptr[n] != RT_NULL)
+        {
+            h->free(ptr[n]);
+        }
+    }
+    h->info(RT_NULL, &used, &r->max_used);
+    CHECK(used == 0, "%s: %u bytes used after replay", h->name, used);
+    if(h->check != RT_NULL)
+    {
+        h->check("replay");
+    }
+}
+
+static void test_replay(const struct trace *t, int bench)
+{
+    struct replay_result r[sizeof(heaps) / sizeof(heaps[0])];
+    unsigned i;
+
+    for(i = 0; i < sizeof(heaps) / sizeof(heaps[0]); i++)
+    {
+        replay(&heaps[i], t, &r[i]);
+    }
+
+    /* same trace, same heap, tlsf has no more failures than first fit */
+    CHECK(r[0].fails <= r[1].fails + r[1].fails / 10 + 1, "tlsf %u fails, mem %u fails",
+          r[0].fails, r[1].fails);
+
+    if(!bench)
+    {
+        return;
+    }
+    printf("%d ops, heap %d bytes\n", t->num, HEAP_SIZE);
+    printf("%-6s %8s %6s %9s %12s %12s %12s %12s\n", "heap", "mallocs", "fails", "max used",
+           "malloc avg", "malloc max", "free avg", "free max");
+    for(i = 0; i < sizeof(heaps) / sizeof(heaps[0]); i++)
+    {
+        printf("%-6s %8u %6u %9u %9.0f ns %9.0f ns %9.0f ns %9.0f ns\n", heaps[i].name,
+               r[i].mallocs, r[i].fails, r[i].max_used,
+               r[i].mallocs ? r[i].malloc_ns / r[i].mallocs : 0, r[i].malloc_max,
+               r[i].frees ? r[i].free_ns / r[i].frees : 0, r[i].free_max);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct trace t = { 0 };
+    int bench = (argc > 1 && strcmp(argv[1], "-b") == 0);
+
+    srand(1);
+    test_stress();
+    test_exhaust();
+
+    if(bench && argc > 2)
+    {
+        if(trace_load(&t, argv[2]) != 0)
+        {
+            printf("can not read %s\n", argv[2]);
+            return 1;
+        }
+    }
+    else
+    {
+        trace_model(&t);
+    }
+    test_replay(&t, 0);
+    printf("tlsf: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    if(errors == 0 && bench)
+    {
+        test_replay(&t, 1);
+    }
+    free(t.ops);
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
@@ -0,0 +1,549 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_udp_sightings.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host simulation of several gateways sharing new node sightings by the
+ * multicast group of thread_udp.c. thread_udp.c is built with -Dstatic= so
+ * its state can be swapped per gateway, sockets are stubbed and sightings
+ * sent by one gateway are delivered to all of them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include <rtthread.h>
+#include <lwip/sockets.h>
+
+#include "thread_network.h"
+#include "embedded_flash.h"
+#include "external_flash.h"
+#include "wnc_data_base.h"
+
+#define GATEWAY_NUM     (4)
+#define PEER_NUM        (16)            /* MAX_UDP_PEER_NUM of thread_udp.c */
+#define SIGHT_PORT      (5212)
+#define MAX_NODE_ID     (2000)
+
+/* report layout of fill_udp_buffer */
+#define REPORT_SEQ      (77)
+#define REPORT_NUM      (78)
+#define REPORT_NODES    (80)
+#define REPORT_NODE_LEN (10)
+
+static int fails;
+
+#define CHECK(cond, ...) do { if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); \
+    printf(__VA_ARGS__); printf("\n"); fails++; } } while(0)
+
+/* thread_udp.c, built with -Dstatic= */
+struct udp_peer
+{
+    rt_uint32_t id;
+    rt_uint16_t seq;
+    rt_uint16_t lost;
+    rt_tick_t   tick;
+};
+
+extern size_t           fill_udp_buffer     (char *data_buf);
+extern void             send_sightings      (struct sockaddr_in *group_addr);
+extern void             analyze_sightings   (const char *data, int len);
+extern int              accept_udp_peer     (rt_uint32_t id, rt_uint16_t seq);
+extern struct udp_peer  udp_peers[PEER_NUM];
+extern rt_uint16_t      sight_seq;
+extern rt_uint8_t       report_seq;
+extern int              multicast_joined;
+extern char             send_buf[1024];
+
+/* globals of other modules */
+detector_info_list_t    g_detector_info_list;
+light_info_list_t       g_light_info_list;
+new_node_list_t         g_new_node_list;
+struct rt_mutex         mutex_new_node_list;
+rt_mq_t                 mq_sys_ctrl;
+wnc_cfg_t               g_wnc_config;
+device_params_t         wnc_device;
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+static rt_tick_t now_tick = 1;
+static int       mutex_depth;
+static int       join_fail;
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    if(mutex_depth++)
+    {
+        printf("recursive mutex\n");
+        exit(1);
+    }
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    mutex_depth--;
+    return RT_EOK;
+}
+
+rt_tick_t rt_tick_get(void)                                 { return now_tick; }
+void *rt_memset(void *s, int c, rt_ubase_t n)               { return memset(s, c, n); }
+void *rt_memcpy(void *d, const void *s, rt_ubase_t n)       { return memcpy(d, s, n); }
+rt_int32_t rt_memcmp(const void *a, const void *b, rt_ubase_t n) { return memcmp(a, b, n); }
+
+rt_int32_t rt_sprintf(char *buf, const char *format, ...)
+{
+    va_list args;
+    int ret;
+
+    va_start(args, format);
+    ret = vsprintf(buf, format, args);
+    va_end(args);
+
+    return ret;
+}
+
+u32_t lwip_htonl(u32_t x)                   { return __builtin_bswap32(x); }
+u16_t lwip_htons(u16_t x)                   { return __builtin_bswap16(x); }
+u32_t ipaddr_addr(const char *cp)           { return 0x0a52ffef; }
+void get_datetime(char *datetime)           { }
+rt_uint32_t get_file_sn(void)               { return 0; }
+void threads_feed_dog(int index)            { }
+
+char xor_verify(const char *data, int len)
+{
+    char x = 0;
+
+    while(len--)
+    {
+        x ^= *data++;
+    }
+    return x;
+}
+
+int lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t optlen)
+{
+    return join_fail ? -1 : 0;
+}
+
+int lwip_socket(int domain, int type, int protocol)                     { return 0; }
+int lwip_bind(int s, const struct sockaddr *name, socklen_t namelen)    { return 0; }
+int lwip_recvfrom(int s, void *mem, size_t len, int flags,
+                  struct sockaddr *from, socklen_t *fromlen)            { return -1; }
+rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)           { return RT_EOK; }
+rt_err_t rt_thread_delay(rt_tick_t tick)                                { return RT_EOK; }
+rt_err_t rt_timer_start(rt_timer_t timer)                               { return RT_EOK; }
+rt_timer_t rt_timer_create(const char *name, void (*timeout)(void *parameter),
+                           void *parameter, rt_tick_t time, rt_uint8_t flag) { return RT_NULL; }
+
+/**
+ ******************************************************************************
+ *                                  NETWORK
+ ******************************************************************************
+ */
+
+/* sightings sent in a round, delivered to all gateways at its end */
+static struct
+{
+    int  from;
+    int  len;
+    char data[256];
+} sent[256];
+static int sent_num;
+static int current;
+
+int lwip_sendto(int s, const void *data, size_t size, int flags,
+                const struct sockaddr *to, socklen_t tolen)
+{
+    const struct sockaddr_in *addr = (const struct sockaddr_in *)to;
+
+    if(ntohs(addr->sin_port) == SIGHT_PORT)
+    {
+        if(size > sizeof(sent[0].data))
+        {
+            printf("sighting too long %d\n", (int)size);
+            exit(1);
+        }
+        sent[sent_num].from = current;
+        sent[sent_num].len = size;
+        memcpy(sent[sent_num].data, data, size);
+        sent_num++;
+    }
+    return size;
+}
+
+/**
+ ******************************************************************************
+ *                                  GATEWAYS
+ ******************************************************************************
+ */
+
+static struct gateway
+{
+    rt_uint32_t     id;
+    new_node_list_t list;
+    struct udp_peer peers[PEER_NUM];
+    rt_uint16_t     sight_seq;
+    rt_uint8_t      report_seq;
+    int             joined;
+} gws[GATEWAY_NUM];
+
+static int reports[GATEWAY_NUM][MAX_NODE_ID];
+static int last_report_seq[GATEWAY_NUM];
+static int seqs_ok;
+static int drop_from = -1, drop_round = -1, duplicate, round_no;
+
+static void load(int g)
+{
+    current = g;
+    wnc_device.id = gws[g].id;
+    g_new_node_list = gws[g].list;
+    memcpy(udp_peers, gws[g].peers, sizeof(udp_peers));
+    sight_seq = gws[g].sight_seq;
+    report_seq = gws[g].report_seq;
+    multicast_joined = gws[g].joined;
+}
+
+static void save(int g)
+{
+    gws[g].list = g_new_node_list;
+    memcpy(gws[g].peers, udp_peers, sizeof(udp_peers));
+    gws[g].sight_seq = sight_seq;
+    gws[g].report_seq = report_seq;
+    gws[g].joined = multicast_joined;
+}
+
+/* gateway g hears a node, as insert_new_device */
+static void hear(int g, rt_uint32_t id, int rssi)
+{
+    new_node_list_t *list = &gws[g].list;
+    int i;
+
+    for(i = 0; i < list->num; i++)
+    {
+        if(list->node[i].id == id)
+        {
+            break;
+        }
+    }
+    if(i < list->num)
+    {
+        if(list->node[i].time_left == 0)
+        {
+            list->node[i].sync = 0;
+        }
+    }
+    else
+    {
+        list->num++;
+        list->node[i].id = id;
+        list->node[i].device_type = 1;
+        list->node[i].sync = 0;
+    }
+    list->node[i].rssi = rssi;
+    list->node[i].snr = 5;
+    list->node[i].time_left = 3;
+}
+
+static void deliver(void)
+{
+    int p, g;
+
+    for(p = 0; p < sent_num; p++)
+    {
+        if(sent[p].from == drop_from && round_no == drop_round)
+        {
+            continue;
+        }
+        for(g = 0; g < GATEWAY_NUM; g++)
+        {
+            load(g);
+            analyze_sightings(sent[p].data, sent[p].len);
+            if(duplicate)
+            {
+                analyze_sightings(sent[p].data, sent[p].len);
+            }
+            save(g);
+        }
+    }
+    sent_num = 0;
+}
+
+/* one report period of gateway g: report, then share sightings */
+static void report_round(int g)
+{
+    unsigned char *buf = (unsigned char *)send_buf;
+    struct sockaddr_in group;
+    int n, i;
+
+    load(g);
+    memset(send_buf, 0, sizeof(send_buf));
+    fill_udp_buffer(send_buf);
+
+    if(buf[REPORT_SEQ] != (rt_uint8_t)last_report_seq[g])
+    {
+        seqs_ok = 0;
+    }
+    last_report_seq[g] = buf[REPORT_SEQ] + 1;
+
+    n = buf[REPORT_NUM];
+    for(i = 0; i < n; i++)
+    {
+        unsigned char *node = buf + REPORT_NODES + i * REPORT_NODE_LEN;
+        rt_uint32_t id = (node[1] << 24) | (node[2] << 16) | (node[3] << 8) | node[4];
+
+        if(node[5] == NODE_STATE_NEW_DEVICE)
+        {
+            reports[g][id]++;
+        }
+    }
+
+    if(multicast_joined)
+    {
+        memset(&group, 0, sizeof(group));
+        group.sin_port = htons(SIGHT_PORT);
+        send_sightings(&group);
+    }
+    save(g);
+    deliver();
+}
+
+static void reset(void)
+{
+    int g;
+
+    memset(gws, 0, sizeof(gws));
+    memset(reports, 0, sizeof(reports));
+    memset(last_report_seq, 0, sizeof(last_report_seq));
+    seqs_ok = 1;
+    for(g = 0; g < GATEWAY_NUM; g++)
+    {
+        gws[g].id = 100 + g;
+        gws[g].joined = 1;
+    }
+}
+
+static void run(int rounds, int reverse)
+{
+    int k;
+
+    for(round_no = 0; round_no < rounds; round_no++)
+    {
+        for(k = 0; k < GATEWAY_NUM; k++)
+        {
+            report_round(reverse ? GATEWAY_NUM - 1 - k : k);
+        }
+        now_tick += 10 * RT_TICK_PER_SECOND;
+    }
+}
+
+static int peer_lost(int g, rt_uint32_t id)
+{
+    int i;
+
+    for(i = 0; i < PEER_NUM; i++)
+    {
+        if(gws[g].peers[i].id == id)
+        {
+            return gws[g].peers[i].lost;
+        }
+    }
+    return -1;
+}
+
+/**
+ ******************************************************************************
+ *                                   CASES
+ ******************************************************************************
+ */
+
+/* best rssi reports three times, once per round, tie goes to the lower id */
+static void test_best_rssi(int reverse)
+{
+    int g, i;
+
+    reset();
+    hear(0, 1, -80); hear(1, 1, -70); hear(2, 1, -90);
+    hear(0, 2, -75); hear(2, 2, -75);
+    hear(3, 3, -100);
+    run(10, reverse);
+
+    CHECK(reports[1][1] == 3 && reports[0][1] == 0 && reports[2][1] == 0,
+          "best rssi %d %d %d", reports[0][1], reports[1][1], reports[2][1]);
+    CHECK(reports[0][2] == 3 && reports[2][2] == 0, "tie %d %d", reports[0][2], reports[2][2]);
+    CHECK(reports[3][3] == 3, "single %d", reports[3][3]);
+    CHECK(seqs_ok, "report seq");
+
+    for(g = 0; g < GATEWAY_NUM; g++)
+    {
+        for(i = 0; i < PEER_NUM; i++)
+        {
+            if(gws[g].peers[i].id)
+            {
+                CHECK(gws[g].peers[i].id != gws[g].id, "self peer");
+                CHECK(gws[g].peers[i].lost == 0, "lost %d", gws[g].peers[i].lost);
+            }
+        }
+    }
+}
+
+/* many nodes need several sighting packets a round */
+static void test_many_nodes(int reverse)
+{
+    int id, g, i;
+
+    reset();
+    srand(reverse + 1);
+    for(id = 1; id <= 300; id++)
+    {
+        for(g = 0; g < GATEWAY_NUM; g++)
+        {
+            if(rand() % 3)
+            {
+                hear(g, id, -60 - (id * 7 + g * 13) % 50);
+            }
+        }
+    }
+    run(10, reverse);
+
+    for(id = 1; id <= 300; id++)
+    {
+        int total = 0, who = 0, best = -1000, best_gw = -1;
+
+        for(g = 0; g < GATEWAY_NUM; g++)
+        {
+            total += reports[g][id];
+            who += (reports[g][id] != 0);
+            for(i = 0; i < gws[g].list.num; i++)
+            {
+                if(gws[g].list.node[i].id == (rt_uint32_t)id && gws[g].list.node[i].rssi > best)
+                {
+                    best = gws[g].list.node[i].rssi;
+                    best_gw = g;
+                }
+            }
+        }
+        if(best_gw < 0)
+        {
+            continue;
+        }
+        CHECK(total == 3 && who == 1 && reports[best_gw][id] == 3,
+              "node %d total %d who %d best gw %d", id, total, who, best_gw);
+    }
+}
+
+/* duplicated sightings are dropped, lost ones counted, nodes heard again compared again */
+static void test_duplicate(int reverse)
+{
+    reset();
+    duplicate = 1;
+    hear(0, 1, -80); hear(1, 1, -70);
+    run(2, reverse);
+    duplicate = 0;
+
+    drop_from = 0;
+    drop_round = 2;
+    run(4, reverse);
+    drop_from = -1;
+
+    CHECK(peer_lost(1, 100) == 1, "lost %d", peer_lost(1, 100));
+    CHECK(reports[1][1] == 3 && reports[0][1] == 0, "dup %d %d", reports[0][1], reports[1][1]);
+
+    hear(0, 1, -60); hear(1, 1, -70);
+    run(5, reverse);
+    CHECK(reports[0][1] == 3 && reports[1][1] == 3, "again %d %d", reports[0][1], reports[1][1]);
+}
+
+/* a restarted gateway sends seq from 0, accepted after the dup time */
+static void test_restart(int reverse)
+{
+    reset();
+    run(2, reverse);
+    gws[0].sight_seq = 0;
+    memset(&gws[0].list, 0, sizeof(gws[0].list));
+    now_tick += 6 * RT_TICK_PER_SECOND;
+
+    hear(0, 5, -50); hear(1, 5, -90);
+    run(4, reverse);
+    CHECK(reports[0][5] == 3 && reports[1][5] == 0, "restart %d %d", reports[0][5], reports[1][5]);
+}
+
+static void test_peer_seq(void)
+{
+    int id;
+
+    memset(udp_peers, 0, sizeof(udp_peers));
+    CHECK(accept_udp_peer(7, 1) == 1, "first");
+    CHECK(accept_udp_peer(7, 1) == 0, "dup");
+    CHECK(accept_udp_peer(7, 0) == 0, "late");
+    CHECK(accept_udp_peer(7, 4) == 1 && udp_peers[0].lost == 2, "gap %d", udp_peers[0].lost);
+    CHECK(accept_udp_peer(7, 65535) == 0, "wrap late");
+    now_tick += 6 * RT_TICK_PER_SECOND;
+    CHECK(accept_udp_peer(7, 0) == 1, "restart");
+
+    for(id = 0; id < 20; id++)
+    {
+        accept_udp_peer(1000 + id, 1);
+    }
+    CHECK(udp_peers[0].id != 7, "oldest replaced");
+}
+
+/* without the group every gateway reports, as broadcast before */
+static void test_no_group(void)
+{
+    int g;
+
+    reset();
+    for(g = 0; g < GATEWAY_NUM; g++)
+    {
+        gws[g].joined = 0;
+    }
+    join_fail = 1;
+    hear(0, 1, -80); hear(1, 1, -70);
+    run(5, 0);
+    CHECK(reports[0][1] == 3 && reports[1][1] == 3 && sent_num == 0,
+          "broadcast %d %d", reports[0][1], reports[1][1]);
+    join_fail = 0;
+}
+
+int main(void)
+{
+    int reverse;
+
+    for(reverse = 0; reverse < 2; reverse++)
+    {
+        test_best_rssi(reverse);
+        test_many_nodes(reverse);
+        test_duplicate(reverse);
+        test_restart(reverse);
+    }
+    test_peer_seq();
+    test_no_group();
+
+    printf("udp sightings: %s, %d failures\n", fails ? "FAIL" : "PASS", fails);
+
+    return fails ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
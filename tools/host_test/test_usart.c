@@ -0,0 +1,441 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_usart.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host model test of bsp/usart.c, the Tx ring with TBE interrupt and the Rx
+ * ring written by DMA. usart.c is included from build/usart_sim.c, a copy
+ * where DR accesses call sim_dr_write() and sim_dr_read(), USART1 and DMA1
+ * channel 5 are memory structures and PRIMASK and IPSR are variables. the
+ * uart interrupt runs at random points where the cpu would take it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gd32f20x.h"
+#include "usart.h"
+
+static USART_TypeDef        sim_usart;
+static DMA_Channel_TypeDef  sim_dma;
+static rt_uint32_t          sim_primask;
+static rt_uint32_t          sim_ipsr;
+
+static int  sim_dr_write(USART_TypeDef *usart, rt_uint8_t c);
+static int  sim_dr_read(USART_TypeDef *usart);
+
+#undef  USART1
+#define USART1              (&sim_usart)
+#undef  DMA1_CHANNEL5
+#define DMA1_CHANNEL5       (&sim_dma)
+#define __get_PRIMASK()     (sim_primask)
+#define __get_IPSR()        (sim_ipsr)
+#undef  UART_ENABLE_IRQ
+#define UART_ENABLE_IRQ(n)
+
+#include "usart_sim.c"
+
+#define TX_CHARS            (200000)
+#define RX_CHARS            (100000)
+#define IRQ_CHANCE          (8)                 /* 1 in IRQ_CHANCE at a point */
+
+static int errors;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(errors++ < 10) { \
+    printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while(0)
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+static struct rt_thread sim_thread;
+static int          sim_started;                /* scheduler is running */
+
+/* uart: TBE and TC are always set, the wire takes a byte at a time */
+static rt_uint8_t   wire[TX_CHARS];
+static int          wire_len;
+static int          tbe_int, rbne_int, idle_int;
+static int          idle_flag, ore_flag;
+static rt_uint8_t   rx_dr;
+
+/* dma channel in circular mode */
+static int          dma_on, dma_count, dma_pos, dma_ht, dma_tc;
+
+/* bytes read by the serial framework */
+static rt_uint8_t   got[RX_CHARS];
+static int          got_len, rx_events;
+
+static int sim_dr_write(USART_TypeDef *usart, rt_uint8_t c)
+{
+    CHECK(usart->STR & USART_FLAG_TBE, "DR written with TBE clear");
+    if(wire_len < TX_CHARS)
+    {
+        wire[wire_len] = c;
+    }
+    wire_len++;
+    return c;
+}
+
+static int sim_dr_read(USART_TypeDef *usart)
+{
+    usart->STR &= ~USART_FLAG_RBNE;
+    idle_flag = 0;
+    ore_flag  = 0;
+    return rx_dr;
+}
+
+/* uart interrupt is taken when not masked and not in another exception */
+static void sim_irq(void)
+{
+    if(sim_primask != 0 || sim_ipsr != 0)
+    {
+        return;
+    }
+    if(tbe_int || (idle_int && idle_flag) || ore_flag)
+    {
+        sim_ipsr = 16 + USART1_IRQn;
+        USART1_IRQHandler();
+        sim_ipsr = 0;
+    }
+}
+
+static void sim_dma_irq(void)
+{
+    if(sim_primask != 0 || sim_ipsr != 0)
+    {
+        return;
+    }
+    if(dma_ht || dma_tc)
+    {
+        sim_ipsr = 16 + DMA1_Channel5_IRQn;
+        DMA1_Channel5_IRQHandler();
+        sim_ipsr = 0;
+    }
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    rt_base_t level = sim_primask;
+
+    sim_primask = 1;
+    return level;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    sim_primask = level;
+    if(rand() % IRQ_CHANCE == 0)
+    {
+        sim_irq();
+    }
+}
+
+rt_thread_t rt_thread_self(void)                                    { return sim_started ? &sim_thread : RT_NULL; }
+void rt_interrupt_enter(void)                                       { }
+void rt_interrupt_leave(void)                                       { }
+
+void USART_INT_Set(USART_TypeDef *usart, uint32_t flag, TypeState state)
+{
+    if(flag == USART_INT_TBE)
+    {
+        tbe_int = (state == ENABLE);
+    }
+    else if(flag == USART_INT_RBNE)
+    {
+        rbne_int = (state == ENABLE);
+    }
+    else if(flag == USART_INT_IDLEF)
+    {
+        idle_int = (state == ENABLE);
+    }
+}
+
+TypeState USART_GetIntBitState(USART_TypeDef *usart, uint32_t flag)
+{
+    if(flag == USART_INT_TBE)
+    {
+        return tbe_int ? SET : RESET;
+    }
+    if(flag == USART_INT_RBNE)
+    {
+        return (rbne_int && (usart->STR & USART_FLAG_RBNE)) ? SET : RESET;
+    }
+    if(flag == USART_INT_IDLEF)
+    {
+        return (idle_int && idle_flag) ? SET : RESET;
+    }
+    return RESET;
+}
+
+TypeState USART_GetBitState(USART_TypeDef *usart, uint32_t flag)
+{
+    return (flag == USART_FLAG_ORE && ore_flag) ? SET : RESET;
+}
+
+void USART_ClearIntBitState(USART_TypeDef *usart, uint32_t flag)    { }
+void USART_DMA_Enable(USART_TypeDef *usart, uint32_t req, TypeState state) { }
+void USART_Init(USART_TypeDef *usart, USART_InitPara *init)         { }
+void USART_Enable(USART_TypeDef *usart, TypeState state)            { }
+
+TypeState DMA_GetIntBitState(uint32_t flag)
+{
+    if(flag == DMA1_INT_HT5)
+    {
+        return dma_ht ? SET : RESET;
+    }
+    if(flag == DMA1_INT_TC5)
+    {
+        return dma_tc ? SET : RESET;
+    }
+    return RESET;
+}
+
+void DMA_ClearIntBitState(uint32_t flag)
+{
+    if(flag == DMA1_INT_GL5)
+    {
+        dma_ht = 0;
+        dma_tc = 0;
+    }
+}
+
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *channel)       { return dma_count; }
+void DMA_Enable(DMA_Channel_TypeDef *channel, TypeState state)      { dma_on = (state == ENABLE); }
+void DMA_DeInit(DMA_Channel_TypeDef *channel)                       { dma_ht = dma_tc = 0; }
+void DMA_INTConfig(DMA_Channel_TypeDef *channel, uint32_t flag, TypeState state) { }
+
+void DMA_Init(DMA_Channel_TypeDef *channel, DMA_InitPara *init)
+{
+    CHECK(init->DMA_MemoryBaseAddr == (uint32_t)uart1_rx_buf, "dma memory address");
+    CHECK(init->DMA_Mode == DMA_MODE_CIRCULAR, "dma not circular");
+    dma_count = init->DMA_BufferSize;
+    dma_pos   = 0;
+}
+
+void RCC_APB2PeriphClock_Enable(uint32_t periph, TypeState state)   { }
+void RCC_AHBPeriphClock_Enable(uint32_t periph, TypeState state)    { }
+void GPIO_Init(GPIO_TypeDef *gpio, GPIO_InitPara *init)             { }
+void NVIC_Init(NVIC_InitPara *init)                                 { }
+
+rt_err_t rt_hw_serial_register(struct rt_serial_device *serial, const char *name,
+                               rt_uint32_t flag, void *data)
+{
+    serial->parent.user_data = data;
+    return RT_EOK;
+}
+
+/* the serial framework reads all bytes at an Rx event */
+void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
+{
+    int ch;
+
+    CHECK(event == RT_SERIAL_EVENT_RX_IND, "serial event %d", event);
+    rx_events++;
+    while((ch = serial->ops->getc(serial)) != -1)
+    {
+        if(got_len < RX_CHARS)
+        {
+            got[got_len] = ch;
+        }
+        got_len++;
+    }
+}
+
+/* a byte received by DMA, with half and full transfer flags */
+static void sim_dma_rx(rt_uint8_t c)
+{
+    if(!dma_on)
+    {
+        return;
+    }
+    uart1_rx_buf[dma_pos] = c;
+    dma_pos = (dma_pos + 1) % UART1_RX_DMA_SIZE;
+    dma_count--;
+    if(dma_count == UART1_RX_DMA_SIZE / 2)
+    {
+        dma_ht = 1;
+    }
+    if(dma_count == 0)
+    {
+        dma_tc = 1;
+        dma_count = UART1_RX_DMA_SIZE;
+    }
+}
+
+/**
+ ******************************************************************************
+ *                                    TEST
+ ******************************************************************************
+ */
+
+static rt_uint8_t sent[TX_CHARS > RX_CHARS ? TX_CHARS : RX_CHARS];
+
+/* putc from threads, masked sections, exceptions and before the scheduler,
+ * with the TBE interrupt at random points: the wire keeps the order */
+static void test_tx(void)
+{
+    struct gd32_uart_stat stat;
+    int i, context, polled = 0;
+
+    sim_usart.STR = USART_FLAG_TBE | USART_FLAG_TC;
+    for(i = 0; i < TX_CHARS; i++)
+    {
+        sent[i] = rand();
+        /* blocks of threads only, where the ring fills and threads wait */
+        context = (i / 4096) % 2 ? rand() % 100 : 100;
+        if(context < 2)
+        {
+            /* rt_kprintf in a critical section */
+            sim_primask = 1;
+        }
+        else if(context < 4)
+        {
+            /* rt_kprintf in another interrupt */
+            sim_ipsr = 16 + SysTick_IRQn;
+        }
+        else if(context < 5)
+        {
+            sim_started = 0;
+        }
+        polled += (context < 5);
+
+        CHECK(serial1.ops->putc(&serial1, sent[i]) == 1, "putc");
+        if(context < 5)
+        {
+            CHECK(uart1.tx_tail == uart1.tx_head && !tbe_int, "ring left after a polled putc");
+        }
+        sim_primask = 0;
+        sim_ipsr    = 0;
+        sim_started = 1;
+
+        if(rand() % (2 * IRQ_CHANCE) == 0)
+        {
+            sim_irq();
+        }
+    }
+
+    /* drain */
+    for(i = 0; i < UART1_TX_RING_SIZE && tbe_int; i++)
+    {
+        sim_irq();
+    }
+    CHECK(!tbe_int && uart1.tx_tail == uart1.tx_head, "ring not drained");
+    CHECK(wire_len == TX_CHARS, "%d bytes sent of %d", wire_len, TX_CHARS);
+    for(i = 0; i < TX_CHARS && i < wire_len; i++)
+    {
+        if(wire[i] != sent[i])
+        {
+            CHECK(0, "byte %d is %02x, sent %02x", i, wire[i], sent[i]);
+            break;
+        }
+    }
+
+    rt_hw_usart_get_stat(&serial1, &stat);
+    CHECK(polled > 0 && stat.tx_waited > 0, "polled %d, waited %u", polled, stat.tx_waited);
+}
+
+/* bursts by DMA are read at half, full transfer and idle line */
+static void test_rx(void)
+{
+    struct gd32_uart_stat stat;
+    int i, n, burst, events;
+
+    CHECK(serial1.ops->control(&serial1, RT_DEVICE_CTRL_SET_INT, (void *)RT_DEVICE_FLAG_INT_RX) == RT_EOK,
+          "set int");
+    CHECK(uart1.rx_dma_on && dma_on && idle_int && !rbne_int, "rx dma not started");
+
+    for(n = 0; n < RX_CHARS; n += burst)
+    {
+        burst = 1 + rand() % (3 * UART1_RX_DMA_SIZE);
+        if(burst > RX_CHARS - n)
+        {
+            burst = RX_CHARS - n;
+        }
+        events = rx_events;
+        for(i = n; i < n + burst; i++)
+        {
+            sent[i] = rand();
+            sim_dma_rx(sent[i]);
+            /* the DMA interrupt is served before the other half is full */
+            if(rand() % IRQ_CHANCE == 0 || dma_count % (UART1_RX_DMA_SIZE / 2) == 1)
+            {
+                sim_dma_irq();
+            }
+        }
+        idle_flag = 1;
+        sim_irq();
+        CHECK(rx_events > events, "no rx event for a burst");
+        CHECK(got_len == n + burst, "%d bytes read of %d", got_len, n + burst);
+    }
+    for(i = 0; i < RX_CHARS && i < got_len; i++)
+    {
+        if(got[i] != sent[i])
+        {
+            CHECK(0, "byte %d is %02x, received %02x", i, got[i], sent[i]);
+            break;
+        }
+    }
+    rt_hw_usart_get_stat(&serial1, &stat);
+    CHECK(stat.rx_overwrite == 0, "%u bytes over written", stat.rx_overwrite);
+
+    /* a full ring and a half not served is counted as written over */
+    for(i = 0; i < UART1_RX_DMA_SIZE + UART1_RX_DMA_SIZE / 2; i++)
+    {
+        sim_dma_rx(rand());
+    }
+    CHECK(dma_ht && dma_tc, "dma flags");
+    sim_dma_irq();
+    rt_hw_usart_get_stat(&serial1, &stat);
+    CHECK(stat.rx_overwrite == UART1_RX_DMA_SIZE / 2, "%u bytes over written", stat.rx_overwrite);
+
+    /* overrun */
+    ore_flag = 1;
+    sim_irq();
+    rt_hw_usart_get_stat(&serial1, &stat);
+    CHECK(stat.rx_overrun == 1 && !ore_flag, "overrun %u", stat.rx_overrun);
+
+    /* without DMA, getc reads DR */
+    CHECK(serial1.ops->control(&serial1, RT_DEVICE_CTRL_CLR_INT, (void *)RT_DEVICE_FLAG_INT_RX) == RT_EOK,
+          "clr int");
+    CHECK(!uart1.rx_dma_on && !dma_on && !idle_int, "rx dma not stopped");
+    CHECK(serial1.ops->getc(&serial1) == -1, "getc without RBNE");
+    rx_dr = 0x5a;
+    sim_usart.STR |= USART_FLAG_RBNE;
+    CHECK(serial1.ops->getc(&serial1) == 0x5a, "getc of DR");
+    CHECK(!(sim_usart.STR & USART_FLAG_RBNE), "RBNE after read");
+}
+
+int main(void)
+{
+    srand(1);
+    rt_hw_usart_init();
+    CHECK(serial1.parent.user_data == &uart1, "uart1 not registered");
+    sim_started = 1;
+
+    test_tx();
+    test_rx();
+
+    printf("usart: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
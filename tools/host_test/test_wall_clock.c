@@ -0,0 +1,248 @@
+/**
+ ***************************** Learn software ******************************
+ *
+ * This file is part of LN firmware.
+ * File name : test_wall_clock.c
+ * Arthor    : Test
+ * Date      : June 29th, 2017
+ *
+ ******************************************************************************
+ */
+
+/**
+ * CHANGE LOGS
+ ******************************************************************************
+ * DATE            BY           DESCRIPTION
+ * 2017-06-29      Test          First version.
+ ******************************************************************************
+ */
+
+/*
+ * host test of applications/user_components/wall_clock.c, included here for
+ * its date math. dates are checked against gmtime(), then the clock runs on
+ * a simulated system tick that drifts from true time, with the pcf8563
+ * modelled as a counter of true seconds and sntp syncs of true time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "../../applications/user_components/wall_clock.c"
+
+#define DATE_DAYS       (60000)             /* 1970-01-01 to 2134 */
+#define SIM_SECONDS     (3 * 24 * 3600L)
+#define SYNC_PERIOD     (900)               /* sntp poll, seconds */
+
+static int errors;
+
+#define CHECK(cond, ...) do { if(!(cond)) { if(errors++ < 10) { \
+    printf("%s:%d: ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); } } } while(0)
+
+/**
+ ******************************************************************************
+ *                                    STUBS
+ ******************************************************************************
+ */
+
+static long long    true_us;                /* true local time */
+static long long    tick_base;              /* tick at true_us 0 */
+static long         tick_ppm;               /* tick rate error */
+static long long    true_sec;               /* true local seconds at true_us 0 */
+static long long    rtc_sec;                /* pcf8563, local seconds at true_us 0 */
+static int          rtc_writes;
+
+/* gmtime of local seconds, as RTC_T */
+static void rtc_from_sec(long long sec, RTC_T *rtc)
+{
+    time_t t = (time_t)sec;
+    struct tm *tm = gmtime(&t);
+
+    rtc->year   = tm->tm_year + 1900;
+    rtc->month  = tm->tm_mon + 1;
+    rtc->day    = tm->tm_mday;
+    rtc->hour   = tm->tm_hour;
+    rtc->minute = tm->tm_min;
+    rtc->second = tm->tm_sec;
+    rtc->week   = tm->tm_wday;
+}
+
+rt_tick_t rt_tick_get(void)
+{
+    return (rt_tick_t)(tick_base + true_us * (US_PER_SEC + tick_ppm) / US_PER_SEC / 1000);
+}
+
+rt_base_t rt_hw_interrupt_disable(void)                             { return 0; }
+void rt_hw_interrupt_enable(rt_base_t level)                        { }
+
+rt_err_t pcf8563_get_datetime(RTC_T *rtc)
+{
+    rtc_from_sec(rtc_sec + true_us / US_PER_SEC, rtc);
+    return RT_EOK;
+}
+
+rt_err_t pcf8563_set_datetime(RTC_T *rtc)
+{
+    struct tm tm;
+
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = rtc->year - 1900;
+    tm.tm_mon  = rtc->month - 1;
+    tm.tm_mday = rtc->day;
+    tm.tm_hour = rtc->hour;
+    tm.tm_min  = rtc->minute;
+    tm.tm_sec  = rtc->second;
+    rtc_sec = (long long)timegm(&tm) - true_us / US_PER_SEC;
+    rtc_writes++;
+
+    return RT_EOK;
+}
+
+void rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+/**
+ ******************************************************************************
+ *                                    TEST
+ ******************************************************************************
+ */
+
+static int same_date(const RTC_T *a, const RTC_T *b)
+{
+    return a->year == b->year && a->month == b->month && a->day == b->day &&
+           a->hour == b->hour && a->minute == b->minute && a->second == b->second &&
+           a->week == b->week;
+}
+
+/* date_from_days and days_from_date against gmtime */
+static void test_dates(void)
+{
+    RTC_T rtc, ref;
+    long days;
+
+    for(days = 0; days < DATE_DAYS; days++)
+    {
+        rtc_from_sec((long long)days * SEC_PER_DAY, &ref);
+        memset(&rtc, 0, sizeof(rtc));
+        date_from_days(days, &rtc);
+        CHECK(same_date(&rtc, &ref), "day %ld is %04d-%02d-%02d week %d", days,
+              rtc.year, rtc.month, rtc.day, rtc.week);
+        CHECK(days_from_date(ref.year, ref.month, ref.day) == days,
+              "%04d-%02d-%02d is day %ld", ref.year, ref.month, ref.day,
+              days_from_date(ref.year, ref.month, ref.day));
+    }
+}
+
+/* run the clock with the system control thread check every second, the
+ * largest difference to ref seconds at true_us 0 is saved to max_error */
+static void run(long seconds, long long ref, long long *max_error)
+{
+    RTC_T rtc, date;
+    rt_uint32_t sec, last_sec = 0;
+    rt_uint16_t ms, last_ms = 0;
+    long long now, error;
+    long i;
+
+    for(i = 0; i < seconds; i++)
+    {
+        true_us += US_PER_SEC + rand() % 1000 - 500;
+        wall_clock_check();
+
+        sec = wall_clock_time(&ms);
+        CHECK(sec > last_sec || (sec == last_sec && ms >= last_ms),
+              "clock goes back from %u.%03u to %u.%03u", last_sec, last_ms, sec, ms);
+        last_sec = sec;
+        last_ms  = ms;
+
+        now   = (long long)sec * US_PER_SEC + ms * 1000;
+        error = now - (ref * US_PER_SEC + true_us);
+        if(error < 0)
+        {
+            error = -error;
+        }
+        if(error > *max_error)
+        {
+            *max_error = error;
+        }
+
+        if(wall_clock_get(&rtc) == RT_EOK)
+        {
+            rtc_from_sec(wall_clock_time(RT_NULL), &date);
+            CHECK(same_date(&rtc, &date), "wall_clock_get %04d-%02d-%02d %02d:%02d:%02d",
+                  rtc.year, rtc.month, rtc.day, rtc.hour, rtc.minute, rtc.second);
+        }
+    }
+}
+
+/* a tick 200 ppm fast is corrected by sntp, the tick counter wraps */
+static void test_sntp(void)
+{
+    long long max_error, utc;
+    long i;
+
+    true_us   = 0;
+    tick_base = 0x100000000LL - 3600 * RT_TICK_PER_SECOND;
+    tick_ppm  = 200;
+    true_sec  = 1498700000LL + WALL_CLOCK_TZ_SECONDS;
+    rtc_sec   = true_sec - 5;
+
+    /* pcf8563 is read at start and every WALL_CLOCK_RTC_PERIOD */
+    wall_clock_init();
+    max_error = 0;
+    run(2 * WALL_CLOCK_RTC_PERIOD, rtc_sec, &max_error);
+    CHECK(max_error < 2 * US_PER_SEC, "%lld us from pcf8563", max_error);
+    CHECK(rtc_writes == 0, "pcf8563 written before sntp");
+
+    /* first sync steps the clock, the rate is corrected from the next ones */
+    for(i = 0; i < SIM_SECONDS / SYNC_PERIOD; i++)
+    {
+        utc = true_sec + true_us / US_PER_SEC - WALL_CLOCK_TZ_SECONDS;
+        wall_clock_sntp_set((rt_uint32_t)utc, (rt_uint32_t)(true_us % US_PER_SEC));
+        max_error = 0;
+        run(SYNC_PERIOD, true_sec, &max_error);
+    }
+    CHECK(clock_ppm > -220 && clock_ppm < -180, "rate correction %ld ppm", clock_ppm);
+    CHECK(max_error < 20000, "%lld us off between syncs", max_error);
+    CHECK(rtc_writes == SIM_SECONDS / SYNC_PERIOD, "pcf8563 written %d times", rtc_writes);
+    CHECK(rtc_sec == true_sec, "pcf8563 %lld s off", rtc_sec - true_sec);
+}
+
+/* set by hand steps the clock back and stops rate correction */
+static void test_set(void)
+{
+    long long max_error = 0;
+    RTC_T rtc;
+
+    /* set on a second boundary of true time */
+    true_us += US_PER_SEC - true_us % US_PER_SEC;
+    rtc_from_sec(946684800LL + 12345, &rtc);        /* 2000-01-01 */
+    CHECK(wall_clock_set(&rtc) == RT_EOK, "wall_clock_set");
+    CHECK(wall_clock_time(RT_NULL) == 946684800UL + 12345, "time after set %u",
+          wall_clock_time(RT_NULL));
+    CHECK(!clock_synced, "still synced after set");
+
+    run(60, rtc_sec, &max_error);
+    CHECK(max_error < 20000, "%lld us off after set", max_error);
+}
+
+int main(void)
+{
+    srand(1);
+    test_dates();
+    test_sntp();
+    test_set();
+
+    printf("wall clock: %s, %d errors\n", errors ? "FAIL" : "PASS", errors);
+
+    return errors ? 1 : 0;
+}
+
+/* ****************************** end of file ****************************** */
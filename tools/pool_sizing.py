@@ -0,0 +1,760 @@
+#!/usr/bin/env python3
+"""
+pool_sizing.py - size lwip heap and pools of LN firmware for its traffic.
+
+  pool_sizing.py stat DEVICE_IP [--reset] [--json FILE]
+      read heap and pool usage of a running device (CMD_NET_POOL_STAT on the
+      tcp management port). --json saves it for replay --usage.
+
+  pool_sizing.py replay CAPTURE.pcap --device DEVICE_IP
+                 [--config NAME:SPEC ...] [-D NAME=VALUE ...]
+                 [--usage FILE.json] [--headroom 1.25]
+      replay traffic of the device in a capture (classic pcap, ethernet)
+      against candidate configs and recommend pool sizes. SPEC is a comma
+      list of lwipopts-like headers and NAME=VALUE overrides, such as
+          --config now:rt-thread/components/lwip-2.0.2/src/lwipopts.h
+          --config small:rt-thread/components/lwip-2.0.2/src/lwipopts.h,MEM_SIZE=8192
+      -D gives rtconfig.h symbols (RT_LWIP_PBUF_NUM=8) to all headers.
+      With --usage a config "device" is added from the values the device
+      reported, and its max usage is a floor of recommendations.
+
+The replay models lwip 2.0.2 with the gd32 eth driver of this tree:
+  - rx frames take pool pbufs (ETH_RX_BUF_SIZE each), ETH_RXBUFNB pbufs stay
+    in dma descriptors. tcp data is held until the device window shows the
+    application read it, other frames are held for --rx-hold-ms.
+  - tcp data sent by the device takes a TCP_SEG and a PBUF_RAM from the heap
+    until acked, with oversize allocation while other data is unacked.
+  - udp sent by the device takes a PBUF_REF and a header from the heap until
+    sent, --tx-hold-ms.
+Heap fragmentation and retransmits missing from the capture are not
+modelled, which is what headroom is for.
+"""
+
+import argparse
+import heapq
+import json
+import math
+import os
+import re
+import socket
+import struct
+import sys
+
+TCP_SERVER_PORT     = 5211
+CMD_NET_POOL_STAT   = 44
+DEVICE_TYPE         = b"LN\0\0"
+
+ETH_RXBUFNB         = 4         # rx descriptors of gd32f20x_eth.c
+ETH_MIN_FRAME       = 60
+
+# 32-bit target sizes
+SIZEOF_STRUCT_PBUF  = 16
+SIZEOF_STRUCT_MEM   = 8
+SIZEOF_TCP_SEG      = 20
+SIZEOF_STRUCT_MEMP  = 12        # with MEMP_OVERFLOW_CHECK
+MEMP_SANITY_REGION  = 16        # before and after an element
+PBUF_IP_HLEN        = 20
+PBUF_TRANSPORT_HLEN = 20
+UDP_HLEN            = 8
+
+DEFAULT_OPTS = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir,
+                            "rt-thread", "components", "lwip-2.0.2", "src", "lwipopts.h")
+
+# lwip opt.h defaults for what a header leaves undefined
+OPT_DEFAULTS = [
+    ("MEM_ALIGNMENT",                   "1"),
+    ("MEM_SIZE",                        "1600"),
+    ("MEMP_OVERFLOW_CHECK",             "0"),
+    ("MEMP_NUM_PBUF",                   "16"),
+    ("TCP_MSS",                         "536"),
+    ("TCP_SND_BUF",                     "(2 * TCP_MSS)"),
+    ("TCP_WND",                         "(4 * TCP_MSS)"),
+    ("TCP_SND_QUEUELEN",                "((4 * (TCP_SND_BUF) + (TCP_MSS - 1))/(TCP_MSS))"),
+    ("MEMP_NUM_TCP_SEG",                "16"),
+    ("PBUF_POOL_SIZE",                  "16"),
+    ("PBUF_LINK_HLEN",                  "14"),
+    ("PBUF_LINK_ENCAPSULATION_HLEN",    "0"),
+    ("PBUF_POOL_BUFSIZE",               "LWIP_MEM_ALIGN_SIZE(TCP_MSS+40+PBUF_LINK_ENCAPSULATION_HLEN+PBUF_LINK_HLEN)"),
+]
+
+CONFIG_KEYS = ["MEM_SIZE", "PBUF_POOL_SIZE", "PBUF_POOL_BUFSIZE", "MEMP_NUM_PBUF",
+               "MEMP_NUM_TCP_SEG", "TCP_MSS", "TCP_SND_BUF", "TCP_WND",
+               "TCP_SND_QUEUELEN", "MEMP_OVERFLOW_CHECK", "MEM_ALIGNMENT",
+               "PBUF_LINK_HLEN", "PBUF_LINK_ENCAPSULATION_HLEN"]
+
+
+def align(value, alignment=4):
+    return (value + alignment - 1) // alignment * alignment
+
+
+# ---------------------------------------------------------------- stat ----
+
+def xor_verify(data):
+    result = 0
+    for b in data:
+        result ^= b
+    return result
+
+
+def read_pool_stat(ip, reset=False, timeout=5.0):
+    """query CMD_NET_POOL_STAT, returns the reply payload"""
+    payload = bytes([1 if reset else 0])
+    pack = struct.pack(">BI4sBH", CMD_NET_POOL_STAT, 0, DEVICE_TYPE, 0, len(payload)) + payload
+    pack += bytes([xor_verify(pack)])
+
+    with socket.create_connection((ip, TCP_SERVER_PORT), timeout=timeout) as sock:
+        sock.sendall(pack)
+        data = b""
+        while True:
+            if len(data) >= 12:
+                need = 12 + struct.unpack(">H", data[10:12])[0] + 1
+                if len(data) >= need:
+                    data = data[:need]
+                    break
+            chunk = sock.recv(2048)
+            if not chunk:
+                raise IOError("connection closed by device")
+            data += chunk
+
+    if xor_verify(data[:-1]) != data[-1] or data[0] != CMD_NET_POOL_STAT:
+        raise IOError("bad reply from device")
+    return data[12:-1]
+
+
+def parse_pool_stat(payload):
+    size, avail, used, mx, err, seconds, mss, snd_buf, wnd, bufsize, count = \
+        struct.unpack_from(">IIIIHIHHHHB", payload, 0)
+    usage = {
+        "heap": {"size": size, "avail": avail, "used": used, "max": mx, "err": err},
+        "seconds": seconds,
+        "TCP_MSS": mss, "TCP_SND_BUF": snd_buf, "TCP_WND": wnd, "PBUF_POOL_BUFSIZE": bufsize,
+        "pools": [],
+    }
+    pos = struct.calcsize(">IIIIHIHHHHB")
+    for _ in range(count):
+        name_len = payload[pos]
+        name = payload[pos + 1:pos + 1 + name_len].decode("ascii", "replace")
+        pos += 1 + name_len
+        esize, avail, used, mx, err = struct.unpack_from(">HHHHH", payload, pos)
+        pos += 10
+        usage["pools"].append({"name": name, "size": esize, "avail": avail,
+                               "used": used, "max": mx, "err": err})
+    return usage
+
+
+def print_usage(usage):
+    heap = usage["heap"]
+    print("%u seconds since reset, TCP_MSS %u TCP_SND_BUF %u TCP_WND %u PBUF_POOL_BUFSIZE %u"
+          % (usage["seconds"], usage["TCP_MSS"], usage["TCP_SND_BUF"], usage["TCP_WND"],
+             usage["PBUF_POOL_BUFSIZE"]))
+    print("%-26s %5s %5s %5s %5s %5s" % ("pool", "size", "avail", "used", "max", "err"))
+    print("%-26s %5u %5u %5u %5u %5u" % ("HEAP", heap["size"], heap["avail"], heap["used"],
+                                         heap["max"], heap["err"]))
+    for pool in usage["pools"]:
+        print("%-26s %5u %5u %5u %5u %5u" % (pool["name"], pool["size"], pool["avail"],
+                                             pool["used"], pool["max"], pool["err"]))
+
+
+def cmd_stat(args):
+    usage = parse_pool_stat(read_pool_stat(args.ip))
+    print_usage(usage)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(usage, f, indent=2)
+    if args.reset:
+        read_pool_stat(args.ip, reset=True)
+        print("usage reset")
+    return 0
+
+
+def usage_pool(usage, name):
+    for pool in usage["pools"]:
+        if pool["name"] == name:
+            return pool
+    return None
+
+
+# -------------------------------------------------------------- config ----
+
+class Config(dict):
+    """lwip options of a candidate, numbers only"""
+
+    def __init__(self, name, values):
+        dict.__init__(self, values)
+        self.name = name
+
+    def rx_buf_size(self):
+        return self["PBUF_POOL_BUFSIZE"] & ~3
+
+    def memp_overhead(self):
+        if not self["MEMP_OVERFLOW_CHECK"]:
+            return 0
+        return align(SIZEOF_STRUCT_MEMP) + 2 * MEMP_SANITY_REGION
+
+    def pool_element(self, size):
+        return self.memp_overhead() + align(size)
+
+    def sram(self):
+        """bytes of heap and pools modelled here"""
+        pool = self["PBUF_POOL_SIZE"] * self.pool_element(SIZEOF_STRUCT_PBUF + align(self["PBUF_POOL_BUFSIZE"]))
+        ref  = self["MEMP_NUM_PBUF"] * self.pool_element(SIZEOF_STRUCT_PBUF)
+        seg  = self["MEMP_NUM_TCP_SEG"] * self.pool_element(SIZEOF_TCP_SEG)
+        heap = align(self["MEM_SIZE"]) + 2 * SIZEOF_STRUCT_MEM
+        return heap + pool + ref + seg
+
+
+class HeaderParser(object):
+    """#define values of lwipopts-like headers, #if blocks on given symbols"""
+
+    TOKEN = re.compile(r"[A-Za-z_]\w*")
+
+    def __init__(self, defines):
+        self.raw = dict((k, str(v)) for k, v in defines.items())
+
+    def parse(self, path):
+        active = [True]
+        taken  = [True]
+        with open(path, encoding="latin-1") as f:
+            lines = f.read().replace("\\\n", " ").splitlines()
+        for line in lines:
+            line = re.sub(r"/\*.*?\*/|//.*", "", line).strip()
+            m = re.match(r"#\s*(\w+)\s*(.*)", line)
+            if not m:
+                continue
+            word, rest = m.group(1), m.group(2).strip()
+            if word in ("ifdef", "ifndef", "if"):
+                if word == "if":
+                    cond = self.cond(rest)
+                else:
+                    cond = (rest.split()[0] in self.raw) == (word == "ifdef")
+                active.append(active[-1] and cond)
+                taken.append(cond)
+            elif word == "elif":
+                cond = not taken[-1] and self.cond(rest)
+                active[-1] = active[-2] and cond
+                taken[-1] = taken[-1] or cond
+            elif word == "else":
+                active[-1] = active[-2] and not taken[-1]
+                taken[-1] = True
+            elif word == "endif":
+                active.pop()
+                taken.pop()
+            elif word == "define" and active[-1]:
+                m = re.match(r"(\w+)(\(?)\s*(.*)", rest)
+                if m and not m.group(2):
+                    self.raw[m.group(1)] = m.group(3).strip() or "1"
+            elif word == "undef" and active[-1]:
+                self.raw.pop(rest.split()[0], None)
+
+    def cond(self, expr):
+        expr = re.sub(r"defined\s*\(?\s*(\w+)\s*\)?",
+                      lambda m: "1" if m.group(1) in self.raw else "0", expr)
+        try:
+            return bool(self.value_of(expr, 0))
+        except (ValueError, SyntaxError, ZeroDivisionError, TypeError):
+            return False
+
+    def value(self, name, depth=0):
+        if name not in self.raw:
+            raise ValueError("%s undefined" % name)
+        return self.value_of(self.raw[name], depth + 1)
+
+    def value_of(self, expr, depth):
+        if depth > 32:
+            raise ValueError("recursive define")
+        funcs = {"LWIP_MEM_ALIGN_SIZE": lambda x: align(x, self.value("MEM_ALIGNMENT") if "MEM_ALIGNMENT" in self.raw else 1),
+                 "LWIP_MIN": min, "LWIP_MAX": max}
+
+        def subst(m):
+            word = m.group(0)
+            if word in funcs or word in ("and", "or", "not"):
+                return word
+            return str(self.value(word, depth))
+
+        expr = re.sub(r"\b(0[xX][0-9a-fA-F]+|\d+)[uUlL]*\b", r"\1", expr)
+        expr = expr.replace("&&", " and ").replace("||", " or ")
+        expr = re.sub(r"!(?!=)", " not ", expr).replace("/", "//")
+        expr = self.TOKEN.sub(subst, expr)
+        return int(eval(expr, {"__builtins__": {}}, funcs))
+
+
+def load_config(name, spec, defines):
+    parser = HeaderParser(defines)
+    overrides = {}
+    for item in filter(None, spec.split(",")):
+        if "=" in item:
+            key, value = item.split("=", 1)
+            overrides[key.strip()] = value.strip()
+        else:
+            parser.parse(item)
+    parser.raw.update(overrides)
+    for key, expr in OPT_DEFAULTS:
+        parser.raw.setdefault(key, expr)
+
+    values = {}
+    for key in CONFIG_KEYS:
+        try:
+            values[key] = parser.value(key)
+        except (ValueError, SyntaxError, ZeroDivisionError, TypeError) as e:
+            raise SystemExit("config %s: %s: %s" % (name, key, e))
+    return Config(name, values)
+
+
+def device_config(usage, base):
+    """config of the device from its CMD_NET_POOL_STAT reply"""
+    values = dict(base)
+    values["MEM_SIZE"]          = usage["heap"]["size"]
+    values["TCP_MSS"]           = usage["TCP_MSS"]
+    values["TCP_SND_BUF"]       = usage["TCP_SND_BUF"]
+    values["TCP_WND"]           = usage["TCP_WND"]
+    values["PBUF_POOL_BUFSIZE"] = usage["PBUF_POOL_BUFSIZE"]
+    values["TCP_SND_QUEUELEN"]  = 4 * usage["TCP_SND_BUF"] // usage["TCP_MSS"]
+    for key, pool in (("PBUF_POOL_SIZE", "PBUF_POOL"), ("MEMP_NUM_PBUF", "PBUF_REF/ROM"),
+                      ("MEMP_NUM_TCP_SEG", "TCP_SEG")):
+        stat = usage_pool(usage, pool)
+        if stat is not None and stat["avail"]:
+            values[key] = stat["avail"]
+    return Config("device", values)
+
+
+# ---------------------------------------------------------------- pcap ----
+
+class Packet(object):
+    __slots__ = ("time", "wire_len", "rx", "tx", "proto", "src", "dst", "sport", "dport",
+                 "seq", "ack", "flags", "win", "payload_len")
+
+
+def read_pcap(path, device_ip):
+    """packets sent or received by device_ip, ethernet frames only"""
+    device = socket.inet_aton(device_ip)
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < 24:
+        raise SystemExit("%s: not a pcap file" % path)
+
+    magic = data[:4]
+    if magic == b"\x0a\x0d\x0d\x0a":
+        raise SystemExit("%s: pcapng, convert with: editcap -F pcap in.pcapng out.pcap" % path)
+    formats = {b"\xd4\xc3\xb2\xa1": ("<", 1e-6), b"\xa1\xb2\xc3\xd4": (">", 1e-6),
+               b"\x4d\x3c\xb2\xa1": ("<", 1e-9), b"\xa1\xb2\x3c\x4d": (">", 1e-9)}
+    if magic not in formats:
+        raise SystemExit("%s: not a pcap file" % path)
+    endian, unit = formats[magic]
+    linktype = struct.unpack(endian + "I", data[20:24])[0]
+    if linktype != 1:
+        raise SystemExit("%s: link type %d, only ethernet is supported" % (path, linktype))
+
+    device_mac = None
+    frames = []
+    pos = 24
+    while pos + 16 <= len(data):
+        sec, frac, incl, orig = struct.unpack(endian + "IIII", data[pos:pos + 16])
+        frame = data[pos + 16:pos + 16 + incl]
+        pos += 16 + incl
+        if len(frame) < 14:
+            continue
+        frames.append((sec + frac * unit, orig, frame))
+        ip = ipv4_of(frame)
+        if device_mac is None and ip is not None and ip[12:16] == device:
+            device_mac = frame[6:12]
+    if device_mac is None:
+        raise SystemExit("%s: nothing sent by %s" % (path, device_ip))
+
+    packets = []
+    for time, orig, frame in sorted(frames, key=lambda x: x[0]):
+        pkt = Packet()
+        pkt.time = time
+        pkt.wire_len = max(orig, ETH_MIN_FRAME)
+        pkt.tx = frame[6:12] == device_mac
+        pkt.rx = not pkt.tx and (frame[0:6] == device_mac or bool(frame[0] & 1))
+        if not (pkt.rx or pkt.tx):
+            continue
+        pkt.proto = None
+        pkt.payload_len = 0
+        ip = ipv4_of(frame)
+        if ip is not None:
+            parse_ipv4(pkt, ip)
+        packets.append(pkt)
+    return packets
+
+
+def ipv4_of(frame):
+    ethertype = struct.unpack(">H", frame[12:14])[0]
+    offset = 14
+    if ethertype == 0x8100 and len(frame) >= 18:
+        ethertype = struct.unpack(">H", frame[16:18])[0]
+        offset = 18
+    if ethertype != 0x0800 or len(frame) < offset + 20:
+        return None
+    return frame[offset:]
+
+
+def parse_ipv4(pkt, ip):
+    ihl = (ip[0] & 0x0f) * 4
+    total = struct.unpack(">H", ip[2:4])[0]
+    frag = struct.unpack(">H", ip[6:8])[0] & 0x1fff
+    pkt.src, pkt.dst = ip[12:16], ip[16:20]
+    if frag != 0:
+        return
+    l4 = ip[ihl:total]
+    if ip[9] == 6 and len(l4) >= 20:
+        pkt.proto = "tcp"
+        pkt.sport, pkt.dport, pkt.seq, pkt.ack, off, pkt.flags, pkt.win = \
+            struct.unpack(">HHIIBBH", l4[:16])
+        pkt.payload_len = total - ihl - (off >> 4) * 4
+    elif ip[9] == 17 and len(l4) >= 8:
+        pkt.proto = "udp"
+        pkt.sport, pkt.dport = struct.unpack(">HH", l4[:4])
+        pkt.payload_len = total - ihl - UDP_HLEN
+
+
+# -------------------------------------------------------------- replay ----
+
+TCP_FIN, TCP_SYN, TCP_ACK = 0x01, 0x02, 0x10
+
+
+def seq_le(a, b):
+    return ((b - a) & 0xffffffff) < 0x80000000
+
+
+class Flow(object):
+    def __init__(self):
+        self.rx_held   = []        # [seq_end, pbufs, bytes] waiting for application
+        self.rx_bytes  = 0
+        self.rcv_wnd   = 0         # largest window the device advertised
+        self.tx_held   = []        # [seq_end, heap, segs, bytes] waiting for ack
+        self.tx_bytes  = 0
+        self.snd_max   = None
+        self.dev_ack   = None      # last ack and window sent by device
+        self.dev_win   = 0
+        self.peer_win  = 0
+
+
+class Replay(object):
+    """occupancy of heap and pools of a config along the capture"""
+
+    def __init__(self, config, rx_hold, tx_hold):
+        self.c = config
+        self.rx_hold = rx_hold
+        self.tx_hold = tx_hold
+        self.flows = {}
+        self.timers = []           # (time, kind, amount) freed later
+        self.use  = {"pool": 0, "heap": 0, "seg": 0, "ref": 0}
+        self.peak = dict(self.use)
+        self.fail = {"pool": 0, "heap": 0, "seg": 0, "ref": 0}
+        self.rx_deferred = 0       # segments the peer could not send in TCP_WND
+        self.tx_deferred = 0       # segments the device could not queue in TCP_SND_BUF
+
+    def alloc(self, kind, amount, limit):
+        if self.use[kind] + amount > limit:
+            self.fail[kind] += 1
+            return False
+        self.use[kind] += amount
+        self.peak[kind] = max(self.peak[kind], self.use[kind])
+        return True
+
+    def free(self, kind, amount):
+        self.use[kind] -= amount
+
+    def heap_block(self, size):
+        return align(max(size, 12), self.c["MEM_ALIGNMENT"]) + SIZEOF_STRUCT_MEM
+
+    def pbuf_ram(self, offset, length):
+        return self.heap_block(align(SIZEOF_STRUCT_PBUF + offset) + align(length))
+
+    def run(self, packets):
+        for pkt in packets:
+            while self.timers and self.timers[0][0] <= pkt.time:
+                _, kind, amount = heapq.heappop(self.timers)
+                self.free(kind, amount)
+            if pkt.rx:
+                self.receive(pkt)
+            else:
+                self.send(pkt)
+        return self
+
+    def later(self, time, kind, amount):
+        heapq.heappush(self.timers, (time, kind, amount))
+
+    def flow_of(self, pkt):
+        if pkt.rx:
+            key = (pkt.dport, pkt.src, pkt.sport)
+        else:
+            key = (pkt.sport, pkt.dst, pkt.dport)
+        return self.flows.setdefault(key, Flow())
+
+    def receive(self, pkt):
+        pbufs = (pkt.wire_len + self.c.rx_buf_size() - 1) // self.c.rx_buf_size()
+        if pkt.proto == "tcp":
+            flow = self.flow_of(pkt)
+            self.acked(flow, pkt)
+            if pkt.payload_len > 0:
+                if flow.rx_bytes + pkt.payload_len > self.c["TCP_WND"]:
+                    self.rx_deferred += 1
+                    return
+                if not self.alloc("pool", pbufs, self.c["PBUF_POOL_SIZE"] - ETH_RXBUFNB):
+                    return
+                flow.rx_held.append([(pkt.seq + pkt.payload_len) & 0xffffffff, pbufs, pkt.payload_len])
+                flow.rx_bytes += pkt.payload_len
+                return
+        if self.alloc("pool", pbufs, self.c["PBUF_POOL_SIZE"] - ETH_RXBUFNB):
+            self.later(pkt.time + self.rx_hold, "pool", pbufs)
+
+    def acked(self, flow, pkt):
+        """peer acked data of device"""
+        flow.peer_win = pkt.win
+        if not (pkt.flags & TCP_ACK):
+            return
+        while flow.tx_held and seq_le(flow.tx_held[0][0], pkt.ack):
+            _, heap, segs, length = flow.tx_held.pop(0)
+            self.free("heap", heap)
+            self.free("seg", segs)
+            flow.tx_bytes -= length
+
+    def read(self, flow, pkt):
+        """device window shows data read by application"""
+        flow.rcv_wnd = max(flow.rcv_wnd, pkt.win)
+        flow.dev_ack, flow.dev_win = pkt.ack, pkt.win
+        read_to = (pkt.ack + pkt.win - flow.rcv_wnd) & 0xffffffff
+        while flow.rx_held and seq_le(flow.rx_held[0][0], read_to):
+            _, pbufs, length = flow.rx_held.pop(0)
+            self.free("pool", pbufs)
+            flow.rx_bytes -= length
+
+    def send(self, pkt):
+        c = self.c
+        if pkt.proto == "udp":
+            if self.alloc("ref", 1, c["MEMP_NUM_PBUF"]):
+                self.later(pkt.time + self.tx_hold, "ref", 1)
+            heap = self.pbuf_ram(c["PBUF_LINK_HLEN"] + PBUF_IP_HLEN, UDP_HLEN)
+            if self.alloc("heap", heap, c["MEM_SIZE"]):
+                self.later(pkt.time + self.tx_hold, "heap", heap)
+            return
+        if pkt.proto != "tcp":
+            return
+
+        flow = self.flow_of(pkt)
+        if pkt.flags & TCP_ACK:
+            self.read(flow, pkt)
+        end = (pkt.seq + pkt.payload_len + ((pkt.flags & (TCP_SYN | TCP_FIN)) != 0)) & 0xffffffff
+        if flow.snd_max is not None and seq_le(end, flow.snd_max):
+            # header only or resent, header pbuf is freed when sent
+            heap = self.pbuf_ram(c["PBUF_LINK_HLEN"] + PBUF_IP_HLEN, PBUF_TRANSPORT_HLEN)
+            if self.alloc("heap", heap, c["MEM_SIZE"]):
+                self.later(pkt.time + self.tx_hold, "heap", heap)
+            return
+
+        new = pkt.payload_len
+        if flow.snd_max is not None and pkt.payload_len > 0:
+            new = min(pkt.payload_len, (end - flow.snd_max) & 0xffffffff)
+        flow.snd_max = end
+        if new == 0 and not (pkt.flags & (TCP_SYN | TCP_FIN)):
+            return
+        if flow.tx_bytes + new > c["TCP_SND_BUF"]:
+            self.tx_deferred += 1
+            return
+
+        segs = max(1, (new + c["TCP_MSS"] - 1) // c["TCP_MSS"])
+        if sum(h[2] for h in flow.tx_held) + segs > c["TCP_SND_QUEUELEN"]:
+            self.tx_deferred += 1
+            return
+        offset = c["PBUF_LINK_HLEN"] + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN
+        heap = 0
+        left = new
+        for _ in range(segs):
+            length = min(left, c["TCP_MSS"])
+            left -= length
+            if flow.tx_held and length < c["TCP_MSS"]:
+                # tcp_pbuf_prealloc() oversizes while data is unacked
+                length = min(c["TCP_MSS"], align(length + c["TCP_MSS"]))
+            heap += self.pbuf_ram(offset, length)
+        if not self.alloc("seg", segs, c["MEMP_NUM_TCP_SEG"]):
+            return
+        if not self.alloc("heap", heap, c["MEM_SIZE"]):
+            self.free("seg", segs)
+            return
+        flow.tx_held.append([end, heap, segs, new])
+        flow.tx_bytes += new
+
+
+def window_limits(packets):
+    """share of bulk data segments sent while a window was full"""
+    flows = {}
+    rx_full = rx_all = tx_full = tx_all = 0
+    for pkt in packets:
+        if pkt.proto != "tcp":
+            continue
+        key = (pkt.dport, pkt.src, pkt.sport) if pkt.rx else (pkt.sport, pkt.dst, pkt.dport)
+        f = flows.setdefault(key, {"dev_ack": None, "dev_win": 0, "peer_ack": None,
+                                   "peer_win": 0, "mss": 0, "rx": 0, "tx": 0, "rx_full": 0,
+                                   "tx_full": 0, "tx_max": 0})
+        if pkt.rx:
+            if pkt.flags & TCP_ACK:
+                f["peer_ack"], f["peer_win"] = pkt.ack, pkt.win
+            if pkt.payload_len > 0 and f["dev_ack"] is not None:
+                f["mss"] = max(f["mss"], pkt.payload_len)
+                in_flight = (pkt.seq + pkt.payload_len - f["dev_ack"]) & 0xffffffff
+                f["rx"] += 1
+                f["rx_full"] += in_flight + f["mss"] > f["dev_win"]
+        else:
+            if pkt.flags & TCP_ACK:
+                f["dev_ack"], f["dev_win"] = pkt.ack, pkt.win
+            if pkt.payload_len > 0 and f["peer_ack"] is not None:
+                f["mss"] = max(f["mss"], pkt.payload_len)
+                unacked = (pkt.seq + pkt.payload_len - f["peer_ack"]) & 0xffffffff
+                f["tx"] += 1
+                f["tx_max"] = max(f["tx_max"], unacked)
+                # full send buffer, not a full peer window
+                f["tx_full"] += unacked + f["mss"] <= f["peer_win"] and unacked >= 2 * f["mss"]
+    for f in flows.values():
+        if f["rx"] >= 32:
+            rx_all += f["rx"]
+            rx_full += f["rx_full"]
+        if f["tx"] >= 32:
+            tx_all += f["tx"]
+            tx_full += f["tx_full"]
+    return (rx_full / rx_all if rx_all else 0.0), (tx_full / tx_all if tx_all else 0.0)
+
+
+def recommend(config, result, usage, headroom, rx_limited, tx_limited):
+    """options for config from its replay peaks"""
+    rec = {}
+
+    def floor(pool, value):
+        if usage is None:
+            return value
+        stat = usage_pool(usage, pool)
+        return max(value, stat["max"] + (stat["err"] > 0)) if stat else value
+
+    pool = int(math.ceil(result.peak["pool"] * headroom)) + ETH_RXBUFNB
+    rec["PBUF_POOL_SIZE"] = floor("PBUF_POOL", pool)
+    rec["MEMP_NUM_PBUF"]  = floor("PBUF_REF/ROM", max(2, int(math.ceil(result.peak["ref"] * headroom))))
+    rec["MEMP_NUM_TCP_SEG"] = max(floor("TCP_SEG", int(math.ceil(result.peak["seg"] * headroom))),
+                                  config["TCP_SND_QUEUELEN"])
+    heap = int(math.ceil(result.peak["heap"] * headroom))
+    if usage is not None:
+        heap = max(heap, int(math.ceil(usage["heap"]["max"] * headroom)))
+    rec["MEM_SIZE"] = max(align(heap, 1024), 4096)
+    rec["TCP_WND"] = config["TCP_WND"]
+    rec["TCP_SND_BUF"] = config["TCP_SND_BUF"]
+
+    notes = []
+    if usage is not None:
+        for stat in [dict(usage["heap"], name="HEAP")] + usage["pools"]:
+            if stat["err"]:
+                notes.append("device failed %d allocations of %s" % (stat["err"], stat["name"]))
+    if rx_limited > 0.3 and config["TCP_WND"] * 2 <= 0xffff:
+        rec["TCP_WND"] = config["TCP_WND"] * 2
+        extra = int(math.ceil(config["TCP_WND"] / float(config.rx_buf_size())))
+        rec["PBUF_POOL_SIZE"] += extra
+        notes.append("device window was full for %d%% of bulk rx segments: TCP_WND doubled, "
+                     "%d more pool pbufs back it" % (rx_limited * 100, extra))
+    if tx_limited > 0.3:
+        rec["TCP_SND_BUF"] = config["TCP_SND_BUF"] * 2
+        rec["MEM_SIZE"] = align(rec["MEM_SIZE"] + config["TCP_SND_BUF"] + 1024, 1024)
+        notes.append("send buffer was full for %d%% of bulk tx segments: TCP_SND_BUF doubled "
+                     "and heap grown" % (tx_limited * 100))
+    queuelen = 4 * rec["TCP_SND_BUF"] // config["TCP_MSS"]
+    rec["MEMP_NUM_TCP_SEG"] = max(rec["MEMP_NUM_TCP_SEG"], queuelen)
+    return rec, notes
+
+
+def cmd_replay(args):
+    defines = {}
+    for item in args.define:
+        key, _, value = item.partition("=")
+        defines[key] = value or "1"
+
+    configs = []
+    for item in args.config or ["now:" + DEFAULT_OPTS]:
+        name, _, spec = item.partition(":")
+        configs.append(load_config(name, spec, defines))
+
+    usage = None
+    if args.usage:
+        with open(args.usage) as f:
+            usage = json.load(f)
+        configs.append(device_config(usage, configs[0]))
+
+    packets = read_pcap(args.capture, args.device)
+    if not packets:
+        raise SystemExit("no packets of %s" % args.device)
+    span = packets[-1].time - packets[0].time
+    rx_limited, tx_limited = window_limits(packets)
+    print("%d packets of %s in %.1f s, rx %d tx %d"
+          % (len(packets), args.device, span, sum(p.rx for p in packets),
+             sum(p.tx for p in packets)))
+    print()
+
+    print("%-10s %8s %8s %8s %8s %8s %8s %8s %8s" % ("config", "sram", "pool", "heap",
+          "seg", "ref", "fails", "rx_wait", "tx_wait"))
+    results = []
+    for config in configs:
+        result = Replay(config, args.rx_hold_ms / 1000.0, args.tx_hold_ms / 1000.0).run(packets)
+        results.append(result)
+        print("%-10s %8d %4d/%-3d %8s %4d/%-3d %4d/%-3d %8d %8d %8d"
+              % (config.name, config.sram(),
+                 result.peak["pool"] + ETH_RXBUFNB, config["PBUF_POOL_SIZE"],
+                 "%d/%d" % (result.peak["heap"], config["MEM_SIZE"]),
+                 result.peak["seg"], config["MEMP_NUM_TCP_SEG"],
+                 result.peak["ref"], config["MEMP_NUM_PBUF"],
+                 sum(result.fail.values()), result.rx_deferred, result.tx_deferred))
+    print()
+
+    base = configs[-1] if usage is not None else configs[0]
+    result = results[configs.index(base)]
+    rec, notes = recommend(base, result, usage, args.headroom, rx_limited, tx_limited)
+    sized = Config("recommended", dict(base, **rec))
+    sized["TCP_SND_QUEUELEN"] = 4 * sized["TCP_SND_BUF"] // sized["TCP_MSS"]
+    check = Replay(sized, args.rx_hold_ms / 1000.0, args.tx_hold_ms / 1000.0).run(packets)
+
+    print("recommended from %s, headroom %.2f:" % (base.name, args.headroom))
+    for key in ("MEM_SIZE", "PBUF_POOL_SIZE", "MEMP_NUM_PBUF", "MEMP_NUM_TCP_SEG",
+                "TCP_SND_BUF", "TCP_WND"):
+        mark = "" if rec[key] == base[key] else "    /* was %d */" % base[key]
+        print("#define %-24s %d%s" % (key, rec[key], mark))
+    for note in notes:
+        print("/* %s */" % note)
+    print("sram %d bytes, %+d from %s, %d failures in replay"
+          % (sized.sram(), sized.sram() - base.sram(), base.name, sum(check.fail.values())))
+    if base["MEMP_OVERFLOW_CHECK"]:
+        elements = base["PBUF_POOL_SIZE"] + base["MEMP_NUM_PBUF"] + base["MEMP_NUM_TCP_SEG"]
+        if usage is not None:
+            elements = sum(p["avail"] for p in usage["pools"])
+        print("MEMP_OVERFLOW_CHECK costs %d bytes over %d pool elements"
+              % (elements * base.memp_overhead(), elements))
+    return 0
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="size lwip heap and pools of LN firmware")
+    sub = parser.add_subparsers(dest="command")
+
+    p = sub.add_parser("stat", help="read heap and pool usage of a device")
+    p.add_argument("ip")
+    p.add_argument("--reset", action="store_true", help="restart max and failures after reading")
+    p.add_argument("--json", help="save usage for replay --usage")
+    p.set_defaults(func=cmd_stat)
+
+    p = sub.add_parser("replay", help="replay a capture against configs")
+    p.add_argument("capture")
+    p.add_argument("--device", required=True, help="ip of the device in the capture")
+    p.add_argument("--config", action="append", help="NAME:HEADER[,NAME=VALUE...]")
+    p.add_argument("-D", dest="define", action="append", default=[], help="rtconfig symbol")
+    p.add_argument("--usage", help="json saved by stat")
+    p.add_argument("--headroom", type=float, default=1.25)
+    p.add_argument("--rx-hold-ms", type=float, default=1.0,
+                   help="time a frame other than tcp data is held")
+    p.add_argument("--tx-hold-ms", type=float, default=0.5,
+                   help="time a frame sent is held by eth dma")
+    p.set_defaults(func=cmd_replay)
+
+    args = parser.parse_args(argv)
+    if not hasattr(args, "func"):
+        parser.print_help()
+        return 2
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
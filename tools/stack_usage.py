@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""
+stack_usage.py - compile time stack usage report of LN firmware threads.
+
+  stack_usage.py BUILD_DIR... [--entry FUNC[=SIZE] ...] [--top N]
+
+Build with gcc and
+    -fstack-usage -fcallgraph-info=su
+so every object has a .su file of function frames and a .ci call graph. The
+report lists the largest frames, then for each thread the deepest call path
+from its entry function, the stack it needs with the context saved at a
+switch, and the size suggested the way list_stack of stack_monitor.c does:
+the need with 25% margin, 64 bytes aligned.
+
+Threads are the rt_thread_create() calls of applications/application.c with
+stack sizes of user_thread_cfg.h, --entry adds others, such as
+    --entry eth_rx_thread_entry=1024
+
+The need is a floor, not a bound, where the path has:
+  - recursion, each function is counted once
+  - calls through pointers (finsh commands, lwip callbacks, hooks)
+  - functions without .su, such as libc and assembly
+  - dynamic frames (alloca, variable length arrays)
+list_stack on the device measures what the threads really used.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir)
+APPLICATION_C = os.path.join(ROOT, "applications", "application.c")
+THREAD_CFG_H = os.path.join(ROOT, "applications", "user_thread", "user_thread_cfg.h")
+
+CONTEXT_BYTES = 64              # r0-r12, lr, pc, psr saved by a switch on cortex-m3
+INDIRECT = "__indirect_call"
+
+SU_LINE = re.compile(r"^(?:(.*?):(\d+):(\d+):)?(\S+)\t(\d+)\t(\S+)")
+CI_NODE = re.compile(r'^node: \{ title: "([^"]+)" label: "([^"]*)"')
+CI_EDGE = re.compile(r'^edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+CI_FRAME = re.compile(r"(\d+) bytes \(([^)]+)\)")
+
+
+class Function:
+    def __init__(self, key, name, where, frame, qualifier):
+        self.key = key
+        self.name = name
+        self.where = where
+        self.frame = frame
+        self.qualifier = qualifier  # static, dynamic or dynamic,bounded
+        self.callees = set()
+
+
+def suggest(need):
+    """STACK_SUGGEST of stack_monitor.c"""
+    size = need + need // 4
+    return (size + 63) & ~63
+
+
+def find_files(paths, ext):
+    for path in paths:
+        if os.path.isfile(path):
+            if path.endswith(ext):
+                yield path
+            continue
+        for top, _, files in os.walk(path):
+            for name in files:
+                if name.endswith(ext):
+                    yield os.path.join(top, name)
+
+
+def load_su(paths, funcs):
+    """frames of .su files, for objects built without -fcallgraph-info"""
+    known = set((f.name, f.where) for f in funcs.values())
+    for path in find_files(paths, ".su"):
+        with open(path) as f:
+            for line in f:
+                m = SU_LINE.match(line)
+                if not m:
+                    continue
+                src, row, col, name, frame, qualifier = m.groups()
+                where = "%s:%s:%s" % (src, row, col) if src else os.path.basename(path)
+                if (name, where) in known:
+                    continue
+                known.add((name, where))
+                # a static function of the same name is keyed as in .ci, "file:name"
+                key = name if name not in funcs else "%s:%s" % (os.path.basename(src or path), name)
+                funcs[key] = Function(key, name, where, int(frame), qualifier)
+
+
+def load_ci(paths, funcs):
+    edges = []
+    for path in find_files(paths, ".ci"):
+        with open(path) as f:
+            for line in f:
+                m = CI_NODE.match(line)
+                if m:
+                    key, label = m.groups()
+                    if key == INDIRECT:
+                        continue
+                    parts = label.split("\\n")
+                    frame = CI_FRAME.search(label)
+                    if frame is None:
+                        # declared only, the frame comes from its own unit
+                        continue
+                    funcs[key] = Function(key, parts[0], parts[1] if len(parts) > 1 else "",
+                                          int(frame.group(1)), frame.group(2))
+                    continue
+                m = CI_EDGE.match(line)
+                if m:
+                    edges.append(m.groups())
+    for src, dst in edges:
+        if src in funcs:
+            funcs[src].callees.add(dst)
+    return len(edges) > 0
+
+
+def deepest(key, funcs, memo, stack):
+    """(bytes, path, notes) of the deepest path from key"""
+    if key in memo:
+        return memo[key]
+    func = funcs.get(key)
+    if func is None:
+        name = key.split(":")[-1]
+        note = "calls through pointers" if key == INDIRECT else "no frame of %s" % name
+        return 0, [name], {note}
+    if key in stack:
+        return 0, [func.name + " (recursion)"], {"recursion in %s" % func.name}
+
+    stack.add(key)
+    best = (0, [], set())
+    notes = set()
+    for callee in sorted(func.callees):
+        result = deepest(callee, funcs, memo, stack)
+        notes |= result[2]
+        if result[0] > best[0] or not best[1]:
+            best = result
+    stack.discard(key)
+
+    if func.qualifier.startswith("dynamic"):
+        notes.add("dynamic frame of %s" % func.name)
+    memo[key] = (func.frame + best[0], [func.name] + best[1], notes)
+    return memo[key]
+
+
+def thread_entries():
+    """(entry, stack size) of threads created by application.c"""
+    sizes = {}
+    try:
+        with open(THREAD_CFG_H) as f:
+            for line in f:
+                m = re.match(r"#define\s+(RT_THREAD_STACK_SIZE_\w+)\s+\(([^)]*)\)", line)
+                if m:
+                    sizes[m.group(1)] = eval(m.group(2), {})
+        with open(APPLICATION_C) as f:
+            text = f.read()
+    except OSError:
+        return []
+
+    entries = []
+    for m in re.finditer(r"rt_thread_create\(\s*\w+\s*,\s*(\w+)\s*,\s*\w+\s*,\s*(\w+)", text):
+        entry, size = m.groups()
+        entries.append((entry, sizes.get(size)))
+    return entries
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="stack usage report of LN firmware threads")
+    parser.add_argument("paths", nargs="+", help="build directories or .su/.ci files")
+    parser.add_argument("--entry", action="append", default=[],
+                        help="FUNC[=SIZE], a thread entry to report")
+    parser.add_argument("--top", type=int, default=20, help="largest frames listed")
+    args = parser.parse_args(argv)
+
+    funcs = {}
+    have_graph = load_ci(args.paths, funcs)
+    load_su(args.paths, funcs)
+    if not funcs:
+        print("no .su files, build with -fstack-usage -fcallgraph-info=su")
+        return 1
+
+    print("largest frames")
+    print("%6s  %-16s %-28s %s" % ("bytes", "qualifier", "function", "location"))
+    for func in sorted(funcs.values(), key=lambda f: -f.frame)[:args.top]:
+        print("%6d  %-16s %-28s %s" % (func.frame, func.qualifier, func.name, func.where))
+
+    if not have_graph:
+        print("\nno .ci files, build with -fcallgraph-info=su for thread stacks")
+        return 0
+
+    entries = thread_entries()
+    for spec in args.entry:
+        name, _, size = spec.partition("=")
+        entries.append((name, int(size, 0) if size else None))
+
+    print("\nthread stacks, need = deepest path + %d bytes context" % CONTEXT_BYTES)
+    print("%-24s %6s %6s %8s  %s" % ("entry", "size", "need", "suggest", "deepest path"))
+    memo = {}
+    status = 0
+    for entry, size in entries:
+        need, path, notes = deepest(entry, funcs, memo, set())
+        if entry not in funcs:
+            print("%-24s %6s %6s %8s  not found" % (entry, size or "-", "-", "-"))
+            continue
+        need += CONTEXT_BYTES
+        flag = ""
+        if size is not None and need > size:
+            flag = "  OVERFLOW"
+            status = 1
+        print("%-24s %6s %5d%s %8d  %s%s" % (entry, size or "-", need, "+" if notes else " ",
+                                             suggest(need), " > ".join(path), flag))
+        for note in sorted(notes):
+            print("%24s   + %s" % ("", note))
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())